@@ -6,6 +6,9 @@
 #include <stdio.h>
 #include "pico/stdlib.h"
 #include "hardware/i2c.h"
+#include "codec_seq.h"
+#include "codec.h"
+#include "trace.h"
 #include "aic3101.h"
 
 #define I2C_PORT i2c0
@@ -16,49 +19,59 @@
 /* The 7 bits AIC3101 address (sent through I2C interface) */
 #define AIC3101_ADDR 0x18
 
-/* Codec register settings. contents is ADDR, DATA per line */
-#define REG_EOF 0xff
+/* register address & data widths */
+#define AIC3101_REG_BITS 7
+#define AIC3101_VAL_BITS 8
+#define WR(r, v) SEQ_WR(AIC3101_REG_BITS, AIC3101_VAL_BITS, r, v)
+#define BURST(r, n) SEQ_BURST(AIC3101_REG_BITS, r, n)
+#define DATA(v) SEQ_DATA(AIC3101_VAL_BITS, v)
+
+/* Codec register settings */
 #if 0
 /* With PLL, with Int MCLK */
-static uint8_t codec_settings[] = 
+static const codec_seq_t codec_settings[] CODEC_SEQ =
 {
-	3,		0x91,	// PLL A - PLL ena, Q=2, P=1
-	4,		0x80,	// PLL B - J=32 : PLL rate = ((32.0 * 2) / (1 * 8)) * BCLK = Fs*256
-	7,		0x0A,	// datapath setup - left dac/left in, right dac/right in
-	11,		0x02,	// ovfl setup - PLL R = 2
-	15,		0x00,	// Left PGA - unmuted, 0dB
-	16,		0x00,	// Right PGA - unmuted, 0dB
-	19,		0x04,	// Left ADC - enabled, MIC1LP single, 0dB
-	22,		0x04,	// Right ADC - enabled, MIC1RP single, 0dB
-	37,		0xC0,	// DAC Power - left/right DACs enabled
-	41,		0x50,	// DAC Output Switching - use L3/R3 & independent vol
-	43,		0x00,	// Left DAC - unmuted, 0dB
-	44,		0x00,	// Right DAC - unmuted, 0dB
-	86,		0x09,	// Left LOP/M - umuted, 0dB, enabled (NOTE - DS error, bit 0 is R/W)
-	93,		0x09,	// Right LOP/M - umuted, 0dB, enabled (NOTE - DS error, bit 0 is R/W)
-	102,	0xA2,	// Clockgen - CLKDIV_IN uses BCLK, PLLDIV_IN uses BCLK
-	109,	0xC0,	// DAC Current - 100% increase over default
-	REG_EOF,		// EOF
+	WR(3,	0x91),	// PLL A - PLL ena, Q=2, P=1
+	WR(4,	0x80),	// PLL B - J=32 : PLL rate = ((32.0 * 2) / (1 * 8)) * BCLK = Fs*256
+	WR(7,	0x0A),	// datapath setup - left dac/left in, right dac/right in
+	WR(11,	0x02),	// ovfl setup - PLL R = 2
+	BURST(15, 2),	// Left/Right PGA
+	DATA(0x00),		//  Left PGA - unmuted, 0dB
+	DATA(0x00),		//  Right PGA - unmuted, 0dB
+	WR(19,	0x04),	// Left ADC - enabled, MIC1LP single, 0dB
+	WR(22,	0x04),	// Right ADC - enabled, MIC1RP single, 0dB
+	WR(37,	0xC0),	// DAC Power - left/right DACs enabled
+	WR(41,	0x50),	// DAC Output Switching - use L3/R3 & independent vol
+	BURST(43, 2),	// Left/Right DAC
+	DATA(0x00),		//  Left DAC - unmuted, 0dB
+	DATA(0x00),		//  Right DAC - unmuted, 0dB
+	WR(86,	0x09),	// Left LOP/M - umuted, 0dB, enabled (NOTE - DS error, bit 0 is R/W)
+	WR(93,	0x09),	// Right LOP/M - umuted, 0dB, enabled (NOTE - DS error, bit 0 is R/W)
+	WR(102,	0xA2),	// Clockgen - CLKDIV_IN uses BCLK, PLLDIV_IN uses BCLK
+	WR(109,	0xC0),	// DAC Current - 100% increase over default
+	SEQ_END
 };
 #else
 /* No PLL, with Ext MCLK */
-static uint8_t codec_settings[] = 
+static const codec_seq_t codec_settings[] CODEC_SEQ =
 {
-	7,		0x0A,	// datapath setup - left dac/left in, right dac/right in
-	19,		0x04,	// Left ADC - enabled, 0dB
-	15,		0x00,	// Left PGA - unmuted, 0dB
-	16,		0x00,	// Right PGA - unmuted, 0dB
-	19,		0x04,	// Left ADC - enabled, MIC1LP single, 0dB
-	22,		0x04,	// Right ADC - enabled, 0dB
-	37,		0xC0,	// DAC Power - left/right DACs enabled
-	41,		0x50,	// DAC Output Switching - use L3/R3 & independent vol
-	43,		0x00,	// Left DAC - unmuted, 0dB
-	44,		0x00,	// Right DAC - unmuted, 0dB
-	86,		0x09,	// Left LOP/M - umuted, 0dB, enabled (NOTE - DS error, bit 0 is R/W)
-	93,		0x09,	// Right LOP/M - umuted, 0dB, enabled (NOTE - DS error, bit 0 is R/W)
-	101,	0x01,	// Clock - CODEC_CLKIN uses CLKDIV_OUT
-	109,	0xC0,	// DAC Current - 100% increase over default
-	REG_EOF,		// EOF
+	WR(7,	0x0A),	// datapath setup - left dac/left in, right dac/right in
+	WR(19,	0x04),	// Left ADC - enabled, 0dB
+	BURST(15, 2),	// Left/Right PGA
+	DATA(0x00),		//  Left PGA - unmuted, 0dB
+	DATA(0x00),		//  Right PGA - unmuted, 0dB
+	WR(19,	0x04),	// Left ADC - enabled, MIC1LP single, 0dB
+	WR(22,	0x04),	// Right ADC - enabled, 0dB
+	WR(37,	0xC0),	// DAC Power - left/right DACs enabled
+	WR(41,	0x50),	// DAC Output Switching - use L3/R3 & independent vol
+	BURST(43, 2),	// Left/Right DAC
+	DATA(0x00),		//  Left DAC - unmuted, 0dB
+	DATA(0x00),		//  Right DAC - unmuted, 0dB
+	WR(86,	0x09),	// Left LOP/M - umuted, 0dB, enabled (NOTE - DS error, bit 0 is R/W)
+	WR(93,	0x09),	// Right LOP/M - umuted, 0dB, enabled (NOTE - DS error, bit 0 is R/W)
+	WR(101,	0x01),	// Clock - CODEC_CLKIN uses CLKDIV_OUT
+	WR(109,	0xC0),	// DAC Current - 100% increase over default
+	SEQ_END
 };
 #endif
 
@@ -113,8 +126,7 @@ int32_t AIC3101_WriteRegister(uint8_t RegisterAddr, uint8_t RegisterValue)
 		return 1;
 	}
 	
-	printf("AIC3101_WriteRegister: write to DevAddr 0x%02X / RegisterAddr 0x%02X = 0x%02X\n\r",
-		AIC3101_ADDR, RegisterAddr, RegisterValue);
+	TRACE(TRC_REG_WR, TRC_SRC_AIC3101, RegisterAddr, RegisterValue);
 
 	return 0;
 }
@@ -129,7 +141,6 @@ int32_t AIC3101_WriteRegister(uint8_t RegisterAddr, uint8_t RegisterValue)
 int32_t AIC3101_ReadRegister(uint8_t RegisterAddr, uint8_t *RegisterValue)
 {
 	int32_t status;
-	uint8_t i2c_msg;
 
 	status = i2c_write_timeout_us(I2C_PORT, AIC3101_ADDR, &RegisterAddr, 1, true, 10000);
 
@@ -162,12 +173,72 @@ int32_t AIC3101_ReadRegister(uint8_t RegisterAddr, uint8_t *RegisterValue)
 		return 1;
 	}
 	
-	printf("AIC3101_ReadRegister: read from DevAddr 0x%02X / Reg %2d = 0x%0X\n\r",
-		AIC3101_ADDR, RegisterAddr, *RegisterValue);
+	TRACE(TRC_REG_RD, TRC_SRC_AIC3101, RegisterAddr, *RegisterValue);
 
 	return 0;
 }
 
+/*
+ * write a run of consecutive registers using auto-increment
+ */
+static int32_t AIC3101_WriteBurst(uint16_t RegisterAddr, const uint16_t *RegisterValue,
+	uint8_t n)
+{
+	int32_t status;
+	uint8_t i, i2c_msg[SEQ_BURST_MAX+1];
+
+	/* Assemble start address followed by data */
+	i2c_msg[0] = RegisterAddr;
+	for(i=0;i<n;i++)
+		i2c_msg[i+1] = RegisterValue[i];
+
+	status = i2c_write_timeout_us(I2C_PORT, AIC3101_ADDR, i2c_msg, n+1, false, 10000);
+
+	/* Check the communication status */
+	if(status != n+1)
+	{
+		/* Reset the I2C communication bus */
+		printf("AIC3101_WriteBurst: write to DevAddr 0x%02X / RegisterAddr 0x%02X failed - resetting.\n\r",
+			AIC3101_ADDR, RegisterAddr);
+
+		i2c_deinit(I2C_PORT);
+		i2c_init(I2C_PORT, 100*1000);
+
+		return 1;
+	}
+
+	TRACE(TRC_REG_BURST, TRC_SRC_AIC3101, RegisterAddr, n);
+
+	return 0;
+}
+
+/*
+ * adapters for the sequence player
+ */
+static int32_t AIC3101_SeqWrite(uint16_t reg, uint16_t val)
+{
+	return AIC3101_WriteRegister(reg, val);
+}
+
+static int32_t AIC3101_SeqRead(uint16_t reg, uint16_t *val)
+{
+	uint8_t data;
+	int32_t result = AIC3101_ReadRegister(reg, &data);
+	*val = data;
+	return result;
+}
+
+const codec_seq_if aic3101_if =
+{
+	.name = "AIC3101",
+	.trace_src = TRC_SRC_AIC3101,
+	.reg_stride = 1,
+	.write = AIC3101_SeqWrite,
+	.read = AIC3101_SeqRead,
+	.burst = AIC3101_WriteBurst,
+	.reclock = codec_seq_i2c_reclock,
+};
+
 /**
   * @brief  Resets the audio AIC3101. It restores the default configuration of the
   *         AIC3101 (this function shall be called before initializing the AIC3101).
@@ -177,28 +248,122 @@ int32_t AIC3101_ReadRegister(uint8_t RegisterAddr, uint8_t *RegisterValue)
   */
 int32_t AIC3101_Reset(void)
 {
-	int32_t result = 0;
-	uint8_t reg, data;
-	uint8_t idx = 0, tries;
-
 	/* hardware reset */
 	gpio_put(CSB_PIN, 0);
 	sleep_ms(1);
 	gpio_put(CSB_PIN, 1);
 	sleep_ms(1);
 
-	/* Load reg/data pairs from table */
-	while((reg = codec_settings[2*idx]) != REG_EOF)
+	/* Load settings from table */
+	return codec_seq_play(&aic3101_if, codec_settings);
+}
+
+/**
+  * @brief  Reprogram the AIC3101 clock dividers for a new rate
+  * @note   Assumes the no-PLL table - Fsref = MCLK / (128 * Q), with the
+  *         codec at Fsref / NCODEC or at 2 x Fsref in dual rate mode.
+  * @param  fs: sample rate in Hz
+  * @param  mclk_ratio: MCLK / fs
+  * @retval 0 if ok, else rate not supported or bus error
+  */
+int32_t AIC3101_SetRate(uint32_t fs, uint16_t mclk_ratio)
+{
+	uint32_t fsref, n2, q;
+	uint8_t datapath = 0x0A;
+
+	if(!fs)
+		return 1;
+
+	/* pick Fsref and twice NCODEC */
+	if(fs > 48000)
 	{
-		data =  codec_settings[2*idx+1];
-		tries = 0;
-		while((AIC3101_WriteRegister(reg, data)!=0) && (tries++ <5));
-		if(tries>4)
-            result++;
-		idx++;
+		fsref = fs / 2;
+		n2 = 2;
+		datapath |= 0x60;	// ADC & DAC dual rate
 	}
+	else
+	{
+		fsref = ((2*48000) % fs) ? 44100 : 48000;
+		n2 = (2*fsref) / fs;
+	}
+	if(((fsref != 48000) && (fsref != 44100)) || (n2 < 2) || (n2 > 12) ||
+		((fs > 48000) ? (2*fsref != fs) : (n2*fs != 2*fsref)))
+		return 1;
+	if(fsref == 44100)
+		datapath |= 0x80;
 
-	return result;
+	/* Q divider from MCLK */
+	if((fs * mclk_ratio) % (128 * fsref))
+		return 1;
+	q = (fs * mclk_ratio) / (128 * fsref);
+	if((q < 2) || (q > 17))
+		return 1;
+
+	codec_seq_t seq[] =
+	{
+		SEQ_WRV(3,	(q & 0xF) << 3),			// PLL A - PLL off, Q
+		SEQ_WRV(2,	((n2-2) << 4) | (n2-2)),	// ADC/DAC NCODEC
+		SEQ_WRV(7,	datapath),					// Fsref, dual rate, datapath
+		SEQ_END
+	};
+	return codec_seq_play(&aic3101_if, seq);
+}
+
+/* codec drives BCLK & WCLK */
+static uint8_t aic3101_master;
+
+/**
+  * @brief  Select AIC3101 clocking - takes effect at the next SetFormat
+  * @param  enable: 1 for the codec to drive BCLK & WCLK, 0 to follow them
+  * @retval 0 if ok
+  */
+int32_t AIC3101_SetMaster(uint8_t enable)
+{
+	aic3101_master = enable ? 1 : 0;
+	return 0;
+}
+
+/**
+  * @brief  Set the AIC3101 audio interface format & word length
+  * @note   As master BCLK runs at 2 words per frame so the word has to
+  *         fill the slot - 16 or 32-bit only.
+  * @param  fmt: FMT_I2S, FMT_LJ, FMT_RJ, FMT_DSP_A or FMT_DSP_B
+  * @param  bits: 16, 20, 24 or 32
+  * @retval 0 if ok, else format not supported or bus error
+  */
+int32_t AIC3101_SetFormat(uint8_t fmt, uint8_t bits)
+{
+	uint8_t mode, wl, offs = 0;
+
+	switch(bits)
+	{
+		case 16: wl = 0; break;
+		case 20: wl = 1; break;
+		case 24: wl = 2; break;
+		case 32: wl = 3; break;
+		default: return 1;
+	}
+	if(aic3101_master && (bits != 16) && (bits != 32))
+		return 1;
+
+	switch(fmt)
+	{
+		case FMT_I2S: mode = 0; break;
+		case FMT_DSP_A: mode = 1; offs = 1; break;
+		case FMT_DSP_B: mode = 1; break;
+		case FMT_RJ: mode = 2; break;
+		case FMT_LJ: mode = 3; break;
+		default: return 1;
+	}
+
+	codec_seq_t seq[] =
+	{
+		SEQ_WRV(8,	aic3101_master ? 0xC0 : 0x00),	// Serial Data Interface A - BCLK & WCLK direction
+		SEQ_WRV(9,	(mode << 6) | (wl << 4)),	// Serial Data Interface B - mode, word length
+		SEQ_WRV(10,	offs),						// Serial Data Interface C - data offset
+		SEQ_END
+	};
+	return codec_seq_play(&aic3101_if, seq);
 }
 
 /*
@@ -213,5 +378,6 @@ int32_t AIC3101_Dump_Regs(void)
 		AIC3101_ReadRegister(reg, &data);
 		reg++;
 	}
+	return 0;
 }
 
@@ -6,10 +6,18 @@
 #ifndef __aic3101__
 #define __aic3101__
 
+#include "codec_seq.h"
+
 int32_t AIC3101_Init(void);
 int32_t AIC3101_Reset(void);
+int32_t AIC3101_SetRate(uint32_t fs, uint16_t mclk_ratio);
+int32_t AIC3101_SetFormat(uint8_t fmt, uint8_t bits);
+int32_t AIC3101_SetMaster(uint8_t enable);
 int32_t AIC3101_WriteRegister(uint8_t RegisterAddr, uint8_t RegisterValue);
 int32_t AIC3101_ReadRegister(uint8_t RegisterAddr, uint8_t *RegisterValue);
 int32_t AIC3101_Dump_Regs(void);
 
+/* register access for the sequence player & the console */
+extern const codec_seq_if aic3101_if;
+
 #endif
@@ -0,0 +1,365 @@
+/*
+ * asrc.c - asynchronous sample rate converter between two clock domains
+ *
+ * The producer writes frames at its own rate into a FIFO and the consumer
+ * reads them back through a polyphase windowed sinc interpolator stepping
+ * by a ratio near the nominal input/output rate ratio. After each read
+ * block a PI controller trims that ratio to hold the FIFO fill at
+ * ASRC_TARGET, so the drift between the two clocks is tracked without any
+ * knowledge of either - wide to pull in, then narrow so a producer that
+ * writes in blocks doesn't put the jumps in its fill into the ratio.
+ * Coefficients for the fractional position are interpolated linearly
+ * between the two nearest phases (a first order Farrow structure over the
+ * bank), which keeps the table small. It's all 32-bit fixed point for the
+ * M0+ - Q2.30 step & position, Q15 taps. The taps are made at build time
+ * by tablegen.py.
+ *
+ * ASRC_HOST builds rp2040_i2s_asrc, which runs converters between drifting
+ * clocks and reports lock, xruns, THD+N & speed.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "asrc.h"
+#ifndef ASRC_HOST
+#include "pico/stdlib.h"
+#else
+#define __not_in_flash_func(f) f
+#endif
+
+#define ASRC_MASK (ASRC_LEN-1)
+
+/* clamp on the integrator - +/-5000 ppm is well past any crystal */
+#define ASRC_INTEG_MAX ((int32_t)(ASRC_ONE/200))
+
+/*
+ * reset a converter - step_nom is input frames per output frame in Q2.30
+ */
+void asrc_init(asrc *a, uint32_t step_nom)
+{
+	memset(a, 0, sizeof(asrc));
+	a->step_nom = step_nom;
+	a->step = step_nom;
+}
+
+/*
+ * room for the producer in frames
+ */
+int32_t asrc_space(const asrc *a)
+{
+	return ASRC_LEN - (int32_t)(a->head - a->tail);
+}
+
+/*
+ * add interleaved frames - returns the number taken, short if the FIFO
+ * filled which counts as an overrun
+ */
+int32_t asrc_write(asrc *a, const int16_t *src, int32_t frames)
+{
+	uint32_t head = a->head;
+	int32_t i, c, space = asrc_space(a);
+
+	if(frames > space)
+	{
+		a->overruns++;
+		frames = space;
+	}
+
+	for(i=0;i<frames;i++)
+	{
+		for(c=0;c<ASRC_CHLS;c++)
+			a->buf[head & ASRC_MASK][c] = *src++;
+		head++;
+	}
+
+	/* data before index for the other core */
+	__sync_synchronize();
+	a->head = head;
+
+	return frames;
+}
+
+/*
+ * produce interleaved output frames. Output is silent until the fill first
+ * reaches the target, and again after an underrun until it has refilled.
+ */
+void __not_in_flash_func(asrc_read)(asrc *a, int16_t *dst, int32_t frames)
+{
+	uint32_t tail = a->tail, frac = a->frac, head = a->head, idx;
+	int32_t i, k, mu, h, acc0, acc1, y, err, lp, kp, ki;
+	const int16_t *h0, *h1;
+
+	/*
+	 * start once there's enough in hand to ride out jitter both ways,
+	 * dropping any surplus so the loop starts with no error
+	 */
+	if(!a->locked)
+	{
+		if(head - tail < (uint32_t)(ASRC_TARGET + ASRC_TAPS/2 + frames))
+		{
+			memset(dst, 0, frames * ASRC_CHLS * sizeof(int16_t));
+			return;
+		}
+		tail = head - (ASRC_TARGET + ASRC_TAPS/2) - frames;
+		a->locked = 1;
+		a->settle = 0;
+	}
+
+	for(i=0;i<frames;i++)
+	{
+		/* taps run tail .. tail+TAPS-1, centred between the middle two */
+		if(head - tail < ASRC_TAPS)
+		{
+			a->underruns++;
+			a->locked = 0;
+			memset(dst, 0, (frames - i) * ASRC_CHLS * sizeof(int16_t));
+			break;
+		}
+
+		/* phase row & position between it and the next */
+		h0 = asrc_coef[frac >> (30 - ASRC_PHASE_BITS)];
+		h1 = h0 + ASRC_TAPS;
+		mu = (frac >> (30 - ASRC_PHASE_BITS - ASRC_MU_BITS)) & ((1<<ASRC_MU_BITS)-1);
+
+		/* products are pre-shifted by 2 so a full scale sum fits */
+		acc0 = acc1 = 0;
+		for(k=0;k<ASRC_TAPS;k++)
+		{
+			h = h0[k] + (((h1[k] - h0[k]) * mu) >> ASRC_MU_BITS);
+			idx = (tail + k) & ASRC_MASK;
+			acc0 += (a->buf[idx][0] * h) >> 2;
+			acc1 += (a->buf[idx][1] * h) >> 2;
+		}
+
+		y = (acc0 + (1<<12)) >> 13;
+		*dst++ = (y > 32767) ? 32767 : (y < -32768) ? -32768 : y;
+		y = (acc1 + (1<<12)) >> 13;
+		*dst++ = (y > 32767) ? 32767 : (y < -32768) ? -32768 : y;
+
+		frac += a->step;
+		tail += frac >> 30;
+		frac &= ASRC_ONE - 1;
+	}
+
+	/* done with the taps before handing them back */
+	__sync_synchronize();
+	a->tail = tail;
+	a->frac = frac;
+
+	/*
+	 * PI on the fill past the read position in Q8 frames - a fuller FIFO
+	 * means the producer is faster so step up
+	 */
+	if(a->locked)
+	{
+		if(a->settle < ASRC_SETTLE)
+		{
+			lp = ASRC_LP_SHIFT;
+			kp = ASRC_KP_SHIFT;
+			ki = ASRC_KI_SHIFT;
+		}
+		else
+		{
+			lp = ASRC_NLP_SHIFT;
+			kp = ASRC_NKP_SHIFT;
+			ki = ASRC_NKI_SHIFT;
+		}
+		err = (int32_t)(a->head - tail - ASRC_TAPS/2) * 256 - (frac >> 22) -
+			ASRC_TARGET * 256;
+		a->err_lp += err - (a->err_lp >> lp);
+		err = a->err_lp >> lp;
+		a->integ += a->err_lp >> (ki + lp - 22 - ASRC_INTEG_FRAC);
+		if(a->integ > (ASRC_INTEG_MAX << ASRC_INTEG_FRAC))
+			a->integ = ASRC_INTEG_MAX << ASRC_INTEG_FRAC;
+		else if(a->integ < -(ASRC_INTEG_MAX << ASRC_INTEG_FRAC))
+			a->integ = -(ASRC_INTEG_MAX << ASRC_INTEG_FRAC);
+		a->step = a->step_nom + (a->integ >> ASRC_INTEG_FRAC) +
+			err * (1 << (22 - kp));
+
+		/* pulled in - shift down to the narrow gear from the mean step */
+		if(a->settle < ASRC_SETTLE)
+		{
+			a->mean += ((a->step - (int32_t)a->step_nom) - a->mean) >> ASRC_MEAN_SHIFT;
+			if(++a->settle == ASRC_SETTLE)
+			{
+				a->integ = a->mean * (1 << ASRC_INTEG_FRAC);
+				a->err_lp = err * (1 << ASRC_NLP_SHIFT);
+			}
+		}
+	}
+}
+
+/*
+ * tracked step relative to nominal in ppm - the producer's clock against
+ * the consumer's
+ */
+int32_t asrc_ppm(const asrc *a)
+{
+	return ((int64_t)(a->step - (int32_t)a->step_nom) * 1000000) /
+		(int64_t)a->step_nom;
+}
+
+#ifdef ASRC_HOST
+#include <math.h>
+#include <time.h>
+
+#define SIM_BLOCK 32
+#define SIM_SEG 8192
+
+/*
+ * THD+N of one segment - 4 parameter sine fit (amplitude, phase, offset &
+ * frequency) so slow ratio wander isn't counted, then what's left over the
+ * fitted tone in dB
+ */
+static double asrc_thdn(const double *y, int n, double w)
+{
+	double m[4][5], a = 0, b = 0, c = 0, dw, res, e, g[4], t;
+	int it, i, j, k, r;
+
+	for(it=0;it<8;it++)
+	{
+		/* normal equations for the fit linearised in the frequency */
+		memset(m, 0, sizeof(m));
+		for(i=0;i<n;i++)
+		{
+			g[0] = cos(w * i);
+			g[1] = sin(w * i);
+			g[2] = 1.0;
+			g[3] = i * (b * g[0] - a * g[1]);
+			for(j=0;j<4;j++)
+			{
+				for(k=0;k<4;k++)
+					m[j][k] += g[j] * g[k];
+				m[j][4] += g[j] * y[i];
+			}
+		}
+		if(it == 0)
+			m[3][3] = 1.0;	// no amplitude yet so hold the frequency
+
+		/* Gauss-Jordan */
+		for(j=0;j<4;j++)
+		{
+			for(r=j+1;r<4;r++)
+				if(fabs(m[r][j]) > fabs(m[j][j]))
+					for(k=0;k<5;k++)
+					{
+						t = m[j][k];
+						m[j][k] = m[r][k];
+						m[r][k] = t;
+					}
+			for(r=0;r<4;r++)
+				if(r != j)
+					for(k=4;k>=j;k--)
+						m[r][k] -= m[r][j] / m[j][j] * m[j][k];
+		}
+		a = m[0][4] / m[0][0];
+		b = m[1][4] / m[1][1];
+		c = m[2][4] / m[2][2];
+		dw = (it == 0) ? 0 : m[3][4] / m[3][3];
+		w += dw;
+	}
+
+	res = 0;
+	for(i=0;i<n;i++)
+	{
+		e = y[i] - a * cos(w * i) - b * sin(w * i) - c;
+		res += e * e;
+	}
+	return 10 * log10(res / n / ((a * a + b * b) / 2));
+}
+
+/*
+ * run a converter between two clocks for a while - the producer writes
+ * in_block frames at a time at fs_in, the consumer reads 32 at fs_out.
+ * THD+N is the worst segment over the last quarter, which fails over
+ * limit as does any xrun once settled.
+ */
+static int asrc_sim(const char *name, double fs_in, double fs_out, double fs_nom,
+	double tone, int in_block, double secs, double limit)
+{
+	static asrc a;
+	static int16_t in[SIM_BLOCK*ASRC_CHLS], out[SIM_BLOCK*ASRC_CHLS];
+	static double rec[SIM_SEG];
+	uint32_t n_in = 0, n_out = 0, total = secs * fs_out, k = 0;
+	uint32_t xruns_late = 0, xr;
+	double t_in = 0, t_out = 0, ns = 0, s, thdn = -200, d;
+	int32_t ppm_min = INT32_MAX, ppm_max = INT32_MIN;
+	struct timespec t0, t1;
+	int i;
+
+	asrc_init(&a, (uint32_t)floor(fs_nom * ASRC_ONE + 0.5));
+
+	while(n_out < total)
+	{
+		if(t_in <= t_out)
+		{
+			/* producer - full scale minus a bit, same tone on both */
+			for(i=0;i<in_block;i++)
+			{
+				s = floor(32000.0 * sin(2 * M_PI * tone * (n_in + i) / fs_in) + 0.5);
+				in[2*i] = in[2*i+1] = s;
+			}
+			asrc_write(&a, in, in_block);
+			n_in += in_block;
+			t_in = n_in / fs_in;
+		}
+		else
+		{
+			xr = a.underruns + a.overruns;
+			clock_gettime(CLOCK_MONOTONIC, &t0);
+			asrc_read(&a, out, SIM_BLOCK);
+			clock_gettime(CLOCK_MONOTONIC, &t1);
+			ns += (t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec);
+			n_out += SIM_BLOCK;
+			t_out = n_out / fs_out;
+
+			/* settled from here */
+			if(n_out < total - total / 4)
+				continue;
+			if(a.underruns + a.overruns != xr)
+				xruns_late++;
+			if(asrc_ppm(&a) < ppm_min)
+				ppm_min = asrc_ppm(&a);
+			if(asrc_ppm(&a) > ppm_max)
+				ppm_max = asrc_ppm(&a);
+			for(i=0;i<SIM_BLOCK;i++)
+				rec[k++] = out[2*i];
+			if(k == SIM_SEG)
+			{
+				d = asrc_thdn(rec, k, 2 * M_PI * tone / fs_out);
+				if(d > thdn)
+					thdn = d;
+				k = 0;
+			}
+		}
+	}
+
+	printf("%-24s %+9.2f %+9d %+9d %4u %4u %8.1f %8.1f\n", name,
+		(fs_in / fs_out / fs_nom - 1) * 1e6, ppm_min, ppm_max,
+		a.underruns + a.overruns, xruns_late, thdn, ns / n_out);
+
+	return xruns_late || (thdn > limit);
+}
+
+/*
+ * host tool - converters between drifting clocks
+ */
+int main(void)
+{
+	int fail = 0;
+
+	printf("%-24s %9s %9s %9s %4s %4s %8s %8s\n", "case", "drift ppm",
+		"track min", "track max", "xrun", "late", "THD+N dB", "ns/frame");
+	fail |= asrc_sim("48k locked", 48000, 48000, 1.0, 997, 1, 30, -80);
+	fail |= asrc_sim("48k +100ppm", 48000 * 1.0001, 48000, 1.0, 997, 1, 30, -80);
+	fail |= asrc_sim("48k -100ppm", 48000, 48000 * 1.0001, 1.0, 997, 1, 30, -80);
+	fail |= asrc_sim("48k +1000ppm", 48000 * 1.001, 48000, 1.0, 997, 1, 30, -80);
+	fail |= asrc_sim("48k +100ppm blocks", 48000 * 1.0001, 48000, 1.0, 997, 32, 30, -80);
+	fail |= asrc_sim("44.1k->48k +50ppm", 44100 * 1.00005, 48000, 44100.0 / 48000, 997, 1, 30, -80);
+	fail |= asrc_sim("48k locked 10kHz", 48000, 48000, 1.0, 9973, 1, 30, -75);
+	fail |= asrc_sim("48k +100ppm 10kHz", 48000 * 1.0001, 48000, 1.0, 9973, 1, 30, -70);
+
+	printf(fail ? "FAILED\n" : "PASSED\n");
+	return fail;
+}
+#endif
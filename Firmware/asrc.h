@@ -0,0 +1,80 @@
+/*
+ * asrc.h - asynchronous sample rate converter between two clock domains
+ */
+
+#ifndef __asrc__
+#define __asrc__
+
+#include <stdint.h>
+
+/* stereo frames in the FIFO - must be a power of 2 */
+#define ASRC_LEN 512
+#define ASRC_CHLS 2
+
+/* fill level the control loop holds, in frames */
+#define ASRC_TARGET (ASRC_LEN/4)
+
+/* step is input frames per output frame in Q2.30 */
+#define ASRC_ONE (1UL<<30)
+
+/* interpolator - taps per output, phases in the table & bits between phases */
+#define ASRC_TAPS 16
+#define ASRC_PHASE_BITS 6
+#define ASRC_PHASES (1<<ASRC_PHASE_BITS)
+#define ASRC_MU_BITS 12
+
+/* Kaiser window shape for the taps - about 70dB stopband */
+#define ASRC_BETA 7.0
+
+/*
+ * PI on the fill error in two gears - step change per frame of error is
+ * 2^-KP and per read block 2^-KI, after a one pole low pass of 2^LP
+ * blocks. The wide gear pulls in from lock for ASRC_SETTLE blocks, then
+ * the integrator takes the mean step and the narrow gear holds it. That's
+ * well below the beat between producer & consumer blocks, which moves the
+ * fill a whole producer block at a time however close the clocks are.
+ */
+#define ASRC_KP_SHIFT 15
+#define ASRC_KI_SHIFT 27
+#define ASRC_LP_SHIFT 6
+#define ASRC_NKP_SHIFT 21
+#define ASRC_NKI_SHIFT 37
+#define ASRC_NLP_SHIFT 12
+#define ASRC_SETTLE 16384
+#define ASRC_MEAN_SHIFT 12
+
+/* integrator fraction bits below Q2.30 for the narrow gear's small steps */
+#define ASRC_INTEG_FRAC 8
+
+/* taps from tables.c */
+extern const int16_t asrc_coef[ASRC_PHASES+1][ASRC_TAPS];
+
+/*
+ * one converter - write() is called by the producer and read() by the
+ * consumer, which may be on different cores. Samples are 16-bit, held
+ * as int32 so the multiplies need no extension.
+ */
+typedef struct
+{
+	int32_t buf[ASRC_LEN][ASRC_CHLS];
+	volatile uint32_t head;		// frames written - producer only
+	volatile uint32_t tail;		// oldest frame in use - consumer only
+	uint32_t frac;				// Q0.30 position past tail+1
+	uint32_t step_nom;			// Q2.30 nominal step
+	int32_t step;				// Q2.30 current step
+	int32_t integ;				// integrator in Q2.30 << INTEG_FRAC
+	int32_t err_lp;				// filtered fill error in Q8 frames << LP
+	int32_t mean;				// mean step less nominal in Q2.30
+	uint32_t settle;			// read blocks since lock, to ASRC_SETTLE
+	uint8_t locked;				// fill reached the target once
+	uint32_t underruns;
+	uint32_t overruns;
+} asrc;
+
+void asrc_init(asrc *a, uint32_t step_nom);
+int32_t asrc_write(asrc *a, const int16_t *src, int32_t frames);
+int32_t asrc_space(const asrc *a);
+void asrc_read(asrc *a, int16_t *dst, int32_t frames);
+int32_t asrc_ppm(const asrc *a);
+
+#endif
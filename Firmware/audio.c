@@ -5,18 +5,77 @@
 
 #include <string.h>
 #include <stdio.h>
-#include <math.h>
 #include "hardware/sync.h"
 #include "pico/multicore.h"
 #include "audio.h"
+#include "codec.h"
+#include "asrc.h"
+#include "capture.h"
+#include "trace.h"
+#include "tables.h"
+#include "fixparam.h"
+#include "meter.h"
 
-#define WAV_PHS 10
+#define WAV_PHS TAB_SINE_BITS
 #define WAV_LEN (1<<WAV_PHS)
 #define INTERP_BITS 10
 
+/* output blocks to wait for a mute to reach the DAC */
+#define MUTE_BLOCKS 3
+
+/* most frames the ASRC source makes in one go */
+#define SRC_CHUNK 32
+
 int32_t phs, frq;
-int16_t sinetab[1024];
-volatile uint8_t core0_mode, core1_mode;
+fixparam audio_par;
+uint32_t audio_hz = TAB_OSC_HZ << 16;
+int32_t audio_db;
+volatile int32_t audio_amp = FIXPARAM_ONE;
+volatile uint8_t core0_mode, core1_mode, core0_mute, core1_mute;
+volatile uint8_t core0_park, core1_park;
+volatile uint32_t audio_blocks;
+uint32_t audio_fs = I2S_FS_DEFAULT;
+uint8_t audio_fmt = I2S_FMT_DEFAULT, audio_bits = I2S_BITS_DEFAULT;
+uint8_t audio_slots = I2S_SLOTS_DEFAULT, audio_master;
+uint32_t audio_resyncs;
+
+/* ASRC source - its own oscillator, clocked by time_us_64() */
+asrc audio_asrc;
+int32_t src_phs;
+uint64_t src_t0, src_frames;
+
+/*
+ * restart the ASRC & its source - the consumer must not be reading, which
+ * holds while muted or out of the ASRC mode
+ */
+static void Audio_Src_Reset(void)
+{
+	asrc_init(&audio_asrc, ASRC_ONE);
+	src_phs = 0;
+	src_frames = 0;
+	src_t0 = time_us_64();
+}
+
+/*
+ * oscillator increment for the tone at the current rate - from the table
+ * for the default 100Hz, or worked out for any other tone or rate
+ */
+static void Audio_Set_Freq(void)
+{
+	uint32_t i;
+	
+	phs = 0;
+	fixparam_rate(&audio_par, Fsample);
+	frq = fixparam_hz_inc(&audio_par, audio_hz);
+	if(audio_hz == (TAB_OSC_HZ << 16))
+		for(i=0;i<TAB_OSC_NUM;i++)
+			if(tab_osc_inc[i].fs == Fsample)
+				frq = tab_osc_inc[i].inc;
+	//frq = 0x000f0000;
+	Audio_Src_Reset();
+	
+	TRACE(TRC_FSAMPLE, TRC_SRC_AUDIO, Fsample, frq);
+}
 
 /*
  * init audio handler
@@ -25,28 +84,314 @@ void Audio_Init(void)
 {
 	/* init audio mode */
 	core0_mode = core1_mode = 0;
+	core0_mute = core1_mute = 0;
 	
 	/* starting phase and freq */
-	phs = 0;
-	frq = (int32_t)floorf(100.0F * powf(2.0F, 32.0F) / (float)Fsample);
-	//frq = 0x000f0000;
+	Audio_Set_Freq();
+}
+
+/*
+ * Request mute on/off and block until complete
+ */
+void Audio_Set_Mute(uint8_t enable)
+{
+	uint32_t blocks;
+	uint64_t timeout;
 	
-	printf("Audio_Init: Fsample = %d, frq = 0x%08X\n", frq);
+	/* hand the request to core 1 */
+	core0_mute = enable ? 1 : 0;
+	while(core0_mute != core1_mute)
+		tight_loop_contents();
+	if(!enable)
+		capture_unmute();
 	
-	/* build sinewave LUT */
-	float th = 0.0F, thinc = 6.2832F/((float)WAV_LEN);
-	for(int i=0;i<WAV_LEN;i++)
+	/* let the silence get through the output buffers */
+	if(enable)
 	{
-		sinetab[i] = floorf(32767.0F * sinf(th) + 0.5F);
-		th += thinc;
+		blocks = audio_blocks;
+		timeout = time_us_64() + (MUTE_BLOCKS+1) * 1000000ULL * SMPS / Fsample;
+		while(((audio_blocks - blocks) < MUTE_BLOCKS) && (time_us_64() < timeout))
+		{
+		}
 	}
 }
 
 /*
- * Request mute on/off and block until complete
+ * check new rate, framing, word length, slots & clocking can be run - with
+ * the codec as master MCLK still comes from here but the codec drives BCLK
+ * & LRCK, in I2S framing with one I2S instance only. Returns 0 if ok.
  */
-void Audio_Set_Mute(uint8_t enable)
+static int32_t Audio_Reconfig_Check(clkplan *plan, uint32_t fs, uint8_t fmt,
+	uint8_t bits, uint8_t slots, uint8_t master)
+{
+	if(master && ((fmt != FMT_I2S) || (slots != 2) || (I2S_INSTANCES > 1)))
+		return 1;
+	
+	/* nothing changes unless a plan exists */
+	return i2s_fulldup_plan(plan, fs, I2S_SLOT_BITS(bits), slots);
+}
+
+/*
+ * stop I2S, reclock the system and codec, then restart with clean buffers
+ * - call muted. If the codec can't follow the old settings are restored.
+ * Returns 0 if ok.
+ */
+static int32_t Audio_Reconfig_Apply(const clkplan *new_plan, uint32_t fs,
+	uint8_t fmt, uint8_t bits, uint8_t slots, uint8_t master)
+{
+	clkplan plan;
+	int32_t err;
+	
+	i2s_fulldup_stop();
+	i2s_fulldup_clocks(new_plan);
+	i2s_fulldup_format(fmt, bits, slots, master);
+	
+	/* codec follows - go back if it can't */
+	err = Codec_SetMaster(master) || Codec_SetRate(fs, I2S_MCLK_RATIO) ||
+		Codec_SetFormat(fmt, bits);
+	if(err)
+	{
+		i2s_fulldup_plan(&plan, audio_fs, I2S_SLOT_BITS(audio_bits),
+			audio_slots);
+		i2s_fulldup_clocks(&plan);
+		i2s_fulldup_format(audio_fmt, audio_bits, audio_slots, audio_master);
+		Codec_SetMaster(audio_master);
+		Codec_SetRate(audio_fs, I2S_MCLK_RATIO);
+		Codec_SetFormat(audio_fmt, audio_bits);
+	}
+	else
+	{
+		audio_fs = fs;
+		audio_fmt = fmt;
+		audio_bits = bits;
+		audio_slots = slots;
+		audio_master = master;
+	}
+	
+	i2s_fulldup_start();
+	Audio_Set_Freq();
+	
+	return err;
+}
+
+/* where a posted rate change is at */
+enum audio_rate_states
+{
+	RATE_IDLE,
+	RATE_MUTE,		// waiting for core 1 to mute
+	RATE_DRAIN,		// letting the silence reach the DAC
+	RATE_PARK,		// waiting for core 1 to park its DMA ISRs
+	RATE_RESUME,	// waiting for core 1 to unpark & unmute
+};
+
+static uint8_t rate_st = RATE_IDLE;
+static int32_t rate_err;
+static uint32_t rate_fs, rate_blocks;
+static uint64_t rate_t0, rate_timeout;
+static clkplan rate_plan;
+
+/*
+ * switch rate, framing, word length, slots & clocking - blocks until done,
+ * see above. Returns 0 if ok.
+ */
+static int32_t Audio_Reconfig(uint32_t fs, uint8_t fmt, uint8_t bits,
+	uint8_t slots, uint8_t master)
+{
+	clkplan plan;
+	int32_t err;
+	
+	if(rate_st != RATE_IDLE)
+		return 1;
+	if(Audio_Reconfig_Check(&plan, fs, fmt, bits, slots, master))
+		return 1;
+	
+	Audio_Set_Mute(1);
+	err = Audio_Reconfig_Apply(&plan, fs, fmt, bits, slots, master);
+	Audio_Set_Mute(0);
+	
+	return err;
+}
+
+/*
+ * change sample rate on the fly - returns the switch time in us, or -1
+ * if the rate can't be generated or the codec won't run at it.
+ */
+int32_t Audio_Set_Rate(uint32_t fs)
+{
+	uint64_t t0 = time_us_64();
+	int32_t us;
+	
+	if(Audio_Reconfig(fs, audio_fmt, audio_bits, audio_slots, audio_master))
+		return -1;
+	
+	us = time_us_64() - t0;
+	TRACE(TRC_RATE, TRC_SRC_AUDIO, Fsample, us);
+	
+	return us;
+}
+
+/*
+ * start a sample rate change without waiting on core 1 - step it with
+ * Audio_Rate_Poll(). Returns 0 if posted, 1 if the rate can't be generated
+ * or a change is already in hand.
+ */
+int32_t Audio_Rate_Post(uint32_t fs)
 {
+	if(rate_st != RATE_IDLE)
+		return 1;
+	if(Audio_Reconfig_Check(&rate_plan, fs, audio_fmt, audio_bits,
+		audio_slots, audio_master))
+		return 1;
+	
+	rate_fs = fs;
+	rate_t0 = time_us_64();
+	core0_mute = 1;
+	rate_st = RATE_MUTE;
+	
+	return 0;
+}
+
+/*
+ * step a posted rate change - core 1 mutes, then parks its DMA ISRs while
+ * I2S & the codec are reclocked here. Returns 1 while in hand, 0 once the
+ * new rate runs or -1 if the codec won't run at it, which leaves the old
+ * one running. Once idle it keeps returning the last result.
+ */
+int32_t Audio_Rate_Poll(void)
+{
+	int32_t us;
+	
+	switch(rate_st)
+	{
+		case RATE_MUTE:
+			if(core1_mute != core0_mute)
+				return 1;
+			rate_blocks = audio_blocks;
+			rate_timeout = time_us_64() +
+				(MUTE_BLOCKS+1) * 1000000ULL * SMPS / Fsample;
+			rate_st = RATE_DRAIN;
+			return 1;
+		
+		case RATE_DRAIN:
+			if(((audio_blocks - rate_blocks) < MUTE_BLOCKS) &&
+				(time_us_64() < rate_timeout))
+				return 1;
+			core0_park = 1;
+			rate_st = RATE_PARK;
+			return 1;
+		
+		case RATE_PARK:
+			if(core1_park != core0_park)
+				return 1;
+			rate_err = Audio_Reconfig_Apply(&rate_plan, rate_fs, audio_fmt,
+				audio_bits, audio_slots, audio_master) ? -1 : 0;
+			core0_park = 0;
+			core0_mute = 0;
+			rate_st = RATE_RESUME;
+			return 1;
+		
+		case RATE_RESUME:
+			if((core1_park != core0_park) || (core1_mute != core0_mute))
+				return 1;
+			capture_unmute();
+			if(!rate_err)
+			{
+				us = time_us_64() - rate_t0;
+				TRACE(TRC_RATE, TRC_SRC_AUDIO, Fsample, us);
+			}
+			rate_st = RATE_IDLE;
+			return rate_err;
+		
+		default:
+			return rate_err;
+	}
+}
+
+/*
+ * change two slot framing format & word length on the fly - word length
+ * is 16, 24 or 32. Returns 0 if ok.
+ */
+int32_t Audio_Set_Format(uint8_t fmt, uint8_t bits)
+{
+	if(fmt >= FMT_TDM)
+		return 1;
+	if((bits != 16) && (bits != 24) && (bits != 32))
+		return 1;
+	
+	if(Audio_Reconfig(audio_fs, fmt, bits, 2, audio_master))
+		return 1;
+	
+	TRACE(TRC_FORMAT, TRC_SRC_AUDIO, fmt, bits);
+	
+	return 0;
+}
+
+/*
+ * switch to TDM with 4, 8 or 16 slots - word length as above. Returns 0
+ * if ok.
+ */
+int32_t Audio_Set_TDM(uint8_t slots, uint8_t bits)
+{
+	if((bits != 16) && (bits != 24) && (bits != 32))
+		return 1;
+	if((slots != 4) && (slots != 8) && (slots != 16))
+		return 1;
+	
+	if(Audio_Reconfig(audio_fs, FMT_TDM, bits, slots, audio_master))
+		return 1;
+	
+	TRACE(TRC_TDM, TRC_SRC_AUDIO, slots, bits);
+	
+	return 0;
+}
+
+/*
+ * pick who drives BCLK & LRCK - with codec_master set the codec does and
+ * I2S follows it, which needs I2S framing. Returns 0 if ok.
+ */
+int32_t Audio_Set_Clocking(uint8_t codec_master)
+{
+	codec_master = codec_master ? 1 : 0;
+	if(Audio_Reconfig(audio_fs, audio_fmt, audio_bits, audio_slots,
+		codec_master))
+		return 1;
+	
+	TRACE(TRC_CLOCKING, TRC_SRC_AUDIO, codec_master, audio_bits);
+	
+	return 0;
+}
+
+/*
+ * restart I2S from the top of a frame if the watchdog saw it slip - muted
+ * so the swapped blocks in flight don't reach the DAC - and drive a posted
+ * rate change. Call from the idle loop. Returns the number of resyncs so far.
+ */
+uint32_t Audio_Watch(void)
+{
+	uint32_t mask;
+	uint64_t t0;
+	
+	/* a posted rate change restarts I2S anyway - see it through first */
+	if(rate_st != RATE_IDLE)
+	{
+		Audio_Rate_Poll();
+		return audio_resyncs;
+	}
+	
+	mask = i2s_fulldup_slipped();
+	if(!mask)
+		return audio_resyncs;
+	
+	t0 = time_us_64();
+	Audio_Set_Mute(1);
+	i2s_fulldup_stop();
+	i2s_fulldup_start();
+	Audio_Set_Mute(0);
+	audio_resyncs++;
+	
+	TRACE(TRC_RESYNC, TRC_SRC_AUDIO, mask, (uint32_t)(time_us_64() - t0));
+	
+	return audio_resyncs;
 }
 
 /*
@@ -69,8 +414,16 @@ void Audio_Disable_Core(uint8_t disable)
  */
 void Audio_Fore(void)
 {
-	/* update mode */
+	/* update mode & mute */
 	core1_mode = core0_mode;
+	core1_mute = core0_mute;
+	
+	/* park the DMA ISRs while core 0 reclocks, & let them go after */
+	if(core1_park != core0_park)
+	{
+		i2s_fulldup_park(core0_park);
+		core1_park = core0_park;
+	}
 }
 
 /*
@@ -86,20 +439,126 @@ void Audio_Fore(void)
  */
 
 /*
- * change the audio generation mode
+ * ask for a new audio generation mode without waiting - Audio_Mode_Live()
+ * says when core 1 has it
  */
-void Audio_Mode(uint8_t new_mode)
+void Audio_Mode_Post(uint8_t new_mode)
 {
 	/* check for change needed */
 	if((new_mode == core0_mode) || (new_mode >= AUDIO_MODES))
 		return;
 	
+	/* core 1 isn't in the ASRC yet so it can start clean */
+	if(new_mode == AUDIO_MODE_ASRC)
+		Audio_Src_Reset();
+	
 	/* change foreground mode */
+	TRACE(TRC_MODE, TRC_SRC_AUDIO, core0_mode, new_mode);
 	core0_mode = new_mode;
+}
+
+/*
+ * 1 once core 1 runs the mode last asked for
+ */
+uint8_t Audio_Mode_Live(void)
+{
+	return core0_mode == core1_mode;
+}
+
+/*
+ * change the audio generation mode
+ */
+void Audio_Mode(uint8_t new_mode)
+{
+	Audio_Mode_Post(new_mode);
 	
 	/* wait for new mode to go live */
-	while(core0_mode != core1_mode)
+	while(!Audio_Mode_Live())
+		tight_loop_contents();
+}
+
+/*
+ * set the test tone in Q16.16 Hz - keeps its phase so there's no click.
+ * Returns 0 if ok, or 1 if it isn't under Nyquist.
+ */
+int32_t Audio_Set_Tone(uint32_t hz)
+{
+	if(!hz || ((uint64_t)hz >= ((uint64_t)Fsample << 15)))
+		return 1;
+
+	/* one word, so core 1 sees the old or the new increment */
+	audio_hz = hz;
+	frq = fixparam_hz_inc(&audio_par, hz);
+
+	TRACE(TRC_FSAMPLE, TRC_SRC_AUDIO, Fsample, frq);
+
+	return 0;
+}
+
+/*
+ * set the test tone level in 1/256 dB below full scale - the saw, sine
+ * & ASRC modes follow it, pass-thru doesn't. Returns 0 if ok, or 1 if
+ * it's over 0dB.
+ */
+int32_t Audio_Set_Level(int32_t db)
+{
+	if(db > 0)
+		return 1;
+
+	audio_db = db;
+	audio_amp = fixparam_db_gain(db);
+
+	return 0;
+}
+
+/*
+ * mode last asked for
+ */
+uint8_t Audio_Get_Mode(void)
+{
+	return core0_mode;
+}
+
+/*
+ * where the audio is at, for the console
+ */
+void Audio_Get_Status(audio_status *s)
+{
+	s->mode = core0_mode;
+	s->mute = core0_mute;
+	s->fs = Fsample;
+	s->hz = audio_hz;
+	s->inc = frq;
+	s->db = audio_db;
+	s->blocks = audio_blocks;
+	s->resyncs = audio_resyncs;
+	s->src_ppm = asrc_ppm(&audio_asrc);
+	s->src_underruns = audio_asrc.underruns;
+	s->src_overruns = audio_asrc.overruns;
+}
+
+/*
+ * scale a block of tone by the level - called only off unity so the
+ * default full scale output stays bit exact
+ */
+static void __not_in_flash_func(Audio_Level)(volatile int16_t *dst, int32_t len,
+	int32_t amp)
+{
+	amp >>= 16;
+	while(len--)
+	{
+		*dst = (*dst * amp) >> 15;
+		dst++;
+	}
+}
+
+static void __not_in_flash_func(Audio_Level32)(volatile int32_t *dst,
+	int32_t len, int32_t amp)
+{
+	while(len--)
 	{
+		*dst = ((int64_t)*dst * amp) >> 31;
+		dst++;
 	}
 }
 
@@ -113,32 +572,117 @@ int16_t sine_interp(uint32_t phs)
 	uint32_t ip, fp;
 	
 	ip = phs>>(32-WAV_PHS);
-	a = sinetab[ip];
-	b = sinetab[(ip + 1)&(WAV_LEN-1)];
+	a = sinetab[ip & (WAV_LEN/2-1)];
+	b = sinetab[(ip & (WAV_LEN/2-1)) + 1];
 	
 	fp = (phs & ((1<<(32-WAV_PHS))-1)) >> ((32-WAV_PHS)-INTERP_BITS);
 	sum = b * fp;
 	sum += a * (((1<<INTERP_BITS)-1)-fp);
+	if(ip & (WAV_LEN/2))
+		sum = -sum;
 	
 	return sum >> INTERP_BITS; 
 }
 
+/*
+ * sine waveform interp - full scale 32-bit
+ */
+int32_t sine_interp32(uint32_t phs)
+{
+	int32_t a, b, sum;
+	uint32_t ip, fp;
+	
+	ip = phs>>(32-WAV_PHS);
+	a = sinetab[ip & (WAV_LEN/2-1)];
+	b = sinetab[(ip & (WAV_LEN/2-1)) + 1];
+	
+	fp = (phs & ((1<<(32-WAV_PHS))-1)) >> ((32-WAV_PHS)-INTERP_BITS);
+	sum = b * fp;
+	sum += a * (((1<<INTERP_BITS)-1)-fp);
+	if(ip & (WAV_LEN/2))
+		sum = -sum;
+	
+	return sum << (16-INTERP_BITS);
+}
+
+/*
+ * ASRC source - run from the core 0 idle loop. Makes the frames due at the
+ * nominal rate by the us timer, which runs from the crystal rather than
+ * the I2S clock, so the ASRC has a real clock domain to bridge when the
+ * codec is master. Falls behind if the loop stalls, which shows as an
+ * underrun at the consumer.
+ */
+void Audio_Src_Poll(void)
+{
+	int16_t buf[SRC_CHUNK*2], wave;
+	uint64_t due;
+	int32_t i, n, amp = audio_amp >> 16;
+	
+	if(core0_mode != AUDIO_MODE_ASRC)
+		return;
+	
+	due = ((time_us_64() - src_t0) * Fsample) / 1000000 - src_frames;
+	while(due)
+	{
+		n = (due > SRC_CHUNK) ? SRC_CHUNK : due;
+		for(i=0;i<n;i++)
+		{
+			wave = sine_interp((uint32_t)src_phs);
+			if(amp != (FIXPARAM_ONE >> 16))
+				wave = (wave * amp) >> 15;
+			buf[2*i] = wave;
+			buf[2*i+1] = -wave;
+			src_phs += frq;
+		}
+		asrc_write(&audio_asrc, buf, n);
+		src_frames += n;
+		due -= n;
+	}
+}
+
+/*
+ * print the ASRC tracking state
+ */
+void Audio_Src_Report(void)
+{
+	printf("ASRC: source %+d ppm, fill %d, %u underruns, %u overruns\n",
+		asrc_ppm(&audio_asrc),
+		(int32_t)(audio_asrc.head - audio_asrc.tail),
+		audio_asrc.underruns, audio_asrc.overruns);
+}
+
 /*
  * handle new buffer of ADC data
  */
 void __not_in_flash_func(Audio_Proc)(volatile int16_t *dst, volatile int16_t *src, int32_t len)
 {
+	volatile int16_t *out = dst;
+	int32_t amp = audio_amp, n = len;
 	int16_t wave;
 	
+	audio_blocks++;
+	
+	/* input measurement for core 0 */
+	if(meter_armed())
+		meter_feed((const int16_t *)src, len);
+	
+	/* silence while muted */
+	if(core1_mute)
+	{
+		while(len--)
+			*dst++ = 0;
+		return;
+	}
+	
 	switch(core1_mode)
 	{
 		default:
-		case 0:
-		case 1:
+		case AUDIO_MODE_SAW:
+		case AUDIO_MODE_SINE:
 			/* saw & sine gen */
 			while(len)
 			{
-				if(core1_mode == 0)
+				if(core1_mode == AUDIO_MODE_SAW)
 					wave = phs >> 16;	// saw
 				else
 					wave = sine_interp((uint32_t)phs);		// sine
@@ -149,12 +693,146 @@ void __not_in_flash_func(Audio_Proc)(volatile int16_t *dst, volatile int16_t *sr
 				phs += frq;
 				len-=2;
 			}
+			if(amp != FIXPARAM_ONE)
+				Audio_Level(out, n, amp);
 			break;
 				
-		case 2:
+		case AUDIO_MODE_THRU:
 			/* just pass-thru */
 			while(len--)
 				*dst++ = *src++;
 			break;
+		
+		case AUDIO_MODE_ASRC:
+			/* core 0 sine through the ASRC */
+			asrc_read(&audio_asrc, (int16_t *)dst, len/2);
+			break;
+	}
+}
+
+/*
+ * handle new buffer of 32-bit ADC data - 24-bit words are MSB aligned
+ */
+void __not_in_flash_func(Audio_Proc32)(volatile int32_t *dst, volatile int32_t *src, int32_t len)
+{
+	volatile int32_t *out = dst;
+	int32_t amp = audio_amp, n = len;
+	int32_t wave;
+	
+	audio_blocks++;
+	
+	/* input measurement for core 0 */
+	if(meter_armed())
+		meter_feed32((const int32_t *)src, len);
+	
+	/* silence while muted */
+	if(core1_mute)
+	{
+		while(len--)
+			*dst++ = 0;
+		return;
+	}
+	
+	switch(core1_mode)
+	{
+		default:
+		case AUDIO_MODE_SAW:
+		case AUDIO_MODE_SINE:
+			/* saw & sine gen */
+			while(len)
+			{
+				if(core1_mode == AUDIO_MODE_SAW)
+					wave = phs;	// saw
+				else
+					wave = sine_interp32((uint32_t)phs);		// sine
+				
+				*dst++ = wave;
+				*dst++ = -wave;
+				
+				phs += frq;
+				len-=2;
+			}
+			if(amp != FIXPARAM_ONE)
+				Audio_Level32(out, n, amp);
+			break;
+				
+		case AUDIO_MODE_THRU:
+			/* just pass-thru */
+			while(len--)
+				*dst++ = *src++;
+			break;
+		
+		case AUDIO_MODE_ASRC:
+			/* core 0 sine through the ASRC, MSB aligned */
+			{
+				int16_t buf[BUFSZ];
+				asrc_read(&audio_asrc, buf, len/2);
+				for(int32_t i=0;i<len;i++)
+					*dst++ = buf[i] * 65536;
+			}
+			break;
+	}
+}
+
+/*
+ * handle new buffer of TDM data - planar, one run of frames per slot with
+ * samples MSB aligned in 32 bits
+ */
+void __not_in_flash_func(Audio_Proc_TDM)(int32_t *dst, const int32_t *src,
+	uint8_t slots, int32_t frames)
+{
+	int32_t i, s, n = slots * frames, amp = audio_amp;
+	
+	audio_blocks++;
+	
+	/* input measurement for core 0 */
+	if(meter_armed())
+		meter_feed_tdm(src, frames);
+	
+	/* silence while muted */
+	if(core1_mute)
+	{
+		while(n--)
+			*dst++ = 0;
+		return;
+	}
+	
+	switch(core1_mode)
+	{
+		default:
+		case AUDIO_MODE_SAW:
+		case AUDIO_MODE_SINE:
+			/* saw & sine gen in slot 0, other slots alternate sign */
+			for(i=0;i<frames;i++)
+			{
+				if(core1_mode == AUDIO_MODE_SAW)
+					dst[i] = phs;	// saw
+				else
+					dst[i] = sine_interp32((uint32_t)phs);		// sine
+				phs += frq;
+			}
+			if(amp != FIXPARAM_ONE)
+				Audio_Level32(dst, frames, amp);
+			for(s=1;s<slots;s++)
+				for(i=0;i<frames;i++)
+					dst[s*frames + i] = (s & 1) ? -dst[i] : dst[i];
+			break;
+				
+		case AUDIO_MODE_THRU:
+			/* just pass-thru */
+			while(n--)
+				*dst++ = *src++;
+			break;
+		
+		case AUDIO_MODE_ASRC:
+			/* core 0 sine through the ASRC, its pair alternating over the slots */
+			{
+				int16_t buf[BUFSZ];
+				asrc_read(&audio_asrc, buf, frames);
+				for(s=0;s<slots;s++)
+					for(i=0;i<frames;i++)
+						*dst++ = buf[2*i + (s & 1)] * 65536;
+			}
+			break;
 	}
 }
@@ -12,7 +12,27 @@
 #define SMPS 32
 #define CHLS 2
 #define BUFSZ (SMPS*CHLS)
-#define AUDIO_MODES 3
+#define AUDIO_MODES 4
+
+/* modes - the ASRC one has a sine made on core 0 from the us timer */
+#define AUDIO_MODE_SAW 0
+#define AUDIO_MODE_SINE 1
+#define AUDIO_MODE_THRU 2
+#define AUDIO_MODE_ASRC 3
+
+/* where the audio is at */
+typedef struct
+{
+	uint8_t mode, mute;
+	uint32_t fs;
+	uint32_t hz;			// test tone in Q16.16 Hz
+	uint32_t inc;			// its phase increment per frame
+	int32_t db;				// its level in 1/256 dB
+	uint32_t blocks;		// output blocks made
+	uint32_t resyncs;		// slips put right by Audio_Watch()
+	int32_t src_ppm;		// ASRC source against the I2S clock
+	uint32_t src_underruns, src_overruns;
+} audio_status;
 
 extern int16_t audio_sl[4], audio_len;
 extern uint64_t audio_duty, audio_period;
@@ -20,10 +40,29 @@ extern uint64_t audio_duty, audio_period;
 void Audio_Init(void);
 void Audio_Set_Algo(uint8_t *curr_algo, uint8_t next_algo);
 void Audio_Set_Mute(uint8_t enable);
+int32_t Audio_Set_Rate(uint32_t fs);
+int32_t Audio_Rate_Post(uint32_t fs);
+int32_t Audio_Rate_Poll(void);
+int32_t Audio_Set_Format(uint8_t fmt, uint8_t bits);
+int32_t Audio_Set_TDM(uint8_t slots, uint8_t bits);
+int32_t Audio_Set_Clocking(uint8_t codec_master);
 void Audio_Mode(uint8_t new_mode);
+void Audio_Mode_Post(uint8_t new_mode);
+uint8_t Audio_Mode_Live(void);
+int32_t Audio_Set_Tone(uint32_t hz);
+int32_t Audio_Set_Level(int32_t db);
+uint8_t Audio_Get_Mode(void);
+void Audio_Get_Status(audio_status *s);
+void Audio_Src_Poll(void);
+void Audio_Src_Report(void);
+uint32_t Audio_Watch(void);
 void Audio_Disable_Core(uint8_t disable);
 void Audio_Fore(void);
 void Audio_Proc(volatile int16_t *dst, volatile int16_t *src, int32_t sz);
+void Audio_Proc32(volatile int32_t *dst, volatile int32_t *src, int32_t sz);
+void Audio_Proc_TDM(int32_t *dst, const int32_t *src, uint8_t slots,
+	int32_t frames);
+int16_t sine_interp(uint32_t phs);
 
 #endif
 
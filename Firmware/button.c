@@ -19,6 +19,7 @@ struct repeating_timer btn_rt;
  */
 bool button_callback(repeating_timer_t *rt)
 {
+	(void)rt;
 	debounce(&btn_dbs, (!gpio_get(BUTTON_PIN)));
 	btn_fe |= btn_dbs.fe;
 	btn_re |= btn_dbs.re;
@@ -0,0 +1,506 @@
+/*
+ * capture.c - triggered capture of I2S input with a pre-trigger ring
+ *
+ * While armed the input DMA of one I2S instance writes its blocks in turn
+ * round a ring in RAM instead of the ping-pong buffers, so nothing is
+ * copied and the audio callback reads them where they land. A tap on the
+ * input ISR scans the watched slot of each block for the trigger, lets
+ * the ring run on for the frames wanted after it, then takes the ring off
+ * the DMA, which freezes it. Core 0 sends the frames around the trigger
+ * over the console as base64 lines that capture_dec.py turns into a WAV
+ * file:
+ *   #CH fs bits slots frames pre trig
+ *   #CD base64 of the samples, frame by frame, little endian in bits/8 bytes
+ *   #CE bytes crc32
+ *
+ * The host build's rp2040_i2s_capture is this with CAPTURE_HOST, running
+ * each trigger over modelled blocks in several formats; "-d" prints a
+ * capture to try capture_dec.py on.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "capture.h"
+#ifndef CAPTURE_HOST
+#include "i2s_fulldup.h"
+#else
+#define __not_in_flash_func(f) f
+#define __uninitialized_ram(v) v
+enum {FMT_I2S, FMT_LJ, FMT_RJ, FMT_DSP_A, FMT_DSP_B, FMT_TDM};
+
+/* just what the capture uses of the I2S engine */
+typedef struct i2s_inst i2s_inst;
+typedef void (*i2s_tap_fn)(i2s_inst *i2s, uint32_t *src);
+struct i2s_inst
+{
+	uint32_t ib_idx;
+	uint32_t *in_blk;
+	uint32_t *ring;
+	uint32_t ring_blocks, ring_idx;
+	i2s_tap_fn tap;
+};
+
+#define I2S_INSTANCES 1
+static i2s_inst sim_inst;
+static uint32_t i2s_words, Fsample;
+static uint8_t i2s_bits, i2s_slot_bits, i2s_fmt, i2s_slots;
+static void i2s_fulldup_set_ring(uint8_t idx, uint32_t *ring, uint32_t blocks,
+	i2s_tap_fn tap);
+#endif
+
+/* bytes per console line - 76 base64 characters */
+#define CAPTURE_LINE 57
+
+/* the ring doesn't need clearing at boot */
+static uint32_t __uninitialized_ram(capture_ring)[CAPTURE_WORDS];
+
+static capture_cfg capture_c;
+static uint32_t capture_bframes, capture_fw, capture_blocks;
+static uint32_t capture_landed, capture_k0, capture_at;
+static uint32_t capture_first, capture_frames;
+static uint32_t capture_crc, capture_bytes;
+static int32_t capture_prev;
+static uint8_t capture_idx;
+static volatile uint8_t capture_st, capture_soft, capture_unmuted;
+
+/*
+ * one slot of a frame in a block, MSB aligned in 32 bits with anything
+ * below the word length cleared
+ */
+static inline int32_t capture_in(const uint32_t *blk, uint32_t f, uint8_t slot)
+{
+	uint32_t w;
+
+	if(i2s_slot_bits == 16)
+	{
+		w = blk[f*capture_fw + slot/2];
+		return (int32_t)((slot & 1) ? w << 16 : w & 0xFFFF0000);
+	}
+	w = blk[f*capture_fw + slot];
+	if(i2s_fmt == FMT_RJ)
+		w <<= 32 - i2s_bits;
+	return (int32_t)(w & (0xFFFFFFFF << (32 - i2s_bits)));
+}
+
+/*
+ * a frame counted from the first block that landed in the ring - landed
+ * blocks follow each other round it
+ */
+static int32_t capture_get(uint32_t f, uint8_t slot)
+{
+	uint32_t b = (capture_k0 + f / capture_bframes) % capture_blocks;
+
+	return capture_in(&capture_ring[b*i2s_words], f % capture_bframes, slot);
+}
+
+/*
+ * trigger condition on the watched slot's next sample
+ */
+static inline uint8_t capture_hit(int32_t x)
+{
+	int32_t lvl = capture_c.level * 65536;
+
+	switch(capture_c.trig)
+	{
+		case CAPTURE_TRIG_LEVEL:
+			return (x >= lvl) || (x <= -lvl);
+		case CAPTURE_TRIG_RISE:
+			return (capture_prev < lvl) && (x >= lvl);
+		case CAPTURE_TRIG_FALL:
+			return (capture_prev >= lvl) && (x < lvl);
+		case CAPTURE_TRIG_UNMUTE:
+			return capture_unmuted && x;
+		default:
+			return capture_soft;
+	}
+}
+
+/*
+ * input tap - look for the trigger in each block as it lands, then freeze
+ * the ring once enough frames are in after it. The block after the last
+ * is already landing over the oldest, so that one's lost. Runs in the
+ * input DMA ISR.
+ */
+static void __not_in_flash_func(capture_tap)(i2s_inst *i2s, uint32_t *src)
+{
+	uint32_t i, m, start, pre;
+	int32_t x;
+
+	/* blocks from before the ring took over, or after it froze */
+	if((src < capture_ring) || (src >= &capture_ring[CAPTURE_WORDS]) ||
+		(capture_st == CAPTURE_FROZEN))
+		return;
+
+	m = capture_landed++;
+	if(!m)
+	{
+		capture_k0 = (src - capture_ring) / i2s_words;
+		capture_prev = capture_in(src, 0, capture_c.slot);
+	}
+
+	if(capture_st == CAPTURE_ARMED)
+	{
+		for(i=0;i<capture_bframes;i++)
+		{
+			x = capture_in(src, i, capture_c.slot);
+			if(capture_hit(x))
+			{
+				capture_at = m*capture_bframes + i;
+				capture_st = CAPTURE_TRIGGERED;
+				break;
+			}
+			capture_prev = x;
+		}
+	}
+
+	if((capture_st == CAPTURE_TRIGGERED) &&
+		((m+1)*capture_bframes - capture_at >= capture_c.post))
+	{
+		i2s->ring = NULL;
+
+		/* frames before the trigger that are still there */
+		start = (m + 2 > capture_blocks) ?
+			(m + 2 - capture_blocks)*capture_bframes : 0;
+		pre = capture_at - start;
+		if(pre > capture_c.pre)
+			pre = capture_c.pre;
+		capture_first = capture_at - pre;
+		capture_frames = pre + capture_c.post;
+
+		__sync_synchronize();
+		capture_st = CAPTURE_FROZEN;
+	}
+}
+
+/*
+ * start filling the ring from an instance's input & look for the trigger -
+ * takes effect at the next block. Arm again after a rate or format
+ * change. Returns 0 if ok, 1 if the setup is bad or doesn't fit the ring.
+ */
+int32_t capture_arm(uint8_t idx, const capture_cfg *cfg)
+{
+	if((idx >= I2S_INSTANCES) || (cfg->trig >= CAPTURE_TRIG_NUM) ||
+		(cfg->slot >= i2s_slots) || !cfg->post)
+		return 1;
+
+	capture_stop();
+	capture_bframes = i2s_words * 32 / i2s_slot_bits / i2s_slots;
+	capture_fw = i2s_words / capture_bframes;
+	capture_blocks = CAPTURE_WORDS / i2s_words;
+
+	/* the trigger can be anywhere in a block & the last one in is lost */
+	if(cfg->pre + cfg->post > (capture_blocks - 2)*capture_bframes)
+		return 1;
+
+	capture_c = *cfg;
+	capture_landed = 0;
+	capture_soft = 0;
+	capture_unmuted = 0;
+	capture_st = CAPTURE_ARMED;
+	capture_idx = idx;
+	i2s_fulldup_set_ring(idx, capture_ring, capture_blocks, capture_tap);
+
+	return 0;
+}
+
+/*
+ * give the instance its ping-pong buffers back & drop any capture
+ */
+void capture_stop(void)
+{
+	i2s_fulldup_set_ring(capture_idx, NULL, 0, NULL);
+	capture_st = CAPTURE_IDLE;
+}
+
+/*
+ * software trigger - fires at the first frame of the block being received
+ */
+void capture_trigger(void)
+{
+	capture_soft = 1;
+}
+
+/*
+ * the audio just unmuted - lets CAPTURE_TRIG_UNMUTE look for sound
+ */
+void capture_unmute(void)
+{
+	capture_unmuted = 1;
+}
+
+/*
+ * CAPTURE_xx state
+ */
+uint8_t capture_state(void)
+{
+	return capture_st;
+}
+
+/*
+ * send a line of samples as base64 & keep the CRC-32 going
+ */
+static void capture_line(const uint8_t *buf, uint32_t n)
+{
+	static const char b64[] =
+		"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	char out[4*CAPTURE_LINE/3 + 1], *p = out;
+	uint32_t i, b, v;
+
+	for(i=0;i<n;i++)
+	{
+		capture_crc ^= buf[i];
+		for(b=0;b<8;b++)
+			capture_crc = (capture_crc >> 1) ^ (0xEDB88320 & -(capture_crc & 1));
+	}
+	capture_bytes += n;
+
+	for(i=0;i<n;i+=3)
+	{
+		v = (uint32_t)buf[i] << 16;
+		if(i+1 < n)
+			v |= (uint32_t)buf[i+1] << 8;
+		if(i+2 < n)
+			v |= buf[i+2];
+		*p++ = b64[(v >> 18) & 63];
+		*p++ = b64[(v >> 12) & 63];
+		*p++ = (i+1 < n) ? b64[(v >> 6) & 63] : '=';
+		*p++ = (i+2 < n) ? b64[v & 63] : '=';
+	}
+	*p = 0;
+	printf("#CD %s\n", out);
+}
+
+/*
+ * send a frozen capture over the console - returns 0 if sent, 1 if there
+ * isn't one
+ */
+int32_t capture_dump(void)
+{
+	uint8_t buf[CAPTURE_LINE], s;
+	uint32_t f, b, v, n = 0, nb = i2s_bits / 8;
+
+	if(capture_st != CAPTURE_FROZEN)
+		return 1;
+	__sync_synchronize();
+
+	printf("#CH %u %u %u %u %u %u\n", Fsample, i2s_bits, i2s_slots,
+		capture_frames, capture_at - capture_first, capture_c.trig);
+	capture_crc = 0xFFFFFFFF;
+	capture_bytes = 0;
+	for(f=0;f<capture_frames;f++)
+	{
+		for(s=0;s<i2s_slots;s++)
+		{
+			v = (uint32_t)capture_get(capture_first + f, s) >> (32 - i2s_bits);
+			for(b=0;b<nb;b++)
+			{
+				buf[n++] = v;
+				v >>= 8;
+				if(n == CAPTURE_LINE)
+				{
+					capture_line(buf, n);
+					n = 0;
+				}
+			}
+		}
+	}
+	if(n)
+		capture_line(buf, n);
+	printf("#CE %u %08X\n", capture_bytes, capture_crc ^ 0xFFFFFFFF);
+
+	return 0;
+}
+
+#ifdef CAPTURE_HOST
+#include <stdlib.h>
+
+#define SIM_BLOCKS 2000
+
+static uint32_t sim_buf[2][CAPTURE_WORDS];
+static uint32_t sim_rnd;
+
+/*
+ * the engine's side of the ring
+ */
+static void i2s_fulldup_set_ring(uint8_t idx, uint32_t *ring, uint32_t blocks,
+	i2s_tap_fn tap)
+{
+	(void)idx;
+	sim_inst.ring_blocks = blocks;
+	sim_inst.ring_idx = blocks - 1;
+	sim_inst.ring = ring;
+	sim_inst.tap = tap;
+}
+
+/*
+ * modelled input - noise at a quarter of the level on every slot, with
+ * the event on the watched slot from frame ev: a step up to full level
+ * for LEVEL & RISE, down for FALL, and sound after silence for UNMUTE.
+ * MSB aligned at the word length.
+ */
+static int32_t sim_gen(uint8_t trig, uint8_t slot, int32_t lvl, uint32_t n,
+	uint8_t s, uint32_t ev)
+{
+	uint32_t h = (n * 2654435761u) ^ (s * 40503u) ^ sim_rnd;
+	int32_t x;
+
+	h ^= h >> 15;
+	h *= 0x2C1B3C6D;
+	h ^= h >> 12;
+	x = (int32_t)(h % (uint32_t)(lvl/2)) - lvl/4;
+
+	if(s == slot)
+	{
+		if((trig == CAPTURE_TRIG_UNMUTE) && (n >= ev - 200))
+			x = (n < ev) ? 0 : x | 1;
+		if((n >= ev) && ((trig == CAPTURE_TRIG_LEVEL) || (trig == CAPTURE_TRIG_RISE)))
+			x = lvl + 1000;
+		if((n >= ev) && (trig == CAPTURE_TRIG_FALL))
+			x = -lvl;
+		if((n < ev) && (trig == CAPTURE_TRIG_FALL))
+			x += lvl + lvl/2;
+	}
+
+	return (int32_t)((uint32_t)x << 16) & (int32_t)(0xFFFFFFFF << (32 - i2s_bits));
+}
+
+/*
+ * FIFO words for a frame
+ */
+static void sim_frame(uint32_t *w, const int32_t *v)
+{
+	uint8_t s;
+
+	if(i2s_slot_bits == 16)
+		for(s=0;s<i2s_slots;s+=2)
+			*w++ = ((uint32_t)v[s] & 0xFFFF0000) | ((uint32_t)v[s+1] >> 16);
+	else
+		for(s=0;s<i2s_slots;s++)
+			*w++ = (i2s_fmt == FMT_RJ) ? (uint32_t)(v[s] >> (32 - i2s_bits)) :
+				(uint32_t)v[s];
+}
+
+/*
+ * run blocks through the ring & tap with the trigger set off at frame ev
+ * after arming at frame 0 - the software trigger and the unmute are given
+ * while the block with ev is received. Checks the frozen frames against
+ * the model. Returns 0 if they match.
+ */
+static int32_t sim_run(const char *name, uint8_t fmt, uint8_t bits,
+	uint8_t slots, uint8_t trig, uint32_t pre, uint32_t post, uint32_t ev)
+{
+	capture_cfg cfg = {trig, slots - 1, 8000, pre, post};
+	uint32_t blk, i, n = 0, want_pre;
+	int32_t v[16], lvl = cfg.level;
+	uint8_t s;
+
+	i2s_fmt = fmt;
+	i2s_bits = bits;
+	i2s_slot_bits = (bits > 16) ? 32 : 16;
+	i2s_slots = slots;
+	i2s_words = 32 * slots * i2s_slot_bits / 32;
+	Fsample = 48000;
+	sim_rnd = rand();
+
+	memset(&sim_inst, 0, sizeof(sim_inst));
+	sim_inst.in_blk = sim_buf[0];
+	if(capture_arm(0, &cfg))
+	{
+		printf("%-28s won't arm\n", name);
+		return 1;
+	}
+
+	for(blk=0;blk<SIM_BLOCKS && (capture_st != CAPTURE_FROZEN);blk++)
+	{
+		/* DMA fills the block in flight */
+		for(i=0;i<capture_bframes;i++,n++)
+		{
+			for(s=0;s<slots;s++)
+				v[s] = sim_gen(trig, cfg.slot, lvl, n, s, ev);
+			sim_frame(&sim_inst.in_blk[i*capture_fw], v);
+		}
+		if((n > ev) && (n - capture_bframes <= ev))
+		{
+			if(trig == CAPTURE_TRIG_SOFT)
+				capture_trigger();
+			if(trig == CAPTURE_TRIG_UNMUTE)
+				capture_unmute();
+		}
+
+		/* input ISR - the first block went to the ping-pong buffers */
+		uint32_t *done = sim_inst.in_blk;
+		sim_inst.ib_idx ^= 1;
+		if(sim_inst.ring)
+		{
+			if(++sim_inst.ring_idx >= sim_inst.ring_blocks)
+				sim_inst.ring_idx = 0;
+			sim_inst.in_blk = &sim_inst.ring[sim_inst.ring_idx*i2s_words];
+		}
+		else
+			sim_inst.in_blk = sim_buf[sim_inst.ib_idx];
+		if(sim_inst.tap)
+			sim_inst.tap(&sim_inst, done);
+	}
+
+	if(capture_st != CAPTURE_FROZEN)
+	{
+		printf("%-28s never froze\n", name);
+		return 1;
+	}
+
+	/* ring frames are counted from the second block */
+	if(trig == CAPTURE_TRIG_SOFT)
+		ev -= ev % capture_bframes;
+	want_pre = (ev - capture_bframes < pre) ? ev - capture_bframes : pre;
+	if((capture_at + capture_bframes != ev) ||
+		(capture_at - capture_first != want_pre) ||
+		(capture_frames != want_pre + post))
+	{
+		printf("%-28s trigger %u pre %u frames %u, wanted %u %u %u\n", name,
+			capture_at + capture_bframes, capture_at - capture_first,
+			capture_frames, ev, want_pre, want_pre + post);
+		return 1;
+	}
+	for(i=0;i<capture_frames;i++)
+	{
+		for(s=0;s<slots;s++)
+		{
+			n = capture_first + capture_bframes + i;
+			if(capture_get(capture_first + i, s) != sim_gen(trig, cfg.slot, lvl, n, s, ev))
+			{
+				printf("%-28s frame %u slot %u differs\n", name, n, s);
+				return 1;
+			}
+		}
+	}
+
+	printf("%-28s trigger at %6u, %5u + %5u frames ok\n", name, ev,
+		want_pre, post);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	int32_t err = 0;
+
+	err |= sim_run("I2S 16 level", FMT_I2S, 16, 2, CAPTURE_TRIG_LEVEL, 4000, 4000, 30017);
+	err |= sim_run("I2S 16 rise", FMT_I2S, 16, 2, CAPTURE_TRIG_RISE, 8000, 100, 9000);
+	err |= sim_run("I2S 16 fall, short pre", FMT_I2S, 16, 2, CAPTURE_TRIG_FALL, 8000, 500, 1000);
+	err |= sim_run("I2S 24 unmute", FMT_I2S, 24, 2, CAPTURE_TRIG_UNMUTE, 2000, 2000, 20500);
+	err |= sim_run("RJ 24 soft", FMT_RJ, 24, 2, CAPTURE_TRIG_SOFT, 1000, 3000, 12345);
+	err |= sim_run("LJ 32 level", FMT_LJ, 32, 2, CAPTURE_TRIG_LEVEL, 3000, 1000, 7777);
+	err |= sim_run("TDM 4x16 rise", FMT_TDM, 16, 4, CAPTURE_TRIG_RISE, 2000, 2000, 25003);
+	err |= sim_run("TDM 8x32 level", FMT_TDM, 32, 8, CAPTURE_TRIG_LEVEL, 1000, 900, 40000);
+	if(sim_run("TDM 16x32 too long", FMT_TDM, 32, 16, CAPTURE_TRIG_LEVEL, 1000, 1000, 4000) != 1)
+		err = 1;
+
+	if((argc > 1) && !strcmp(argv[1], "-d"))
+	{
+		sim_run("I2S 24 level", FMT_I2S, 24, 2, CAPTURE_TRIG_LEVEL, 480, 480, 5000);
+		capture_dump();
+	}
+
+	printf(err ? "FAIL\n" : "PASS\n");
+	return err ? 1 : 0;
+}
+#endif
@@ -0,0 +1,49 @@
+/*
+ * capture.h - triggered capture of I2S input with a pre-trigger ring
+ */
+
+#ifndef __capture__
+#define __capture__
+
+#include <stdint.h>
+
+/* ring size in FIFO words - 16384 frames of 16-bit stereo */
+#define CAPTURE_WORDS 16384
+
+/* what fires the trigger */
+enum capture_trigs
+{
+	CAPTURE_TRIG_LEVEL,		// |sample| reaches level
+	CAPTURE_TRIG_RISE,		// sample crosses level going up
+	CAPTURE_TRIG_FALL,		// sample crosses level going down
+	CAPTURE_TRIG_UNMUTE,	// first non-zero sample after capture_unmute()
+	CAPTURE_TRIG_SOFT,		// capture_trigger()
+	CAPTURE_TRIG_NUM
+};
+
+enum capture_states
+{
+	CAPTURE_IDLE,
+	CAPTURE_ARMED,
+	CAPTURE_TRIGGERED,
+	CAPTURE_FROZEN
+};
+
+/* what to capture */
+typedef struct
+{
+	uint8_t trig;		// CAPTURE_TRIG_xx
+	uint8_t slot;		// slot the trigger watches
+	int16_t level;		// at 16-bit full scale
+	uint32_t pre;		// frames kept before the trigger
+	uint32_t post;		// and from it on
+} capture_cfg;
+
+int32_t capture_arm(uint8_t idx, const capture_cfg *cfg);
+void capture_stop(void);
+void capture_trigger(void);
+void capture_unmute(void);
+uint8_t capture_state(void);
+int32_t capture_dump(void);
+
+#endif
@@ -0,0 +1,61 @@
+#!/usr/bin/env python3
+# capture_dec.py - turn captures ("#CH/#CD/#CE" lines, see capture.c) in a
+# console log or stdin into WAV files, one per capture, and say where each
+# one triggered.
+#
+# usage: capture_dec.py [log file] [-o output prefix]
+
+import base64
+import sys
+import wave
+import zlib
+
+TRIGS = ['level', 'rise', 'fall', 'unmute', 'soft']
+
+def save(name, hdr, data):
+    fs, bits, slots, frames, pre, trig = hdr
+    nb = bits // 8
+    if len(data) != frames * slots * nb:
+        print('%s: %d bytes, wanted %d' % (name, len(data), frames * slots * nb))
+        return
+    w = wave.open(name, 'wb')
+    w.setnchannels(slots)
+    w.setsampwidth(nb)
+    w.setframerate(fs)
+    w.writeframes(data)
+    w.close()
+    tname = TRIGS[trig] if trig < len(TRIGS) else '?'
+    print('%s: %d frames of %d x %d-bit at %d Hz, %s trigger at frame %d (%.3f ms)' %
+          (name, frames, slots, bits, fs, tname, pre, 1000.0 * pre / fs))
+
+def main():
+    args = sys.argv[1:]
+    prefix = 'capture'
+    if '-o' in args:
+        i = args.index('-o')
+        prefix = args[i+1]
+        del args[i:i+2]
+    inp = open(args[0], errors='replace') if args else sys.stdin
+    hdr, data, n = None, b'', 0
+    for line in inp:
+        f = line.split()
+        if not f:
+            continue
+        try:
+            if f[0] == '#CH':
+                hdr, data = [int(x) for x in f[1:7]], b''
+            elif f[0] == '#CD' and hdr:
+                data += base64.b64decode(f[1])
+            elif f[0] == '#CE' and hdr:
+                name = '%s%d.wav' % (prefix, n)
+                if int(f[1]) != len(data) or int(f[2], 16) != zlib.crc32(data):
+                    print('%s: bad length or CRC, dropped' % name)
+                else:
+                    save(name, hdr, data)
+                n += 1
+                hdr = None
+        except (ValueError, IndexError, base64.binascii.Error):
+            print('bad record: ' + line.strip())
+            hdr = None
+
+main()
@@ -0,0 +1,220 @@
+/*
+ * clkplan.c - system clock / PIO / MCLK plan solver for RP2040 audio rates
+ *
+ * MCLK comes from clk_sys through an integer GPOUT divider and the I2S
+ * PIO runs from clk_sys through its own divider, so for the two to stay
+ * phase locked the PIO divider must be an exact multiple of the MCLK
+ * divider in 16.8 fixed point. The solver walks the MCLK divider and the
+ * PLL post dividers, derives the nearest feedback divider for each and
+ * keeps the lowest error plan. The inner loop has no 64-bit divides so a
+ * query takes well under a millisecond on target.
+ *
+ * With CLKPLAN_HOST it's rp2040_i2s_clkplan in the host build, printing
+ * the plans for the common rates.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "clkplan.h"
+#ifndef CLKPLAN_HOST
+#include "pico/stdlib.h"
+#include "hardware/clocks.h"
+#include "hardware/pll.h"
+#include "hardware/uart.h"
+#endif
+
+/*
+ * |a_num/a_den| < |b_num/b_den| for errors as fractions
+ */
+static int clkplan_better(int64_t a_num, uint32_t a_den, int64_t b_num,
+	uint32_t b_den)
+{
+	if(a_num < 0)
+		a_num = -a_num;
+	if(b_num < 0)
+		b_num = -b_num;
+
+	return a_num * b_den < b_num * a_den;
+}
+
+/**
+  * @brief  Find the lowest error clock plan for a sample rate
+  * @param  plan: result
+  * @param  fs: sample rate in Hz
+  * @param  mclk_ratio: MCLK/Fs
+  * @param  frame_cycles: PIO clocks per I2S frame
+  * @retval 0 if a plan was found, else 1
+  */
+int32_t clkplan_solve(clkplan *plan, uint32_t fs, uint16_t mclk_ratio,
+	uint16_t frame_cycles)
+{
+	uint32_t mclk, m, m_min, m_max, sys, vco, ref, fb, pd, pd1, pd2, refdiv;
+	uint32_t pio_div, den, best_den = 1;
+	int64_t diff, best_diff = 0;
+	int32_t found = 0;
+
+	memset(plan, 0, sizeof(clkplan));
+	plan->fs = fs;
+	plan->mclk_ratio = mclk_ratio;
+	plan->frame_cycles = frame_cycles;
+
+	if(!fs || !mclk_ratio || !frame_cycles)
+		return 1;
+
+	/* range of MCLK dividers that land clk_sys in bounds */
+	mclk = fs * mclk_ratio;
+	m_min = (CLKPLAN_SYS_MIN_HZ + mclk - 1) / mclk;
+	m_max = CLKPLAN_SYS_MAX_HZ / mclk;
+	if(!m_min)
+		m_min = 1;
+
+	/* walk down so ties go to the fastest clk_sys */
+	for(m=m_max;m>=m_min;m--)
+	{
+		/* can't beat exact */
+		if(found && !best_diff)
+			break;
+		
+		/* PIO divider must be exact in 16.8 and at least 1.0 */
+		if((m * mclk_ratio * 256) % frame_cycles)
+			continue;
+		pio_div = (m * mclk_ratio * 256) / frame_cycles;
+		if((pio_div < 0x100) || (pio_div >= 0x1000000))
+			continue;
+
+		sys = m * mclk;
+		for(refdiv=1;CLKPLAN_XOSC_HZ/refdiv >= CLKPLAN_REF_MIN_HZ;refdiv++)
+		{
+			ref = CLKPLAN_XOSC_HZ / refdiv;
+			for(pd1=7;pd1>=1;pd1--)
+			{
+				for(pd2=pd1;pd2>=1;pd2--)
+				{
+					/* ideal VCO, skipping anything out of range */
+					pd = pd1 * pd2;
+					if(sys > CLKPLAN_VCO_MAX_HZ / pd)
+						continue;
+					vco = sys * pd;
+
+					/* nearest feedback divider */
+					fb = (vco + ref/2) / ref;
+					if((fb < CLKPLAN_FBDIV_MIN) || (fb > CLKPLAN_FBDIV_MAX))
+						continue;
+					if((fb * ref < CLKPLAN_VCO_MIN_HZ) || (fb * ref > CLKPLAN_VCO_MAX_HZ))
+						continue;
+
+					/* error relative to the ideal VCO */
+					diff = (int64_t)fb * ref - vco;
+					den = vco;
+					if(!found || clkplan_better(diff, den, best_diff, best_den))
+					{
+						found = 1;
+						best_diff = diff;
+						best_den = den;
+						plan->refdiv = refdiv;
+						plan->postdiv1 = pd1;
+						plan->postdiv2 = pd2;
+						plan->fbdiv = fb;
+						plan->vco_hz = fb * ref;
+						plan->sys_hz = plan->vco_hz / pd;
+						plan->pio_div = pio_div;
+						plan->mclk_div = m;
+					}
+				}
+			}
+		}
+	}
+
+	if(!found)
+		return 1;
+
+	/* report actual rate & error */
+	plan->fs_mhz = ((uint64_t)plan->vco_hz * 1000) /
+		((uint64_t)plan->postdiv1 * plan->postdiv2 * plan->mclk_div * mclk_ratio);
+	plan->err_ppb = (best_diff * 1000000000) / best_den;
+
+	return 0;
+}
+
+#ifndef CLKPLAN_HOST
+/**
+  * @brief  Switch clk_sys to a new plan
+  * @note   Caller must stop anything timed from clk_sys first. clk_peri is
+  *         moved to the 48MHz USB PLL so UART rates stay fixed. I2C runs
+  *         from clk_sys, so its divider has to be set again after.
+  * @param  plan: plan from clkplan_solve()
+  * @retval 0 if ok
+  */
+int32_t clkplan_apply(const clkplan *plan)
+{
+	/* run clk_sys from the USB PLL while PLL_SYS relocks */
+	clock_configure(clk_sys,
+		CLOCKS_CLK_SYS_CTRL_SRC_VALUE_CLKSRC_CLK_SYS_AUX,
+		CLOCKS_CLK_SYS_CTRL_AUXSRC_VALUE_CLKSRC_PLL_USB,
+		48 * MHZ,
+		48 * MHZ);
+
+	pll_init(pll_sys, plan->refdiv, plan->vco_hz, plan->postdiv1, plan->postdiv2);
+
+	clock_configure(clk_sys,
+		CLOCKS_CLK_SYS_CTRL_SRC_VALUE_CLKSRC_CLK_SYS_AUX,
+		CLOCKS_CLK_SYS_CTRL_AUXSRC_VALUE_CLKSRC_PLL_SYS,
+		plan->sys_hz,
+		plan->sys_hz);
+
+	/* keep peripherals independent of clk_sys */
+	if(clock_get_hz(clk_peri) != 48 * MHZ)
+	{
+		clock_configure(clk_peri,
+			0,
+			CLOCKS_CLK_PERI_CTRL_AUXSRC_VALUE_CLKSRC_PLL_USB,
+			48 * MHZ,
+			48 * MHZ);
+		uart_set_baudrate(uart_default, PICO_DEFAULT_UART_BAUD_RATE);
+	}
+
+	return 0;
+}
+#else
+#include <time.h>
+
+/*
+ * host tool - print plans for the common rates & ratios
+ */
+int main(void)
+{
+	static const uint32_t rates[] = {44100, 48000, 88200, 96000, 192000};
+	static const uint16_t ratios[] = {128, 256, 384, 512};
+	struct timespec t0, t1;
+	clkplan plan;
+	uint32_t i, j, k;
+	double ns;
+
+	printf("    Fs ratio  refdiv fbdiv pd1 pd2      VCO       sys  pio_div mdiv      actual     ppb    us/query\n");
+	for(i=0;i<sizeof(rates)/sizeof(rates[0]);i++)
+	{
+		for(j=0;j<sizeof(ratios)/sizeof(ratios[0]);j++)
+		{
+			/* time repeated queries for a stable figure */
+			clock_gettime(CLOCK_MONOTONIC, &t0);
+			for(k=0;k<1000;k++)
+				clkplan_solve(&plan, rates[i], ratios[j], 128);
+			clock_gettime(CLOCK_MONOTONIC, &t1);
+			ns = ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) / 1000;
+
+			if(clkplan_solve(&plan, rates[i], ratios[j], 128))
+			{
+				printf("%6u %5u  no plan\n", rates[i], ratios[j]);
+				continue;
+			}
+			printf("%6u %5u  %6u %5u %3u %3u %10u %9u %4u.%03u %4u %7u.%03u %7d %8.2f\n",
+				rates[i], ratios[j], plan.refdiv, plan.fbdiv, plan.postdiv1,
+				plan.postdiv2, plan.vco_hz, plan.sys_hz, plan.pio_div >> 8,
+				((plan.pio_div & 0xff) * 1000) / 256, plan.mclk_div,
+				plan.fs_mhz / 1000, plan.fs_mhz % 1000, plan.err_ppb, ns / 1000);
+		}
+	}
+
+	return 0;
+}
+#endif
@@ -0,0 +1,53 @@
+/*
+ * clkplan.h - system clock / PIO / MCLK plan solver for RP2040 audio rates
+ */
+
+#ifndef __clkplan__
+#define __clkplan__
+
+#include <stdint.h>
+
+/* crystal & PLL limits */
+#define CLKPLAN_XOSC_HZ 12000000
+#define CLKPLAN_VCO_MIN_HZ 750000000
+#define CLKPLAN_VCO_MAX_HZ 1600000000
+#define CLKPLAN_FBDIV_MIN 16
+#define CLKPLAN_FBDIV_MAX 320
+#define CLKPLAN_REF_MIN_HZ 5000000
+
+/* allowed clk_sys range */
+#define CLKPLAN_SYS_MIN_HZ 100000000
+#define CLKPLAN_SYS_MAX_HZ 200000000
+
+/* one complete clock plan */
+typedef struct
+{
+	/* request */
+	uint32_t fs;			// sample rate in Hz
+	uint16_t mclk_ratio;	// MCLK / Fs
+	uint16_t frame_cycles;	// PIO clocks per frame
+
+	/* PLL_SYS */
+	uint8_t refdiv;
+	uint8_t postdiv1;
+	uint8_t postdiv2;
+	uint16_t fbdiv;
+	uint32_t vco_hz;
+	uint32_t sys_hz;
+
+	/* dividers */
+	uint32_t pio_div;		// 16.8 fixed point
+	uint32_t mclk_div;		// integer GPOUT divider
+
+	/* result */
+	uint32_t fs_mhz;		// actual rate in milli-Hz
+	int32_t err_ppb;		// actual vs requested in parts per billion
+} clkplan;
+
+int32_t clkplan_solve(clkplan *plan, uint32_t fs, uint16_t mclk_ratio,
+	uint16_t frame_cycles);
+#ifndef CLKPLAN_HOST
+int32_t clkplan_apply(const clkplan *plan);
+#endif
+
+#endif
@@ -0,0 +1,215 @@
+/*
+ * codec.c - dispatch to the codec selected in main.h
+ *
+ * Keeps the per-codec #if chain in one place so the rest of the firmware
+ * can init, check & reclock whichever codec is built in.
+ */
+
+#include <stdio.h>
+#include "codec_seq.h"
+#include "codec_model.h"
+#include "i2s_fulldup.h"
+#include "wm8731.h"
+#include "aic3101.h"
+#include "nau88c22.h"
+#include "sgtl5000.h"
+#include "uda1345.h"
+#include "codec.h"
+
+#if	defined(CODEC_WM8731)
+#define CODEC_NAME "WM8731"
+#define CODEC_MODEL codec_model_wm8731
+#define CODEC_IF wm8731_if
+#define CODEC_INIT WM8731_Init
+#define CODEC_RESET WM8731_Reset
+#define CODEC_SETRATE WM8731_SetRate
+#define CODEC_SETFORMAT WM8731_SetFormat
+#define CODEC_SETMASTER WM8731_SetMaster
+#elif defined(CODEC_AIC3101)
+#define CODEC_NAME "AIC3101"
+#define CODEC_MODEL codec_model_aic3101
+#define CODEC_IF aic3101_if
+#define CODEC_INIT AIC3101_Init
+#define CODEC_RESET AIC3101_Reset
+#define CODEC_SETRATE AIC3101_SetRate
+#define CODEC_SETFORMAT AIC3101_SetFormat
+#define CODEC_SETMASTER AIC3101_SetMaster
+#elif defined(CODEC_NAU88C22)
+#define CODEC_NAME "NAU88C22"
+#define CODEC_MODEL codec_model_nau88c22
+#define CODEC_IF nau88c22_if
+#define CODEC_INIT NAU88C22_Init
+#define CODEC_RESET NAU88C22_Reset
+#define CODEC_SETRATE NAU88C22_SetRate
+#define CODEC_SETFORMAT NAU88C22_SetFormat
+#define CODEC_SETMASTER NAU88C22_SetMaster
+#elif defined(CODEC_SGTL5000)
+#define CODEC_NAME "SGTL5000"
+#define CODEC_MODEL codec_model_sgtl5000
+#define CODEC_IF sgtl5000_if
+#define CODEC_INIT SGTL5000_Init
+#define CODEC_RESET SGTL5000_Reset
+#define CODEC_SETRATE SGTL5000_SetRate
+#define CODEC_SETFORMAT SGTL5000_SetFormat
+#define CODEC_SETMASTER SGTL5000_SetMaster
+#elif defined(CODEC_UDA1345)
+#define CODEC_NAME "UDA1345"
+#define CODEC_MODEL codec_model_uda1345
+#define CODEC_IF uda1345_if
+#define CODEC_INIT UDA1345_Init
+#define CODEC_RESET UDA1345_Reset
+#define CODEC_SETRATE UDA1345_SetRate
+#define CODEC_SETFORMAT UDA1345_SetFormat
+#define CODEC_SETMASTER UDA1345_SetMaster
+#else
+#error "Please define a codec in main.h"
+#endif
+
+/* the control bus has been set up */
+static uint8_t codec_bus_up;
+
+/*
+ * init the codec & report - returns 0 if ok
+ */
+int32_t Codec_Init(void)
+{
+	codec_bus_up = 1;
+	if(CODEC_INIT())
+	{
+		printf(CODEC_NAME " Codec Init Failed...\n");
+		return 1;
+	}
+	
+	/* match the I2S defaults */
+	if(Codec_SetRate(I2S_FS_DEFAULT, I2S_MCLK_RATIO) ||
+		Codec_SetFormat(I2S_FMT_DEFAULT, I2S_BITS_DEFAULT))
+	{
+		printf(CODEC_NAME " can't run at %d Hz, format %d, %d-bit\n",
+			I2S_FS_DEFAULT, I2S_FMT_DEFAULT, I2S_BITS_DEFAULT);
+		return 1;
+	}
+
+#if	defined(CODEC_AIC3101)
+	printf("AIC3101 Codec Initialized\n");
+	AIC3101_Dump_Regs();
+#elif defined(CODEC_NAU88C22)
+	uint16_t id, rev;
+	NAU88C22_ReadRegister(63, &id);
+	NAU88C22_ReadRegister(62, &rev);
+	printf("NAU88C22 Codec Initialized - ID = 0x%03X, Rev = 0x%03X\n", id, rev);
+	//NAU88C22_Dump_Regs();
+#elif defined(CODEC_SGTL5000)
+	uint16_t id;
+	SGTL5000_ReadRegister(0x0000, &id);
+	printf("SGTL5000 Codec Initialized - ID = 0x%04X\n", id);
+	//SGTL5000_Dump_Regs();
+#else
+	printf(CODEC_NAME " Codec Initialized\n");
+#endif
+
+	return 0;
+}
+
+/*
+ * reprogram the codec rate registers - returns 0 if ok
+ */
+int32_t Codec_SetRate(uint32_t fs, uint16_t mclk_ratio)
+{
+	return CODEC_SETRATE(fs, mclk_ratio);
+}
+
+/*
+ * reprogram the codec framing & word length - returns 0 if ok. DSP modes
+ * pack the channels back to back so the codec word has to fill the slot.
+ * On a TDM bus the codec runs DSP B and ignores the slots after its own.
+ */
+int32_t Codec_SetFormat(uint8_t fmt, uint8_t bits)
+{
+	if(fmt == FMT_TDM)
+		fmt = FMT_DSP_B;
+	if((fmt == FMT_DSP_A) || (fmt == FMT_DSP_B))
+		bits = I2S_SLOT_BITS(bits);
+	
+	return CODEC_SETFORMAT(fmt, bits);
+}
+
+/*
+ * pick who drives BCLK & LRCK - takes effect at the next Codec_SetFormat.
+ * Returns 0 if ok, or 1 if the codec can't be master.
+ */
+int32_t Codec_SetMaster(uint8_t enable)
+{
+	return CODEC_SETMASTER(enable);
+}
+
+/*
+ * 1 if reg is a register address the codec has
+ */
+static int32_t Codec_RegOk(uint16_t reg)
+{
+	return ((reg >> CODEC_MODEL.reg_shift) < CODEC_MODEL.num_regs) &&
+		!(reg % CODEC_IF.reg_stride);
+}
+
+/*
+ * write one codec register by address - returns 0 if ok, -1 if there's
+ * no such register, or 1 if the bus failed
+ */
+int32_t Codec_WriteReg(uint16_t reg, uint16_t val)
+{
+	if(!Codec_RegOk(reg))
+		return -1;
+
+	return CODEC_IF.write(reg, val) ? 1 : 0;
+}
+
+/*
+ * read one codec register by address - as above, and -1 as well if the
+ * control bus is write-only
+ */
+int32_t Codec_ReadReg(uint16_t reg, uint16_t *val)
+{
+	if(!CODEC_IF.read || !Codec_RegOk(reg))
+		return -1;
+
+	return CODEC_IF.read(reg, val) ? 1 : 0;
+}
+
+/*
+ * run the codec init, rate & format sequences against the model to
+ * check ordering and measure control bus traffic without touching the bus
+ */
+void Codec_ModelCheck(void)
+{
+	static codec_model model;
+
+	codec_model_init(&model, &CODEC_MODEL);
+	codec_seq_set_model(&model);
+	CODEC_RESET();
+	if(CODEC_SETRATE(I2S_FS_DEFAULT, I2S_MCLK_RATIO))
+		printf(CODEC_NAME " can't run at %d Hz, %dx MCLK\n", I2S_FS_DEFAULT,
+			I2S_MCLK_RATIO);
+	if(Codec_SetFormat(I2S_FMT_DEFAULT, I2S_BITS_DEFAULT))
+		printf(CODEC_NAME " can't take format %d, %d-bit\n", I2S_FMT_DEFAULT,
+			I2S_BITS_DEFAULT);
+	codec_seq_set_model(NULL);
+	codec_model_report(&model);
+}
+
+/*
+ * re-time the control bus after clk_sys changes - before Codec_Init
+ * there's no bus set up to re-time
+ */
+void Codec_Reclock(void)
+{
+	if(codec_bus_up && CODEC_IF.reclock)
+		CODEC_IF.reclock();
+}
+
+/*
+ * the built in codec's model
+ */
+const codec_model_desc *Codec_Model(void)
+{
+	return &CODEC_MODEL;
+}
@@ -0,0 +1,33 @@
+/*
+ * codec.h - dispatch to the codec selected in main.h
+ */
+
+#ifndef __codec__
+#define __codec__
+
+#include "main.h"
+#include "codec_model.h"
+
+/* serial framing formats */
+enum codec_fmts
+{
+	FMT_I2S,	// Philips I2S - MSB one bit after LRCK, left on LRCK low
+	FMT_LJ,		// left justified - MSB with LRCK, left on LRCK high
+	FMT_RJ,		// right justified - LSB at the end of the slot
+	FMT_DSP_A,	// DSP/PCM A - one bit sync, left MSB one bit after it
+	FMT_DSP_B,	// DSP/PCM B - one bit sync with the left MSB
+	FMT_TDM,	// 4-16 slots, DSP B sync - the codec takes slots 0 & 1
+	FMT_NUM
+};
+
+int32_t Codec_Init(void);
+int32_t Codec_SetRate(uint32_t fs, uint16_t mclk_ratio);
+int32_t Codec_SetFormat(uint8_t fmt, uint8_t bits);
+int32_t Codec_SetMaster(uint8_t enable);
+int32_t Codec_WriteReg(uint16_t reg, uint16_t val);
+int32_t Codec_ReadReg(uint16_t reg, uint16_t *val);
+void Codec_ModelCheck(void);
+const codec_model_desc *Codec_Model(void);
+void Codec_Reclock(void);
+
+#endif
@@ -0,0 +1,662 @@
+/*
+ * codec_model.c - behavioral register models of the supported codecs
+ *
+ * Bus timing matches the drivers: I2C at 100kHz and the bitbang L3 port
+ * in uda1345.c. PLL lock and reference settle times are conservative
+ * values assumed by the model, not datasheet guarantees.
+ */
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include "codec_model.h"
+
+/* I2C bus bit time at 100kHz */
+#define I2C_BIT_US 10
+
+/* L3 bitbang - 3us per bit + 2us gap per byte */
+#define L3_BYTE_US 26
+
+/* 1dB down in Q16 */
+#define MODEL_DB_DOWN 58409
+
+/* assumed settle times */
+#define PLL_LOCK_US 10000
+#define VMID_SETTLE_US 250000
+
+/*
+ * flag a sequence violation
+ */
+static void model_violation(codec_model *m, const char *fmt, ...)
+{
+	va_list ap;
+
+	printf("%s model @ %u us: ", m->desc->name, (unsigned)m->t_us);
+	va_start(ap, fmt);
+	vprintf(fmt, ap);
+	va_end(ap);
+	printf("\n\r");
+	m->violations++;
+}
+
+/*
+ * account for one bus transaction carrying n bytes after the device address
+ */
+static void model_bus_time(codec_model *m, uint32_t n, uint8_t read)
+{
+	uint32_t us;
+
+	if(m->desc->bus == MODEL_BUS_L3)
+	{
+		/* L3 address byte + data bytes */
+		us = (1 + n) * L3_BYTE_US;
+	}
+	else
+	{
+		/* start + dev addr + bytes + stop, 9 bits per byte */
+		us = (2 + 9 * (1 + n)) * I2C_BIT_US;
+
+		/* reads add a repeated start and a second dev addr */
+		if(read)
+			us += (1 + 9) * I2C_BIT_US;
+	}
+
+	m->bus_us += us;
+	m->bytes += n;
+	m->t_us += us;
+}
+
+/*
+ * register address to shadow index, -1 if out of range
+ */
+static int32_t model_index(codec_model *m, uint16_t reg)
+{
+	uint32_t idx = reg >> m->desc->reg_shift;
+
+	if(idx >= m->desc->num_regs)
+		return -1;
+
+	return idx;
+}
+
+/*
+ * check if reg has been written since reset
+ */
+static uint8_t model_was_written(codec_model *m, uint16_t reg)
+{
+	int32_t idx = model_index(m, reg);
+
+	if(idx < 0)
+		return 0;
+
+	return (m->written[idx>>5] >> (idx&31)) & 1;
+}
+
+/*
+ * current shadow value of reg
+ */
+static uint16_t model_reg(codec_model *m, uint16_t reg)
+{
+	int32_t idx = model_index(m, reg);
+
+	return idx < 0 ? 0 : m->regs[idx];
+}
+
+/*
+ * store a value in the shadow file
+ */
+static void model_store(codec_model *m, uint16_t reg, uint16_t val)
+{
+	int32_t idx = model_index(m, reg);
+
+	if(idx < 0)
+		return;
+
+	m->regs[idx] = val;
+	m->written[idx>>5] |= 1 << (idx&31);
+}
+
+/*
+ * clear shadow state back to power-on
+ */
+static void model_clear(codec_model *m)
+{
+	memset(m->regs, 0, sizeof(m->regs));
+	memset(m->written, 0, sizeof(m->written));
+	m->pll_on_us = 0;
+	m->ref_on_us = 0;
+	m->dac_gain = 1 << 16;
+}
+
+/*
+ * true if PLL is enabled and has had time to lock
+ */
+static uint8_t model_pll_locked(codec_model *m)
+{
+	return m->pll_on_us && (m->t_us - m->pll_on_us >= PLL_LOCK_US);
+}
+
+/* ---------------------------------------------------------------------- */
+/* WM8731                                                                 */
+/* ---------------------------------------------------------------------- */
+
+static void wm8731_reset(codec_model *m)
+{
+	static const uint16_t defaults[] =
+	{
+		0x097, 0x097, 0x079, 0x079, 0x00A, 0x008, 0x09F, 0x00A, 0x000, 0x000
+	};
+
+	model_clear(m);
+	memcpy(m->regs, defaults, sizeof(defaults));
+}
+
+static void wm8731_write(codec_model *m, uint16_t reg, uint16_t val)
+{
+	/* reg 15 is soft reset */
+	if(reg == 0x0f)
+	{
+		wm8731_reset(m);
+		return;
+	}
+
+	if(reg > 9)
+	{
+		model_violation(m, "write to unknown Reg 0x%02X", reg);
+		return;
+	}
+
+	/* format & rate must not change while the interface is active */
+	if(((reg == 7) || (reg == 8)) && (model_reg(m, 9) & 1))
+		model_violation(m, "Reg 0x%02X changed while active", reg);
+
+	model_store(m, reg, val);
+}
+
+const codec_model_desc codec_model_wm8731 =
+{
+	.name = "WM8731",
+	.bus = MODEL_BUS_I2C,
+	.reg_shift = 0,
+	.num_regs = 16,
+	.addr_bytes = 1,
+	.data_bytes = 1,
+	.readable = 0,
+	.wire = MODEL_WIRE_7_9,
+	.dev_addr = 0x1A,
+	.hw_reset = 0,
+	.reset = wm8731_reset,
+	.write = wm8731_write,
+};
+
+/* ---------------------------------------------------------------------- */
+/* TLV320AIC3101                                                          */
+/* ---------------------------------------------------------------------- */
+
+static void aic3101_reset(codec_model *m)
+{
+	model_clear(m);
+	m->regs[3] = 0x10;		// PLL A - disabled, Q=2, P=8
+	m->regs[4] = 0x04;		// PLL B - J=1
+}
+
+static void aic3101_write(codec_model *m, uint16_t reg, uint16_t val)
+{
+	/* page 1 holds filter coefs - only track page select */
+	if((reg != 0) && (model_reg(m, 0) & 1))
+		return;
+
+	if(reg > 109)
+	{
+		model_violation(m, "write to reserved Reg %d", reg);
+		return;
+	}
+
+	/* PLL enable */
+	if(reg == 3)
+	{
+		if((val & 0x80) && !(model_reg(m, 3) & 0x80))
+			m->pll_on_us = m->t_us;
+		else if(!(val & 0x80))
+			m->pll_on_us = 0;
+	}
+
+	/* PLL reprogrammed while running */
+	if(((reg == 4) || (reg == 5) || (reg == 6) || (reg == 11)) &&
+		(model_reg(m, 3) & 0x80))
+		model_violation(m, "PLL Reg %d changed while PLL enabled", reg);
+
+	/* converter power-up while CODEC_CLKIN comes from an unlocked PLL */
+	if(((reg == 19) && (val & 0x04)) || ((reg == 22) && (val & 0x04)) ||
+		((reg == 37) && (val & 0xC0)))
+	{
+		if(!(model_reg(m, 101) & 1) && m->pll_on_us && !model_pll_locked(m))
+			model_violation(m, "Reg %d powers converter before PLL lock", reg);
+	}
+
+	model_store(m, reg, val);
+}
+
+const codec_model_desc codec_model_aic3101 =
+{
+	.name = "AIC3101",
+	.bus = MODEL_BUS_I2C,
+	.reg_shift = 0,
+	.num_regs = 128,
+	.addr_bytes = 1,
+	.data_bytes = 1,
+	.readable = 1,
+	.wire = MODEL_WIRE_8_8,
+	.dev_addr = 0x18,
+	.hw_reset = 1,
+	.reset = aic3101_reset,
+	.write = aic3101_write,
+};
+
+/* ---------------------------------------------------------------------- */
+/* NAU88C22                                                               */
+/* ---------------------------------------------------------------------- */
+
+static void nau88c22_reset(codec_model *m)
+{
+	model_clear(m);
+	m->regs[4] = 0x050;		// 24-bit I2S
+	m->regs[6] = 0x140;		// PLL clock, /2, slave
+	m->regs[63] = 0x01A;	// Device ID
+}
+
+static void nau88c22_write(codec_model *m, uint16_t reg, uint16_t val)
+{
+	/* reg 0 is soft reset */
+	if(reg == 0)
+	{
+		nau88c22_reset(m);
+		return;
+	}
+
+	if((reg >= 62) && (reg <= 63))
+	{
+		model_violation(m, "write to read-only Reg %d", reg);
+		return;
+	}
+
+	if(reg > 81)
+	{
+		model_violation(m, "write to unknown Reg %d", reg);
+		return;
+	}
+
+	/* bias/VMID & PLL enables */
+	if(reg == 1)
+	{
+		if((val & 0x003) && !m->ref_on_us)
+			m->ref_on_us = m->t_us ? m->t_us : 1;
+		else if(!(val & 0x003))
+			m->ref_on_us = 0;
+
+		if((val & 0x020) && !(model_reg(m, 1) & 0x020))
+			m->pll_on_us = m->t_us;
+		else if(!(val & 0x020))
+			m->pll_on_us = 0;
+	}
+
+	/* PLL reprogrammed while running */
+	if((reg >= 36) && (reg <= 39) && (model_reg(m, 1) & 0x020))
+		model_violation(m, "PLL Reg %d changed while PLL enabled", reg);
+
+	/* outputs enabled before VMID has settled */
+	if((reg == 3) && (val & 0x18F))
+	{
+		if(!m->ref_on_us || (m->t_us - m->ref_on_us < VMID_SETTLE_US))
+			model_violation(m, "outputs enabled before VMID settled");
+	}
+
+	/* converters running from a PLL that isn't locked */
+	if(((reg == 6) && (val & 0x100)) ||
+		(((reg == 2) || (reg == 3)) && (model_reg(m, 6) & 0x100)))
+	{
+		if(((reg == 6) || (val & 0x003)) && m->pll_on_us && !model_pll_locked(m))
+			model_violation(m, "Reg %d clocks converters from unlocked PLL", reg);
+	}
+
+	model_store(m, reg, val);
+}
+
+const codec_model_desc codec_model_nau88c22 =
+{
+	.name = "NAU88C22",
+	.bus = MODEL_BUS_I2C,
+	.reg_shift = 0,
+	.num_regs = 128,
+	.addr_bytes = 1,
+	.data_bytes = 1,
+	.readable = 1,
+	.wire = MODEL_WIRE_7_9,
+	.dev_addr = 0x1A,
+	.hw_reset = 0,
+	.reset = nau88c22_reset,
+	.write = nau88c22_write,
+};
+
+/* ---------------------------------------------------------------------- */
+/* SGTL5000                                                               */
+/* ---------------------------------------------------------------------- */
+
+#define SGTL_CHIP_ID 0x0000
+#define SGTL_CHIP_DIG_POWER 0x0002
+#define SGTL_CHIP_CLK_CTRL 0x0004
+#define SGTL_CHIP_I2S_CTRL 0x0006
+#define SGTL_CHIP_LINREG_CTRL 0x0026
+#define SGTL_CHIP_REF_CTRL 0x0028
+#define SGTL_CHIP_LINE_OUT_CTRL 0x002C
+#define SGTL_CHIP_ANA_POWER 0x0030
+#define SGTL_CHIP_PLL_CTRL 0x0032
+#define SGTL_CHIP_ANA_STATUS 0x0036
+
+static void sgtl5000_reset(codec_model *m)
+{
+	model_clear(m);
+	m->regs[SGTL_CHIP_ID>>1] = 0xA011;
+	m->regs[SGTL_CHIP_CLK_CTRL>>1] = 0x0008;
+	m->regs[SGTL_CHIP_I2S_CTRL>>1] = 0x0010;
+	m->regs[SGTL_CHIP_ANA_POWER>>1] = 0x7060;
+}
+
+static void sgtl5000_write(codec_model *m, uint16_t reg, uint16_t val)
+{
+	uint16_t ana;
+
+	if(reg & 1)
+	{
+		model_violation(m, "write to odd address 0x%04X", reg);
+		return;
+	}
+
+	if((reg == SGTL_CHIP_ID) || (reg == SGTL_CHIP_ANA_STATUS))
+	{
+		model_violation(m, "write to read-only Reg 0x%04X", reg);
+		return;
+	}
+
+	if(reg == SGTL_CHIP_ANA_POWER)
+	{
+		/* charge pump before its supply rail is chosen */
+		if((val & 0x0800) && !model_was_written(m, SGTL_CHIP_LINREG_CTRL))
+			model_violation(m, "charge pump on before CHIP_LINREG_CTRL set");
+
+		/* outputs before references are configured */
+		if((val & 0x0011) && !model_was_written(m, SGTL_CHIP_REF_CTRL))
+			model_violation(m, "outputs on before CHIP_REF_CTRL set");
+		if((val & 0x0001) && !model_was_written(m, SGTL_CHIP_LINE_OUT_CTRL))
+			model_violation(m, "LINEOUT on before CHIP_LINE_OUT_CTRL set");
+
+		/* PLL & VCO amp both needed */
+		if(((val & 0x0500) == 0x0500) &&
+			((model_reg(m, SGTL_CHIP_ANA_POWER) & 0x0500) != 0x0500))
+			m->pll_on_us = m->t_us;
+		else if((val & 0x0500) != 0x0500)
+			m->pll_on_us = 0;
+	}
+
+	/* PLL reprogrammed while running */
+	ana = model_reg(m, SGTL_CHIP_ANA_POWER);
+	if((reg == SGTL_CHIP_PLL_CTRL) && ((ana & 0x0500) == 0x0500))
+		model_violation(m, "CHIP_PLL_CTRL changed while PLL powered");
+
+	/* system clock from a PLL that isn't locked */
+	if((reg == SGTL_CHIP_CLK_CTRL) && ((val & 3) == 3) && !model_pll_locked(m))
+		model_violation(m, "CHIP_CLK_CTRL selects PLL before lock");
+
+	model_store(m, reg, val);
+}
+
+const codec_model_desc codec_model_sgtl5000 =
+{
+	.name = "SGTL5000",
+	.bus = MODEL_BUS_I2C,
+	.reg_shift = 1,
+	.num_regs = 0x13C>>1,
+	.addr_bytes = 2,
+	.data_bytes = 2,
+	.readable = 1,
+	.wire = MODEL_WIRE_16_16,
+	.dev_addr = 0x0A,
+	.hw_reset = 0,
+	.reset = sgtl5000_reset,
+	.write = sgtl5000_write,
+};
+
+/* ---------------------------------------------------------------------- */
+/* UDA1345                                                                */
+/* ---------------------------------------------------------------------- */
+
+static void uda1345_reset(codec_model *m)
+{
+	model_clear(m);
+}
+
+static void uda1345_write(codec_model *m, uint16_t reg, uint16_t val)
+{
+	/* data transfer regs 0, 2, 3 & status reg 0x10 */
+	if((reg != 0x00) && (reg != 0x02) && (reg != 0x03) && (reg != 0x10))
+	{
+		model_violation(m, "write to unknown L3 Reg 0x%02X", reg);
+		return;
+	}
+
+	model_store(m, reg, val);
+
+	/* volume in 1dB steps down from full scale, & mute */
+	if((reg == 0x00) || (reg == 0x02))
+	{
+		m->dac_gain = (model_reg(m, 0x02) & 0x04) ? 0 : 1 << 16;
+		for(val=model_reg(m, 0x00);val;val--)
+			m->dac_gain = (m->dac_gain * MODEL_DB_DOWN) >> 16;
+	}
+}
+
+const codec_model_desc codec_model_uda1345 =
+{
+	.name = "UDA1345",
+	.bus = MODEL_BUS_L3,
+	.reg_shift = 0,
+	.num_regs = 0x20,
+	.addr_bytes = 0,
+	.data_bytes = 1,
+	.readable = 0,
+	.wire = MODEL_WIRE_L3,
+	.dev_addr = 0x05,
+	.hw_reset = 0,
+	.reset = uda1345_reset,
+	.write = uda1345_write,
+};
+
+/* ---------------------------------------------------------------------- */
+/* common                                                                 */
+/* ---------------------------------------------------------------------- */
+
+/*
+ * set up a model at power-on
+ */
+void codec_model_init(codec_model *m, const codec_model_desc *desc)
+{
+	memset(m, 0, sizeof(codec_model));
+	m->desc = desc;
+	desc->reset(m);
+}
+
+/*
+ * single register write transaction
+ */
+int32_t codec_model_write(codec_model *m, uint16_t reg, uint16_t val)
+{
+	model_bus_time(m, m->desc->addr_bytes + m->desc->data_bytes, 0);
+	m->writes++;
+	m->desc->write(m, reg, val);
+	return 0;
+}
+
+/*
+ * single register read transaction
+ */
+int32_t codec_model_read(codec_model *m, uint16_t reg, uint16_t *val)
+{
+	if(!m->desc->readable)
+	{
+		model_violation(m, "read of Reg 0x%04X on write-only bus", reg);
+		return 1;
+	}
+
+	model_bus_time(m, m->desc->addr_bytes + m->desc->data_bytes, 1);
+	m->reads++;
+	*val = model_reg(m, reg);
+	return 0;
+}
+
+/*
+ * auto-increment write of n registers in one transaction
+ */
+int32_t codec_model_burst(codec_model *m, uint16_t reg, const uint16_t *val,
+	uint8_t n, uint8_t stride)
+{
+	uint8_t i;
+
+	model_bus_time(m, m->desc->addr_bytes + n * m->desc->data_bytes, 0);
+	for(i=0;i<n;i++)
+	{
+		m->writes++;
+		m->desc->write(m, reg, val[i]);
+		reg += stride;
+	}
+	return 0;
+}
+
+/*
+ * advance simulated time
+ */
+void codec_model_delay(codec_model *m, uint32_t ms)
+{
+	m->t_us += 1000 * (uint64_t)ms;
+}
+
+/*
+ * back to power-on register state, as from a reset pin - keeps the counts
+ */
+void codec_model_reset(codec_model *m)
+{
+	m->ptr = 0;
+	m->desc->reset(m);
+}
+
+/*
+ * one write transaction as the bytes after the device address - a bare
+ * register address sets the pointer for a read to follow. Returns 0 if
+ * ok, or 1 if it isn't a transaction the codec takes.
+ */
+int32_t codec_model_bus_write(codec_model *m, const uint8_t *buf, uint32_t n)
+{
+	uint16_t val[256];
+	uint32_t i;
+
+	switch(m->desc->wire)
+	{
+		case MODEL_WIRE_7_9:
+			if(n == 1)
+			{
+				m->ptr = buf[0] >> 1;
+				return 0;
+			}
+			if(n == 2)
+				return codec_model_write(m, buf[0] >> 1,
+					((buf[0] & 1) << 8) | buf[1]);
+			break;
+
+		case MODEL_WIRE_8_8:
+			if((n < 1) || (n > 256))
+				break;
+			m->ptr = buf[0];
+			if(n == 1)
+				return 0;
+			for(i=1;i<n;i++)
+				val[i-1] = buf[i];
+			if(n == 2)
+				codec_model_write(m, buf[0], val[0]);
+			else
+				codec_model_burst(m, buf[0], val, n - 1, 1);
+			m->ptr = buf[0] + n - 1;
+			return 0;
+
+		case MODEL_WIRE_16_16:
+			if((n < 2) || (n & 1) || (n > 2 + 2 * 255))
+				break;
+			m->ptr = (buf[0] << 8) | buf[1];
+			if(n == 2)
+				return 0;
+			for(i=2;i<n;i+=2)
+				val[i/2-1] = (buf[i] << 8) | buf[i+1];
+			if(n == 4)
+				return codec_model_write(m, m->ptr, val[0]);
+			return codec_model_burst(m, m->ptr, val, n/2 - 1, 2);
+
+		case MODEL_WIRE_L3:
+			/* another device's address, or a read mode */
+			if((n != 2) || ((buf[0] >> 2) != m->desc->dev_addr))
+				return 0;
+			if(buf[0] & 1)
+				break;
+			return codec_model_write(m,
+				((buf[0] & 2) ? 0x10 : 0x00) | (buf[1] >> 6), buf[1] & 0x3F);
+	}
+
+	model_violation(m, "%u byte write the bus doesn't take", (unsigned)n);
+	return 1;
+}
+
+/*
+ * one read transaction from the register pointer - returns 0 if ok, or 1
+ * if the bus is write-only or it isn't a read the codec takes
+ */
+int32_t codec_model_bus_read(codec_model *m, uint8_t *buf, uint32_t n)
+{
+	uint16_t val;
+	uint32_t i;
+
+	switch(m->desc->wire)
+	{
+		case MODEL_WIRE_7_9:
+		case MODEL_WIRE_16_16:
+			if(n != 2)
+				break;
+			if(codec_model_read(m, m->ptr, &val))
+				return 1;
+			buf[0] = val >> 8;
+			buf[1] = val & 0xFF;
+			return 0;
+
+		case MODEL_WIRE_8_8:
+			for(i=0;i<n;i++)
+			{
+				if(codec_model_read(m, m->ptr++, &val))
+					return 1;
+				buf[i] = val;
+			}
+			return 0;
+
+		case MODEL_WIRE_L3:
+			return codec_model_read(m, m->ptr, &val);
+	}
+
+	model_violation(m, "%u byte read the bus doesn't take", (unsigned)n);
+	return 1;
+}
+
+/*
+ * summarize traffic, timing & violations
+ */
+void codec_model_report(codec_model *m)
+{
+	printf("%s model: %u writes, %u reads, %u bytes, bus %u us, total %u us, %u violations\n\r",
+		m->desc->name, (unsigned)m->writes, (unsigned)m->reads,
+		(unsigned)m->bytes, (unsigned)m->bus_us, (unsigned)m->t_us,
+		(unsigned)m->violations);
+}
@@ -0,0 +1,90 @@
+/*
+ * codec_model.h - behavioral register models of the supported codecs
+ *
+ * Each model keeps a shadow register file, accounts for control bus
+ * time and flags illegal sequences (power-up ordering, use of a PLL
+ * before lock, writes to read-only or unknown registers). Models have no
+ * SDK dependencies so they build on the host as well as on target.
+ *
+ * The register calls above are what the sequence player makes. The bus
+ * calls take a transaction's bytes after the device address, as they go
+ * on the wire, so the host build's simulated I2C & L3 ports can put the
+ * drivers' own traffic through a model.
+ */
+
+#ifndef __codec_model__
+#define __codec_model__
+
+#include <stdint.h>
+
+/* max register file size over all models */
+#define MODEL_MAX_REGS 160
+
+/* control bus types */
+enum codec_model_bus
+{
+	MODEL_BUS_I2C,
+	MODEL_BUS_L3,
+};
+
+/* how register addresses & data go on the wire */
+enum codec_model_wire
+{
+	MODEL_WIRE_7_9,		// 7-bit address & 9-bit data packed in 2 bytes
+	MODEL_WIRE_8_8,		// address byte then data bytes, auto-increment
+	MODEL_WIRE_16_16,	// 16-bit address then 16-bit data, MSB first
+	MODEL_WIRE_L3,		// L3 address byte then one data byte
+};
+
+typedef struct codec_model codec_model;
+
+/* static description of one codec */
+typedef struct
+{
+	const char *name;
+	uint8_t bus;			// MODEL_BUS_xx
+	uint8_t reg_shift;		// register address >> reg_shift = index
+	uint16_t num_regs;		// size of register file
+	uint8_t addr_bytes;		// register address bytes on the bus
+	uint8_t data_bytes;		// register data bytes on the bus
+	uint8_t readable;		// 0 if the bus is write-only
+	uint8_t wire;			// MODEL_WIRE_xx
+	uint8_t dev_addr;		// 7-bit I2C or 6-bit L3 device address
+	uint8_t hw_reset;		// 1 if the PMOD's pin 20 is an active low reset
+	void (*reset)(codec_model *m);
+	void (*write)(codec_model *m, uint16_t reg, uint16_t val);
+} codec_model_desc;
+
+/* model instance state */
+struct codec_model
+{
+	const codec_model_desc *desc;
+	uint16_t regs[MODEL_MAX_REGS];
+	uint64_t t_us;			// simulated time since reset
+	uint64_t pll_on_us;		// when PLL was enabled, 0 if off
+	uint64_t ref_on_us;		// when references were enabled, 0 if off
+	uint32_t written[(MODEL_MAX_REGS+31)/32];	// regs written since reset
+	uint16_t ptr;			// register pointer for bus reads
+	uint32_t dac_gain;		// Q16 DAC volume & mute, unity if not modelled
+	uint32_t writes, reads, bytes, bus_us;
+	uint32_t violations;
+};
+
+extern const codec_model_desc codec_model_wm8731;
+extern const codec_model_desc codec_model_aic3101;
+extern const codec_model_desc codec_model_nau88c22;
+extern const codec_model_desc codec_model_sgtl5000;
+extern const codec_model_desc codec_model_uda1345;
+
+void codec_model_init(codec_model *m, const codec_model_desc *desc);
+int32_t codec_model_write(codec_model *m, uint16_t reg, uint16_t val);
+int32_t codec_model_read(codec_model *m, uint16_t reg, uint16_t *val);
+int32_t codec_model_burst(codec_model *m, uint16_t reg, const uint16_t *val,
+	uint8_t n, uint8_t stride);
+void codec_model_delay(codec_model *m, uint32_t ms);
+void codec_model_reset(codec_model *m);
+int32_t codec_model_bus_write(codec_model *m, const uint8_t *buf, uint32_t n);
+int32_t codec_model_bus_read(codec_model *m, uint8_t *buf, uint32_t n);
+void codec_model_report(codec_model *m);
+
+#endif
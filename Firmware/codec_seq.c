@@ -0,0 +1,202 @@
+/*
+ * codec_seq.c - common codec init sequence player
+ */
+
+#include <stdio.h>
+#include "hardware/i2c.h"
+#include "codec_seq.h"
+#include "trace.h"
+
+/* how many times to try a failing bus transaction */
+#define SEQ_TRIES 5
+
+/* when set, bus traffic goes to this model instead of the codec */
+static codec_model *seq_model;
+
+/*
+ * route sequences to a codec model, or NULL for real hardware
+ */
+void codec_seq_set_model(codec_model *m)
+{
+	seq_model = m;
+}
+
+/*
+ * the I2C divider is set from clk_sys - set it again after a change. All
+ * the I2C codecs sit on i2c0 at 100kHz.
+ */
+void codec_seq_i2c_reclock(void)
+{
+	i2c_set_baudrate(i2c0, 100*1000);
+}
+
+/*
+ * current time - simulated when running against a model
+ */
+static uint64_t codec_seq_time_us(void)
+{
+	return seq_model ? seq_model->t_us : time_us_64();
+}
+
+/*
+ * write with retries
+ * NOTE: Some codecs occasionally NAK the first write after reset.
+ */
+static int32_t codec_seq_write(const codec_seq_if *cif, uint16_t reg,
+	uint16_t val)
+{
+	uint8_t tries = 0;
+	int32_t r;
+
+	if(seq_model)
+		return codec_model_write(seq_model, reg, val);
+
+	do
+		r = cif->write(reg, val);
+	while(r && (++tries < SEQ_TRIES));
+
+	return r != 0;
+}
+
+/*
+ * read with retries
+ */
+static int32_t codec_seq_read(const codec_seq_if *cif, uint16_t reg,
+	uint16_t *val)
+{
+	uint8_t tries = 0;
+	int32_t r;
+
+	if(seq_model)
+		return codec_model_read(seq_model, reg, val);
+
+	if(!cif->read)
+	{
+		printf("%s: read of Reg 0x%04X on write-only codec\n\r", cif->name, reg);
+		return 1;
+	}
+
+	do
+		r = cif->read(reg, val);
+	while(r && (++tries < SEQ_TRIES));
+
+	return r != 0;
+}
+
+/*
+ * send a burst to consecutive registers
+ */
+static int32_t codec_seq_burst(const codec_seq_if *cif, uint16_t reg,
+	const codec_seq_t *data, uint8_t n)
+{
+	uint16_t buf[SEQ_BURST_MAX];
+	uint8_t i, tries = 0;
+	int32_t result = 0, r;
+
+	/* no burst support - fall back to single writes */
+	if(!cif->burst)
+	{
+		for(i=0;i<n;i++)
+		{
+			result += codec_seq_write(cif, reg, data[i].val);
+			reg += cif->reg_stride;
+		}
+		return result;
+	}
+
+	/* gather payload */
+	for(i=0;i<n;i++)
+		buf[i] = data[i].val;
+
+	if(seq_model)
+		return codec_model_burst(seq_model, reg, buf, n, cif->reg_stride);
+
+	do
+		r = cif->burst(reg, buf, n);
+	while(r && (++tries < SEQ_TRIES));
+
+	return r != 0;
+}
+
+/**
+  * @brief  Execute a codec init sequence
+  * @param  cif: access methods for the target codec
+  * @param  seq: sequence table terminated by SEQ_END
+  * @retval number of failed operations
+  */
+int32_t codec_seq_play(const codec_seq_if *cif, const codec_seq_t *seq)
+{
+	int32_t result = 0;
+	uint16_t data;
+	uint64_t timeout;
+
+	while(seq->op != SEQ_OP_END)
+	{
+		switch(seq->op)
+		{
+			case SEQ_OP_WR:
+				result += codec_seq_write(cif, seq->reg, seq->val);
+				seq++;
+				break;
+
+			case SEQ_OP_DLY:
+				TRACE(TRC_DELAY, cif->trace_src, seq->val, 0);
+				if(seq_model)
+					codec_model_delay(seq_model, seq->val);
+				else
+					my_sleep_ms(seq->val);
+				seq++;
+				break;
+
+			case SEQ_OP_POLL:
+				/* mask in this entry, expected value in next */
+				timeout = codec_seq_time_us() + 1000 * (uint64_t)seq->arg;
+				while(1)
+				{
+					if(codec_seq_read(cif, seq->reg, &data))
+					{
+						result++;
+						break;
+					}
+
+					if((data & seq->val) == seq[1].val)
+						break;
+
+					if(codec_seq_time_us() >= timeout)
+					{
+						printf("%s: poll Reg 0x%04X timed out = 0x%04X\n\r",
+							cif->name, seq->reg, data);
+						result++;
+						break;
+					}
+				}
+				seq += 2;
+				break;
+
+			case SEQ_OP_VFY:
+				/* mask in this entry, expected value in next */
+				if(codec_seq_read(cif, seq->reg, &data))
+					result++;
+				else if((data & seq->val) != seq[1].val)
+				{
+					printf("%s: verify Reg 0x%04X = 0x%04X, expected 0x%04X\n\r",
+						cif->name, seq->reg, data & seq->val, seq[1].val);
+					result++;
+				}
+				seq += 2;
+				break;
+
+			case SEQ_OP_BURST:
+				result += codec_seq_burst(cif, seq->reg, &seq[1], seq->arg);
+				seq += 1 + seq->arg;
+				break;
+
+			default:
+				/* stray DATA or unknown op means a malformed table */
+				printf("%s: bad sequence op %d\n\r", cif->name, seq->op);
+				return result + 1;
+		}
+	}
+
+	return result;
+}
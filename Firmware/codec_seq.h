@@ -0,0 +1,99 @@
+/*
+ * codec_seq.h - common codec init sequence format & player
+ *
+ * Every codec driver describes its startup as a table of codec_seq_t
+ * entries built with the SEQ_xx() macros below. The macros range-check
+ * register addresses and data against the codec's widths at compile time
+ * so a typo in a table is a build error rather than a bad I2C write.
+ * Tables should be declared const with the CODEC_SEQ attribute so that
+ * they stay in flash even when building with PICO_COPY_TO_RAM.
+ */
+
+#ifndef __codec_seq__
+#define __codec_seq__
+
+#include "main.h"
+#include "codec_model.h"
+
+/* sequence opcodes */
+enum codec_seq_ops
+{
+	SEQ_OP_END,		// end of sequence
+	SEQ_OP_WR,		// write val to reg
+	SEQ_OP_DLY,		// wait val ms
+	SEQ_OP_POLL,	// read reg until (data & mask) == val, arg = timeout ms
+	SEQ_OP_VFY,		// read reg once and check (data & mask) == val
+	SEQ_OP_BURST,	// write next arg DATA entries to consecutive regs
+	SEQ_OP_DATA,	// payload for BURST, POLL & VFY
+};
+
+/* one sequence entry - 6 bytes */
+typedef struct
+{
+	uint8_t op;
+	uint8_t arg;
+	uint16_t reg;
+	uint16_t val;
+} codec_seq_t;
+
+/* keep sequence tables in flash */
+#define CODEC_SEQ __in_flash("codec_seq")
+
+/* max entries in one burst */
+#define SEQ_BURST_MAX 32
+
+/* evaluates to 0, or fails the build if e is true */
+#define SEQ_BUILD_BUG_ON_ZERO(e) \
+	(0*sizeof(struct { int seq_range_error:(1-2*!!(e)); }))
+
+/* pass x through if it fits in bits, else fail the build */
+#define SEQ_CHK(x, bits) \
+	((x) + SEQ_BUILD_BUG_ON_ZERO((unsigned long)(x) >= (1UL<<(bits))))
+
+/* pass x through if it is a multiple of n, else fail the build */
+#define SEQ_ALIGNED(x, n) \
+	((x) + SEQ_BUILD_BUG_ON_ZERO((x) % (n)))
+
+/*
+ * table entry builders - rb/vb are the register address & data widths
+ * of the target codec. Drivers normally wrap these in local macros.
+ */
+#define SEQ_WR(rb, vb, r, v) \
+	{SEQ_OP_WR, 0, SEQ_CHK(r, rb), SEQ_CHK(v, vb)}
+#define SEQ_DLY(ms) \
+	{SEQ_OP_DLY, 0, 0, SEQ_CHK(ms, 16)}
+#define SEQ_POLL(rb, vb, r, m, v, ms) \
+	{SEQ_OP_POLL, SEQ_CHK(ms, 8), SEQ_CHK(r, rb), SEQ_CHK(m, vb)}, \
+	{SEQ_OP_DATA, 0, 0, SEQ_CHK(v, vb)}
+#define SEQ_VFY(rb, vb, r, m, v) \
+	{SEQ_OP_VFY, 0, SEQ_CHK(r, rb), SEQ_CHK(m, vb)}, \
+	{SEQ_OP_DATA, 0, 0, SEQ_CHK(v, vb)}
+#define SEQ_BURST(rb, r, n) \
+	{SEQ_OP_BURST, SEQ_CHK(n, 8) + SEQ_BUILD_BUG_ON_ZERO((n) > SEQ_BURST_MAX), \
+		SEQ_CHK(r, rb), 0}
+#define SEQ_DATA(vb, v) \
+	{SEQ_OP_DATA, 0, 0, SEQ_CHK(v, vb)}
+#define SEQ_END \
+	{SEQ_OP_END, 0, 0, 0}
+
+/* unchecked write for short sequences built at run time */
+#define SEQ_WRV(r, v) \
+	{SEQ_OP_WR, 0, (r), (v)}
+
+/* codec access methods used by the player */
+typedef struct
+{
+	const char *name;
+	uint8_t trace_src;		// TRC_SRC_xx for trace events
+	uint8_t reg_stride;		// address step between consecutive regs
+	int32_t (*write)(uint16_t reg, uint16_t val);
+	int32_t (*read)(uint16_t reg, uint16_t *val);	// NULL if write-only
+	int32_t (*burst)(uint16_t reg, const uint16_t *val, uint8_t n);	// optional
+	void (*reclock)(void);	// re-time the bus after clk_sys changes, optional
+} codec_seq_if;
+
+void codec_seq_set_model(codec_model *m);
+void codec_seq_i2c_reclock(void);
+int32_t codec_seq_play(const codec_seq_if *cif, const codec_seq_t *seq);
+
+#endif
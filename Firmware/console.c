@@ -0,0 +1,511 @@
+/*
+ * console.c - line command console on the stdio UART
+ *
+ * console_poll() takes what the UART has without waiting and runs a line
+ * once its CR or LF is in, so the idle loop never stalls on input. Words
+ * are split on spaces; numbers take a 0x prefix for hex, and Hz & dB take
+ * decimals and an optional unit. Every command answers with one line for
+ * scripts to wait on - "OK" and key=value pairs, or "ERR <command> <why>"
+ * with why one of unknown, syntax, range, long or fail:
+ *   mode [saw|sine|thru|asrc]      OK mode=sine
+ *   freq [Hz]                      OK freq=997.0000 inc=0x0550ACD6
+ *   amp [dB]                       OK amp=-3.00
+ *   mute [0|1]                     OK mute=0
+ *   rate [Hz]                      OK rate=96000 us=1830
+ *   codec reg r <reg>              OK reg=0x002E val=0x0F0F
+ *   codec reg w <reg> <val>        OK reg=0x002E val=0x0F0F
+ *   stats                          OK fs=48000 mode=sine ...
+ *   plan [list|run <name|all>|     OK plan=level state=running rows=3
+ *        stop|table]
+ *   stream [on [in|out|both]       OK stream=in inst=0 frames=120 ...
+ *          [inst]|off]
+ *   help                           OK cmds=mode,freq,...
+ * With no argument mode, freq, amp, mute & rate report the setting. ISR
+ * times in stats are since the last stats.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <strings.h>
+#include "main.h"
+#include "console.h"
+#include "audio.h"
+#include "codec.h"
+#include "i2s_fulldup.h"
+#include "fsmeas.h"
+#include "plan.h"
+#include "stream.h"
+
+/* decimal places Hz & dB are given to */
+#define CONSOLE_HZ_PLACES 4
+#define CONSOLE_DB_PLACES 2
+
+static const char *console_modes[AUDIO_MODES] =
+{
+	"saw", "sine", "thru", "asrc"
+};
+
+static char console_buf[CONSOLE_LINE+1];
+static uint32_t console_len;
+static uint8_t console_long;
+
+/*
+ * error reply
+ */
+static void console_err(const char *cmd, const char *why)
+{
+	printf("ERR %s %s\n", cmd, why);
+}
+
+/*
+ * [+-]digits[.digits] then unit or nothing, as a fixed point number with
+ * one as its unity - returns 0 if ok
+ */
+static int32_t console_fix(const char *s, uint32_t one, const char *unit,
+	int64_t *v)
+{
+	int64_t ip = 0, fp = 0, div = 1;
+	uint8_t neg = 0, digits = 0;
+
+	if((*s == '-') || (*s == '+'))
+		neg = *s++ == '-';
+	for(;(*s >= '0') && (*s <= '9');s++, digits++)
+	{
+		ip = ip * 10 + (*s - '0');
+		if(ip > 1000000000)
+			return 1;
+	}
+	if(*s == '.')
+		for(s++;(*s >= '0') && (*s <= '9');s++, digits++)
+			if(div < 1000000)
+			{
+				fp = fp * 10 + (*s - '0');
+				div *= 10;
+			}
+	if(!digits || (*s && (!unit || strcasecmp(s, unit))))
+		return 1;
+
+	*v = ip * one + (fp * one + div / 2) / div;
+	if(neg)
+		*v = -*v;
+
+	return 0;
+}
+
+/*
+ * unsigned number, 0x for hex - returns 0 if ok
+ */
+static int32_t console_num(const char *s, uint32_t *v)
+{
+	char *end;
+
+	if((*s < '0') || (*s > '9'))
+		return 1;
+	*v = strtoul(s, &end, 0);
+
+	return *end ? 1 : 0;
+}
+
+/*
+ * fixed point number with one as its unity to places decimals, in buf
+ */
+static const char *console_put_fix(char *buf, int64_t v, uint32_t one,
+	uint32_t places)
+{
+	uint32_t ip, fp, scale = 1, i;
+	uint64_t a = (v < 0) ? -v : v;
+
+	for(i=0;i<places;i++)
+		scale *= 10;
+	ip = a / one;
+	fp = ((a % one) * scale + one / 2) / one;
+	if(fp == scale)
+	{
+		ip++;
+		fp = 0;
+	}
+	sprintf(buf, "%s%u.%0*u", (v < 0) ? "-" : "", ip, (int)places, fp);
+
+	return buf;
+}
+
+static void console_mode(int argc, char **argv)
+{
+	uint32_t m;
+
+	if(argc > 1)
+	{
+		for(m=0;m<AUDIO_MODES;m++)
+			if(!strcmp(argv[1], console_modes[m]))
+				break;
+		if((m == AUDIO_MODES) && console_num(argv[1], &m))
+		{
+			console_err(argv[0], "syntax");
+			return;
+		}
+		if(m >= AUDIO_MODES)
+		{
+			console_err(argv[0], "range");
+			return;
+		}
+		Audio_Mode(m);
+	}
+	printf("OK mode=%s\n", console_modes[Audio_Get_Mode()]);
+}
+
+static void console_freq(int argc, char **argv)
+{
+	audio_status s;
+	int64_t hz;
+	char buf[24];
+
+	if(argc > 1)
+	{
+		if(console_fix(argv[1], 65536, "Hz", &hz))
+		{
+			console_err(argv[0], "syntax");
+			return;
+		}
+		if((hz <= 0) || (hz > UINT32_MAX) || Audio_Set_Tone(hz))
+		{
+			console_err(argv[0], "range");
+			return;
+		}
+	}
+	Audio_Get_Status(&s);
+	printf("OK freq=%s inc=0x%08X\n", console_put_fix(buf, s.hz, 65536,
+		CONSOLE_HZ_PLACES), s.inc);
+}
+
+static void console_amp(int argc, char **argv)
+{
+	audio_status s;
+	int64_t db;
+	char buf[24];
+
+	if(argc > 1)
+	{
+		if(console_fix(argv[1], 256, "dB", &db))
+		{
+			console_err(argv[0], "syntax");
+			return;
+		}
+		if((db < INT32_MIN) || Audio_Set_Level(db))
+		{
+			console_err(argv[0], "range");
+			return;
+		}
+	}
+	Audio_Get_Status(&s);
+	printf("OK amp=%s\n", console_put_fix(buf, s.db, 256, CONSOLE_DB_PLACES));
+}
+
+static void console_mute(int argc, char **argv)
+{
+	audio_status s;
+	uint32_t on;
+
+	if(argc > 1)
+	{
+		if(console_num(argv[1], &on) || (on > 1))
+		{
+			console_err(argv[0], "syntax");
+			return;
+		}
+		Audio_Set_Mute(on);
+	}
+	Audio_Get_Status(&s);
+	printf("OK mute=%u\n", s.mute);
+}
+
+static void console_rate(int argc, char **argv)
+{
+	uint32_t fs;
+	int32_t us = 0;
+
+	if(argc > 1)
+	{
+		if(console_num(argv[1], &fs))
+		{
+			console_err(argv[0], "syntax");
+			return;
+		}
+		us = Audio_Set_Rate(fs);
+		if(us < 0)
+		{
+			console_err(argv[0], "fail");
+			return;
+		}
+	}
+	printf("OK rate=%u us=%d\n", Fsample, us);
+}
+
+static void console_codec(int argc, char **argv)
+{
+	uint32_t reg, val = 0;
+	uint16_t rd;
+	int32_t err;
+
+	if((argc < 4) || strcmp(argv[1], "reg") ||
+		(strcmp(argv[2], "r") && strcmp(argv[2], "w")) ||
+		(argc != ((argv[2][0] == 'w') ? 5 : 4)) ||
+		console_num(argv[3], &reg) ||
+		((argc == 5) && console_num(argv[4], &val)))
+	{
+		console_err(argv[0], "syntax");
+		return;
+	}
+	if((reg > 0xFFFF) || (val > 0xFFFF))
+	{
+		console_err(argv[0], "range");
+		return;
+	}
+
+	if(argv[2][0] == 'w')
+		err = Codec_WriteReg(reg, val);
+	else
+	{
+		err = Codec_ReadReg(reg, &rd);
+		val = rd;
+	}
+	if(err)
+	{
+		console_err(argv[0], (err < 0) ? "range" : "fail");
+		return;
+	}
+	printf("OK reg=0x%04X val=0x%04X\n", reg, val);
+}
+
+static void console_stats(int argc, char **argv)
+{
+	audio_status s;
+	i2s_isr_times t;
+	fsmeas_stats m;
+	uint32_t blocks = 0, us_sum = 0, us_max = 0, stalls = 0;
+	char hz[24], db[24];
+
+	(void)argc;
+	(void)argv;
+	Audio_Get_Status(&s);
+	for(uint n=0;n<I2S_INSTANCES;n++)
+	{
+		i2s_fulldup_isr_times(n, &t);
+		blocks += t.blocks;
+		us_sum += t.us_sum;
+		us_max = (t.us_max > us_max) ? t.us_max : us_max;
+		stalls += t.stalls;
+	}
+	fsmeas_poll();
+	fsmeas_get(&m);
+
+	printf("OK fs=%u mode=%s freq=%s amp=%s mute=%u blocks=%u resyncs=%u "
+		"isr_blocks=%u isr_us_mean=%u isr_us_max=%u isr_stalls=%u "
+		"fs_meas=%.3f fs_ppm=%+.2f src_ppm=%+d src_underruns=%u "
+		"src_overruns=%u\n",
+		s.fs, console_modes[s.mode],
+		console_put_fix(hz, s.hz, 65536, CONSOLE_HZ_PLACES),
+		console_put_fix(db, s.db, 256, CONSOLE_DB_PLACES),
+		s.mute, s.blocks, s.resyncs,
+		blocks, blocks ? us_sum / blocks : 0, us_max, stalls,
+		m.fs, m.ppm, s.src_ppm, s.src_underruns, s.src_overruns);
+}
+
+static void console_plan(int argc, char **argv)
+{
+	static const char *states[] = {"idle", "running", "done", "failed"};
+	const plan_row *rows;
+	uint32_t i, n;
+
+	if(argc > 1)
+	{
+		if(!strcmp(argv[1], "list") && (argc == 2))
+		{
+			printf("OK plans=");
+			for(i=0;i<plans_num;i++)
+				printf("%s%s", i ? "," : "", plans[i].name);
+			printf("\n");
+			return;
+		}
+		if(!strcmp(argv[1], "run") && (argc == 3))
+		{
+			if(plan_run(strcmp(argv[2], "all") ? argv[2] : NULL))
+			{
+				console_err(argv[0], "range");
+				return;
+			}
+		}
+		else if(!strcmp(argv[1], "stop") && (argc == 2))
+			plan_stop();
+		else if(!strcmp(argv[1], "table") && (argc == 2))
+			plan_report();
+		else
+		{
+			console_err(argv[0], "syntax");
+			return;
+		}
+	}
+	n = plan_rows(&rows);
+	printf("OK plan=%s state=%s rows=%u\n", plan_name(), states[plan_state()],
+		n);
+}
+
+static void console_stream(int argc, char **argv)
+{
+	static const char *srcs[] = {"off", "in", "out", "both"};
+	stream_stats s;
+	uint32_t src = STREAM_IN, idx = 0;
+
+	if(argc > 1)
+	{
+		if(!strcmp(argv[1], "on") && (argc <= 4))
+		{
+			if(argc > 2)
+			{
+				for(src=STREAM_IN;src<=STREAM_BOTH;src++)
+					if(!strcmp(argv[2], srcs[src]))
+						break;
+				if(src > STREAM_BOTH)
+				{
+					console_err(argv[0], "syntax");
+					return;
+				}
+			}
+			if((argc > 3) && console_num(argv[3], &idx))
+			{
+				console_err(argv[0], "syntax");
+				return;
+			}
+			if(idx >= I2S_INSTANCES)
+			{
+				console_err(argv[0], "range");
+				return;
+			}
+			if(stream_start(idx, src))
+			{
+				console_err(argv[0], "fail");
+				return;
+			}
+		}
+		else if(!strcmp(argv[1], "off") && (argc == 2))
+			stream_stop();
+		else
+		{
+			console_err(argv[0], "syntax");
+			return;
+		}
+	}
+	stream_get(&s);
+	printf("OK stream=%s inst=%u frames=%u bytes=%u dropped=%u late=%u "
+		"rearms=%u\n", srcs[s.srcs], s.inst, s.frames, s.bytes, s.dropped,
+		s.late, s.rearms);
+}
+
+static void console_help(int argc, char **argv);
+
+/* commands */
+static const struct
+{
+	const char *name;
+	void (*fn)(int argc, char **argv);
+} console_cmds[] =
+{
+	{"mode",	console_mode},
+	{"freq",	console_freq},
+	{"amp",		console_amp},
+	{"mute",	console_mute},
+	{"rate",	console_rate},
+	{"codec",	console_codec},
+	{"stats",	console_stats},
+	{"plan",	console_plan},
+	{"stream",	console_stream},
+	{"help",	console_help},
+};
+#define CONSOLE_CMDS (sizeof(console_cmds)/sizeof(console_cmds[0]))
+
+static void console_help(int argc, char **argv)
+{
+	(void)argc;
+	(void)argv;
+	printf("OK cmds=");
+	for(uint32_t i=0;i<CONSOLE_CMDS;i++)
+		printf("%s%s", i ? "," : "", console_cmds[i].name);
+	printf("\n");
+}
+
+/*
+ * split a line into words & run it
+ */
+static void console_run(char *line)
+{
+	char *argv[CONSOLE_ARGS], *w;
+	int argc = 0;
+	uint32_t i;
+
+	for(w=strtok(line, " \t");w;w=strtok(NULL, " \t"))
+	{
+		if(argc == CONSOLE_ARGS)
+		{
+			console_err(argv[0], "syntax");
+			return;
+		}
+		argv[argc++] = w;
+	}
+	if(!argc)
+		return;
+
+	for(i=0;i<CONSOLE_CMDS;i++)
+		if(!strcmp(argv[0], console_cmds[i].name))
+		{
+			console_cmds[i].fn(argc, argv);
+			return;
+		}
+	console_err(argv[0], "unknown");
+}
+
+/*
+ * start with an empty line
+ */
+void console_init(void)
+{
+	console_len = 0;
+	console_long = 0;
+}
+
+/*
+ * take what the UART has & run a line if one is in - never waits for input
+ */
+void console_poll(void)
+{
+	char *w;
+	int c;
+
+	while((c = getchar_timeout_us(0)) != PICO_ERROR_TIMEOUT)
+	{
+		if((c == '\r') || (c == '\n'))
+		{
+			console_buf[console_len] = 0;
+			if(console_long)
+			{
+				w = strtok(console_buf, " \t");
+				console_err(w ? w : "-", "long");
+			}
+			else
+				console_run(console_buf);
+			console_len = 0;
+			console_long = 0;
+
+			/* one line a pass, so the rest of the loop keeps up */
+			return;
+		}
+		if((c == '\b') || (c == 0x7F))
+		{
+			if(console_len)
+				console_len--;
+		}
+		else if(console_len < CONSOLE_LINE)
+			console_buf[console_len++] = c;
+		else
+			console_long = 1;
+	}
+}
@@ -0,0 +1,17 @@
+/*
+ * console.h - line command console on the stdio UART
+ */
+
+#ifndef __console__
+#define __console__
+
+#include <stdint.h>
+
+/* longest command line & most words in one */
+#define CONSOLE_LINE 80
+#define CONSOLE_ARGS 6
+
+void console_init(void);
+void console_poll(void);
+
+#endif
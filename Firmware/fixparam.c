@@ -0,0 +1,175 @@
+/*
+ * fixparam.c - fixed point parameter conversions for the control path
+ *
+ * Hz to phase increment, dB to Q1.31 gain and ms to a per frame ramp step
+ * or one pole coefficient, without the soft float powf() & expf() that
+ * stall the M0+ for thousands of cycles. Each is a few 32 x 32 multiplies,
+ * shifts and a lookup in tab_exp2 or tab_recip from tables.c. The one
+ * 64-bit divide is in fixparam_rate(), once per rate change.
+ *
+ * Against double libm, over every input host/fixcheck.c tries:
+ * - fixparam_hz_inc() is the floor of the exact increment, or one below
+ *   it when that's within 2^-16 of an integer;
+ * - fixparam_db_gain() is within 0.0005 dB down to -100 dB, and within
+ *   two Q1.31 LSBs below that;
+ * - fixparam_ms_step() is within 2^-28 of 1/frames relative, plus one
+ *   LSB;
+ * - fixparam_ms_coef() is within 10^-6 relative for ramps of 16 frames
+ *   or more, where it comes from a series, and 0.0005 below that.
+ */
+
+#include "fixparam.h"
+#include "tables.h"
+
+/* log2(10)/20 in Q24 & log2(e) in Q30 */
+#define FIXPARAM_DB_LOG2 2786635
+#define FIXPARAM_LOG2E 1549082005U
+
+/* 1/frames under which the coefficient comes from its series - 1/16 */
+#define FIXPARAM_SERIES_MAX (1U<<27)
+
+/* Newton steps after the seed - each doubles the bits from about 8 */
+#define FIXPARAM_RECIP_STEPS 2
+
+/*
+ * set the constants for a rate - the one place a 64-bit divide happens
+ */
+void fixparam_rate(fixparam *p, uint32_t fs)
+{
+	p->fs = fs;
+	p->hz_k = UINT64_MAX / fs;
+	p->ms_k = ((uint64_t)fs << 24) / 1000;
+}
+
+/*
+ * phase increment per frame for a Q16.16 frequency, 2^32 a cycle
+ */
+uint32_t fixparam_hz_inc(const fixparam *p, uint32_t hz)
+{
+	uint64_t acc;
+
+	/* hz * hz_k >> 48, in two halves so no product passes 64 bits */
+	acc = (uint64_t)hz * (uint32_t)(p->hz_k >> 32);
+	acc += ((uint64_t)hz * (uint32_t)p->hz_k) >> 32;
+
+	return (uint32_t)(acc >> 16);
+}
+
+/*
+ * 2^l for a Q16 l up to 0, as Q1.31 - table & linear interpolation
+ */
+static int32_t fixparam_exp2(int32_t l)
+{
+	uint32_t a, m, f, i, v;
+
+	if(l >= 0)
+		return FIXPARAM_ONE;
+
+	/* l = f - m, f in [0, 1) */
+	a = -l;
+	m = a >> 16;
+	f = a & 0xFFFF;
+	if(f)
+	{
+		m++;
+		f = 0x10000 - f;
+	}
+	if(m > 31)
+		return 0;
+
+	/* steps are under 2^25, so 3 bits off leave the product in 32 */
+	i = f >> (16 - TAB_EXP2_BITS);
+	f &= (1 << (16 - TAB_EXP2_BITS)) - 1;
+	v = tab_exp2[i] + ((((tab_exp2[i+1] - tab_exp2[i]) >> 3) * f) >>
+		(16 - TAB_EXP2_BITS - 3));
+
+	/* 2^f in Q2.30 is 2^f / 2 in Q1.31 */
+	return v >> (m - 1);
+}
+
+/*
+ * Q1.31 gain for 1/256 dB - unity for 0 dB and over
+ */
+int32_t fixparam_db_gain(int32_t db)
+{
+	int64_t l;
+
+	/* dB to log2 in Q16 */
+	l = ((int64_t)db * FIXPARAM_DB_LOG2) >> 16;
+	if(l < -(32 << 16))
+		return 0;
+
+	return fixparam_exp2((int32_t)l);
+}
+
+/*
+ * 1/x for x in [0.5, 1) in Q0.32, as Q2.30 - seed from the table & Newton
+ */
+static uint32_t fixparam_recip(uint32_t x)
+{
+	uint32_t r, e;
+
+	r = tab_recip[(x >> (31 - TAB_RECIP_BITS)) & (TAB_RECIP_LEN - 1)];
+	for(int n=0;n<FIXPARAM_RECIP_STEPS;n++)
+	{
+		/* x.r in Q2.30 is near 1, r.(2 - x.r) is nearer 1/x */
+		e = ((uint64_t)x * r) >> 32;
+		r = ((uint64_t)r * ((2U << 30) - e)) >> 30;
+	}
+
+	return r;
+}
+
+/*
+ * 1/frames for a ramp of Q16.16 ms, in Q1.31 - unity for a frame or less
+ */
+static uint32_t fixparam_inv_frames(const fixparam *p, uint32_t ms)
+{
+	uint64_t n;
+	uint32_t r;
+	int s;
+
+	/* frames in Q40 */
+	n = (uint64_t)ms * p->ms_k;
+	if(n <= (1ULL << 40))
+		return FIXPARAM_ONE;
+
+	/* n = x.2^(64-s) with x in [0.5, 1), so 2^40/n = r.2^(s-54) */
+	s = __builtin_clzll(n);
+	r = fixparam_recip((uint32_t)((n << s) >> 32));
+	r >>= 23 - s;
+
+	return (r > FIXPARAM_ONE) ? FIXPARAM_ONE : r;
+}
+
+/*
+ * per frame step of a linear ramp across full scale in Q16.16 ms, Q1.31
+ */
+int32_t fixparam_ms_step(const fixparam *p, uint32_t ms)
+{
+	return fixparam_inv_frames(p, ms);
+}
+
+/*
+ * coefficient of a one pole smoother y += c.(x - y) with a time constant of
+ * Q16.16 ms, c = 1 - e^(-1/frames) in Q1.31
+ */
+int32_t fixparam_ms_coef(const fixparam *p, uint32_t ms)
+{
+	uint32_t x, x2, x3, x4;
+
+	x = fixparam_inv_frames(p, ms);
+
+	/* long ramps - x - x^2/2 + x^3/6 - x^4/24, good to x^5/120 */
+	if(x < FIXPARAM_SERIES_MAX)
+	{
+		x2 = ((uint64_t)x * x) >> 31;
+		x3 = ((uint64_t)x2 * x) >> 31;
+		x4 = ((uint64_t)x3 * x) >> 31;
+		return x - (x2 >> 1) + x3 / 6 - x4 / 24;
+	}
+
+	/* short ones - 1 - 2^(-x.log2(e)) */
+	return FIXPARAM_ONE -
+		fixparam_exp2(-(int32_t)(((uint64_t)x * FIXPARAM_LOG2E) >> 45));
+}
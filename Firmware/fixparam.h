@@ -0,0 +1,32 @@
+/*
+ * fixparam.h - fixed point parameter conversions for the control path
+ */
+
+#ifndef __fixparam__
+#define __fixparam__
+
+#include <stdint.h>
+
+/* Q16.16 Hz & ms, 1/256 dB */
+#define FIXPARAM_HZ(hz) ((uint32_t)((hz) * 65536.0 + 0.5))
+#define FIXPARAM_MS(ms) ((uint32_t)((ms) * 65536.0 + 0.5))
+#define FIXPARAM_DB(db) ((int32_t)((db) * 256.0 + ((db) < 0 ? -0.5 : 0.5)))
+
+/* Q1.31 unity, as near as it gets */
+#define FIXPARAM_ONE 0x7FFFFFFF
+
+/* per rate constants - set by fixparam_rate() when the rate changes */
+typedef struct
+{
+	uint32_t fs;
+	uint64_t hz_k;			// floor(2^64 / fs) - increment per Q16 Hz in Q48
+	uint32_t ms_k;			// floor(fs * 2^24 / 1000) - frames per ms in Q24
+} fixparam;
+
+void fixparam_rate(fixparam *p, uint32_t fs);
+uint32_t fixparam_hz_inc(const fixparam *p, uint32_t hz);
+int32_t fixparam_db_gain(int32_t db);
+int32_t fixparam_ms_step(const fixparam *p, uint32_t ms);
+int32_t fixparam_ms_coef(const fixparam *p, uint32_t ms);
+
+#endif
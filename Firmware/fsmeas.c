@@ -0,0 +1,146 @@
+/*
+ * fsmeas.c - LRCK frame rate measurement on a spare PIO state machine
+ *
+ * The i2s_fsmeas program counts clk_sys cycles over FSMEAS_FRAMES LRCK
+ * periods and pushes one count per window with no gaps between windows,
+ * so the rate is measured to 2 clocks per window whether LRCK comes from
+ * the I2S PIO or from a codec running as master. Counts are collected by
+ * fsmeas_poll() from the idle loop - the RX FIFO holds 8 windows so it
+ * only needs calling every few hundred ms.
+ */
+
+#include <stdio.h>
+#include <math.h>
+#include "hardware/pio.h"
+#include "hardware/clocks.h"
+#include "i2s_fulldup.pio.h"
+#include "fsmeas.h"
+
+static PIO fsmeas_pio;
+static uint fsmeas_sm, fsmeas_offset, fsmeas_pin;
+static uint32_t fsmeas_sys_hz, fsmeas_first;
+
+/*
+ * window lengths in clk_sys cycles - sums are taken from the first window
+ * so the variance doesn't drown in the length squared
+ */
+static uint32_t fsmeas_n, fsmeas_ref, fsmeas_min, fsmeas_max;
+static uint32_t fsmeas_nominal;
+static double fsmeas_sum, fsmeas_sumsq;
+
+/*
+ * load the counter program on pio1 - doesn't start it
+ */
+void fsmeas_init(uint lrck_pin)
+{
+	fsmeas_pio = pio1;
+	fsmeas_pin = lrck_pin;
+	fsmeas_offset = pio_add_program(fsmeas_pio, &i2s_fsmeas_program);
+	fsmeas_sm = pio_claim_unused_sm(fsmeas_pio, true);
+}
+
+/*
+ * (re)start counting & clear the statistics - call after any clk_sys
+ * change with the rate LRCK should be running at
+ */
+void fsmeas_start(uint32_t fs_nominal)
+{
+	pio_sm_set_enabled(fsmeas_pio, fsmeas_sm, false);
+	pio_sm_clear_fifos(fsmeas_pio, fsmeas_sm);
+	pio_sm_restart(fsmeas_pio, fsmeas_sm);
+
+	fsmeas_sys_hz = clock_get_hz(clk_sys);
+	fsmeas_nominal = fs_nominal;
+	fsmeas_n = 0;
+	fsmeas_sum = fsmeas_sumsq = 0.0;
+	fsmeas_min = UINT32_MAX;
+	fsmeas_max = 0;
+
+	/* first window starts off the sync wait so is a few clocks long */
+	fsmeas_first = 1;
+
+	i2s_fsmeas_program_init(fsmeas_pio, fsmeas_sm, fsmeas_offset, fsmeas_pin,
+		FSMEAS_FRAMES);
+}
+
+/*
+ * collect finished windows
+ */
+void fsmeas_poll(void)
+{
+	uint32_t x, cycles;
+	int32_t d;
+
+	while(!pio_sm_is_rx_fifo_empty(fsmeas_pio, fsmeas_sm))
+	{
+		x = pio_sm_get(fsmeas_pio, fsmeas_sm);
+		if(fsmeas_first)
+		{
+			fsmeas_first = 0;
+			continue;
+		}
+
+		/* X counts down from ~0 once every 2 clocks outside the edges */
+		cycles = 2 * ~x + 2 * FSMEAS_FRAMES + 4;
+
+		if(!fsmeas_n++)
+			fsmeas_ref = cycles;
+		d = (int32_t)(cycles - fsmeas_ref);
+		fsmeas_sum += d;
+		fsmeas_sumsq += (double)d * d;
+		if(cycles < fsmeas_min)
+			fsmeas_min = cycles;
+		if(cycles > fsmeas_max)
+			fsmeas_max = cycles;
+	}
+}
+
+/*
+ * statistics since the last start - all zero until a window is in
+ */
+void fsmeas_get(fsmeas_stats *stats)
+{
+	double mean, var, ns;
+
+	stats->windows = fsmeas_n;
+	stats->fs_nominal = fsmeas_nominal;
+	stats->fs = stats->ppm = stats->ppm_min = stats->ppm_max = 0.0;
+	stats->jitter_rms_ns = stats->jitter_pp_ns = 0.0;
+	if(!fsmeas_n)
+		return;
+
+	mean = fsmeas_sum / fsmeas_n;
+	var = fsmeas_sumsq / fsmeas_n - mean * mean;
+	mean += fsmeas_ref;
+	ns = 1e9 / fsmeas_sys_hz;
+
+	/* a longer window is a lower rate */
+	stats->fs = FSMEAS_FRAMES * (double)fsmeas_sys_hz / mean;
+	stats->ppm = (stats->fs / fsmeas_nominal - 1.0) * 1e6;
+	stats->ppm_min = (FSMEAS_FRAMES * (double)fsmeas_sys_hz / fsmeas_max /
+		fsmeas_nominal - 1.0) * 1e6;
+	stats->ppm_max = (FSMEAS_FRAMES * (double)fsmeas_sys_hz / fsmeas_min /
+		fsmeas_nominal - 1.0) * 1e6;
+	stats->jitter_rms_ns = (var > 0.0 ? sqrt(var) : 0.0) * ns;
+	stats->jitter_pp_ns = (fsmeas_max - fsmeas_min) * ns;
+}
+
+/*
+ * print the statistics
+ */
+void fsmeas_report(void)
+{
+	fsmeas_stats stats;
+
+	fsmeas_poll();
+	fsmeas_get(&stats);
+	if(!stats.windows)
+	{
+		printf("Fs: no LRCK\n");
+		return;
+	}
+
+	printf("Fs: %.3f Hz, %+.2f ppm (%+.2f to %+.2f), jitter %.1f ns rms %.1f ns p-p over %u x %u frames\n",
+		stats.fs, stats.ppm, stats.ppm_min, stats.ppm_max,
+		stats.jitter_rms_ns, stats.jitter_pp_ns, stats.windows, FSMEAS_FRAMES);
+}
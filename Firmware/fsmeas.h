@@ -0,0 +1,30 @@
+/*
+ * fsmeas.h - LRCK frame rate measurement on a spare PIO state machine
+ */
+
+#ifndef __fsmeas__
+#define __fsmeas__
+
+#include "main.h"
+
+/* LRCK periods per measurement window */
+#define FSMEAS_FRAMES 4096
+
+/* running statistics since the last start */
+typedef struct
+{
+	uint32_t windows;		// windows measured
+	uint32_t fs_nominal;	// rate the ppm figures are against
+	double fs;				// mean rate in Hz
+	double ppm, ppm_min, ppm_max;
+	double jitter_rms_ns;	// window length deviation from the mean
+	double jitter_pp_ns;
+} fsmeas_stats;
+
+void fsmeas_init(uint lrck_pin);
+void fsmeas_start(uint32_t fs_nominal);
+void fsmeas_poll(void);
+void fsmeas_get(fsmeas_stats *stats);
+void fsmeas_report(void);
+
+#endif
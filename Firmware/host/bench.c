@@ -0,0 +1,366 @@
+/*
+ * bench.c - microbenchmark of the audio kernels on the host build
+ *
+ * Linked into rp2040_i2s_bench with the firmware sources other than
+ * main.c. Runs each Audio_Proc, Audio_Proc32 & Audio_Proc_TDM mode, the
+ * tone level scaling, the input meter and the sine interpolators a block
+ * at a time over a large buffer, as the I2S interrupt would, and reports
+ * host ns per sample.
+ *
+ * Host times are only comparable on the machine that took them, so no
+ * baseline is kept in the tree - -s writes one from this run, to
+ * BENCH_BASELINE in the build directory unless one is named. Later runs
+ * are checked against it and a row is flagged if it got slower by more
+ * than BENCH_TOL_PCT, or -t's percentage, which makes the exit status 1.
+ * With no baseline nothing is flagged:
+ *   ./rp2040_i2s_bench [-s] [-t pct] [baseline]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "pico/stdlib.h"
+#include "audio.h"
+#include "asrc.h"
+#include "meter.h"
+
+/* samples each kernel runs over & best of how many runs */
+#define BENCH_SAMPLES (1<<20)
+#define BENCH_REPS 25
+
+/* slots the TDM rows run with */
+#define BENCH_TDM_SLOTS 8
+
+/* tone level the level rows run at, 1/256 dB */
+#define BENCH_LEVEL_DB (-6*256)
+
+/* meter tone - a whole number of cycles in a row's frames */
+#define BENCH_METER_INC (0x100000000ULL / 64)
+
+/* default host slowdown that counts as a regression */
+#define BENCH_TOL_PCT 25
+
+/* most rows a baseline file can have */
+#define BENCH_ROWS_MAX 32
+
+/* firmware state the kernels run from - core 1 isn't here to set it */
+extern volatile uint8_t core1_mode, core1_mute;
+extern int32_t phs, frq;
+extern asrc audio_asrc;
+int16_t sine_interp(uint32_t phs);
+int32_t sine_interp32(uint32_t phs);
+
+/* one row */
+typedef struct
+{
+	const char *name;
+	void (*run)(uint8_t mode);
+	uint8_t mode;			// core1_mode, or mute if AUDIO_MODES
+} bench_kernel;
+
+static int16_t in16[BENCH_SAMPLES], out16[BENCH_SAMPLES];
+static int32_t in32[BENCH_SAMPLES], out32[BENCH_SAMPLES];
+
+/* ASRC source - a sine the producer writes a block of before each read */
+static int16_t src_buf[SMPS*CHLS];
+static uint64_t bench_asrc_ns;
+
+static uint64_t bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * keep the ASRC fed & time only the reads - the writes are core 0's
+ */
+static void bench_asrc_block(void (*proc)(void *dst, int32_t len), void *dst)
+{
+	uint64_t t0;
+
+	asrc_write(&audio_asrc, src_buf, SMPS);
+	t0 = bench_now();
+	proc(dst, BUFSZ);
+	bench_asrc_ns += bench_now() - t0;
+}
+
+static void bench_proc16_asrc(void *dst, int32_t len)
+{
+	Audio_Proc(dst, in16, len);
+}
+
+static void bench_proc32_asrc(void *dst, int32_t len)
+{
+	Audio_Proc32(dst, in32, len);
+}
+
+static void bench_proc16(uint8_t mode)
+{
+	int32_t i;
+
+	for(i=0;i<BENCH_SAMPLES;i+=BUFSZ)
+		if(mode == AUDIO_MODE_ASRC)
+			bench_asrc_block(bench_proc16_asrc, &out16[i]);
+		else
+			Audio_Proc(&out16[i], &in16[i], BUFSZ);
+}
+
+static void bench_proc32(uint8_t mode)
+{
+	int32_t i;
+
+	for(i=0;i<BENCH_SAMPLES;i+=BUFSZ)
+		if(mode == AUDIO_MODE_ASRC)
+			bench_asrc_block(bench_proc32_asrc, &out32[i]);
+		else
+			Audio_Proc32(&out32[i], &in32[i], BUFSZ);
+}
+
+static void bench_tdm(uint8_t mode)
+{
+	int32_t i;
+
+	(void)mode;
+	for(i=0;i<BENCH_SAMPLES;i+=BENCH_TDM_SLOTS*SMPS)
+		Audio_Proc_TDM(&out32[i], &in32[i], BENCH_TDM_SLOTS, SMPS);
+}
+
+/*
+ * the generators with the level off unity, so Audio_Level scales them
+ */
+static void bench_level16(uint8_t mode)
+{
+	Audio_Set_Level(BENCH_LEVEL_DB);
+	bench_proc16(mode);
+	Audio_Set_Level(0);
+}
+
+static void bench_level32(uint8_t mode)
+{
+	Audio_Set_Level(BENCH_LEVEL_DB);
+	bench_proc32(mode);
+	Audio_Set_Level(0);
+}
+
+/*
+ * the input meter over the whole buffer, armed for all of it
+ */
+static void bench_meter(uint8_t mode)
+{
+	int32_t i;
+
+	(void)mode;
+	meter_start(0, BENCH_SAMPLES / CHLS, BENCH_METER_INC);
+	for(i=0;i<BENCH_SAMPLES;i+=BUFSZ)
+		meter_feed(&in16[i], BUFSZ);
+	meter_stop();
+}
+
+static void bench_meter32(uint8_t mode)
+{
+	int32_t i;
+
+	(void)mode;
+	meter_start(0, BENCH_SAMPLES / CHLS, BENCH_METER_INC);
+	for(i=0;i<BENCH_SAMPLES;i+=BUFSZ)
+		meter_feed32(&in32[i], BUFSZ);
+	meter_stop();
+}
+
+static void bench_sine(uint8_t mode)
+{
+	uint32_t p = 0;
+	int32_t i;
+
+	(void)mode;
+	for(i=0;i<BENCH_SAMPLES;i++)
+	{
+		out16[i] = sine_interp(p);
+		p += frq;
+	}
+}
+
+static void bench_sine32(uint8_t mode)
+{
+	uint32_t p = 0;
+	int32_t i;
+
+	(void)mode;
+	for(i=0;i<BENCH_SAMPLES;i++)
+	{
+		out32[i] = sine_interp32(p);
+		p += frq;
+	}
+}
+
+/* the kernels - the level rows are the saw ones with Audio_Level too */
+static const bench_kernel bench_kernels[] =
+{
+	{"proc16_saw",		bench_proc16, 0},
+	{"proc16_sine",		bench_proc16, 1},
+	{"proc16_pass",		bench_proc16, 2},
+	{"proc16_asrc",		bench_proc16, AUDIO_MODE_ASRC},
+	{"proc16_mute",		bench_proc16, AUDIO_MODES},
+	{"proc32_saw",		bench_proc32, 0},
+	{"proc32_sine",		bench_proc32, 1},
+	{"proc32_pass",		bench_proc32, 2},
+	{"proc32_asrc",		bench_proc32, AUDIO_MODE_ASRC},
+	{"level16_saw",		bench_level16, 0},
+	{"level32_saw",		bench_level32, 0},
+	{"tdm8_saw",		bench_tdm, 0},
+	{"tdm8_sine",		bench_tdm, 1},
+	{"tdm8_pass",		bench_tdm, 2},
+	{"meter_feed",		bench_meter, 0},
+	{"meter_feed32",	bench_meter32, 0},
+	{"sine_interp",		bench_sine, 0},
+	{"sine_interp32",	bench_sine32, 0},
+};
+
+#define BENCH_KERNELS (int32_t)(sizeof(bench_kernels)/sizeof(bench_kernels[0]))
+
+/*
+ * best host time for a row in ns per sample
+ */
+static double bench_run(const bench_kernel *k)
+{
+	uint64_t t0, ns, best = ~0ULL;
+	int32_t r, i;
+
+	core1_mode = k->mode < AUDIO_MODES ? k->mode : 0;
+	core1_mute = k->mode == AUDIO_MODES;
+	for(r=0;r<BENCH_REPS;r++)
+	{
+		/* ASRC filled to where it starts reading */
+		asrc_init(&audio_asrc, ASRC_ONE);
+		for(i=0;i<ASRC_TARGET;i+=SMPS)
+			asrc_write(&audio_asrc, src_buf, SMPS);
+		bench_asrc_ns = 0;
+		t0 = bench_now();
+		k->run(k->mode);
+		ns = k->mode == AUDIO_MODE_ASRC ? bench_asrc_ns : bench_now() - t0;
+		if(ns < best)
+			best = ns;
+	}
+
+	return (double)best / BENCH_SAMPLES;
+}
+
+/* baseline rows */
+static struct
+{
+	char name[32];
+	double ns;
+} base[BENCH_ROWS_MAX];
+static int32_t nbase;
+
+static void bench_load(const char *path)
+{
+	char line[128];
+	FILE *f = fopen(path, "r");
+
+	if(!f)
+	{
+		printf("no baseline at %s - -s writes one\n", path);
+		return;
+	}
+	while(fgets(line, sizeof(line), f) && (nbase < BENCH_ROWS_MAX))
+		if((line[0] != '#') && (sscanf(line, "%31s %lf", base[nbase].name,
+			&base[nbase].ns) == 2))
+			nbase++;
+	fclose(f);
+}
+
+static int32_t bench_find(const char *name)
+{
+	int32_t i;
+
+	for(i=0;i<nbase;i++)
+		if(!strcmp(base[i].name, name))
+			return i;
+
+	return -1;
+}
+
+int main(int argc, char **argv)
+{
+	const char *path = BENCH_BASELINE;
+	double ns[BENCH_KERNELS];
+	int32_t i, b, save = 0, flags = 0, tol = BENCH_TOL_PCT;
+	uint32_t seed = 1;
+	const char *note;
+	FILE *f;
+
+	for(i=1;i<argc;i++)
+		if(!strcmp(argv[i], "-s"))
+			save = 1;
+		else if(!strcmp(argv[i], "-t") && (i + 1 < argc))
+			tol = atoi(argv[++i]);
+		else
+			path = argv[i];
+	if(!save)
+		bench_load(path);
+
+	/* kernel state as the firmware starts it, at the default rate */
+	Fsample = I2S_FS_DEFAULT;
+	Audio_Init();
+	for(i=0;i<BENCH_SAMPLES;i++)
+	{
+		seed = seed * 1664525 + 1013904223;
+		in16[i] = seed >> 16;
+		in32[i] = seed;
+	}
+	for(i=0;i<SMPS;i++)
+		src_buf[2*i] = src_buf[2*i+1] = sine_interp(i * (0x100000000ULL / SMPS));
+
+	printf("%u samples a row, best of %u\n", BENCH_SAMPLES, BENCH_REPS);
+	printf("%-16s %9s %9s\n", "kernel", "ns/sample", "baseline");
+
+	for(i=0;i<BENCH_KERNELS;i++)
+	{
+		const bench_kernel *k = &bench_kernels[i];
+
+		ns[i] = bench_run(k);
+
+		/* against the baseline */
+		b = save ? -1 : bench_find(k->name);
+		if(b >= 0)
+		{
+			note = (ns[i] > base[b].ns * (100 + tol) / 100) ? "REGRESSED" :
+				"ok";
+			flags += note[0] == 'R';
+			printf("%-16s %9.2f %9.2f  %s\n", k->name, ns[i], base[b].ns, note);
+		}
+		else
+			printf("%-16s %9.2f %9s%s\n", k->name, ns[i], "-",
+				nbase ? "  new" : "");
+	}
+
+	if(save)
+	{
+		if(!(f = fopen(path, "w")))
+		{
+			printf("can't write %s\n", path);
+			return 1;
+		}
+		fprintf(f, "# kernel ns/sample - rp2040_i2s_bench -s\n");
+		for(i=0;i<BENCH_KERNELS;i++)
+			fprintf(f, "%s %.3f\n", bench_kernels[i].name, ns[i]);
+		fclose(f);
+		printf("baseline written to %s\n", path);
+		return 0;
+	}
+
+	printf(flags ? "REGRESSED\n" : "PASSED\n");
+	return flags ? 1 : 0;
+}
+
+/*
+ * main.c's - the codec sequencer's delays
+ */
+void my_sleep_ms(uint64_t ms)
+{
+	sleep_ms(ms);
+}
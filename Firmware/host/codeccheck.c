@@ -0,0 +1,148 @@
+/*
+ * codeccheck.c - each codec driver against its model on the host build
+ *
+ * Linked into rp2040_i2s_codecs with the firmware less main.c. For every
+ * supported codec in turn its model goes on the simulated bus the driver
+ * talks to - I2C at its address or the bit-banged L3 port - then the
+ * driver's own Init, SetRate over the standard rates & MCLK ratios,
+ * SetFormat over the formats & word lengths as slave & as master, and
+ * Reset again, all run against it. Bus time is taken on the simulated
+ * clock so the model's PLL lock & settle checks see real delays. Between
+ * Init & the rest clk_sys moves as for a new clock plan and the driver's
+ * reclock hook has to keep the bus at its rate. Exits 1 if any model
+ * flagged an illegal sequence, a transfer ran off its rate or an Init
+ * failed:
+ *   ./rp2040_i2s_codecs
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "hardware/clocks.h"
+#include "codec.h"
+#include "codec_model.h"
+#include "wm8731.h"
+#include "aic3101.h"
+#include "nau88c22.h"
+#include "sgtl5000.h"
+#include "uda1345.h"
+#include "sim.h"
+
+static const struct
+{
+	const codec_model_desc *desc;
+	const codec_seq_if *cif;
+	int32_t (*init)(void);
+	int32_t (*reset)(void);
+	int32_t (*set_rate)(uint32_t fs, uint16_t mclk_ratio);
+	int32_t (*set_format)(uint8_t fmt, uint8_t bits);
+	int32_t (*set_master)(uint8_t enable);
+} codeccheck_codecs[] =
+{
+	{&codec_model_wm8731, &wm8731_if, WM8731_Init, WM8731_Reset, WM8731_SetRate,
+		WM8731_SetFormat, WM8731_SetMaster},
+	{&codec_model_aic3101, &aic3101_if, AIC3101_Init, AIC3101_Reset, AIC3101_SetRate,
+		AIC3101_SetFormat, AIC3101_SetMaster},
+	{&codec_model_nau88c22, &nau88c22_if, NAU88C22_Init, NAU88C22_Reset, NAU88C22_SetRate,
+		NAU88C22_SetFormat, NAU88C22_SetMaster},
+	{&codec_model_sgtl5000, &sgtl5000_if, SGTL5000_Init, SGTL5000_Reset, SGTL5000_SetRate,
+		SGTL5000_SetFormat, SGTL5000_SetMaster},
+	{&codec_model_uda1345, &uda1345_if, UDA1345_Init, UDA1345_Reset, UDA1345_SetRate,
+		UDA1345_SetFormat, UDA1345_SetMaster},
+};
+#define CODECCHECK_CODECS (sizeof(codeccheck_codecs)/sizeof(codeccheck_codecs[0]))
+
+static const uint32_t codeccheck_rates[] =
+{
+	8000, 16000, 32000, 44100, 48000, 88200, 96000, 192000
+};
+#define CODECCHECK_RATES (sizeof(codeccheck_rates)/sizeof(codeccheck_rates[0]))
+
+static const uint16_t codeccheck_ratios[] = {128, 256, 384, 512};
+#define CODECCHECK_RATIOS (sizeof(codeccheck_ratios)/sizeof(codeccheck_ratios[0]))
+
+static const uint8_t codeccheck_bits[] = {16, 20, 24, 32};
+#define CODECCHECK_BITS (sizeof(codeccheck_bits)/sizeof(codeccheck_bits[0]))
+
+/* clk_sys of the 44.1kHz plan, to move to after Init */
+#define CODECCHECK_SYS_HZ 135475200
+
+/*
+ * move clk_sys as a new clock plan would & have the driver re-time its bus
+ */
+static void codeccheck_reclock(const codec_seq_if *cif, uint32_t hz)
+{
+	clock_configure(clk_sys, 0, 0, hz, hz);
+	if(cif->reclock)
+		cif->reclock();
+}
+
+/*
+ * main.c's - the codec sequencer's delays
+ */
+void my_sleep_ms(uint64_t ms)
+{
+	sleep_ms(ms);
+}
+
+int main(void)
+{
+	codec_model m;
+	sim_counters n;
+	uint32_t c, i, j, rates, fmts, bad = 0, sys_hz = clock_get_hz(clk_sys);
+	uint8_t master, fmt;
+
+	for(c=0;c<CODECCHECK_CODECS;c++)
+	{
+		codec_model_init(&m, codeccheck_codecs[c].desc);
+		sim_codec_attach(&m);
+		if(codeccheck_codecs[c].init())
+		{
+			printf("%s: Init failed\n", m.desc->name);
+			bad++;
+		}
+		codeccheck_reclock(codeccheck_codecs[c].cif, CODECCHECK_SYS_HZ);
+
+		rates = 0;
+		for(i=0;i<CODECCHECK_RATES;i++)
+			for(j=0;j<CODECCHECK_RATIOS;j++)
+				rates += !codeccheck_codecs[c].set_rate(codeccheck_rates[i],
+					codeccheck_ratios[j]);
+
+		fmts = 0;
+		for(master=0;master<2;master++)
+		{
+			if(codeccheck_codecs[c].set_master(master))
+				continue;
+			for(fmt=0;fmt<FMT_TDM;fmt++)
+				for(i=0;i<CODECCHECK_BITS;i++)
+					fmts += !codeccheck_codecs[c].set_format(fmt,
+						codeccheck_bits[i]);
+		}
+		codeccheck_codecs[c].set_master(0);
+
+		if(codeccheck_codecs[c].reset())
+		{
+			printf("%s: Reset failed\n", m.desc->name);
+			bad++;
+		}
+		codeccheck_reclock(codeccheck_codecs[c].cif, sys_hz);
+
+		printf("%s: %u rates & %u formats taken\n", m.desc->name,
+			(unsigned)rates, (unsigned)fmts);
+		codec_model_report(&m);
+		bad += m.violations;
+	}
+
+	/* the built in codec's model goes back for anything after */
+	sim_codec_attach(sim_codec());
+	sim_get_counters(&n);
+	if(n.i2c_off_rate)
+	{
+		printf("codecs: %u I2C transfers off their rate\n",
+			(unsigned)n.i2c_off_rate);
+		bad++;
+	}
+	printf("codecs: %s\n", bad ? "FAIL" : "pass");
+
+	return bad ? 1 : 0;
+}
@@ -0,0 +1,292 @@
+/*
+ * fixcheck.c - error bounds & speed of fixparam.c on the host build
+ *
+ * Linked into rp2040_i2s_fixparam with fixparam.c & the tables.c made for
+ * the build. Runs each conversion over its input range at several rates,
+ * worst case first, against double libm, and checks it holds the bounds
+ * given in fixparam.c. Then times each against the float code it
+ * replaces - the host has an FPU, so the float times here are far better
+ * than the soft float the M0+ runs. Exits 1 if any bound is broken:
+ *   ./rp2040_i2s_fixparam
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "fixparam.h"
+
+/* rates checked - the standard ones & some a clock plan might round to */
+static const uint32_t fixcheck_rates[] =
+{
+	8000, 11025, 16000, 22050, 32000, 44100, 44101, 47999, 48000, 88200,
+	96000, 192000
+};
+#define FIXCHECK_RATES (sizeof(fixcheck_rates)/sizeof(fixcheck_rates[0]))
+
+/* bounds from fixparam.c */
+#define FIXCHECK_DB_TOL 0.0005
+#define FIXCHECK_DB_FLOOR -100.0
+#define FIXCHECK_DB_LSB 2.0
+#define FIXCHECK_STEP_TOL (1.0 / (1 << 28))
+#define FIXCHECK_COEF_TOL 1e-6
+#define FIXCHECK_COEF_TOL_SHORT 0.0005
+
+/* calls per timing & best of how many runs */
+#define FIXCHECK_CALLS (1<<16)
+#define FIXCHECK_REPS 25
+
+static uint32_t fixcheck_in[FIXCHECK_CALLS];
+static volatile int32_t fixcheck_sink;
+
+static uint64_t fixcheck_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * one result line - returns 1 if out
+ */
+static int fixcheck_report(const char *name, uint32_t n, const char *what,
+	double worst, double tol)
+{
+	int fail = worst > tol;
+
+	printf("%-16s %8u inputs, worst %-10s %.3g of %.3g - %s\n", name, n,
+		what, worst, tol, fail ? "FAIL" : "pass");
+	return fail;
+}
+
+/*
+ * Hz to increment - every Q16 Hz step of 1/7 Hz & the tenths to 20 kHz
+ */
+static int fixcheck_hz(void)
+{
+	fixparam p;
+	uint32_t r, hz, inc, n = 0, below = 0, bad = 0;
+	uint64_t exact;
+	double frac;
+
+	for(r=0;r<FIXCHECK_RATES;r++)
+	{
+		fixparam_rate(&p, fixcheck_rates[r]);
+		for(hz=0;hz<(65535U<<16);hz+=9362)
+		{
+			exact = ((uint64_t)hz << 16) / fixcheck_rates[r];
+			inc = fixparam_hz_inc(&p, hz);
+			n++;
+			if(inc == (uint32_t)exact)
+				continue;
+
+			/* one below only where the exact value is just over */
+			frac = (double)(((uint64_t)hz << 16) % fixcheck_rates[r]) /
+				fixcheck_rates[r];
+			if((inc == (uint32_t)exact - 1) && (frac < 1.0 / 65536))
+				below++;
+			else
+				bad++;
+		}
+	}
+	printf("%-16s %8u inputs, %u one below the floor\n", "hz_inc", n, below);
+
+	return fixcheck_report("hz_inc", n, "misses", bad, 0);
+}
+
+/*
+ * dB to gain - every 1/256 dB from -200 to +1
+ */
+static int fixcheck_db(void)
+{
+	int32_t db, g;
+	uint32_t n = 0;
+	double ideal, e, worst_db = 0.0, worst_lsb = 0.0;
+
+	for(db=FIXPARAM_DB(-200);db<=FIXPARAM_DB(1);db++)
+	{
+		g = fixparam_db_gain(db);
+		ideal = db >= 0 ? FIXPARAM_ONE : pow(10.0, db / 256.0 / 20.0) * 2147483648.0;
+		n++;
+		if(db / 256.0 >= FIXCHECK_DB_FLOOR)
+		{
+			e = fabs(20.0 * log10(g / ideal));
+			if(e > worst_db)
+				worst_db = e;
+		}
+		else
+		{
+			e = fabs(g - ideal);
+			if(e > worst_lsb)
+				worst_lsb = e;
+		}
+	}
+
+	return fixcheck_report("db_gain", n, "dB", worst_db, FIXCHECK_DB_TOL) |
+		fixcheck_report("db_gain < -100", n, "LSB", worst_lsb, FIXCHECK_DB_LSB);
+}
+
+/*
+ * ms to ramp step & coefficient - 1/64 ms to 10 s in steps of 1/64 octave
+ */
+static int fixcheck_ms(void)
+{
+	fixparam p;
+	uint32_t r, ms, n = 0;
+	int32_t step, coef;
+	double frames, ideal, e, worst_step = 0.0, worst_coef = 0.0,
+		worst_short = 0.0;
+	int i;
+
+	for(r=0;r<FIXCHECK_RATES;r++)
+	{
+		fixparam_rate(&p, fixcheck_rates[r]);
+		for(i=0;i<64*19;i++)
+		{
+			ms = (uint32_t)(1024.0 * pow(2.0, i / 64.0));
+			frames = ms / 65536.0 * fixcheck_rates[r] / 1000.0;
+			if(frames <= 1.0)
+				continue;
+			step = fixparam_ms_step(&p, ms);
+			coef = fixparam_ms_coef(&p, ms);
+			n++;
+
+			/* relative, less the LSB the result is rounded to */
+			ideal = 2147483648.0 / frames;
+			e = (fabs(step - ideal) - 1.0) / ideal;
+			if(e > worst_step)
+				worst_step = e;
+
+			ideal = -expm1(-1.0 / frames) * 2147483648.0;
+			e = (fabs(coef - ideal) - 1.0) / ideal;
+			if(frames >= 16.0)
+			{
+				if(e > worst_coef)
+					worst_coef = e;
+			}
+			else if(e > worst_short)
+				worst_short = e;
+		}
+	}
+
+	return fixcheck_report("ms_step", n, "relative", worst_step,
+			FIXCHECK_STEP_TOL) |
+		fixcheck_report("ms_coef", n, "relative", worst_coef,
+			FIXCHECK_COEF_TOL) |
+		fixcheck_report("ms_coef < 16", n, "relative", worst_short,
+			FIXCHECK_COEF_TOL_SHORT);
+}
+
+/* the conversions & the float code they replace, over fixcheck_in[] */
+static fixparam fixcheck_p;
+
+static void fixcheck_hz_fix(uint32_t x)
+{
+	fixcheck_sink = fixparam_hz_inc(&fixcheck_p, x);
+}
+
+static void fixcheck_hz_float(uint32_t x)
+{
+	fixcheck_sink = (int32_t)floorf((x / 65536.0F) * powf(2.0F, 32.0F) /
+		(float)fixcheck_p.fs);
+}
+
+static void fixcheck_db_fix(uint32_t x)
+{
+	fixcheck_sink = fixparam_db_gain(-(int32_t)(x >> 16));
+}
+
+static void fixcheck_db_float(uint32_t x)
+{
+	fixcheck_sink = (int32_t)(powf(10.0F, -(float)(x >> 16) / 5120.0F) *
+		2147483647.0F);
+}
+
+static void fixcheck_step_fix(uint32_t x)
+{
+	fixcheck_sink = fixparam_ms_step(&fixcheck_p, x);
+}
+
+static void fixcheck_step_float(uint32_t x)
+{
+	fixcheck_sink = (int32_t)(2147483647.0F / ((x / 65536.0F) *
+		(float)fixcheck_p.fs / 1000.0F));
+}
+
+static void fixcheck_coef_fix(uint32_t x)
+{
+	fixcheck_sink = fixparam_ms_coef(&fixcheck_p, x);
+}
+
+static void fixcheck_coef_float(uint32_t x)
+{
+	fixcheck_sink = (int32_t)((1.0F - expf(-1000.0F / ((x / 65536.0F) *
+		(float)fixcheck_p.fs))) * 2147483647.0F);
+}
+
+static const struct
+{
+	const char *name;
+	void (*fix)(uint32_t x);
+	void (*flt)(uint32_t x);
+} fixcheck_calls[] =
+{
+	{"hz_inc",	fixcheck_hz_fix,	fixcheck_hz_float},
+	{"db_gain",	fixcheck_db_fix,	fixcheck_db_float},
+	{"ms_step",	fixcheck_step_fix,	fixcheck_step_float},
+	{"ms_coef",	fixcheck_coef_fix,	fixcheck_coef_float},
+};
+
+/*
+ * best host time for one call in ns
+ */
+static double fixcheck_time(void (*fn)(uint32_t x))
+{
+	uint64_t t0, ns, best = ~0ULL;
+	int32_t r, i;
+
+	for(r=0;r<FIXCHECK_REPS;r++)
+	{
+		t0 = fixcheck_now();
+		for(i=0;i<FIXCHECK_CALLS;i++)
+			fn(fixcheck_in[i]);
+		ns = fixcheck_now() - t0;
+		if(ns < best)
+			best = ns;
+	}
+
+	return (double)best / FIXCHECK_CALLS;
+}
+
+int main(void)
+{
+	double fix, flt;
+	int fail = 0;
+	uint32_t i;
+
+	fail |= fixcheck_hz();
+	fail |= fixcheck_db();
+	fail |= fixcheck_ms();
+
+	/* 20 to 20000 in Q16 - Hz, ms, or 1/256 dB down once shifted */
+	srand(1);
+	for(i=0;i<FIXCHECK_CALLS;i++)
+		fixcheck_in[i] = (uint32_t)(20.0 * 65536.0 * pow(1000.0,
+			(double)rand() / RAND_MAX));
+	fixparam_rate(&fixcheck_p, 48000);
+
+	printf("\n%-16s %10s %10s %8s\n", "call at 48kHz", "fixed ns", "float ns",
+		"ratio");
+	for(i=0;i<sizeof(fixcheck_calls)/sizeof(fixcheck_calls[0]);i++)
+	{
+		fix = fixcheck_time(fixcheck_calls[i].fix);
+		flt = fixcheck_time(fixcheck_calls[i].flt);
+		printf("%-16s %10.2f %10.2f %8.2f\n", fixcheck_calls[i].name, fix, flt,
+			flt / fix);
+	}
+	printf("fixparam: %s\n", fail ? "FAIL" : "pass");
+
+	return fail;
+}
@@ -0,0 +1,456 @@
+/*
+ * golden.c - golden vector check of the audio kernels on the host build
+ *
+ * Linked into rp2040_i2s_golden with the firmware sources other than
+ * main.c. Renders each generator & pass-thru mode of Audio_Proc (16-bit)
+ * and Audio_Proc32 (24-bit) a block at a time to a stereo WAV in the
+ * current directory, pass-thru from synthetic ADC tones made in integer
+ * math, and compares it with the golden file of the same name in
+ * GOLDEN_DIR or the one named. The golden has to cover the whole render.
+ * Modes built on integer math alone have to match bit for bit.
+ * The sine table & ASRC coefficients come from libm calls at build time
+ * that can round differently between hosts, so those modes are held to the
+ * golden's level, THD & SNR and to a few LSBs of it instead. THD & SNR of the
+ * left channel are reported for every mode, from a least squares fit of
+ * the tone & its harmonics after GOLDEN_SKIP_S to let the ASRC lock. -w
+ * writes the golden files from this run instead:
+ *   ./rp2040_i2s_golden [-w] [-s seconds] [golden dir]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "pico/stdlib.h"
+#include "audio.h"
+#include "asrc.h"
+
+/* default render length & what the analysis skips at the start */
+#define GOLDEN_SECONDS 0.25
+#define GOLDEN_SKIP_S 0.05
+
+/* longest render */
+#define GOLDEN_SECONDS_MAX 10
+
+/* harmonics in the fit, the fundamental included */
+#define GOLDEN_HARMS 9
+#define GOLDEN_TERMS (2*GOLDEN_HARMS+1)
+
+/*
+ * spectral tolerances - level in dB either way, THD & SNR in dB worse &
+ * the largest sample difference in 16-bit LSBs, which allows for a few
+ * LSBs of table rounding through the interpolators
+ */
+#define GOLDEN_TOL_LEVEL 0.05
+#define GOLDEN_TOL_THD 1.0
+#define GOLDEN_TOL_SNR 1.0
+#define GOLDEN_TOL_LSB 16
+
+/*
+ * synthetic ADC input for pass-thru - tones on left & right from magic
+ * circle oscillators, E being 2 sin(pi f / fs) in Q30 at 48kHz, starting
+ * at -1 dBFS of 24 bits
+ */
+#define GOLDEN_ADC_HZ_L 997.0
+#define GOLDEN_ADC_HZ_R 1999.0
+#define GOLDEN_ADC_E_L 140031393
+#define GOLDEN_ADC_E_R 280163513
+#define GOLDEN_ADC_AMP 7476354
+
+/* firmware state the kernels run from - core 1 isn't here to set it */
+extern volatile uint8_t core1_mode, core1_mute;
+extern int32_t phs, frq;
+extern asrc audio_asrc;
+int16_t sine_interp(uint32_t phs);
+
+/* one mode */
+typedef struct
+{
+	const char *name;
+	uint8_t mode;		// core1_mode
+	uint8_t bits;		// 16 through Audio_Proc, 24 through Audio_Proc32
+	uint8_t exact;		// bit exact, else spectral
+} golden_mode;
+
+static const golden_mode golden_modes[] =
+{
+	{"saw16", 0, 16, 1},
+	{"sine16", 1, 16, 0},
+	{"pass16", 2, 16, 1},
+	{"asrc16", AUDIO_MODE_ASRC, 16, 0},
+	{"saw24", 0, 24, 1},
+	{"sine24", 1, 24, 0},
+	{"pass24", 2, 24, 1},
+};
+
+#define GOLDEN_MODES (int32_t)(sizeof(golden_modes)/sizeof(golden_modes[0]))
+
+/* one ADC tone */
+typedef struct
+{
+	int64_t c, s, e;
+} golden_osc;
+
+/* measures of a render's left channel */
+typedef struct
+{
+	double level;		// fundamental in dBFS
+	double thd;			// harmonics 2 up to the fundamental, dB
+	double snr;			// fundamental to what's left, dB
+} golden_stats;
+
+/*
+ * next 24-bit sample of an ADC tone - integer math only, so it's the same
+ * on any host, and c & s stay on an ellipse so the level holds
+ */
+static int32_t golden_osc_step(golden_osc *o)
+{
+	o->c -= (o->e * o->s + (1 << 29)) >> 30;
+	o->s += (o->e * o->c + (1 << 29)) >> 30;
+
+	return (int32_t)o->s;
+}
+
+/*
+ * render - frames of stereo in 32-bit words MSB aligned, either width
+ */
+static void golden_render(const golden_mode *m, int32_t *out, int32_t frames)
+{
+	static int16_t in16[BUFSZ], out16[BUFSZ], src[SMPS*CHLS];
+	static int32_t in32[BUFSZ], out32[BUFSZ];
+	golden_osc adc[CHLS] =
+	{
+		{GOLDEN_ADC_AMP, 0, GOLDEN_ADC_E_L},
+		{GOLDEN_ADC_AMP, 0, GOLDEN_ADC_E_R},
+	};
+	uint32_t src_phs = 0;
+	int32_t i, j, v, n = 0;
+
+	core1_mode = m->mode;
+	core1_mute = 0;
+	phs = 0;
+	asrc_init(&audio_asrc, ASRC_ONE);
+
+	while(n < frames)
+	{
+		/* the ADC & the ASRC's source are ready before each block */
+		for(i=0;i<SMPS;i++)
+		{
+			for(j=0;j<CHLS;j++)
+			{
+				v = golden_osc_step(&adc[j]);
+				in16[2*i+j] = v >> 8;
+				in32[2*i+j] = v * 256;
+			}
+			src[2*i] = sine_interp(src_phs);
+			src[2*i+1] = -src[2*i];
+			src_phs += frq;
+		}
+		if(m->mode == AUDIO_MODE_ASRC)
+			asrc_write(&audio_asrc, src, SMPS);
+
+		if(m->bits == 16)
+		{
+			Audio_Proc(out16, in16, BUFSZ);
+			for(j=0;j<BUFSZ;j++)
+				out32[j] = out16[j] << 16;
+		}
+		else
+			Audio_Proc32(out32, in32, BUFSZ);
+
+		/* 24-bit goes out as its top 24 bits */
+		for(i=0;(i<SMPS)&&(n<frames);i++,n++)
+			for(j=0;j<CHLS;j++)
+				out[2*n+j] = m->bits == 16 ? out32[2*i+j] :
+					(int32_t)(out32[2*i+j] & 0xFFFFFF00);
+	}
+}
+
+static void golden_put16(FILE *f, uint32_t v)
+{
+	fputc(v, f);
+	fputc(v >> 8, f);
+}
+
+static void golden_put32(FILE *f, uint32_t v)
+{
+	golden_put16(f, v);
+	golden_put16(f, v >> 16);
+}
+
+/*
+ * write a stereo PCM WAV - samples MSB aligned in 32 bits. Returns 0 if
+ * ok.
+ */
+static int32_t golden_write(const char *path, const int32_t *x,
+	int32_t frames, uint8_t bits)
+{
+	uint32_t bytes = bits / 8, data = frames * CHLS * bytes, k;
+	int32_t i;
+	FILE *f = fopen(path, "wb");
+
+	if(!f)
+		return 1;
+	fwrite("RIFF", 1, 4, f);
+	golden_put32(f, 36 + data);
+	fwrite("WAVEfmt ", 1, 8, f);
+	golden_put32(f, 16);
+	golden_put16(f, 1);							// PCM
+	golden_put16(f, CHLS);
+	golden_put32(f, I2S_FS_DEFAULT);
+	golden_put32(f, I2S_FS_DEFAULT * CHLS * bytes);
+	golden_put16(f, CHLS * bytes);
+	golden_put16(f, bits);
+	fwrite("data", 1, 4, f);
+	golden_put32(f, data);
+	for(i=0;i<frames*CHLS;i++)
+		for(k=0;k<bytes;k++)
+			fputc((uint32_t)x[i] >> (32 - 8 * (bytes - k)), f);
+
+	return fclose(f) ? 1 : 0;
+}
+
+static uint32_t golden_get(const uint8_t *p, uint32_t n)
+{
+	uint32_t v = 0;
+
+	while(n--)
+		v = (v << 8) | p[n];
+
+	return v;
+}
+
+/*
+ * read a stereo PCM WAV written as above into x - returns the frames, or
+ * -1 if it isn't one at the rate & width expected
+ */
+static int32_t golden_read(const char *path, int32_t *x, int32_t max,
+	uint8_t bits)
+{
+	uint8_t hdr[8], fmt[16];
+	uint32_t len, bytes = bits / 8, k;
+	int32_t i, n = -1;
+	uint8_t s[4];
+	FILE *f = fopen(path, "rb");
+
+	if(!f)
+		return -1;
+	if((fread(hdr, 1, 8, f) != 8) || memcmp(hdr, "RIFF", 4) ||
+		(fread(hdr, 1, 4, f) != 4) || memcmp(hdr, "WAVE", 4))
+		goto done;
+
+	/* chunks up to the data */
+	while(fread(hdr, 1, 8, f) == 8)
+	{
+		len = golden_get(hdr + 4, 4);
+		if(!memcmp(hdr, "fmt ", 4))
+		{
+			if((len < 16) || (fread(fmt, 1, 16, f) != 16) ||
+				(golden_get(fmt, 2) != 1) || (golden_get(fmt + 2, 2) != CHLS) ||
+				(golden_get(fmt + 4, 4) != I2S_FS_DEFAULT) ||
+				(golden_get(fmt + 14, 2) != bits))
+				goto done;
+			fseek(f, len - 16 + (len & 1), SEEK_CUR);
+		}
+		else if(!memcmp(hdr, "data", 4))
+		{
+			n = len / (CHLS * bytes);
+			if(n > max)
+				n = max;
+			for(i=0;i<n*CHLS;i++)
+			{
+				if(fread(s, 1, bytes, f) != bytes)
+				{
+					n = -1;
+					goto done;
+				}
+				for(x[i]=0,k=0;k<bytes;k++)
+					x[i] |= (uint32_t)s[k] << (32 - 8 * (bytes - k));
+			}
+			goto done;
+		}
+		else
+			fseek(f, len + (len & 1), SEEK_CUR);
+	}
+
+done:
+	fclose(f);
+	return n;
+}
+
+/*
+ * fit DC & GOLDEN_HARMS harmonics of f0 to the left channel past the skip
+ * by least squares - normal equations solved by Gauss-Jordan
+ */
+static void golden_analyse(const int32_t *x, int32_t frames, double f0,
+	golden_stats *st)
+{
+	static double m[GOLDEN_TERMS][GOLDEN_TERMS+1];
+	double g[GOLDEN_TERMS], c[GOLDEN_TERMS], y, e, t, w = 2 * M_PI * f0 / I2S_FS_DEFAULT;
+	double fund, harm = 0, res = 0;
+	int32_t i, j, k, r, skip = GOLDEN_SKIP_S * I2S_FS_DEFAULT;
+
+	memset(m, 0, sizeof(m));
+	for(i=skip;i<frames;i++)
+	{
+		y = x[2*i] / 2147483648.0;
+		g[0] = 1.0;
+		for(j=0;j<GOLDEN_HARMS;j++)
+		{
+			g[2*j+1] = cos(w * (j + 1) * i);
+			g[2*j+2] = sin(w * (j + 1) * i);
+		}
+		for(j=0;j<GOLDEN_TERMS;j++)
+		{
+			for(k=0;k<GOLDEN_TERMS;k++)
+				m[j][k] += g[j] * g[k];
+			m[j][GOLDEN_TERMS] += g[j] * y;
+		}
+	}
+
+	for(j=0;j<GOLDEN_TERMS;j++)
+	{
+		for(r=j+1;r<GOLDEN_TERMS;r++)
+			if(fabs(m[r][j]) > fabs(m[j][j]))
+				for(k=0;k<=GOLDEN_TERMS;k++)
+				{
+					t = m[j][k];
+					m[j][k] = m[r][k];
+					m[r][k] = t;
+				}
+		for(r=0;r<GOLDEN_TERMS;r++)
+			if(r != j)
+				for(k=GOLDEN_TERMS;k>=j;k--)
+					m[r][k] -= m[r][j] / m[j][j] * m[j][k];
+	}
+	for(j=0;j<GOLDEN_TERMS;j++)
+		c[j] = m[j][GOLDEN_TERMS] / m[j][j];
+
+	/* powers of each part & of what the fit leaves */
+	fund = (c[1] * c[1] + c[2] * c[2]) / 2;
+	for(j=1;j<GOLDEN_HARMS;j++)
+		harm += (c[2*j+1] * c[2*j+1] + c[2*j+2] * c[2*j+2]) / 2;
+	for(i=skip;i<frames;i++)
+	{
+		e = x[2*i] / 2147483648.0 - c[0];
+		for(j=0;j<GOLDEN_HARMS;j++)
+			e -= c[2*j+1] * cos(w * (j + 1) * i) + c[2*j+2] * sin(w * (j + 1) * i);
+		res += e * e;
+	}
+	res /= frames - skip;
+
+	st->level = 10 * log10(fund * 2);
+	st->thd = 10 * log10((harm + 1e-30) / fund);
+	st->snr = 10 * log10(fund / (res + 1e-30));
+}
+
+int main(int argc, char **argv)
+{
+	static int32_t out[GOLDEN_SECONDS_MAX*I2S_FS_DEFAULT*CHLS];
+	static int32_t ref[GOLDEN_SECONDS_MAX*I2S_FS_DEFAULT*CHLS];
+	const char *dir = GOLDEN_DIR;
+	double secs = GOLDEN_SECONDS, f0;
+	int32_t i, j, n, frames, diffs, worst, d, fail = 0, write = 0, bad;
+	golden_stats st, gst;
+	char path[512];
+
+	for(i=1;i<argc;i++)
+		if(!strcmp(argv[i], "-w"))
+			write = 1;
+		else if(!strcmp(argv[i], "-s") && (i + 1 < argc))
+			secs = atof(argv[++i]);
+		else
+			dir = argv[i];
+	if((secs <= GOLDEN_SKIP_S) || (secs > GOLDEN_SECONDS_MAX))
+	{
+		printf("render length must be over %.2f s & up to %u s\n",
+			GOLDEN_SKIP_S, GOLDEN_SECONDS_MAX);
+		return 1;
+	}
+	frames = secs * I2S_FS_DEFAULT;
+
+	/* kernel state as the firmware starts it, at the default rate */
+	Fsample = I2S_FS_DEFAULT;
+	Audio_Init();
+
+	printf("%.2f s of each mode at %u Hz against %s\n", secs, I2S_FS_DEFAULT, dir);
+	printf("%-8s %6s %9s %8s %8s  %s\n", "mode", "check", "level dB", "THD dB",
+		"SNR dB", "golden");
+	for(i=0;i<GOLDEN_MODES;i++)
+	{
+		const golden_mode *m = &golden_modes[i];
+
+		golden_render(m, out, frames);
+		f0 = m->mode == 2 ? GOLDEN_ADC_HZ_L :
+			(double)(uint32_t)frq * I2S_FS_DEFAULT / 4294967296.0;
+		golden_analyse(out, frames, f0, &st);
+		printf("%-8s %6s %9.3f %8.2f %8.2f  ", m->name, m->exact ? "exact" :
+			"tol", st.level, st.thd, st.snr);
+
+		/* the render, & the golden with -w */
+		snprintf(path, sizeof(path), "%s.wav", m->name);
+		bad = golden_write(path, out, frames, m->bits);
+		if(write)
+		{
+			snprintf(path, sizeof(path), "%s/%s.wav", dir, m->name);
+			bad |= golden_write(path, out, frames, m->bits);
+			printf("%s\n", bad ? "can't write" : "written");
+			fail |= bad;
+			continue;
+		}
+		if(bad)
+		{
+			printf("can't write %s\n", path);
+			fail = 1;
+			continue;
+		}
+
+		snprintf(path, sizeof(path), "%s/%s.wav", dir, m->name);
+		n = golden_read(path, ref, frames, m->bits);
+		if(n < 0)
+		{
+			printf("FAIL - no golden %s\n", path);
+			fail = 1;
+			continue;
+		}
+
+		/* a short golden would leave the end of the render unchecked */
+		if(n < frames)
+		{
+			printf("FAIL - golden has %d of %d frames\n", n, frames);
+			fail = 1;
+			continue;
+		}
+
+		for(diffs=0,worst=0,j=0;j<frames*CHLS;j++)
+		{
+			d = (out[j] >> (32 - m->bits)) - (ref[j] >> (32 - m->bits));
+			diffs += d != 0;
+			worst = abs(d) > worst ? abs(d) : worst;
+		}
+		if(m->exact)
+			bad = diffs != 0;
+		else
+		{
+			golden_analyse(ref, frames, f0, &gst);
+			bad = ((worst >> (m->bits - 16)) > GOLDEN_TOL_LSB) ||
+				(fabs(st.level - gst.level) > GOLDEN_TOL_LEVEL) ||
+				(st.thd > gst.thd + GOLDEN_TOL_THD) ||
+				(st.snr < gst.snr - GOLDEN_TOL_SNR);
+		}
+		printf("%s - %d of %d samples differ, worst %d LSB\n", bad ? "FAIL" : "ok",
+			diffs, frames * CHLS, worst);
+		fail |= bad;
+	}
+
+	printf(fail ? "FAILED\n" : "PASSED\n");
+	return fail;
+}
+
+/*
+ * main.c's - the codec sequencer's delays
+ */
+void my_sleep_ms(uint64_t ms)
+{
+	sleep_ms(ms);
+}
@@ -0,0 +1,109 @@
+/*
+ * plancheck.c - the measurement plans on the host build
+ *
+ * Linked into rp2040_i2s_plan, which builds main.c with PLAN_AUTORUN so
+ * every plan runs in turn from power up over the simulated DO to DI loop.
+ * The run ends PLANCHECK_LINGER_PS after the last plan stops, once its
+ * table is out, or when RP2040_SIM_SECONDS is up if that's sooner. It
+ * passes if they all finished with a result for every row, each tone
+ * down to PLANCHECK_MIN read back within PLANCHECK_DB of its set level,
+ * and what isn't the tone stayed under PLANCHECK_FLOOR from full scale -
+ * the loop is lossless, so that's 16-bit quantisation. A row after a
+ * codec register write is expected to move by the DAC volume the codec's
+ * model gives that write, which the sim puts on the loop.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include "plan.h"
+#include "sim.h"
+
+/* tone error & noise floor in 1/100 dB, lowest level checked in 1/256 dB */
+#define PLANCHECK_DB 50
+#define PLANCHECK_FLOOR -9000
+#define PLANCHECK_MIN (-60 * 256)
+
+/* simulated time from the last plan stopping to the end of the run */
+#define PLANCHECK_LINGER_PS 500000000000ULL
+
+/* a codec register write that mutes the loop */
+#define PLANCHECK_MUTED INT32_MIN
+
+/*
+ * the level a codec register write moves the loop by, in 1/100 dB - on a
+ * model of its own so as not to touch the sim's
+ */
+static int32_t plancheck_reg_db(uint16_t reg, uint16_t val)
+{
+	codec_model m;
+
+	if(reg == PLAN_NO_REG)
+		return 0;
+	codec_model_init(&m, sim_codec()->desc);
+	codec_model_write(&m, reg, val);
+	if(!m.dac_gain)
+		return PLANCHECK_MUTED;
+
+	return lround(2000.0 * log10(m.dac_gain / 65536.0));
+}
+
+/*
+ * the run's over once the last plan has stopped & had time to report
+ */
+bool sim_soak_done(void)
+{
+	static uint64_t stopped_ps;
+	uint8_t st = plan_state();
+
+	if((st == PLAN_FAILED) || ((st == PLAN_DONE) &&
+		!strcmp(plan_name(), plans[plans_num-1].name)))
+	{
+		if(!stopped_ps)
+			stopped_ps = sim_time_ps();
+		return sim_time_ps() - stopped_ps >= PLANCHECK_LINGER_PS;
+	}
+	stopped_ps = 0;
+
+	return false;
+}
+
+/*
+ * pass or fail the run
+ */
+int sim_soak_check(void)
+{
+	const plan_row *r;
+	uint32_t i, n, bad = 0;
+	int32_t set, reg_db;
+	int fail;
+
+	n = plan_rows(&r);
+	for(i=0;i<n;i++,r++)
+	{
+		if(!r->ok || (r->tone + r->thdn > PLANCHECK_FLOOR))
+		{
+			bad++;
+			continue;
+		}
+
+		/* a codec register write moves the level by what it sets */
+		reg_db = plancheck_reg_db(r->reg, r->val);
+		if(reg_db == PLANCHECK_MUTED)
+			continue;
+		set = (r->db * 100) / 256 + reg_db;
+		if((set >= (PLANCHECK_MIN * 100) / 256) &&
+			(abs(r->tone - set) > PLANCHECK_DB))
+			bad++;
+	}
+
+	fail = (plan_state() != PLAN_DONE) || strcmp(plan_name(),
+		plans[plans_num-1].name) || !n || bad;
+	printf("plan: %s - %s %s, %u rows, %u bad\n", fail ? "FAIL" : "pass",
+		plan_name(), (plan_state() == PLAN_DONE) ? "done" : "not done", n,
+		bad);
+
+	return fail;
+}
@@ -0,0 +1,38 @@
+/*
+ * hardware/clocks.h - host shim of the Pico SDK, see host/sim.c
+ */
+
+#ifndef __sim_hardware_clocks__
+#define __sim_hardware_clocks__
+
+#include "pico/stdlib.h"
+
+enum clock_index
+{
+	clk_gpout0 = 0,
+	clk_gpout1,
+	clk_gpout2,
+	clk_gpout3,
+	clk_ref,
+	clk_sys,
+	clk_peri,
+	clk_usb,
+	clk_adc,
+	clk_rtc,
+	CLK_COUNT
+};
+
+#define CLOCKS_CLK_GPOUT1_CTRL_AUXSRC_VALUE_CLK_SYS 0x6
+#define CLOCKS_CLK_SYS_CTRL_SRC_VALUE_CLK_REF 0x0
+#define CLOCKS_CLK_SYS_CTRL_SRC_VALUE_CLKSRC_CLK_SYS_AUX 0x1
+#define CLOCKS_CLK_SYS_CTRL_AUXSRC_VALUE_CLKSRC_PLL_SYS 0x0
+#define CLOCKS_CLK_SYS_CTRL_AUXSRC_VALUE_CLKSRC_PLL_USB 0x1
+#define CLOCKS_CLK_PERI_CTRL_AUXSRC_VALUE_CLK_SYS 0x0
+#define CLOCKS_CLK_PERI_CTRL_AUXSRC_VALUE_CLKSRC_PLL_USB 0x2
+
+uint32_t clock_get_hz(enum clock_index clk_index);
+bool clock_configure(enum clock_index clk_index, uint32_t src, uint32_t auxsrc,
+	uint32_t src_freq, uint32_t freq);
+void clock_gpio_init(uint gpio, uint src, float div);
+
+#endif
@@ -0,0 +1,95 @@
+/*
+ * hardware/dma.h - host shim of the Pico SDK, see host/sim.c
+ */
+
+#ifndef __sim_hardware_dma__
+#define __sim_hardware_dma__
+
+#include "pico/stdlib.h"
+
+#define NUM_DMA_CHANNELS 12
+
+/* pacing - PIO DREQs are 0-15, unpaced is DREQ_FORCE */
+#define DREQ_PIO0_TX0 0
+#define DREQ_PIO0_RX0 4
+#define DREQ_PIO1_TX0 8
+#define DREQ_PIO1_RX0 12
+#define DREQ_FORCE 0x3f
+
+#define DMA_SNIFF_CTRL_CALC_VALUE_CRC32 0x0
+#define DMA_SNIFF_CTRL_CALC_VALUE_CRC32R 0x1
+#define DMA_SNIFF_CTRL_CALC_VALUE_SUM 0xf
+
+enum dma_channel_transfer_size
+{
+	DMA_SIZE_8 = 0,
+	DMA_SIZE_16 = 1,
+	DMA_SIZE_32 = 2
+};
+
+typedef struct
+{
+	bool read_inc, write_inc, sniff;
+	uint8_t dreq, size, chain_to;
+} dma_channel_config;
+
+int dma_claim_unused_channel(bool required);
+void dma_channel_unclaim(uint channel);
+dma_channel_config dma_channel_get_default_config(uint channel);
+
+static inline void channel_config_set_read_increment(dma_channel_config *c, bool incr)
+{
+	c->read_inc = incr;
+}
+
+static inline void channel_config_set_write_increment(dma_channel_config *c, bool incr)
+{
+	c->write_inc = incr;
+}
+
+static inline void channel_config_set_dreq(dma_channel_config *c, uint dreq)
+{
+	c->dreq = (uint8_t)dreq;
+}
+
+static inline void channel_config_set_transfer_data_size(dma_channel_config *c,
+	enum dma_channel_transfer_size size)
+{
+	c->size = (uint8_t)size;
+}
+
+static inline void channel_config_set_sniff_enable(dma_channel_config *c, bool sniff_enable)
+{
+	c->sniff = sniff_enable;
+}
+
+static inline void channel_config_set_chain_to(dma_channel_config *c, uint chain_to)
+{
+	c->chain_to = (uint8_t)chain_to;
+}
+
+void dma_channel_configure(uint channel, const dma_channel_config *config,
+	volatile void *write_addr, const volatile void *read_addr,
+	uint transfer_count, bool trigger);
+void dma_channel_set_read_addr(uint channel, const volatile void *read_addr, bool trigger);
+void dma_channel_set_write_addr(uint channel, volatile void *write_addr, bool trigger);
+void dma_channel_set_trans_count(uint channel, uint32_t trans_count, bool trigger);
+void dma_channel_start(uint channel);
+void dma_channel_abort(uint channel);
+bool dma_channel_is_busy(uint channel);
+void dma_channel_wait_for_finish_blocking(uint channel);
+
+void dma_channel_set_irq0_enabled(uint channel, bool enabled);
+void dma_channel_set_irq1_enabled(uint channel, bool enabled);
+bool dma_channel_get_irq0_status(uint channel);
+bool dma_channel_get_irq1_status(uint channel);
+void dma_channel_acknowledge_irq0(uint channel);
+void dma_channel_acknowledge_irq1(uint channel);
+
+void dma_sniffer_enable(uint channel, uint mode, bool force_channel_enable);
+void dma_sniffer_disable(void);
+void dma_sniffer_set_byte_swap_enabled(bool swap);
+void dma_sniffer_set_data_accumulator(uint32_t seed_value);
+uint32_t dma_sniffer_get_data_accumulator(void);
+
+#endif
@@ -0,0 +1,23 @@
+/*
+ * hardware/i2c.h - host shim of the Pico SDK, see host/sim.c
+ */
+
+#ifndef __sim_hardware_i2c__
+#define __sim_hardware_i2c__
+
+#include "pico/stdlib.h"
+
+typedef struct i2c_inst i2c_inst_t;
+extern i2c_inst_t *const i2c0_inst, *const i2c1_inst;
+#define i2c0 i2c0_inst
+#define i2c1 i2c1_inst
+
+uint i2c_init(i2c_inst_t *i2c, uint baudrate);
+void i2c_deinit(i2c_inst_t *i2c);
+uint i2c_set_baudrate(i2c_inst_t *i2c, uint baudrate);
+int i2c_write_timeout_us(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src,
+	size_t len, bool nostop, uint timeout_us);
+int i2c_read_timeout_us(i2c_inst_t *i2c, uint8_t addr, uint8_t *dst,
+	size_t len, bool nostop, uint timeout_us);
+
+#endif
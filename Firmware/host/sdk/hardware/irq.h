@@ -0,0 +1,22 @@
+/*
+ * hardware/irq.h - host shim of the Pico SDK, see host/sim.c
+ */
+
+#ifndef __sim_hardware_irq__
+#define __sim_hardware_irq__
+
+#include "pico/stdlib.h"
+
+typedef void (*irq_handler_t)(void);
+
+/* just the lines the simulation raises */
+enum
+{
+	DMA_IRQ_0 = 11,
+	DMA_IRQ_1 = 12,
+};
+
+void irq_set_exclusive_handler(uint num, irq_handler_t handler);
+void irq_set_enabled(uint num, bool enabled);
+
+#endif
@@ -0,0 +1,207 @@
+/*
+ * hardware/pio.h - host shim of the Pico SDK, see host/sim.c
+ *
+ * State machines aren't run an instruction at a time - host/sim.c knows
+ * the programs in i2s_fulldup.pio and moves a FIFO word per slot instead.
+ */
+
+#ifndef __sim_hardware_pio__
+#define __sim_hardware_pio__
+
+#include "pico/stdlib.h"
+#include "hardware/gpio.h"
+
+#define NUM_PIOS 2
+#define NUM_PIO_STATE_MACHINES 4
+#define PIO_INSTRUCTION_COUNT 32
+
+/* just the FIFO registers, so DMA has something to point at */
+typedef struct
+{
+	volatile uint32_t txf[NUM_PIO_STATE_MACHINES];
+	volatile uint32_t rxf[NUM_PIO_STATE_MACHINES];
+} pio_hw_t;
+
+typedef pio_hw_t *PIO;
+extern pio_hw_t sim_pio_hw[NUM_PIOS];
+#define pio0_hw (&sim_pio_hw[0])
+#define pio1_hw (&sim_pio_hw[1])
+#define pio0 pio0_hw
+#define pio1 pio1_hw
+
+typedef struct pio_program
+{
+	const uint16_t *instructions;
+	uint8_t length;
+	int8_t origin;
+	uint8_t pio_version;
+} pio_program_t;
+
+enum pio_fifo_join
+{
+	PIO_FIFO_JOIN_NONE = 0,
+	PIO_FIFO_JOIN_TX = 1,
+	PIO_FIFO_JOIN_RX = 2,
+};
+
+typedef struct
+{
+	uint16_t clkdiv_int;
+	uint8_t clkdiv_frac;
+	uint8_t wrap_target, wrap;
+	uint8_t out_base, out_count, set_base, set_count, in_base;
+	uint8_t sideset_base, sideset_bits, jmp_pin;
+	bool sideset_optional, sideset_pindirs;
+	bool in_right, autopush, out_right, autopull;
+	uint8_t push_threshold, pull_threshold;
+	uint8_t fifo_join;
+} pio_sm_config;
+
+static inline pio_sm_config pio_get_default_sm_config(void)
+{
+	pio_sm_config c = {0};
+	
+	c.clkdiv_int = 1;
+	c.wrap = PIO_INSTRUCTION_COUNT - 1;
+	c.in_right = c.out_right = true;
+	c.push_threshold = c.pull_threshold = 32;
+	return c;
+}
+
+static inline void sm_config_set_out_pins(pio_sm_config *c, uint out_base, uint out_count)
+{
+	c->out_base = (uint8_t)out_base;
+	c->out_count = (uint8_t)out_count;
+}
+
+static inline void sm_config_set_set_pins(pio_sm_config *c, uint set_base, uint set_count)
+{
+	c->set_base = (uint8_t)set_base;
+	c->set_count = (uint8_t)set_count;
+}
+
+static inline void sm_config_set_in_pins(pio_sm_config *c, uint in_base)
+{
+	c->in_base = (uint8_t)in_base;
+}
+
+static inline void sm_config_set_sideset_pins(pio_sm_config *c, uint sideset_base)
+{
+	c->sideset_base = (uint8_t)sideset_base;
+}
+
+static inline void sm_config_set_sideset(pio_sm_config *c, uint bit_count,
+	bool optional, bool pindirs)
+{
+	c->sideset_bits = (uint8_t)bit_count;
+	c->sideset_optional = optional;
+	c->sideset_pindirs = pindirs;
+}
+
+static inline void sm_config_set_clkdiv_int_frac(pio_sm_config *c, uint16_t div_int,
+	uint8_t div_frac)
+{
+	c->clkdiv_int = div_int;
+	c->clkdiv_frac = div_frac;
+}
+
+static inline void sm_config_set_wrap(pio_sm_config *c, uint wrap_target, uint wrap)
+{
+	c->wrap_target = (uint8_t)wrap_target;
+	c->wrap = (uint8_t)wrap;
+}
+
+static inline void sm_config_set_jmp_pin(pio_sm_config *c, uint pin)
+{
+	c->jmp_pin = (uint8_t)pin;
+}
+
+static inline void sm_config_set_in_shift(pio_sm_config *c, bool shift_right,
+	bool autopush, uint push_threshold)
+{
+	c->in_right = shift_right;
+	c->autopush = autopush;
+	c->push_threshold = (uint8_t)push_threshold;
+}
+
+static inline void sm_config_set_out_shift(pio_sm_config *c, bool shift_right,
+	bool autopull, uint pull_threshold)
+{
+	c->out_right = shift_right;
+	c->autopull = autopull;
+	c->pull_threshold = (uint8_t)pull_threshold;
+}
+
+static inline void sm_config_set_fifo_join(pio_sm_config *c, enum pio_fifo_join join)
+{
+	c->fifo_join = (uint8_t)join;
+}
+
+/* instruction encoding - only what the init code execs */
+enum pio_src_dest
+{
+	pio_pins = 0,
+	pio_x = 1,
+	pio_y = 2,
+	pio_null = 3,
+	pio_pindirs = 4,
+	pio_exec_mov = 4,
+	pio_status = 5,
+	pio_pc = 5,
+	pio_isr = 6,
+	pio_osr = 7,
+	pio_exec_out = 7,
+};
+
+static inline uint pio_encode_jmp(uint addr)
+{
+	return addr & 0x1f;
+}
+
+static inline uint pio_encode_pull(bool if_empty, bool block)
+{
+	return 0x8080 | (if_empty ? 0x40 : 0) | (block ? 0x20 : 0);
+}
+
+static inline uint pio_encode_mov(enum pio_src_dest dest, enum pio_src_dest src)
+{
+	return 0xa000 | ((dest & 7) << 5) | (src & 7);
+}
+
+static inline uint pio_encode_out(enum pio_src_dest dest, uint count)
+{
+	return 0x6000 | ((dest & 7) << 5) | (count & 0x1f);
+}
+
+uint pio_add_program(PIO pio, const pio_program_t *program);
+bool pio_can_add_program(PIO pio, const pio_program_t *program);
+void pio_remove_program(PIO pio, const pio_program_t *program, uint loaded_offset);
+int pio_claim_unused_sm(PIO pio, bool required);
+void pio_sm_unclaim(PIO pio, uint sm);
+void pio_gpio_init(PIO pio, uint pin);
+uint pio_get_dreq(PIO pio, uint sm, bool is_tx);
+
+int pio_sm_init(PIO pio, uint sm, uint initial_pc, const pio_sm_config *config);
+void pio_sm_set_config(PIO pio, uint sm, const pio_sm_config *config);
+void pio_sm_set_enabled(PIO pio, uint sm, bool enabled);
+void pio_set_sm_mask_enabled(PIO pio, uint32_t mask, bool enabled);
+void pio_enable_sm_mask_in_sync(PIO pio, uint32_t mask);
+void pio_sm_restart(PIO pio, uint sm);
+void pio_sm_set_clkdiv_int_frac(PIO pio, uint sm, uint16_t div_int, uint8_t div_frac);
+void pio_sm_set_pins(PIO pio, uint sm, uint32_t pin_values);
+void pio_sm_set_pindirs_with_mask(PIO pio, uint sm, uint32_t pin_dirs, uint32_t pin_mask);
+void pio_sm_exec(PIO pio, uint sm, uint instr);
+uint8_t pio_sm_get_pc(PIO pio, uint sm);
+
+void pio_sm_clear_fifos(PIO pio, uint sm);
+void pio_sm_put(PIO pio, uint sm, uint32_t data);
+uint32_t pio_sm_get(PIO pio, uint sm);
+uint pio_sm_get_rx_fifo_level(PIO pio, uint sm);
+uint pio_sm_get_tx_fifo_level(PIO pio, uint sm);
+
+static inline bool pio_sm_is_rx_fifo_empty(PIO pio, uint sm)
+{
+	return !pio_sm_get_rx_fifo_level(pio, sm);
+}
+
+#endif
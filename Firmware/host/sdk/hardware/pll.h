@@ -0,0 +1,20 @@
+/*
+ * hardware/pll.h - host shim of the Pico SDK, see host/sim.c
+ */
+
+#ifndef __sim_hardware_pll__
+#define __sim_hardware_pll__
+
+#include "pico/stdlib.h"
+
+typedef struct pll_hw pll_hw_t;
+typedef pll_hw_t *PLL;
+extern pll_hw_t *const pll_sys_hw, *const pll_usb_hw;
+#define pll_sys pll_sys_hw
+#define pll_usb pll_usb_hw
+
+void pll_init(PLL pll, uint ref_div, uint vco_freq, uint post_div1,
+	uint post_div2);
+void pll_deinit(PLL pll);
+
+#endif
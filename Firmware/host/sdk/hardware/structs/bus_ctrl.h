@@ -0,0 +1,26 @@
+/*
+ * hardware/structs/bus_ctrl.h - host shim of the Pico SDK, see host/sim.c
+ *
+ * One bus with no arbitration, so the priority register is only stored.
+ */
+
+#ifndef __sim_hardware_structs_bus_ctrl__
+#define __sim_hardware_structs_bus_ctrl__
+
+#include "pico/stdlib.h"
+
+#define BUSCTRL_BUS_PRIORITY_PROC0_BITS 0x00000001
+#define BUSCTRL_BUS_PRIORITY_PROC1_BITS 0x00000010
+#define BUSCTRL_BUS_PRIORITY_DMA_R_BITS 0x00000100
+#define BUSCTRL_BUS_PRIORITY_DMA_W_BITS 0x00001000
+
+typedef struct
+{
+	volatile uint32_t priority;
+	volatile uint32_t priority_ack;
+} bus_ctrl_hw_t;
+
+extern bus_ctrl_hw_t sim_bus_ctrl_hw;
+#define bus_ctrl_hw (&sim_bus_ctrl_hw)
+
+#endif
@@ -0,0 +1,10 @@
+/*
+ * hardware/structs/clocks.h - host shim of the Pico SDK, see host/sim.c
+ */
+
+#ifndef __sim_hardware_structs_clocks__
+#define __sim_hardware_structs_clocks__
+
+#include "hardware/clocks.h"
+
+#endif
@@ -0,0 +1,14 @@
+/*
+ * hardware/sync.h - host shim of the Pico SDK, see host/sim.c
+ */
+
+#ifndef __sim_hardware_sync__
+#define __sim_hardware_sync__
+
+#include "pico/stdlib.h"
+
+/* holds off the calling core's interrupts - nests */
+uint32_t save_and_disable_interrupts(void);
+void restore_interrupts(uint32_t status);
+
+#endif
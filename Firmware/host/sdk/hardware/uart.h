@@ -0,0 +1,46 @@
+/*
+ * hardware/uart.h - host shim of the Pico SDK, see host/sim.c
+ *
+ * The console is the host's stdout, so UART0 only keeps its rate. UART1's
+ * TX FIFO drains at its baud rate, paces DMA & goes to a file.
+ */
+
+#ifndef __sim_hardware_uart__
+#define __sim_hardware_uart__
+
+#include "pico/stdlib.h"
+
+/* DMA pacing, by the DMA's DREQ numbers */
+#define DREQ_UART0_TX 20
+#define DREQ_UART0_RX 21
+#define DREQ_UART1_TX 22
+#define DREQ_UART1_RX 23
+
+/* just the data register, so DMA has something to point at */
+typedef struct
+{
+	volatile uint32_t dr;
+} uart_hw_t;
+
+typedef struct uart_inst uart_inst_t;
+extern uart_inst_t *const uart0_inst, *const uart1_inst;
+extern uart_hw_t sim_uart_hw[2];
+#define uart0 uart0_inst
+#define uart1 uart1_inst
+#define uart_default uart0
+
+uint uart_init(uart_inst_t *uart, uint baudrate);
+uint uart_set_baudrate(uart_inst_t *uart, uint baudrate);
+uint uart_get_index(uart_inst_t *uart);
+
+static inline uart_hw_t *uart_get_hw(uart_inst_t *uart)
+{
+	return &sim_uart_hw[uart_get_index(uart)];
+}
+
+static inline uint uart_get_dreq(uart_inst_t *uart, bool is_tx)
+{
+	return DREQ_UART0_TX + uart_get_index(uart) * 2 + !is_tx;
+}
+
+#endif
@@ -0,0 +1,10 @@
+/*
+ * pico/binary_info.h - host shim of the Pico SDK, see host/sim.c
+ */
+
+#ifndef __sim_pico_binary_info__
+#define __sim_pico_binary_info__
+
+#define bi_decl(...)
+
+#endif
@@ -0,0 +1,15 @@
+/*
+ * pico/multicore.h - host shim of the Pico SDK, see host/sim.c
+ */
+
+#ifndef __sim_pico_multicore__
+#define __sim_pico_multicore__
+
+#include "pico/stdlib.h"
+
+void multicore_launch_core1(void (*entry)(void));
+void multicore_lockout_victim_init(void);
+bool multicore_lockout_start_timeout_us(uint64_t timeout_us);
+bool multicore_lockout_end_timeout_us(uint64_t timeout_us);
+
+#endif
@@ -0,0 +1,78 @@
+/*
+ * pico/stdlib.h - host shim of the Pico SDK, see host/sim.c
+ */
+
+#ifndef __sim_pico_stdlib__
+#define __sim_pico_stdlib__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+typedef unsigned int uint;
+
+/* placement attributes mean nothing off the chip */
+#define __not_in_flash(group)
+#define __not_in_flash_func(f) f
+#define __time_critical_func(f) f
+#define __no_inline_not_in_flash_func(f) f
+#define __scratch_x(group)
+#define __scratch_y(group)
+#define __uninitialized_ram(v) v
+#define __in_flash(group)
+
+#define count_of(a) (sizeof(a)/sizeof((a)[0]))
+#define KHZ 1000
+#define MHZ 1000000
+
+#define PICO_OK 0
+#define PICO_ERROR_GENERIC -1
+#define PICO_ERROR_TIMEOUT -2
+#define PICO_DEFAULT_UART_BAUD_RATE 115200
+
+/* the chip ID register reads a host word */
+extern uint32_t sim_sysinfo[1];
+#define SYSINFO_BASE ((uintptr_t)sim_sysinfo)
+
+#include "hardware/gpio.h"
+#include "hardware/uart.h"
+
+/* time is the simulated clock, not the host's */
+uint64_t time_us_64(void);
+uint32_t time_us_32(void);
+void sleep_us(uint64_t us);
+void sleep_ms(uint32_t ms);
+
+bool stdio_init_all(void);
+int getchar_timeout_us(uint32_t timeout_us);
+void panic(const char *fmt, ...) __attribute__((noreturn));
+uint get_core_num(void);
+
+/* lets the other core run while this one spins on it */
+void tight_loop_contents(void);
+static inline void __dmb(void) { __sync_synchronize(); }
+static inline void __compiler_memory_barrier(void) { __asm__ volatile("" ::: "memory"); }
+
+/* repeating timers run on the core that added them, like alarm IRQs */
+typedef struct repeating_timer repeating_timer_t;
+typedef bool (*repeating_timer_callback_t)(repeating_timer_t *rt);
+struct repeating_timer
+{
+	int64_t delay_us;
+	repeating_timer_callback_t callback;
+	void *user_data;
+	int alarm_id;
+};
+
+bool add_repeating_timer_us(int64_t delay_us, repeating_timer_callback_t callback,
+	void *user_data, repeating_timer_t *out);
+bool cancel_repeating_timer(repeating_timer_t *timer);
+
+static inline bool add_repeating_timer_ms(int32_t delay_ms,
+	repeating_timer_callback_t callback, void *user_data, repeating_timer_t *out)
+{
+	return add_repeating_timer_us(delay_ms * (int64_t)1000, callback, user_data, out);
+}
+
+#endif
@@ -0,0 +1,19 @@
+/*
+ * pico/unique_id.h - host shim of the Pico SDK, see host/sim.c
+ */
+
+#ifndef __sim_pico_unique_id__
+#define __sim_pico_unique_id__
+
+#include "pico/stdlib.h"
+
+#define PICO_UNIQUE_BOARD_ID_SIZE_BYTES 8
+
+typedef struct
+{
+	uint8_t id[PICO_UNIQUE_BOARD_ID_SIZE_BYTES];
+} pico_unique_board_id_t;
+
+void pico_get_unique_board_id(pico_unique_board_id_t *id_out);
+
+#endif
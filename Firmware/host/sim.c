@@ -0,0 +1,2214 @@
+/*
+ * sim.c - simulated RP2040 behind the host build's SDK shim
+ *
+ * Core 0 is the main thread and core 1 a thread of its own. A hardware
+ * thread owns the simulated clock: it moves the I2S state machines on a
+ * FIFO word at a time, services DMA off their DREQs, counts LRCK windows
+ * for the rate counter and raises the DMA & timer IRQs. Handlers run on
+ * the hardware thread holding the target core's interrupt lock, which
+ * save_and_disable_interrupts() and multicore lockout take too, so a core
+ * in a critical section holds its IRQs off as on the chip.
+ *
+ * Core 0 and the clock take turns. Each time core 0 looks at the clock it
+ * waits while the hardware thread runs a quantum, or up to the end of a
+ * sleep, so its code takes no simulated time and a run comes out the same
+ * every time. Core 1 only spins in Audio_Fore() between its handlers so
+ * it's left to run on its own.
+ *
+ * The state machines aren't stepped an instruction at a time - the
+ * programs in i2s_fulldup.pio are recognised as they're loaded and DO is
+ * looped back to DI a word at a time. A slip of some bits models the ISR
+ * that far ahead of the frame, so the words come in that much late and
+ * pio_sm_get_pc() walks the loaded program to where each push now falls.
+ * pio_emu.c covers the programs themselves.
+ *
+ * The codec's control port goes to its codec_model - I2C transfers to its
+ * address & the L3 bits bit-banged on GPIO - so the drivers' own traffic
+ * is checked, taking the bus's time on the simulated clock as it goes.
+ * Other I2C addresses are plain register files. SCL runs off clk_sys as on
+ * the chip, so a bus not re-timed after a clk_sys change runs off its
+ * rate, and that fails the run too. The model's DAC volume scales what
+ * goes round the loop.
+ *
+ * Set in the environment:
+ * RP2040_SIM_SECONDS - stop after this many simulated seconds & exit with
+ *                      sim_soak_check(), or sooner if sim_soak_done() says
+ * RP2040_SIM_SPEED - simulated seconds per real second, 0 runs flat out
+ * RP2040_SIM_QUANTUM_US - how far the clock moves each time core 0 looks
+ * RP2040_SIM_UART1 - file for what UART1 sends, else it's dropped
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include "pico/stdlib.h"
+#include "pico/multicore.h"
+#include "pico/unique_id.h"
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "hardware/i2c.h"
+#include "hardware/irq.h"
+#include "hardware/pio.h"
+#include "hardware/pll.h"
+#include "hardware/structs/bus_ctrl.h"
+#include "hardware/sync.h"
+#include "hardware/uart.h"
+#include "i2s_fulldup.pio.h"
+#include "codec.h"
+#include "sim.h"
+
+#ifndef SYS_CLK_HZ
+#define SYS_CLK_HZ 125000000
+#endif
+
+#define SIM_PS_PER_US 1000000ULL
+#define SIM_NONE UINT64_MAX
+
+/* default quantum */
+#define SIM_QUANTUM_US 10000
+
+/*
+ * longest wait for a core's interrupt lock, & for core 0 to look at the
+ * clock, before the clock moves on
+ */
+#define SIM_IRQ_WAIT_NS 1000000
+#define SIM_TURN_WAIT_NS 10000000
+#define SIM_LOCKOUT_MIN_NS 100000000
+
+/* handler runs per line per step, in case one never clears its line */
+#define SIM_IRQ_RUNS 16
+
+#define SIM_IRQS 32
+#define SIM_TIMERS 8
+#define SIM_ATS 8
+#define SIM_GPIOS NUM_BANK0_GPIOS
+#define SIM_FIFO_DEPTH 8
+#define SIM_UART_FIFO 32
+
+/* UART bits per byte - start, 8 data & stop */
+#define SIM_UART_BITS 10
+
+/* I2C bits - start & stop, then 9 a byte with the address byte */
+#define SIM_I2C_BITS(n) (2 + 9 * (1 + (n)))
+
+/* the codec PMOD's L3 port, & pin 20 as a reset for codecs that have one */
+#define SIM_L3_DATA 16
+#define SIM_L3_CLK 17
+#define SIM_L3_MODE 20
+#define SIM_CODEC_RST 20
+
+/* what a loaded program is */
+enum sim_roles
+{
+	SIM_SM_OTHER,
+	SIM_SM_I2S,
+	SIM_SM_TDM,
+	SIM_SM_SLAVE,
+	SIM_SM_FSMEAS
+};
+
+static const struct
+{
+	const pio_program_t *prog;
+	uint8_t role;
+} sim_progs[] =
+{
+	{&i2s_fulldup_program, SIM_SM_I2S},
+	{&i2s_fulldup_lj_program, SIM_SM_I2S},
+	{&i2s_fulldup_dsp_a_program, SIM_SM_I2S},
+	{&i2s_fulldup_dsp_b_program, SIM_SM_I2S},
+	{&i2s_fulldup_tdm_program, SIM_SM_TDM},
+	{&i2s_fulldup_slave_program, SIM_SM_SLAVE},
+	{&i2s_fsmeas_program, SIM_SM_FSMEAS},
+};
+
+typedef struct
+{
+	bool claimed, enabled;
+	uint8_t role, offset, length, entry;
+	pio_sm_config cfg;
+	uint32_t osr, x, y;
+	uint32_t txf[SIM_FIFO_DEPTH], rxf[SIM_FIFO_DEPTH];
+	uint8_t tx_lvl, rx_lvl;
+
+	/* I2S - word n goes at t0 + n*period */
+	uint32_t frame_bits;
+	uint64_t t0_ps, n, next_ps;
+	double period_ps;
+	bool loop;
+	uint8_t slip;
+	uint64_t hist;
+
+	/* rate counter - windows of frames LRCK periods */
+	uint32_t frames;
+	uint64_t win_ps;
+	double win_frac;
+} sim_sm;
+
+typedef struct
+{
+	uint32_t used;
+	uint8_t length[PIO_INSTRUCTION_COUNT];	// of the program loaded here
+	uint16_t code[PIO_INSTRUCTION_COUNT];	// jumps relocated as loaded
+	uint8_t role[PIO_INSTRUCTION_COUNT];
+	sim_sm sm[NUM_PIO_STATE_MACHINES];
+} sim_pio;
+
+typedef struct
+{
+	bool claimed, busy;
+	dma_channel_config cfg;
+	uintptr_t read, write;
+	uint32_t count, reload;
+} sim_dma;
+
+typedef struct
+{
+	repeating_timer_t *rt;
+	uint64_t next_ps;
+	uint8_t core;
+} sim_timer;
+
+typedef struct
+{
+	void (*fn)(void);
+	uint64_t at_ps;
+} sim_at_evt;
+
+typedef struct
+{
+	uint8_t func;
+	bool dir, out, up, down;
+	int8_t drive;
+} sim_gpio;
+
+typedef struct
+{
+	uint8_t regs[256];
+	uint8_t ptr;
+	bool nak;
+	codec_model *model;		// takes the transfers in place of regs
+} sim_i2c_dev;
+
+typedef struct
+{
+	codec_model *model;
+	uint8_t sr, bits, addr;
+	bool have_addr;
+} sim_l3_port;
+
+struct uart_inst
+{
+	uint baud;
+	uint8_t idx;
+
+	/* TX FIFO - the byte at txf[tx_rd] goes out at next_ps */
+	uint8_t txf[SIM_UART_FIFO];
+	uint8_t tx_lvl, tx_rd;
+	uint64_t next_ps;
+	FILE *out;
+};
+
+struct i2c_inst
+{
+	uint baud;
+	uint32_t sys_hz;		// clk_sys the divider was set from
+	bool off_rate;			// said so once
+};
+
+struct pll_hw
+{
+	uint ref_div, vco_freq, post_div1, post_div2;
+};
+
+/* the chip */
+pio_hw_t sim_pio_hw[NUM_PIOS];
+uint32_t sim_sysinfo[1] = {0x10002927};
+bus_ctrl_hw_t sim_bus_ctrl_hw = {0, 1};
+static struct uart_inst sim_uart[2] = {{.idx = 0}, {.idx = 1}};
+static struct i2c_inst sim_i2c[2];
+static struct pll_hw sim_pll[2];
+uart_inst_t *const uart0_inst = &sim_uart[0], *const uart1_inst = &sim_uart[1];
+uart_hw_t sim_uart_hw[2];
+i2c_inst_t *const i2c0_inst = &sim_i2c[0], *const i2c1_inst = &sim_i2c[1];
+pll_hw_t *const pll_sys_hw = &sim_pll[0], *const pll_usb_hw = &sim_pll[1];
+
+static sim_pio sim_pios[NUM_PIOS];
+static sim_dma sim_dmas[NUM_DMA_CHANNELS];
+static uint32_t sim_dma_intr, sim_dma_inte[2];
+static struct
+{
+	bool on, bswap;
+	uint8_t chan, mode;
+	uint32_t acc;
+} sim_sniff;
+static uint32_t sim_clk_hz[CLK_COUNT];
+static double sim_mclk_div = 1.0;
+static sim_gpio sim_gpios[SIM_GPIOS];
+static sim_i2c_dev sim_i2c_devs[128];
+static sim_l3_port sim_l3;
+static codec_model sim_codec_m;
+static irq_handler_t sim_irq_handler[2][SIM_IRQS];
+static bool sim_irq_on[2][SIM_IRQS];
+static sim_timer sim_timers[SIM_TIMERS];
+static sim_at_evt sim_ats[SIM_ATS];
+static sim_counters sim_n;
+
+/* the simulation */
+static pthread_mutex_t sim_mtx, sim_core_irq[2];
+static pthread_t sim_hw, sim_core1;
+static __thread uint8_t sim_core;
+static __thread bool sim_is_hw, sim_is_core0;
+static __thread uint32_t sim_irqs_off;
+static pthread_mutex_t sim_turn_mtx = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sim_turn_cv = PTHREAD_COND_INITIALIZER;
+static bool sim_waiting;
+static uint64_t sim_wait_until, sim_turns;
+static bool sim_victim[2], sim_lockout[2];
+static uint64_t sim_ps, sim_end_ps = SIM_NONE, sim_quantum_ps;
+static double sim_speed;
+
+/*
+ * lock the chip state - recursive so the shim can call itself
+ */
+static void sim_lock(void)
+{
+	pthread_mutex_lock(&sim_mtx);
+}
+
+static void sim_unlock(void)
+{
+	pthread_mutex_unlock(&sim_mtx);
+}
+
+static uint64_t sim_now(void)
+{
+	return __atomic_load_n(&sim_ps, __ATOMIC_ACQUIRE);
+}
+
+/*
+ * real time in ns
+ */
+static uint64_t sim_real_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * absolute CLOCK_REALTIME ns from now, for the timed waits
+ */
+static struct timespec sim_deadline(uint64_t ns)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	ns += ts.tv_nsec;
+	ts.tv_sec += ns / 1000000000ULL;
+	ts.tv_nsec = ns % 1000000000ULL;
+	return ts;
+}
+
+/*
+ * core 0 hands the clock over until ps, or for a quantum if 0, & waits
+ * for it back
+ */
+static void sim_turn(uint64_t ps)
+{
+	uint64_t turn;
+
+	pthread_mutex_lock(&sim_turn_mtx);
+	turn = sim_turns;
+	sim_wait_until = ps;
+	sim_waiting = true;
+	pthread_cond_broadcast(&sim_turn_cv);
+	while(sim_turns == turn)
+		pthread_cond_wait(&sim_turn_cv, &sim_turn_mtx);
+	pthread_mutex_unlock(&sim_turn_mtx);
+}
+
+/*
+ * the hardware thread waits for core 0 to hand over - or to have been
+ * busy for a while - & returns how far it may run
+ */
+static uint64_t sim_turn_wait(uint64_t now)
+{
+	struct timespec ts = sim_deadline(SIM_TURN_WAIT_NS);
+	uint64_t until = now + sim_quantum_ps;
+
+	pthread_mutex_lock(&sim_turn_mtx);
+	while(!sim_waiting)
+		if(pthread_cond_timedwait(&sim_turn_cv, &sim_turn_mtx, &ts))
+			break;
+	if(sim_waiting && (sim_wait_until > now))
+		until = sim_wait_until;
+	sim_waiting = false;
+	pthread_mutex_unlock(&sim_turn_mtx);
+
+	return until;
+}
+
+/*
+ * the clock's back with core 0
+ */
+static void sim_turn_done(void)
+{
+	pthread_mutex_lock(&sim_turn_mtx);
+	sim_turns++;
+	pthread_cond_broadcast(&sim_turn_cv);
+	pthread_mutex_unlock(&sim_turn_mtx);
+}
+
+/*
+ * take a core's interrupt lock, waiting up to ns of real time - 1 if held
+ */
+static int32_t sim_core_enter(uint8_t core, uint64_t ns)
+{
+	struct timespec ts = sim_deadline(ns);
+
+	return pthread_mutex_timedlock(&sim_core_irq[core], &ts) ? 1 : 0;
+}
+
+/*
+ * ------------------------------------------------------------------------
+ * PIO
+ * ------------------------------------------------------------------------
+ */
+
+static inline sim_pio *sim_pio_of(PIO pio)
+{
+	return &sim_pios[pio - sim_pio_hw];
+}
+
+static inline sim_sm *sim_sm_of(PIO pio, uint sm)
+{
+	return &sim_pio_of(pio)->sm[sm & 3];
+}
+
+static inline bool sim_sm_is_i2s(const sim_sm *m)
+{
+	return (m->role == SIM_SM_I2S) || (m->role == SIM_SM_TDM) ||
+		(m->role == SIM_SM_SLAVE);
+}
+
+static uint8_t sim_tx_depth(const sim_sm *m)
+{
+	if(m->cfg.fifo_join == PIO_FIFO_JOIN_TX)
+		return 8;
+	return (m->cfg.fifo_join == PIO_FIFO_JOIN_RX) ? 0 : 4;
+}
+
+static uint8_t sim_rx_depth(const sim_sm *m)
+{
+	if(m->cfg.fifo_join == PIO_FIFO_JOIN_RX)
+		return 8;
+	return (m->cfg.fifo_join == PIO_FIFO_JOIN_TX) ? 0 : 4;
+}
+
+static uint32_t sim_tx_pop(sim_sm *m)
+{
+	uint32_t w = m->txf[0];
+
+	memmove(m->txf, m->txf+1, --m->tx_lvl * sizeof(uint32_t));
+	return w;
+}
+
+static uint32_t sim_rx_pop(sim_sm *m)
+{
+	uint32_t w = m->rxf[0];
+
+	memmove(m->rxf, m->rxf+1, --m->rx_lvl * sizeof(uint32_t));
+	return w;
+}
+
+/*
+ * the pin a state machine's LRCK is on
+ */
+static uint sim_sm_lrck(const sim_sm *m)
+{
+	return (m->role == SIM_SM_SLAVE) ? i2s_fulldup_slave_PIN_LRCK :
+		m->cfg.sideset_base + 1u;
+}
+
+/*
+ * clk_sys cycles per frame - the codec makes LRCK from MCLK as master
+ */
+static double sim_sm_frame_cycles(const sim_sm *m)
+{
+	if(m->role == SIM_SM_SLAVE)
+		return 256.0 * sim_mclk_div;
+	return 4.0 * m->frame_bits *
+		(m->cfg.clkdiv_int + m->cfg.clkdiv_frac / 256.0);
+}
+
+static double sim_sm_frame_ps(const sim_sm *m)
+{
+	return sim_sm_frame_cycles(m) * 1e12 / sim_clk_hz[clk_sys];
+}
+
+/*
+ * a state machine starts - the I2S ones from the top of a frame
+ */
+static void sim_sm_start(sim_sm *m)
+{
+	m->enabled = true;
+	if(sim_sm_is_i2s(m))
+	{
+		/* Y holds the loop length less the unrolled bits */
+		if(m->role == SIM_SM_TDM)
+			m->frame_bits = m->y + 2;
+		else
+			m->frame_bits = 2 * (m->y + ((m->role == SIM_SM_SLAVE) ? 1 : 2));
+		m->period_ps = sim_sm_frame_ps(m) * 32 / m->frame_bits;
+		m->t0_ps = sim_now();
+		m->n = 1;
+		m->next_ps = m->t0_ps + (uint64_t)m->period_ps;
+	}
+	else if(m->role == SIM_SM_FSMEAS)
+	{
+		m->frames = m->osr + 1;
+		m->win_ps = SIM_NONE;
+		m->win_frac = 0.0;
+	}
+}
+
+/*
+ * DMA for a DREQ - defined below
+ */
+static void sim_dma_dreq(uint8_t dreq);
+
+/*
+ * a looped word through the codec's DAC volume - 16-bit slots go two to a
+ * word, wider ones one. The codec takes no volume on a TDM bus.
+ */
+static uint32_t sim_dac_gain(const sim_sm *m, uint32_t w)
+{
+	int64_t g = sim_codec_m.dac_gain;
+
+	if((g == (1 << 16)) || (m->role == SIM_SM_TDM))
+		return w;
+	if(m->frame_bits == 32)
+		return ((uint32_t)(uint16_t)(((int16_t)(w >> 16) * g) >> 16) << 16) |
+			(uint16_t)(((int16_t)w * g) >> 16);
+	return (uint32_t)(((int32_t)w * g) >> 16);
+}
+
+/*
+ * one word slot of an I2S state machine - out of TX, back round the loop
+ * & into RX. Autopull & autopush stall it rather than lose a word.
+ */
+static void sim_sm_word(sim_pio *p, uint8_t sm)
+{
+	sim_sm *m = &p->sm[sm];
+	uint8_t dreq = ((p == sim_pios) ? DREQ_PIO0_TX0 : DREQ_PIO1_TX0) + sm;
+	uint32_t w;
+
+	if(!m->tx_lvl || (m->rx_lvl >= sim_rx_depth(m)))
+		sim_n.stalls++;
+	else
+	{
+		m->hist = (m->hist << 32) | sim_tx_pop(m);
+		if(m->loop)
+			w = sim_dac_gain(m, (uint32_t)(m->hist >> m->slip));
+		else
+			w = gpio_get(m->cfg.in_base) ? 0xFFFFFFFF : 0;
+		m->rxf[m->rx_lvl++] = w;
+		sim_n.words++;
+		sim_dma_dreq(dreq);
+		sim_dma_dreq(dreq + 4);
+	}
+
+	m->next_ps = m->t0_ps + (uint64_t)(++m->n * m->period_ps);
+}
+
+/*
+ * the I2S state machine driving a pin as LRCK
+ */
+static sim_sm *sim_lrck_source(uint pin)
+{
+	for(uint s=0;s<NUM_PIO_STATE_MACHINES;s++)
+	{
+		sim_sm *m = &sim_pios[0].sm[s];
+		if(m->enabled && sim_sm_is_i2s(m) && (sim_sm_lrck(m) == pin))
+			return m;
+	}
+	return NULL;
+}
+
+/*
+ * rate counter - push the count for each window of LRCK periods, in
+ * 2-clock steps as the program's loop counts
+ */
+static void sim_fsmeas(sim_sm *m, uint64_t now)
+{
+	sim_sm *src = sim_lrck_source(m->cfg.in_base);
+	double cycles;
+	uint32_t k;
+
+	if(!src)
+	{
+		m->win_ps = SIM_NONE;
+		return;
+	}
+	if(m->win_ps == SIM_NONE)
+	{
+		m->win_ps = now + (uint64_t)(m->frames * sim_sm_frame_ps(src));
+		return;
+	}
+	if(m->win_ps > now)
+		return;
+
+	cycles = m->frames * sim_sm_frame_cycles(src) + m->win_frac;
+	k = (uint32_t)floor((cycles - 2.0*m->frames - 4.0) / 2.0);
+	m->win_frac = cycles - (2.0*k + 2.0*m->frames + 4.0);
+	if(m->rx_lvl < sim_rx_depth(m))		// push noblock
+		m->rxf[m->rx_lvl++] = ~k;
+	m->win_ps += (uint64_t)(m->frames * sim_sm_frame_ps(src));
+}
+
+/*
+ * load a program at the top of free instruction memory, or its origin
+ */
+uint pio_add_program(PIO pio, const pio_program_t *program)
+{
+	sim_pio *p = sim_pio_of(pio);
+	uint32_t mask = (program->length >= 32) ? ~0u :
+		(1u << program->length) - 1;
+	int off;
+
+	sim_lock();
+	for(off=PIO_INSTRUCTION_COUNT-program->length;off>=0;off--)
+	{
+		if((program->origin >= 0) && (off != program->origin))
+			continue;
+		if(!(p->used & (mask << off)))
+			break;
+	}
+	if(off < 0)
+		panic("No program space");
+
+	p->used |= mask << off;
+	p->length[off] = program->length;
+	for(uint i=0;i<program->length;i++)
+		p->code[off+i] = program->instructions[i] +
+			((program->instructions[i] >> 13) ? 0 : off);
+	p->role[off] = SIM_SM_OTHER;
+	for(uint i=0;i<count_of(sim_progs);i++)
+		if((sim_progs[i].prog->length == program->length) &&
+			!memcmp(sim_progs[i].prog->instructions, program->instructions,
+			program->length * sizeof(uint16_t)))
+			p->role[off] = sim_progs[i].role;
+	sim_unlock();
+
+	return off;
+}
+
+bool pio_can_add_program(PIO pio, const pio_program_t *program)
+{
+	sim_pio *p = sim_pio_of(pio);
+	uint32_t mask = (program->length >= 32) ? ~0u :
+		(1u << program->length) - 1;
+
+	for(int off=PIO_INSTRUCTION_COUNT-program->length;off>=0;off--)
+		if(((program->origin < 0) || (off == program->origin)) &&
+			!(p->used & (mask << off)))
+			return true;
+	return false;
+}
+
+void pio_remove_program(PIO pio, const pio_program_t *program, uint loaded_offset)
+{
+	sim_pio *p = sim_pio_of(pio);
+	uint32_t mask = (program->length >= 32) ? ~0u :
+		(1u << program->length) - 1;
+
+	sim_lock();
+	p->used &= ~(mask << loaded_offset);
+	p->length[loaded_offset] = 0;
+	sim_unlock();
+}
+
+int pio_claim_unused_sm(PIO pio, bool required)
+{
+	sim_pio *p = sim_pio_of(pio);
+
+	sim_lock();
+	for(uint s=0;s<NUM_PIO_STATE_MACHINES;s++)
+		if(!p->sm[s].claimed)
+		{
+			p->sm[s].claimed = true;
+			sim_unlock();
+			return s;
+		}
+	sim_unlock();
+	if(required)
+		panic("No PIO state machines are available");
+	return -1;
+}
+
+void pio_sm_unclaim(PIO pio, uint sm)
+{
+	sim_sm_of(pio, sm)->claimed = false;
+}
+
+void pio_gpio_init(PIO pio, uint pin)
+{
+	gpio_set_function(pin, (pio == pio0) ? GPIO_FUNC_PIO0 : GPIO_FUNC_PIO1);
+}
+
+uint pio_get_dreq(PIO pio, uint sm, bool is_tx)
+{
+	return ((pio == pio0) ? DREQ_PIO0_TX0 : DREQ_PIO1_TX0) +
+		(is_tx ? 0 : 4) + sm;
+}
+
+/*
+ * reset a state machine to a program - clears slips put in by the test
+ */
+int pio_sm_init(PIO pio, uint sm, uint initial_pc, const pio_sm_config *config)
+{
+	sim_pio *p = sim_pio_of(pio);
+	sim_sm *m = sim_sm_of(pio, sm);
+
+	sim_lock();
+	m->enabled = false;
+	m->cfg = *config;
+	m->tx_lvl = m->rx_lvl = 0;
+	m->osr = m->x = m->y = 0;
+	m->slip = 0;
+	m->hist = 0;
+	m->role = SIM_SM_OTHER;
+	m->offset = m->length = 0;
+	m->entry = initial_pc;
+	for(int off=initial_pc;off>=0;off--)
+		if(p->length[off] && ((int)initial_pc < off + p->length[off]))
+		{
+			m->role = p->role[off];
+			m->offset = off;
+			m->length = p->length[off];
+			break;
+		}
+	sim_unlock();
+
+	return PICO_OK;
+}
+
+/*
+ * new settings without a reset - joining or splitting the FIFOs empties them
+ */
+void pio_sm_set_config(PIO pio, uint sm, const pio_sm_config *config)
+{
+	sim_sm *m = sim_sm_of(pio, sm);
+
+	sim_lock();
+	if(config->fifo_join != m->cfg.fifo_join)
+		m->tx_lvl = m->rx_lvl = 0;
+	m->cfg = *config;
+	sim_unlock();
+}
+
+void pio_sm_set_enabled(PIO pio, uint sm, bool enabled)
+{
+	pio_set_sm_mask_enabled(pio, 1u << sm, enabled);
+}
+
+void pio_set_sm_mask_enabled(PIO pio, uint32_t mask, bool enabled)
+{
+	sim_lock();
+	for(uint s=0;s<NUM_PIO_STATE_MACHINES;s++)
+	{
+		sim_sm *m = sim_sm_of(pio, s);
+		if(!(mask & (1u << s)) || (m->enabled == enabled))
+			continue;
+		if(enabled)
+			sim_sm_start(m);
+		else
+			m->enabled = false;
+	}
+	sim_unlock();
+}
+
+void pio_enable_sm_mask_in_sync(PIO pio, uint32_t mask)
+{
+	pio_set_sm_mask_enabled(pio, mask, true);
+}
+
+void pio_sm_restart(PIO pio, uint sm)
+{
+	sim_sm *m = sim_sm_of(pio, sm);
+
+	sim_lock();
+	m->osr = 0;
+	sim_unlock();
+}
+
+void pio_sm_set_clkdiv_int_frac(PIO pio, uint sm, uint16_t div_int, uint8_t div_frac)
+{
+	sim_sm *m = sim_sm_of(pio, sm);
+
+	sim_lock();
+	m->cfg.clkdiv_int = div_int;
+	m->cfg.clkdiv_frac = div_frac;
+	sim_unlock();
+}
+
+void pio_sm_set_pins(PIO pio, uint sm, uint32_t pin_values)
+{
+	(void)pio;
+	(void)sm;
+	(void)pin_values;
+}
+
+void pio_sm_set_pindirs_with_mask(PIO pio, uint sm, uint32_t pin_dirs,
+	uint32_t pin_mask)
+{
+	(void)pio;
+	(void)sm;
+	(void)pin_dirs;
+	(void)pin_mask;
+}
+
+/*
+ * the instructions init code execs - pull, mov from OSR, out & jmp
+ */
+void pio_sm_exec(PIO pio, uint sm, uint instr)
+{
+	sim_sm *m = sim_sm_of(pio, sm);
+	uint32_t v;
+
+	sim_lock();
+	switch(instr >> 13)
+	{
+		case 4:		// pull
+			if(instr & 0x80)
+				m->osr = m->tx_lvl ? sim_tx_pop(m) : m->x;
+			break;
+
+		case 5:		// mov
+			switch(instr & 7)
+			{
+				case pio_x: v = m->x; break;
+				case pio_y: v = m->y; break;
+				case pio_osr: v = m->osr; break;
+				default: v = 0; break;
+			}
+			switch((instr >> 5) & 7)
+			{
+				case pio_x: m->x = v; break;
+				case pio_y: m->y = v; break;
+				case pio_osr: m->osr = v; break;
+			}
+			break;
+
+		case 0:		// jmp - where sim_sm_push_pc() walks from
+			m->entry = instr & 0x1F;
+			break;
+
+		default:	// out to null - the word model has no OSR count
+			break;
+	}
+	sim_unlock();
+}
+
+/*
+ * where an I2S program is just after it pushes word w - walked from the
+ * entry with the ISR already holding the slip's bits. Only the order the
+ * instructions run in matters, so waits pass straight through. The first
+ * frame is walked to settle, then it's the push for w's place in a frame.
+ */
+static uint8_t sim_sm_push_pc(const sim_pio *p, const sim_sm *m, uint64_t w)
+{
+	uint32_t wpf = (m->frame_bits > 32) ? m->frame_bits / 32 : 1;
+	uint32_t push = wpf + w % wpf + 1, pushes = 0, cnt = m->slip;
+	uint32_t x = 0, y = m->y, v, taken, steps;
+	uint8_t pc = m->entry, next;
+	uint16_t in;
+
+	/* a whole word's slip is a push before the program starts */
+	if(cnt >= 32)
+	{
+		pushes++;
+		cnt -= 32;
+	}
+
+	/* a master program runs 4 instructions a bit, the slave 5 */
+	for(steps=0;steps<256*push;steps++)
+	{
+		in = p->code[pc];
+		next = (pc == m->cfg.wrap) ? m->cfg.wrap_target : (pc + 1) & 0x1F;
+		switch(in >> 13)
+		{
+			case 0:		// jmp
+				switch((in >> 5) & 7)
+				{
+					case 0: taken = 1; break;
+					case 1: taken = !x; break;
+					case 2: taken = x--; break;
+					case 3: taken = !y; break;
+					case 4: taken = y--; break;
+					case 5: taken = x != y; break;
+					default: taken = 0; break;
+				}
+				if(taken)
+					next = in & 0x1F;
+				break;
+
+			case 2:		// in, autopushed at 32 bits
+				cnt += (in & 0x1F) ? (in & 0x1F) : 32;
+				if(cnt >= 32)
+				{
+					cnt = 0;
+					if(++pushes == push)
+						return next;
+				}
+				break;
+
+			case 5:		// mov between x, y & null
+				switch(in & 7)
+				{
+					case pio_x: v = x; break;
+					case pio_y: v = y; break;
+					default: v = 0; break;
+				}
+				if(((in >> 3) & 3) == 1)
+					v = ~v;
+				if(((in >> 5) & 7) == pio_x)
+					x = v;
+				else if(((in >> 5) & 7) == pio_y)
+					y = v;
+				break;
+
+			case 7:		// set
+				if(((in >> 5) & 7) == pio_x)
+					x = in & 0x1F;
+				else if(((in >> 5) & 7) == pio_y)
+					y = in & 0x1F;
+				break;
+		}
+		pc = next;
+	}
+
+	return pc;
+}
+
+/*
+ * the I2S programs are where the push for the word just in left them
+ */
+uint8_t pio_sm_get_pc(PIO pio, uint sm)
+{
+	sim_sm *m = sim_sm_of(pio, sm);
+
+	if(sim_sm_is_i2s(m) && m->frame_bits && (m->n >= 2))
+		return sim_sm_push_pc(sim_pio_of(pio), m, m->n - 2);
+	return m->offset;
+}
+
+void pio_sm_clear_fifos(PIO pio, uint sm)
+{
+	sim_sm *m = sim_sm_of(pio, sm);
+
+	sim_lock();
+	m->tx_lvl = m->rx_lvl = 0;
+	sim_unlock();
+}
+
+void pio_sm_put(PIO pio, uint sm, uint32_t data)
+{
+	sim_sm *m = sim_sm_of(pio, sm);
+
+	sim_lock();
+	if(m->tx_lvl < sim_tx_depth(m))
+		m->txf[m->tx_lvl++] = data;
+	sim_unlock();
+}
+
+uint32_t pio_sm_get(PIO pio, uint sm)
+{
+	sim_sm *m = sim_sm_of(pio, sm);
+	uint32_t w = 0;
+
+	sim_lock();
+	if(m->rx_lvl)
+		w = sim_rx_pop(m);
+	sim_unlock();
+
+	return w;
+}
+
+uint pio_sm_get_rx_fifo_level(PIO pio, uint sm)
+{
+	return sim_sm_of(pio, sm)->rx_lvl;
+}
+
+uint pio_sm_get_tx_fifo_level(PIO pio, uint sm)
+{
+	return sim_sm_of(pio, sm)->tx_lvl;
+}
+
+/*
+ * ------------------------------------------------------------------------
+ * DMA
+ * ------------------------------------------------------------------------
+ */
+
+/*
+ * state machine for a FIFO register address - NULL if it's memory
+ */
+static sim_sm *sim_fifo_at(uintptr_t a, bool *tx)
+{
+	uintptr_t base = (uintptr_t)sim_pio_hw;
+	uint32_t r;
+
+	if((a < base) || (a >= base + sizeof(sim_pio_hw)))
+		return NULL;
+	a -= base;
+	r = (a % sizeof(pio_hw_t)) / sizeof(uint32_t);
+	*tx = r < NUM_PIO_STATE_MACHINES;
+	return &sim_pios[a / sizeof(pio_hw_t)].sm[r % NUM_PIO_STATE_MACHINES];
+}
+
+/*
+ * UART for a data register address - NULL if it isn't one
+ */
+static struct uart_inst *sim_uart_at(uintptr_t a)
+{
+	for(uint i=0;i<count_of(sim_uart);i++)
+		if(a == (uintptr_t)&sim_uart_hw[i].dr)
+			return &sim_uart[i];
+	return NULL;
+}
+
+/*
+ * a byte into a UART's TX FIFO - it starts going out now if it was idle
+ */
+static void sim_uart_push(struct uart_inst *u, uint8_t c)
+{
+	if(!u->tx_lvl)
+		u->next_ps = sim_now() + SIM_UART_BITS * 1000000ULL * SIM_PS_PER_US /
+			(u->baud ? u->baud : 115200);
+	u->txf[(u->tx_rd + u->tx_lvl++) % SIM_UART_FIFO] = c;
+}
+
+/*
+ * feed a transfer to the sniffer - bytes in memory order, each MSB first
+ */
+static void sim_sniff_word(uint32_t w)
+{
+	if(sim_sniff.bswap)
+		w = __builtin_bswap32(w);
+
+	switch(sim_sniff.mode)
+	{
+		case DMA_SNIFF_CTRL_CALC_VALUE_CRC32:
+			for(uint b=0;b<4;b++,w>>=8)
+			{
+				sim_sniff.acc ^= (w & 0xFF) << 24;
+				for(uint k=0;k<8;k++)
+					sim_sniff.acc = (sim_sniff.acc & 0x80000000) ?
+						(sim_sniff.acc << 1) ^ 0x04C11DB7 : sim_sniff.acc << 1;
+			}
+			break;
+
+		case DMA_SNIFF_CTRL_CALC_VALUE_CRC32R:
+			for(uint b=0;b<4;b++,w>>=8)
+			{
+				sim_sniff.acc ^= w & 0xFF;
+				for(uint k=0;k<8;k++)
+					sim_sniff.acc = (sim_sniff.acc & 1) ?
+						(sim_sniff.acc >> 1) ^ 0xEDB88320 : sim_sniff.acc >> 1;
+			}
+			break;
+
+		case DMA_SNIFF_CTRL_CALC_VALUE_SUM:
+			sim_sniff.acc += w;
+			break;
+	}
+}
+
+/*
+ * move words while the channel's DREQ allows - raises its IRQ when done
+ */
+static void sim_dma_service(uint8_t ch)
+{
+	sim_dma *c = &sim_dmas[ch];
+	uint32_t size = 1u << c->cfg.size, w;
+	struct uart_inst *u;
+	sim_sm *rd, *wr;
+	bool rd_tx, wr_tx;
+
+	rd = sim_fifo_at(c->read, &rd_tx);
+	wr = sim_fifo_at(c->write, &wr_tx);
+	u = sim_uart_at(c->write);
+	while(c->busy && c->count)
+	{
+		if(rd && (rd_tx || !rd->rx_lvl))
+			break;
+		if(wr && (!wr_tx || (wr->tx_lvl >= sim_tx_depth(wr))))
+			break;
+		if(u && (u->tx_lvl >= SIM_UART_FIFO))
+			break;
+
+		w = 0;
+		if(rd)
+			w = sim_rx_pop(rd);
+		else
+		{
+			memcpy(&w, (const void *)c->read, size);
+			if(c->cfg.read_inc)
+				c->read += size;
+		}
+		if(wr)
+			wr->txf[wr->tx_lvl++] = w;
+		else if(u)
+			sim_uart_push(u, w);
+		else
+		{
+			memcpy((void *)c->write, &w, size);
+			if(c->cfg.write_inc)
+				c->write += size;
+		}
+		if(c->cfg.sniff && sim_sniff.on && (sim_sniff.chan == ch))
+			sim_sniff_word(w);
+		sim_n.dma_words++;
+
+		if(!--c->count)
+		{
+			c->busy = false;
+			sim_dma_intr |= 1u << ch;
+		}
+	}
+}
+
+static void sim_dma_dreq(uint8_t dreq)
+{
+	for(uint8_t ch=0;ch<NUM_DMA_CHANNELS;ch++)
+		if(sim_dmas[ch].busy && (sim_dmas[ch].cfg.dreq == dreq))
+			sim_dma_service(ch);
+}
+
+static void sim_dma_trigger(uint ch)
+{
+	sim_dma *c = &sim_dmas[ch];
+
+	if(c->busy)
+		return;
+	c->count = c->reload;
+	c->busy = c->count != 0;
+	sim_dma_service(ch);
+}
+
+int dma_claim_unused_channel(bool required)
+{
+	sim_lock();
+	for(uint ch=0;ch<NUM_DMA_CHANNELS;ch++)
+		if(!sim_dmas[ch].claimed)
+		{
+			sim_dmas[ch].claimed = true;
+			sim_unlock();
+			return ch;
+		}
+	sim_unlock();
+	if(required)
+		panic("No DMA channels are available");
+	return -1;
+}
+
+void dma_channel_unclaim(uint channel)
+{
+	sim_dmas[channel].claimed = false;
+}
+
+dma_channel_config dma_channel_get_default_config(uint channel)
+{
+	dma_channel_config c = {0};
+
+	c.read_inc = true;
+	c.dreq = DREQ_FORCE;
+	c.size = DMA_SIZE_32;
+	c.chain_to = channel;
+	return c;
+}
+
+void dma_channel_configure(uint channel, const dma_channel_config *config,
+	volatile void *write_addr, const volatile void *read_addr,
+	uint transfer_count, bool trigger)
+{
+	sim_dma *c = &sim_dmas[channel];
+
+	sim_lock();
+	c->cfg = *config;
+	c->write = (uintptr_t)write_addr;
+	c->read = (uintptr_t)read_addr;
+	c->reload = transfer_count;
+	if(trigger)
+		sim_dma_trigger(channel);
+	sim_unlock();
+}
+
+void dma_channel_set_read_addr(uint channel, const volatile void *read_addr, bool trigger)
+{
+	sim_lock();
+	sim_dmas[channel].read = (uintptr_t)read_addr;
+	if(trigger)
+		sim_dma_trigger(channel);
+	sim_unlock();
+}
+
+void dma_channel_set_write_addr(uint channel, volatile void *write_addr, bool trigger)
+{
+	sim_lock();
+	sim_dmas[channel].write = (uintptr_t)write_addr;
+	if(trigger)
+		sim_dma_trigger(channel);
+	sim_unlock();
+}
+
+void dma_channel_set_trans_count(uint channel, uint32_t trans_count, bool trigger)
+{
+	sim_lock();
+	sim_dmas[channel].reload = trans_count;
+	if(trigger)
+		sim_dma_trigger(channel);
+	sim_unlock();
+}
+
+void dma_channel_start(uint channel)
+{
+	sim_lock();
+	sim_dma_trigger(channel);
+	sim_unlock();
+}
+
+void dma_channel_abort(uint channel)
+{
+	sim_lock();
+	sim_dmas[channel].busy = false;
+	sim_dmas[channel].count = 0;
+	sim_unlock();
+}
+
+bool dma_channel_is_busy(uint channel)
+{
+	return sim_dmas[channel].busy;
+}
+
+void dma_channel_wait_for_finish_blocking(uint channel)
+{
+	while(dma_channel_is_busy(channel))
+		time_us_64();
+}
+
+void dma_channel_set_irq0_enabled(uint channel, bool enabled)
+{
+	sim_lock();
+	if(enabled)
+		sim_dma_inte[0] |= 1u << channel;
+	else
+		sim_dma_inte[0] &= ~(1u << channel);
+	sim_unlock();
+}
+
+void dma_channel_set_irq1_enabled(uint channel, bool enabled)
+{
+	sim_lock();
+	if(enabled)
+		sim_dma_inte[1] |= 1u << channel;
+	else
+		sim_dma_inte[1] &= ~(1u << channel);
+	sim_unlock();
+}
+
+bool dma_channel_get_irq0_status(uint channel)
+{
+	return (sim_dma_intr & sim_dma_inte[0]) & (1u << channel);
+}
+
+bool dma_channel_get_irq1_status(uint channel)
+{
+	return (sim_dma_intr & sim_dma_inte[1]) & (1u << channel);
+}
+
+void dma_channel_acknowledge_irq0(uint channel)
+{
+	sim_lock();
+	sim_dma_intr &= ~(1u << channel);
+	sim_unlock();
+}
+
+void dma_channel_acknowledge_irq1(uint channel)
+{
+	dma_channel_acknowledge_irq0(channel);
+}
+
+void dma_sniffer_enable(uint channel, uint mode, bool force_channel_enable)
+{
+	sim_lock();
+	sim_sniff.on = true;
+	sim_sniff.chan = channel;
+	sim_sniff.mode = mode;
+	if(force_channel_enable)
+		sim_dmas[channel].cfg.sniff = true;
+	sim_unlock();
+}
+
+void dma_sniffer_disable(void)
+{
+	sim_sniff.on = false;
+}
+
+void dma_sniffer_set_byte_swap_enabled(bool swap)
+{
+	sim_sniff.bswap = swap;
+}
+
+void dma_sniffer_set_data_accumulator(uint32_t seed_value)
+{
+	sim_lock();
+	sim_sniff.acc = seed_value;
+	sim_unlock();
+}
+
+uint32_t dma_sniffer_get_data_accumulator(void)
+{
+	return sim_sniff.acc;
+}
+
+/*
+ * ------------------------------------------------------------------------
+ * IRQs, timers & the cores
+ * ------------------------------------------------------------------------
+ */
+
+static bool sim_irq_line(uint num)
+{
+	if(num == DMA_IRQ_0)
+		return sim_dma_intr & sim_dma_inte[0];
+	if(num == DMA_IRQ_1)
+		return sim_dma_intr & sim_dma_inte[1];
+	return false;
+}
+
+/*
+ * an IRQ a core would take now - call with the chip locked
+ */
+static bool sim_irq_pending(uint8_t core, uint num)
+{
+	return sim_irq_on[core][num] && sim_irq_handler[core][num] &&
+		sim_irq_line(num);
+}
+
+void irq_set_exclusive_handler(uint num, irq_handler_t handler)
+{
+	sim_lock();
+	sim_irq_handler[sim_core][num] = handler;
+	sim_unlock();
+}
+
+void irq_set_enabled(uint num, bool enabled)
+{
+	sim_lock();
+	sim_irq_on[sim_core][num] = enabled;
+	sim_unlock();
+}
+
+uint32_t save_and_disable_interrupts(void)
+{
+	pthread_mutex_lock(&sim_core_irq[sim_core]);
+	sim_irqs_off++;
+	return 0;
+}
+
+void restore_interrupts(uint32_t status)
+{
+	(void)status;
+	sim_irqs_off--;
+	pthread_mutex_unlock(&sim_core_irq[sim_core]);
+}
+
+uint get_core_num(void)
+{
+	return sim_core;
+}
+
+bool add_repeating_timer_us(int64_t delay_us, repeating_timer_callback_t callback,
+	void *user_data, repeating_timer_t *out)
+{
+	out->delay_us = delay_us;
+	out->callback = callback;
+	out->user_data = user_data;
+
+	sim_lock();
+	for(uint i=0;i<SIM_TIMERS;i++)
+		if(!sim_timers[i].rt)
+		{
+			sim_timers[i].rt = out;
+			sim_timers[i].core = sim_core;
+			sim_timers[i].next_ps = sim_now() +
+				(uint64_t)llabs(delay_us) * SIM_PS_PER_US;
+			out->alarm_id = i + 1;
+			sim_unlock();
+			return true;
+		}
+	sim_unlock();
+
+	return false;
+}
+
+bool cancel_repeating_timer(repeating_timer_t *timer)
+{
+	bool found = false;
+
+	sim_lock();
+	for(uint i=0;i<SIM_TIMERS;i++)
+		if(sim_timers[i].rt == timer)
+		{
+			sim_timers[i].rt = NULL;
+			found = true;
+		}
+	sim_unlock();
+
+	return found;
+}
+
+/*
+ * core 1 runs only when nothing else wants to - it mostly spins in
+ * Audio_Fore(), & anything else that wakes must get the CPU straight away
+ */
+static void *sim_core1_main(void *arg)
+{
+	struct sched_param sp = {0};
+
+	sim_core = 1;
+	pthread_setschedparam(pthread_self(), SCHED_IDLE, &sp);
+	((void (*)(void))arg)();
+	return NULL;
+}
+
+void multicore_launch_core1(void (*entry)(void))
+{
+	if(pthread_create(&sim_core1, NULL, sim_core1_main, (void *)entry))
+		panic("Can't start core 1");
+}
+
+void multicore_lockout_victim_init(void)
+{
+	sim_victim[sim_core] = true;
+}
+
+/*
+ * hold the other core's IRQs off - its thread carries on, but the
+ * handlers that would run on it wait as they would on the chip
+ */
+bool multicore_lockout_start_timeout_us(uint64_t timeout_us)
+{
+	uint8_t other = sim_core ^ 1;
+	uint64_t ns = timeout_us * 1000;
+
+	if(!sim_victim[other] || sim_lockout[other])
+		return false;
+	if(ns < SIM_LOCKOUT_MIN_NS)
+		ns = SIM_LOCKOUT_MIN_NS;
+	if(sim_core_enter(other, ns))
+		return false;
+	sim_lockout[other] = true;
+
+	return true;
+}
+
+bool multicore_lockout_end_timeout_us(uint64_t timeout_us)
+{
+	uint8_t other = sim_core ^ 1;
+
+	(void)timeout_us;
+	if(!sim_lockout[other])
+		return false;
+	sim_lockout[other] = false;
+	pthread_mutex_unlock(&sim_core_irq[other]);
+
+	return true;
+}
+
+/*
+ * ------------------------------------------------------------------------
+ * time, clocks & the rest
+ * ------------------------------------------------------------------------
+ */
+
+/*
+ * core 0 lets the clock move on whenever it looks at it - unless its IRQs
+ * are off, as it would only wait for itself
+ */
+uint64_t time_us_64(void)
+{
+	if(sim_is_core0 && !sim_irqs_off)
+		sim_turn(0);
+	return sim_now() / SIM_PS_PER_US;
+}
+
+uint32_t time_us_32(void)
+{
+	return (uint32_t)time_us_64();
+}
+
+/*
+ * core 1 only gets the CPU when the other threads are waiting
+ */
+void tight_loop_contents(void)
+{
+	if(!sim_is_hw)
+		usleep(10);
+}
+
+/*
+ * handlers take no simulated time so don't wait in them
+ */
+void sleep_us(uint64_t us)
+{
+	uint64_t end = sim_now() + us * SIM_PS_PER_US;
+
+	if(!sim_is_core0)
+		return;
+	while(sim_now() < end)
+		sim_turn(end);
+}
+
+void sleep_ms(uint32_t ms)
+{
+	sleep_us(ms * 1000ULL);
+}
+
+uint32_t clock_get_hz(enum clock_index clk_index)
+{
+	return sim_clk_hz[clk_index];
+}
+
+bool clock_configure(enum clock_index clk_index, uint32_t src, uint32_t auxsrc,
+	uint32_t src_freq, uint32_t freq)
+{
+	(void)src;
+	(void)auxsrc;
+	if(freq > src_freq)
+		return false;
+	sim_lock();
+	sim_clk_hz[clk_index] = freq;
+	sim_unlock();
+
+	return true;
+}
+
+/*
+ * MCLK only - the codec as master makes LRCK from it
+ */
+void clock_gpio_init(uint gpio, uint src, float div)
+{
+	(void)src;
+	sim_lock();
+	sim_mclk_div = div;
+	sim_gpios[gpio].func = GPIO_FUNC_GPCK;
+	sim_unlock();
+}
+
+void pll_init(PLL pll, uint ref_div, uint vco_freq, uint post_div1, uint post_div2)
+{
+	pll->ref_div = ref_div;
+	pll->vco_freq = vco_freq;
+	pll->post_div1 = post_div1;
+	pll->post_div2 = post_div2;
+}
+
+void pll_deinit(PLL pll)
+{
+	pll->vco_freq = 0;
+}
+
+uint uart_init(uart_inst_t *uart, uint baudrate)
+{
+	sim_lock();
+	uart->tx_lvl = 0;
+	sim_unlock();
+	return uart_set_baudrate(uart, baudrate);
+}
+
+uint uart_set_baudrate(uart_inst_t *uart, uint baudrate)
+{
+	uart->baud = baudrate;
+	return baudrate;
+}
+
+uint uart_get_index(uart_inst_t *uart)
+{
+	return uart->idx;
+}
+
+bool stdio_init_all(void)
+{
+	setvbuf(stdout, NULL, _IOLBF, 0);
+	return true;
+}
+
+/*
+ * console input is the host's stdin - nothing once it's closed
+ */
+int getchar_timeout_us(uint32_t timeout_us)
+{
+	struct pollfd pfd = {0, POLLIN, 0};
+	unsigned char c;
+
+	if((poll(&pfd, 1, timeout_us / 1000) != 1) || (read(0, &c, 1) != 1))
+		return PICO_ERROR_TIMEOUT;
+
+	return c;
+}
+
+void panic(const char *fmt, ...)
+{
+	va_list ap;
+
+	fflush(stdout);
+	fputs("\n*** PANIC ***\n\n", stderr);
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	fputs("\n", stderr);
+	exit(1);
+}
+
+void pico_get_unique_board_id(pico_unique_board_id_t *id_out)
+{
+	static const uint8_t id[PICO_UNIQUE_BOARD_ID_SIZE_BYTES] =
+		{'S', 'I', 'M', 'R', 'P', '2', '0', '4'};
+
+	memcpy(id_out->id, id, sizeof(id));
+}
+
+void gpio_init(uint gpio)
+{
+	sim_lock();
+	sim_gpios[gpio].func = GPIO_FUNC_SIO;
+	sim_gpios[gpio].dir = false;
+	sim_gpios[gpio].out = false;
+	sim_unlock();
+}
+
+void gpio_set_function(uint gpio, enum gpio_function fn)
+{
+	sim_gpios[gpio].func = fn;
+}
+
+void gpio_set_dir(uint gpio, bool out)
+{
+	sim_gpios[gpio].dir = out;
+}
+
+/*
+ * a codec model's clock catches up with the simulated one
+ */
+static void sim_codec_sync(codec_model *m)
+{
+	uint64_t us = sim_now() / SIM_PS_PER_US;
+
+	if(m->t_us < us)
+		m->t_us = us;
+}
+
+/*
+ * an L3 bit in on each CLK rising edge, LSB first - a byte with MODE low
+ * is an address, with MODE high data for the address before
+ */
+static void sim_l3_edge(uint gpio, bool was, bool value)
+{
+	sim_l3_port *l = &sim_l3;
+	uint8_t buf[2];
+
+	if(!l->model || (sim_gpios[SIM_L3_CLK].func != GPIO_FUNC_SIO))
+		return;
+	if(gpio == SIM_L3_MODE)
+	{
+		l->bits = 0;
+		l->sr = 0;
+		return;
+	}
+	if((gpio != SIM_L3_CLK) || was || !value)
+		return;
+
+	l->sr |= sim_gpios[SIM_L3_DATA].out << l->bits;
+	if(++l->bits < 8)
+		return;
+	if(!sim_gpios[SIM_L3_MODE].out)
+	{
+		l->addr = l->sr;
+		l->have_addr = true;
+	}
+	else if(l->have_addr)
+	{
+		buf[0] = l->addr;
+		buf[1] = l->sr;
+		sim_codec_sync(l->model);
+		codec_model_bus_write(l->model, buf, 2);
+	}
+	l->bits = 0;
+	l->sr = 0;
+}
+
+/*
+ * a codec with a reset pin goes back to power-on while it's held low
+ */
+static void sim_codec_reset_edge(uint gpio, bool was, bool value)
+{
+	if((gpio != SIM_CODEC_RST) || !was || value)
+		return;
+	for(uint a=0;a<128;a++)
+		if(sim_i2c_devs[a].model && sim_i2c_devs[a].model->desc->hw_reset)
+			codec_model_reset(sim_i2c_devs[a].model);
+}
+
+void gpio_put(uint gpio, bool value)
+{
+	bool was = sim_gpios[gpio].out;
+
+	sim_lock();
+	sim_gpios[gpio].out = value;
+	if((sim_gpios[gpio].func == GPIO_FUNC_SIO) && sim_gpios[gpio].dir &&
+		(was != value))
+	{
+		sim_l3_edge(gpio, was, value);
+		sim_codec_reset_edge(gpio, was, value);
+	}
+	sim_unlock();
+}
+
+/*
+ * what's on a pin - its own output, else what the test drives, else pulls
+ */
+bool gpio_get(uint gpio)
+{
+	sim_gpio *g = &sim_gpios[gpio];
+
+	if((g->func == GPIO_FUNC_SIO) && g->dir)
+		return g->out;
+	if(g->drive >= 0)
+		return g->drive;
+	return g->up;
+}
+
+void gpio_set_pulls(uint gpio, bool up, bool down)
+{
+	sim_gpios[gpio].up = up;
+	sim_gpios[gpio].down = down;
+}
+
+/*
+ * the time a transfer of n bytes after the address takes on the bus -
+ * SCL comes from clk_sys, so it's off by as much as clk_sys has moved
+ * since the divider was set
+ */
+static void sim_i2c_time(i2c_inst_t *i2c, size_t n)
+{
+	uint64_t scl = (uint64_t)i2c->baud * sim_clk_hz[clk_sys] / i2c->sys_hz;
+
+	if(!i2c->off_rate && ((scl * 100 > i2c->baud * 101ULL) ||
+		(scl * 100 < i2c->baud * 99ULL)))
+	{
+		printf("sim: I2C at %u Hz, set for %u Hz - not re-timed after a "
+			"clk_sys change\n", (unsigned)scl, i2c->baud);
+		i2c->off_rate = true;
+	}
+	if((scl * 100 > i2c->baud * 101ULL) || (scl * 100 < i2c->baud * 99ULL))
+	{
+		sim_lock();
+		sim_n.i2c_off_rate++;
+		sim_unlock();
+	}
+	sleep_us((SIM_I2C_BITS(n) * 1000000ULL + scl - 1) / scl);
+}
+
+/*
+ * an address with a codec model attached is that codec, any other a
+ * device with 256 byte registers, the first byte written being the
+ * register pointer
+ */
+uint i2c_init(i2c_inst_t *i2c, uint baudrate)
+{
+	return i2c_set_baudrate(i2c, baudrate);
+}
+
+uint i2c_set_baudrate(i2c_inst_t *i2c, uint baudrate)
+{
+	i2c->baud = baudrate;
+	i2c->sys_hz = sim_clk_hz[clk_sys];
+	return baudrate;
+}
+
+void i2c_deinit(i2c_inst_t *i2c)
+{
+	i2c->baud = 0;
+}
+
+int i2c_write_timeout_us(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src,
+	size_t len, bool nostop, uint timeout_us)
+{
+	sim_i2c_dev *d = &sim_i2c_devs[addr & 0x7f];
+
+	int32_t bad = 0;
+
+	(void)nostop;
+	(void)timeout_us;
+	if(!i2c->baud || d->nak)
+		return PICO_ERROR_GENERIC;
+
+	sim_lock();
+	if(d->model)
+	{
+		sim_codec_sync(d->model);
+		bad = codec_model_bus_write(d->model, src, len);
+	}
+	else
+	{
+		for(size_t i=0;i<len;i++)
+		{
+			if(!i)
+				d->ptr = src[i];
+			else
+				d->regs[d->ptr++] = src[i];
+		}
+	}
+	sim_unlock();
+	sim_i2c_time(i2c, len);
+
+	return bad ? PICO_ERROR_GENERIC : (int)len;
+}
+
+int i2c_read_timeout_us(i2c_inst_t *i2c, uint8_t addr, uint8_t *dst,
+	size_t len, bool nostop, uint timeout_us)
+{
+	sim_i2c_dev *d = &sim_i2c_devs[addr & 0x7f];
+
+	int32_t bad = 0;
+
+	(void)nostop;
+	(void)timeout_us;
+	if(!i2c->baud || d->nak)
+		return PICO_ERROR_GENERIC;
+
+	sim_lock();
+	if(d->model)
+	{
+		sim_codec_sync(d->model);
+		bad = codec_model_bus_read(d->model, dst, len);
+	}
+	else
+	{
+		for(size_t i=0;i<len;i++)
+			dst[i] = d->regs[d->ptr++];
+	}
+	sim_unlock();
+	sim_i2c_time(i2c, len);
+
+	return bad ? PICO_ERROR_GENERIC : (int)len;
+}
+
+/*
+ * ------------------------------------------------------------------------
+ * the hardware thread
+ * ------------------------------------------------------------------------
+ */
+
+/*
+ * the soonest thing due - call with the chip locked
+ */
+static uint64_t sim_next_event(uint64_t now)
+{
+	uint64_t next = SIM_NONE;
+
+	for(uint p=0;p<NUM_PIOS;p++)
+		for(uint s=0;s<NUM_PIO_STATE_MACHINES;s++)
+		{
+			sim_sm *m = &sim_pios[p].sm[s];
+			if(!m->enabled)
+				continue;
+			if(sim_sm_is_i2s(m) && (m->next_ps < next))
+				next = m->next_ps;
+			else if((m->role == SIM_SM_FSMEAS) && (m->win_ps < next))
+				next = m->win_ps;
+		}
+	for(uint i=0;i<count_of(sim_uart);i++)
+		if(sim_uart[i].tx_lvl && (sim_uart[i].next_ps < next))
+			next = sim_uart[i].next_ps;
+	for(uint i=0;i<SIM_TIMERS;i++)
+		if(sim_timers[i].rt && (sim_timers[i].next_ps < next))
+			next = sim_timers[i].next_ps;
+	for(uint i=0;i<SIM_ATS;i++)
+		if(sim_ats[i].fn && (sim_ats[i].at_ps < next))
+			next = sim_ats[i].at_ps;
+	if(sim_end_ps < next)
+		next = sim_end_ps;
+
+	return (next < now) ? now : next;
+}
+
+/*
+ * everything due by now - call with the chip locked
+ */
+static void sim_run_events(uint64_t now)
+{
+	for(uint p=0;p<NUM_PIOS;p++)
+		for(uint8_t s=0;s<NUM_PIO_STATE_MACHINES;s++)
+		{
+			sim_sm *m = &sim_pios[p].sm[s];
+			if(!m->enabled)
+				continue;
+			if(sim_sm_is_i2s(m))
+			{
+				while(m->enabled && (m->next_ps <= now))
+					sim_sm_word(&sim_pios[p], s);
+			}
+			else if(m->role == SIM_SM_FSMEAS)
+				sim_fsmeas(m, now);
+		}
+
+	/* UART bytes go out a character time apart & make room for DMA */
+	for(uint i=0;i<count_of(sim_uart);i++)
+	{
+		struct uart_inst *u = &sim_uart[i];
+		while(u->tx_lvl && (u->next_ps <= now))
+		{
+			if(u->out)
+				fputc(u->txf[u->tx_rd], u->out);
+			u->tx_rd = (u->tx_rd + 1) % SIM_UART_FIFO;
+			u->tx_lvl--;
+			u->next_ps += SIM_UART_BITS * 1000000ULL * SIM_PS_PER_US /
+				(u->baud ? u->baud : 115200);
+			sim_dma_dreq(uart_get_dreq(u, true));
+		}
+	}
+}
+
+/*
+ * anything for the cores or the test - call with the chip locked
+ */
+static bool sim_due(uint64_t now)
+{
+	for(uint8_t core=0;core<2;core++)
+		if(sim_irq_pending(core, DMA_IRQ_0) || sim_irq_pending(core, DMA_IRQ_1))
+			return true;
+	for(uint i=0;i<SIM_TIMERS;i++)
+		if(sim_timers[i].rt && (sim_timers[i].next_ps <= now))
+			return true;
+	for(uint i=0;i<SIM_ATS;i++)
+		if(sim_ats[i].fn && (sim_ats[i].at_ps <= now))
+			return true;
+
+	return now >= sim_end_ps;
+}
+
+/*
+ * run the handlers for pending IRQs on their cores
+ */
+static void sim_dispatch_irqs(void)
+{
+	static const uint lines[] = {DMA_IRQ_0, DMA_IRQ_1};
+	irq_handler_t h;
+
+	for(uint8_t core=0;core<2;core++)
+		for(uint l=0;l<count_of(lines);l++)
+			for(uint run=0;run<SIM_IRQ_RUNS;run++)
+			{
+				sim_lock();
+				h = sim_irq_pending(core, lines[l]) ?
+					sim_irq_handler[core][lines[l]] : NULL;
+				sim_unlock();
+				if(!h)
+					break;
+				if(sim_core_enter(core, SIM_IRQ_WAIT_NS))
+				{
+					sim_n.irq_waits++;
+					break;
+				}
+				sim_core = core;
+				h();
+				pthread_mutex_unlock(&sim_core_irq[core]);
+				sim_n.irqs++;
+			}
+}
+
+/*
+ * run the timer callbacks & test events that are due
+ */
+static void sim_dispatch_timers(uint64_t now)
+{
+	repeating_timer_t *rt;
+	void (*fn)(void);
+	uint8_t core;
+	bool again;
+
+	for(uint i=0;i<SIM_TIMERS;i++)
+	{
+		sim_lock();
+		rt = (sim_timers[i].rt && (sim_timers[i].next_ps <= now)) ?
+			sim_timers[i].rt : NULL;
+		core = sim_timers[i].core;
+		sim_unlock();
+		if(!rt)
+			continue;
+		if(sim_core_enter(core, SIM_IRQ_WAIT_NS))
+		{
+			/* held off too long - it misses this tick */
+			sim_lock();
+			if(sim_timers[i].rt == rt)
+				sim_timers[i].next_ps += (rt->delay_us ?
+					(uint64_t)llabs(rt->delay_us) : 1) * SIM_PS_PER_US;
+			sim_unlock();
+			sim_n.irq_waits++;
+			continue;
+		}
+		sim_core = core;
+		again = rt->callback(rt);
+		pthread_mutex_unlock(&sim_core_irq[core]);
+		sim_n.timers++;
+
+		sim_lock();
+		if(sim_timers[i].rt == rt)
+		{
+			if(again)
+				sim_timers[i].next_ps += (rt->delay_us ?
+					(uint64_t)llabs(rt->delay_us) : 1) * SIM_PS_PER_US;
+			else
+				sim_timers[i].rt = NULL;
+		}
+		sim_unlock();
+	}
+
+	for(uint i=0;i<SIM_ATS;i++)
+	{
+		sim_lock();
+		fn = (sim_ats[i].fn && (sim_ats[i].at_ps <= now)) ? sim_ats[i].fn : NULL;
+		sim_ats[i].fn = fn ? NULL : sim_ats[i].fn;
+		sim_unlock();
+		if(fn)
+			fn();
+	}
+}
+
+/*
+ * end of a timed run
+ */
+static void sim_finish(uint64_t real_ns)
+{
+	int status;
+
+	fflush(stdout);
+	printf("sim: %.3f s in %.3f s real, %llu words, %llu stalls, "
+		"%llu IRQs, %llu held off, %llu timer calls\n",
+		sim_now() / 1e12, real_ns / 1e9,
+		(unsigned long long)sim_n.words, (unsigned long long)sim_n.stalls,
+		(unsigned long long)sim_n.irqs, (unsigned long long)sim_n.irq_waits,
+		(unsigned long long)sim_n.timers);
+	status = sim_soak_check();
+	if(sim_codec_m.writes || sim_codec_m.reads)
+		codec_model_report(&sim_codec_m);
+	if(sim_codec_m.violations || sim_n.i2c_off_rate)
+		status = 1;
+	fflush(stdout);
+	if(sim_uart[1].out)
+		fflush(sim_uart[1].out);
+	_exit(status);
+}
+
+/*
+ * move the clock on from one event to the next, a quantum at a time,
+ * handing over to the cores in between
+ */
+static void *sim_hw_main(void *arg)
+{
+	uint64_t now = 0, until, real0 = sim_real_ns(), real;
+	bool due;
+
+	(void)arg;
+	sim_is_hw = true;
+	while(1)
+	{
+		until = sim_turn_wait(now);
+		while(now < until)
+		{
+			sim_lock();
+			do
+			{
+				now = sim_next_event(now);
+				if(now > until)
+					now = until;
+				__atomic_store_n(&sim_ps, now, __ATOMIC_RELEASE);
+				sim_run_events(now);
+				due = sim_due(now);
+			} while(!due && (now < until));
+			sim_unlock();
+
+			sim_dispatch_irqs();
+			sim_dispatch_timers(now);
+			if((now >= sim_end_ps) || sim_soak_done())
+				sim_finish(sim_real_ns() - real0);
+		}
+
+		/* hold back to the wanted speed */
+		if(sim_speed > 0.0)
+		{
+			real = real0 + (uint64_t)(now / 1000.0 / sim_speed);
+			while(sim_real_ns() < real)
+				usleep(100);
+		}
+		sim_turn_done();
+	}
+
+	return NULL;
+}
+
+/*
+ * power up - before main() so the clock is running when it starts
+ */
+__attribute__((constructor)) static void sim_init(void)
+{
+	pthread_mutexattr_t a;
+	const char *s;
+
+	pthread_mutexattr_init(&a);
+	pthread_mutexattr_settype(&a, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(&sim_mtx, &a);
+	pthread_mutex_init(&sim_core_irq[0], &a);
+	pthread_mutex_init(&sim_core_irq[1], &a);
+	pthread_mutexattr_destroy(&a);
+
+	sim_clk_hz[clk_ref] = 12000000;
+	sim_clk_hz[clk_sys] = SYS_CLK_HZ;
+	sim_clk_hz[clk_peri] = SYS_CLK_HZ;
+	sim_clk_hz[clk_usb] = 48000000;
+	sim_clk_hz[clk_adc] = 48000000;
+	for(uint i=0;i<SIM_GPIOS;i++)
+		sim_gpios[i].drive = -1;
+	for(uint p=0;p<NUM_PIOS;p++)
+		for(uint s=0;s<NUM_PIO_STATE_MACHINES;s++)
+			sim_pios[p].sm[s].loop = true;
+	codec_model_init(&sim_codec_m, Codec_Model());
+	sim_codec_attach(&sim_codec_m);
+
+	if((s = getenv("RP2040_SIM_SECONDS")) && (atof(s) > 0.0))
+		sim_end_ps = (uint64_t)(atof(s) * 1e12);
+	if((s = getenv("RP2040_SIM_SPEED")))
+		sim_speed = atof(s);
+	sim_quantum_ps = SIM_QUANTUM_US * SIM_PS_PER_US;
+	if((s = getenv("RP2040_SIM_QUANTUM_US")) && (atoi(s) > 0))
+		sim_quantum_ps = atoi(s) * SIM_PS_PER_US;
+	if((s = getenv("RP2040_SIM_UART1")) && !(sim_uart[1].out = fopen(s, "wb")))
+	{
+		perror(s);
+		exit(1);
+	}
+
+	sim_is_core0 = true;
+	if(pthread_create(&sim_hw, NULL, sim_hw_main, NULL))
+	{
+		fputs("sim: can't start the hardware thread\n", stderr);
+		exit(1);
+	}
+}
+
+/*
+ * ------------------------------------------------------------------------
+ * test control - see sim.h
+ * ------------------------------------------------------------------------
+ */
+
+uint64_t sim_time_ps(void)
+{
+	return sim_now();
+}
+
+void sim_get_counters(sim_counters *c)
+{
+	sim_lock();
+	*c = sim_n;
+	sim_unlock();
+}
+
+int32_t sim_at(uint64_t us, void (*fn)(void))
+{
+	sim_lock();
+	for(uint i=0;i<SIM_ATS;i++)
+		if(!sim_ats[i].fn)
+		{
+			sim_ats[i].fn = fn;
+			sim_ats[i].at_ps = us * SIM_PS_PER_US;
+			sim_unlock();
+			return 0;
+		}
+	sim_unlock();
+
+	return 1;
+}
+
+void sim_i2s_loop(uint32_t sm, bool on)
+{
+	sim_lock();
+	sim_pios[0].sm[sm & 3].loop = on;
+	sim_unlock();
+}
+
+void sim_i2s_slip(uint32_t sm, uint32_t bits)
+{
+	sim_lock();
+	sim_pios[0].sm[sm & 3].slip = (bits > 32) ? 32 : bits;
+	sim_unlock();
+}
+
+void sim_gpio_drive(uint32_t gpio, int32_t level)
+{
+	sim_lock();
+	sim_gpios[gpio].drive = (level < 0) ? -1 : (level != 0);
+	sim_unlock();
+}
+
+uint8_t *sim_i2c_regs(uint8_t addr)
+{
+	return sim_i2c_devs[addr & 0x7f].regs;
+}
+
+void sim_i2c_nak(uint8_t addr, bool nak)
+{
+	sim_i2c_devs[addr & 0x7f].nak = nak;
+}
+
+void sim_codec_attach(codec_model *m)
+{
+	sim_lock();
+	if(m->desc->bus == MODEL_BUS_L3)
+	{
+		memset(&sim_l3, 0, sizeof(sim_l3));
+		sim_l3.model = m;
+	}
+	else
+		sim_i2c_devs[m->desc->dev_addr & 0x7f].model = m;
+	sim_unlock();
+}
+
+codec_model *sim_codec(void)
+{
+	return &sim_codec_m;
+}
+
+__attribute__((weak)) int sim_soak_check(void)
+{
+	return 0;
+}
+
+__attribute__((weak)) bool sim_soak_done(void)
+{
+	return false;
+}
@@ -0,0 +1,62 @@
+/*
+ * sim.h - control of the simulated RP2040 the host build runs on
+ */
+
+#ifndef __sim__
+#define __sim__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "codec_model.h"
+
+/* what the simulation has done since it started */
+typedef struct
+{
+	uint64_t words;			// FIFO words through the I2S state machines
+	uint64_t stalls;		// word slots a state machine waited on a FIFO
+	uint64_t irqs;			// DMA IRQ handler runs
+	uint64_t irq_waits;		// IRQs held off by a core's interrupt lock
+	uint64_t timers;		// repeating timer callbacks
+	uint64_t dma_words;		// words DMA moved
+	uint64_t i2c_off_rate;	// I2C transfers off the rate set, clk_sys moved
+} sim_counters;
+
+uint64_t sim_time_ps(void);
+void sim_get_counters(sim_counters *c);
+
+/* run fn on the simulation thread once the clock reaches us */
+int32_t sim_at(uint64_t us, void (*fn)(void));
+
+/*
+ * the data in pin of a pio0 state machine sees its data out pin - slip
+ * puts the ISR bits (0-32) ahead of the frame, so the words come in that
+ * much late. Slips go when the state machine is next initialized.
+ */
+void sim_i2s_loop(uint32_t sm, bool on);
+void sim_i2s_slip(uint32_t sm, uint32_t bits);
+
+/* drive a GPIO from outside - level -1 lets it go */
+void sim_gpio_drive(uint32_t gpio, int32_t level);
+
+/* register file of an I2C device - NAK all transfers to it if nak */
+uint8_t *sim_i2c_regs(uint8_t addr);
+void sim_i2c_nak(uint8_t addr, bool nak);
+
+/*
+ * put a codec model on the bus its desc names, at its address - it takes
+ * over from any there before. The built in codec's model is there from
+ * power-up and a run with violations flagged in it fails.
+ */
+void sim_codec_attach(codec_model *m);
+codec_model *sim_codec(void);
+
+/* exit status at the end of a timed run - defaults to pass */
+int sim_soak_check(void);
+
+/*
+ * polled by the clock - true ends the run there as if its time was up.
+ * Defaults to never, so a run without RP2040_SIM_SECONDS goes on.
+ */
+bool sim_soak_done(void);
+
+#endif
@@ -0,0 +1,120 @@
+/*
+ * soak.c - PRBS loopback soak on the host build
+ *
+ * Linked into rp2040_i2s_soak, which builds main.c with PRBS_TEST so the
+ * stream goes round the simulated DO to DI loop. A timed run passes if
+ * the checker stayed locked with no bad blocks. With RP2040_SIM_SLIP set
+ * the loop slips by a slot that many seconds in, and the run passes if
+ * the slip watchdog tripped within SOAK_TRIP_BLOCKS, Audio_Watch() had
+ * resynced within SOAK_RESYNC_BLOCKS and the checker locked again. Without RP2040_SIM_SECONDS the run ends on its own after
+ * SOAK_SECONDS, or SOAK_SLIP_SECONDS after the slip if that's later.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "i2s_fulldup.h"
+#include "audio.h"
+#include "prbs.h"
+#include "sim.h"
+
+/* default run length, & time after a slip to see it locked again */
+#define SOAK_SECONDS 10.0
+#define SOAK_SLIP_SECONDS 5.0
+
+/*
+ * input blocks after a slip by which the watchdog must have tripped - one
+ * in flight past I2S_PHASE_TRIP - and the resync must be done
+ */
+#define SOAK_TRIP_BLOCKS (I2S_PHASE_TRIP + 1)
+#define SOAK_RESYNC_BLOCKS 128
+
+static double soak_slip_s, soak_end_s;
+static uint32_t soak_slips, soak_resyncs;
+static int32_t soak_tripped = -1, soak_resynced = -1;
+
+/*
+ * us from now to the end of that many more input blocks
+ */
+static uint64_t soak_blocks_us(uint32_t blocks)
+{
+	return sim_time_ps() / 1000000 + 1 + blocks * 1000000ULL * SMPS / Fsample;
+}
+
+/*
+ * how the watchdog is doing that many blocks after the slip
+ */
+static void soak_trip_check(void)
+{
+	soak_tripped = i2s_insts[0].slips - soak_slips;
+}
+
+static void soak_resync_check(void)
+{
+	audio_status s;
+
+	Audio_Get_Status(&s);
+	soak_resynced = s.resyncs - soak_resyncs;
+}
+
+/*
+ * put the ISR a slot ahead of the frame - the words come in a slot late,
+ * which swaps L/R
+ */
+static void soak_slip(void)
+{
+	audio_status s;
+
+	Audio_Get_Status(&s);
+	soak_slips = i2s_insts[0].slips;
+	soak_resyncs = s.resyncs;
+	sim_i2s_slip(i2s_insts[0].sm, i2s_slot_bits);
+	sim_at(soak_blocks_us(SOAK_TRIP_BLOCKS), soak_trip_check);
+	sim_at(soak_blocks_us(SOAK_RESYNC_BLOCKS), soak_resync_check);
+}
+
+__attribute__((constructor)) static void soak_init(void)
+{
+	const char *s = getenv("RP2040_SIM_SLIP");
+
+	if(s && ((soak_slip_s = atof(s)) > 0.0))
+		sim_at((uint64_t)(soak_slip_s * 1e6), soak_slip);
+
+	s = getenv("RP2040_SIM_SECONDS");
+	if(!s || (atof(s) <= 0.0))
+		soak_end_s = (soak_slip_s + SOAK_SLIP_SECONDS > SOAK_SECONDS) ?
+			soak_slip_s + SOAK_SLIP_SECONDS : SOAK_SECONDS;
+}
+
+/*
+ * end of a run with no time given
+ */
+bool sim_soak_done(void)
+{
+	return (soak_end_s > 0.0) && (sim_time_ps() >= soak_end_s * 1e12);
+}
+
+/*
+ * pass or fail the run
+ */
+int sim_soak_check(void)
+{
+	prbs_stats s;
+	int fail;
+
+	prbs_get(&s);
+	if(soak_slip_s > 0.0)
+	{
+		fail = !s.locked || !(s.slips + s.lost) || (soak_tripped < 1) ||
+			(soak_resynced < 1);
+		printf("soak: watchdog %s within %u blocks, resync %s within %u\n",
+			(soak_tripped > 0) ? "tripped" : "didn't trip", SOAK_TRIP_BLOCKS,
+			(soak_resynced > 0) ? "done" : "not done", SOAK_RESYNC_BLOCKS);
+	}
+	else
+		fail = !s.locked || !s.blocks || s.block_errs || s.slips || s.lost;
+	printf("soak: %s - %u blocks, %u bad, %u slips, %u lost, %u syncs, %s\n",
+		fail ? "FAIL" : "pass", s.blocks, s.block_errs, s.slips, s.lost,
+		s.syncs, s.locked ? "locked" : "not locked");
+
+	return fail;
+}
@@ -0,0 +1,186 @@
+/*
+ * tablecheck.c - check of the build time tables against libm
+ *
+ * Linked into rp2040_i2s_tables with the tables.c tablegen.py made for the
+ * build. Works each entry out again in double with libm and checks the
+ * table holds it to within rounding - half an LSB for the sine & ASRC taps,
+ * and the exact floor for the oscillator increments. The CRC table must
+ * match bit for bit, so its worst is the count of entries that don't.
+ * Prints the worst error of each table & exits 1 if any is out:
+ *   ./rp2040_i2s_tables
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "tables.h"
+
+/* what rounding to the nearest LSB can leave, plus double's own error */
+#define TABLECHECK_TOL (0.5 + 1e-9)
+
+/*
+ * zeroth order modified Bessel function, to convergence
+ */
+static double tablecheck_i0(double x)
+{
+	double s = 1.0, t = 1.0;
+	int k;
+
+	for(k=1;t>1e-17*s;k++)
+	{
+		t *= (x / (2 * k)) * (x / (2 * k));
+		s += t;
+	}
+	return s;
+}
+
+/*
+ * one result line - returns 1 if out
+ */
+static int tablecheck_report(const char *name, int n, double worst, double tol)
+{
+	int fail = worst > tol;
+
+	printf("%-16s %6d entries, worst %.6f of %.6f - %s\n", name, n, worst,
+		tol, fail ? "FAIL" : "pass");
+	return fail;
+}
+
+/*
+ * sine - the first half cycle at Q15 & the point after it
+ */
+static int tablecheck_sine(void)
+{
+	double worst = 0.0, e;
+	int i;
+
+	for(i=0;i<=TAB_SINE_HALF;i++)
+	{
+		e = fabs(sinetab[i] - 32767.0 * sin(2.0 * M_PI * i / TAB_SINE_LEN));
+		if(e > worst)
+			worst = e;
+	}
+	return tablecheck_report("sinetab", TAB_SINE_HALF+1, worst,
+		TABLECHECK_TOL);
+}
+
+/*
+ * ASRC taps - Kaiser windowed sinc, each phase scaled to unity at DC
+ */
+static int tablecheck_asrc(void)
+{
+	double h[ASRC_TAPS], sum, t, u, worst = 0.0, e;
+	int p, k, dc, dc_worst = 0;
+
+	for(p=0;p<=ASRC_PHASES;p++)
+	{
+		sum = 0.0;
+		for(k=0;k<ASRC_TAPS;k++)
+		{
+			t = (ASRC_TAPS/2 - 1) + (double)p / ASRC_PHASES - k;
+			u = t / (ASRC_TAPS/2);
+			h[k] = (t == 0.0) ? 1.0 : sin(M_PI * t) / (M_PI * t);
+			h[k] *= (u*u < 1.0) ? tablecheck_i0(ASRC_BETA * sqrt(1.0 - u*u)) /
+				tablecheck_i0(ASRC_BETA) : 0.0;
+			sum += h[k];
+		}
+		dc = 0;
+		for(k=0;k<ASRC_TAPS;k++)
+		{
+			e = fabs(asrc_coef[p][k] - 32767.0 * h[k] / sum);
+			if(e > worst)
+				worst = e;
+			dc += asrc_coef[p][k];
+		}
+		if(abs(dc - 32767) > dc_worst)
+			dc_worst = abs(dc - 32767);
+	}
+
+	/* rounding can move each row's DC gain by half an LSB a tap at most */
+	return tablecheck_report("asrc_coef", (ASRC_PHASES+1)*ASRC_TAPS, worst,
+			TABLECHECK_TOL) |
+		tablecheck_report("asrc_coef DC", ASRC_PHASES+1, dc_worst,
+			ASRC_TAPS/2);
+}
+
+/*
+ * 2^x & reciprocal seeds for fixparam.c, both Q2.30
+ */
+static int tablecheck_fix(void)
+{
+	double worst = 0.0, worst_r = 0.0, e;
+	int i;
+
+	for(i=0;i<=TAB_EXP2_LEN;i++)
+	{
+		e = fabs(tab_exp2[i] - ldexp(exp2((double)i / TAB_EXP2_LEN), 30));
+		if(e > worst)
+			worst = e;
+	}
+	for(i=0;i<TAB_RECIP_LEN;i++)
+	{
+		e = fabs(tab_recip[i] - ldexp(2.0 * TAB_RECIP_LEN /
+			(TAB_RECIP_LEN + i + 0.5), 30));
+		if(e > worst_r)
+			worst_r = e;
+	}
+	return tablecheck_report("tab_exp2", TAB_EXP2_LEN+1, worst, TABLECHECK_TOL) |
+		tablecheck_report("tab_recip", TAB_RECIP_LEN, worst_r, TABLECHECK_TOL);
+}
+
+/*
+ * oscillator increments - TAB_OSC_HZ in Q0.32 cycles per frame
+ */
+static int tablecheck_osc(void)
+{
+	const uint32_t rates[] = {TAB_OSC_RATES};
+	double worst = 0.0, e;
+	int fail = 0;
+	uint32_t i;
+
+	for(i=0;i<TAB_OSC_NUM;i++)
+	{
+		/* every rate in order, & the floor of the exact increment */
+		if(tab_osc_inc[i].fs != rates[i])
+			fail = 1;
+		if(tab_osc_inc[i].inc != (int32_t)(((uint64_t)TAB_OSC_HZ << 32) / rates[i]))
+			fail = 1;
+		e = fabs(tab_osc_inc[i].inc - ldexp(TAB_OSC_HZ, 32) / rates[i]);
+		if(e > worst)
+			worst = e;
+	}
+	return tablecheck_report("tab_osc_inc", TAB_OSC_NUM, fail ? 1.0 : worst,
+		1.0 - 1e-9);
+}
+
+/*
+ * CRC-32 - each byte value shifted through the reflected polynomial
+ */
+static int tablecheck_crc(void)
+{
+	uint32_t i, k, c;
+	int bad = 0;
+
+	for(i=0;i<TAB_CRC_LEN;i++)
+	{
+		for(c=i,k=0;k<8;k++)
+			c = (c >> 1) ^ (0xEDB88320 & -(c & 1));
+		if(tab_crc32[i] != c)
+			bad++;
+	}
+	return tablecheck_report("tab_crc32", TAB_CRC_LEN, bad, 0.0);
+}
+
+int main(void)
+{
+	int fail = 0;
+
+	fail |= tablecheck_sine();
+	fail |= tablecheck_asrc();
+	fail |= tablecheck_osc();
+	fail |= tablecheck_fix();
+	fail |= tablecheck_crc();
+	printf("tables: %s\n", fail ? "FAIL" : "pass");
+
+	return fail;
+}
@@ -13,11 +13,15 @@
 #include "hardware/dma.h"
 #include "hardware/irq.h"
 #include "hardware/pio.h"
+#include "hardware/structs/bus_ctrl.h"
 #include "hardware/structs/clocks.h"
 #include "hardware/clocks.h"
 #include "pico/multicore.h"
 #include "i2s_fulldup.pio.h"
 #include "audio.h"
+#include "clkplan.h"
+#include "fsmeas.h"
+#include "trace.h"
 
 /* uncomment this to run audio processing on core 1 */
 #define MULTICORE
@@ -25,8 +29,16 @@
 /* uncomment this if using old Pico SDK */
 //#define OLD_SDK
 
-/* I2S PIO has L+R (Frames) in 32-bits */
+/*
+ * I2S PIO has L+R (Frames) in 32-bits, or in 2 x 32-bits for wider slots.
+ * TDM frames are up to 16 x 32-bits.
+ */
 #define FRAMES_PER_BUFFER (BUFSZ/2)
+#define WORDS_MAX (I2S_TDM_SLOTS_MAX*FRAMES_PER_BUFFER)
+
+#if I2S_BANK_WORDS != 2*FRAMES_PER_BUFFER
+#error "I2S_BANK_WORDS doesn't hold a block of 2 x 32-bit slots"
+#endif
 
 /* I2S comes out on these pins */
 #define I2S_DO_PIN 12		// data out
@@ -34,17 +46,221 @@
 #define I2S_CLK_PIN_BASE 10	// BCLK, LRCK
 #define I2S_MCLK_PIN 21		// MCLK
 
+/* second engine for a codec on the other PMOD - shares MCLK */
+#define I2S1_DO_PIN 8
+#define I2S1_DI_PIN 9
+#define I2S1_CLK_PIN_BASE 6
+
+/* the slave program waits on BCLK & LRCK by GPIO number */
+#if (I2S_CLK_PIN_BASE != i2s_fulldup_slave_PIN_BCLK) || \
+	(I2S_CLK_PIN_BASE+1 != i2s_fulldup_slave_PIN_LRCK)
+#error "i2s_fulldup_slave pins don't match I2S_CLK_PIN_BASE"
+#endif
+
+/* PIO clocking - 4 PIO cycles/bit */
+#define I2S_FRAME_CYCLES(slot_bits, slots) (4*(slots)*(slot_bits))
+
 #define IN_DIAG_PIN 26
 #define OUT_DIAG_PIN 27
 
-/* resources we use */
+/* pin groups - data out, data in, BCLK (LRCK above it) */
+static const uint8_t i2s_pins[][3] =
+{
+	{I2S_DO_PIN, I2S_DI_PIN, I2S_CLK_PIN_BASE},
+	{I2S1_DO_PIN, I2S1_DI_PIN, I2S1_CLK_PIN_BASE},
+};
+
+#if I2S_INSTANCES > 2
+#error "no pin group for more than 2 I2S instances"
+#endif
+
+/* resources we use - one program on pio0 shared by every instance */
 PIO pio;
-uint sm;
-uint dma_chan_input, dma_chan_output;
-uint ib_idx, ob_idx;
-uint32_t input_buf[2*FRAMES_PER_BUFFER], output_buf[2*FRAMES_PER_BUFFER],
-	xfer_buf[FRAMES_PER_BUFFER];
-uint32_t Fsample;
+uint pio_offset, i2s_words;
+i2s_inst i2s_insts[I2S_INSTANCES];
+static uint32_t input_buf[I2S_INSTANCES][2*WORDS_MAX];
+static uint32_t output_buf[I2S_INSTANCES][WORDS_MAX];
+static uint32_t xfer_buf[I2S_INSTANCES][WORDS_MAX];
+
+/*
+ * SRAM4 holds the core 1 stack & these, so the DMA only meets the core 1
+ * ISR that works on them at the bus - TDM blocks use the ones above
+ */
+static __scratch_x("i2s_bank") uint32_t bank_input_buf[I2S_INSTANCES]
+	[2*I2S_BANK_WORDS];
+static __scratch_x("i2s_bank") uint32_t bank_output_buf[I2S_INSTANCES]
+	[I2S_BANK_WORDS];
+uint8_t i2s_banked = 1;
+uint32_t i2s_stall_us = 0xFFFFFFFF;
+int32_t tdm_in[WORDS_MAX], tdm_out[WORDS_MAX];
+uint32_t Fsample, pio_div;
+uint8_t i2s_bits = I2S_BITS_DEFAULT, i2s_slot_bits = 16, i2s_fmt = I2S_FMT_DEFAULT;
+uint8_t i2s_rj_shift;
+uint8_t i2s_slots = I2S_SLOTS_DEFAULT, i2s_slave;
+uint i2s_phase_split;
+
+/*
+ * PIO program for each framing format - RJ is LJ with the data shifted.
+ * TDM loops over the whole frame rather than a slot. Y is loaded with the
+ * loop length less y_adj, as the master programs unroll one bit.
+ */
+typedef struct
+{
+	const pio_program_t *prog;
+	pio_sm_config (*get_config)(uint offset);
+	uint entry_point, entry_left;
+	uint8_t frame_loop, y_adj;
+} i2s_prog;
+
+static const i2s_prog i2s_progs[FMT_NUM] =
+{
+	[FMT_I2S] = {&i2s_fulldup_program, i2s_fulldup_program_get_default_config,
+		i2s_fulldup_offset_entry_point, i2s_fulldup_offset_entry_left, 0, 2},
+	[FMT_LJ] = {&i2s_fulldup_lj_program, i2s_fulldup_lj_program_get_default_config,
+		i2s_fulldup_lj_offset_entry_point, i2s_fulldup_lj_offset_entry_left, 0, 2},
+	[FMT_RJ] = {&i2s_fulldup_lj_program, i2s_fulldup_lj_program_get_default_config,
+		i2s_fulldup_lj_offset_entry_point, i2s_fulldup_lj_offset_entry_left, 0, 2},
+	[FMT_DSP_A] = {&i2s_fulldup_dsp_a_program, i2s_fulldup_dsp_a_program_get_default_config,
+		i2s_fulldup_dsp_a_offset_entry_point, i2s_fulldup_dsp_a_offset_entry_left, 0, 2},
+	[FMT_DSP_B] = {&i2s_fulldup_dsp_b_program, i2s_fulldup_dsp_b_program_get_default_config,
+		i2s_fulldup_dsp_b_offset_entry_point, i2s_fulldup_dsp_b_offset_entry_left, 0, 2},
+	[FMT_TDM] = {&i2s_fulldup_tdm_program, i2s_fulldup_tdm_program_get_default_config,
+		i2s_fulldup_tdm_offset_entry_point, i2s_fulldup_tdm_offset_entry_point, 1, 2},
+};
+
+/* I2S with the codec as master - starts by finding the LRCK edge */
+static const i2s_prog i2s_slave_prog =
+{
+	&i2s_fulldup_slave_program, i2s_fulldup_slave_program_get_default_config,
+	i2s_fulldup_slave_offset_sync_right, i2s_fulldup_slave_offset_sync_left, 0, 1
+};
+
+/*
+ * program for the current setup
+ */
+static const i2s_prog *i2s_prog_get(uint8_t fmt, uint8_t slave)
+{
+	return slave ? &i2s_slave_prog : &i2s_progs[fmt];
+}
+
+/*
+ * TDM input - split a buffer of FIFO words into one contiguous run per
+ * slot, MSB aligned in 32 bits
+ */
+static void __not_in_flash_func(i2s_tdm_deinterleave)(int32_t *dst, const uint32_t *src)
+{
+	uint32_t i, s;
+	
+	if(i2s_slot_bits == 16)
+	{
+		for(i=0;i<FRAMES_PER_BUFFER;i++)
+		{
+			for(s=0;s<i2s_slots;s+=2)
+			{
+				dst[s*FRAMES_PER_BUFFER + i] = *src & 0xFFFF0000;
+				dst[(s+1)*FRAMES_PER_BUFFER + i] = *src++ << 16;
+			}
+		}
+	}
+	else
+	{
+		for(i=0;i<FRAMES_PER_BUFFER;i++)
+			for(s=0;s<i2s_slots;s++)
+				dst[s*FRAMES_PER_BUFFER + i] = *src++;
+	}
+}
+
+/*
+ * TDM output - pack per slot runs back into FIFO order
+ */
+static void __not_in_flash_func(i2s_tdm_interleave)(uint32_t *dst, const int32_t *src)
+{
+	uint32_t i, s;
+	
+	if(i2s_slot_bits == 16)
+	{
+		for(i=0;i<FRAMES_PER_BUFFER;i++)
+			for(s=0;s<i2s_slots;s+=2)
+				*dst++ = (src[s*FRAMES_PER_BUFFER + i] & 0xFFFF0000) |
+					((uint32_t)src[(s+1)*FRAMES_PER_BUFFER + i] >> 16);
+	}
+	else
+	{
+		for(i=0;i<FRAMES_PER_BUFFER;i++)
+			for(s=0;s<i2s_slots;s++)
+				*dst++ = src[s*FRAMES_PER_BUFFER + i];
+	}
+}
+
+/*
+ * default block callback - the current audio mode, in the current format
+ */
+void __not_in_flash_func(i2s_fulldup_proc_audio)(i2s_inst *i2s, uint32_t *dst,
+	uint32_t *src)
+{
+	(void)i2s;
+	if(i2s_fmt == FMT_TDM)
+	{
+		i2s_tdm_deinterleave(tdm_in, src);
+		Audio_Proc_TDM(tdm_out, tdm_in, i2s_slots, FRAMES_PER_BUFFER);
+		i2s_tdm_interleave(dst, tdm_out);
+	}
+	else if(i2s_slot_bits == 16)
+		Audio_Proc((int16_t *)dst, (int16_t *)src, 2*FRAMES_PER_BUFFER);
+	else if(!i2s_rj_shift)
+		Audio_Proc32((int32_t *)dst, (int32_t *)src, 2*FRAMES_PER_BUFFER);
+	else
+	{
+		/*
+		 * right justified - MSB align for processing and back again. The
+		 * input may sit in a capture ring so it's aligned into tdm_in.
+		 */
+		int32_t *d = (int32_t *)dst;
+		for(uint i=0;i<i2s_words;i++)
+			tdm_in[i] = src[i] << i2s_rj_shift;
+		Audio_Proc32(d, tdm_in, 2*FRAMES_PER_BUFFER);
+		for(uint i=0;i<i2s_words;i++)
+			d[i] >>= i2s_rj_shift;
+	}
+}
+
+/*
+ * block callback for the other instances - send what the instance before
+ * this one sends, so down the chain every codec gets instance 0's
+ * stimulus. The input block src is left where it landed for any tap.
+ * Instances are handled in order so this sees the previous one's block
+ * from the same LRCK period.
+ */
+void __not_in_flash_func(i2s_fulldup_proc_mirror)(i2s_inst *i2s, uint32_t *dst,
+	uint32_t *src)
+{
+	(void)src;
+	if(i2s->idx)
+		memcpy(dst, i2s[-1].xfer_buf, i2s_words*sizeof(uint32_t));
+}
+
+/*
+ * slip watchdog - the half of the program the state machine is in as an
+ * input block completes only changes if the words slip against the frame,
+ * which swaps the slots. Learn it over the first blocks after a start,
+ * then flag a slip for core 0 when most of the recent blocks disagree.
+ * TDM runs the whole frame in one loop so there's nothing to see.
+ */
+static void __not_in_flash_func(i2s_phase_check)(i2s_inst *i2s)
+{
+	uint8_t half;
+	
+	if(i2s->slipped || !i2s_phase_split)
+		return;
+	half = ((i2s->phase_pc - pio_offset) < i2s_phase_split) ? 1 : 0;
+	
+	if(i2s_phase_vote(&i2s->phase, half))
+	{
+		i2s->slips++;
+		i2s->slipped = 1;
+		TRACE(TRC_SLIP, TRC_SRC_I2S + i2s->idx, i2s->slips, half);
+	}
+}
 
 /*
  * IRQ0 handler - used only for I2S input
@@ -53,55 +269,106 @@ uint32_t Fsample;
  */
 void dma_input_handler(void)
 {
+	uint32_t start, *done;
+	i2s_inst *i2s;
+	
 	gpio_put(IN_DIAG_PIN, 1);
 	
-	/* Clear IRQ for I2S input */
-	dma_channel_acknowledge_irq0(dma_chan_input);
+	/* where each finished state machine is, before any block work */
+	for(uint n=0;n<I2S_INSTANCES;n++)
+		if(dma_channel_get_irq0_status(i2s_insts[n].dma_chan_input))
+			i2s_insts[n].phase_pc = pio_sm_get_pc(pio, i2s_insts[n].sm);
 	
-	/* reset write address to start of next buffer */
-	ib_idx ^= 1;
-	dma_channel_set_write_addr(dma_chan_input,
-		&input_buf[ib_idx*FRAMES_PER_BUFFER],
-		true
-	);
-	
-	/* start next transfer sequence */
-	dma_channel_start(dma_chan_input);
+	for(uint n=0;n<I2S_INSTANCES;n++)
+	{
+		i2s = &i2s_insts[n];
+		if(!dma_channel_get_irq0_status(i2s->dma_chan_input))
+			continue;
+		start = time_us_32();
+		i2s_phase_check(i2s);
+		
+		/* Clear IRQ for I2S input */
+		dma_channel_acknowledge_irq0(i2s->dma_chan_input);
+		
+		/* take the sniffer's total for this block before the next starts */
+		if(i2s->sniff)
+		{
+			i2s->sniff_crc = dma_sniffer_get_data_accumulator();
+			dma_sniffer_set_data_accumulator(I2S_SNIFF_SEED);
+		}
+		
+		/* reset write address to start of next buffer - or ring block */
+		done = i2s->in_blk;
+		i2s->ib_idx ^= 1;
+		if(i2s->ring)
+		{
+			if(++i2s->ring_idx >= i2s->ring_blocks)
+				i2s->ring_idx = 0;
+			i2s->in_blk = &i2s->ring[i2s->ring_idx*i2s_words];
+		}
+		else
+			i2s->in_blk = &i2s->input_buf[i2s->ib_idx*i2s_words];
+		dma_channel_set_write_addr(i2s->dma_chan_input, i2s->in_blk, true);
+		
+		/* start next transfer sequence */
+		dma_channel_start(i2s->dma_chan_input);
+		
+		/* process to transfer buffer */
+		i2s->proc(i2s, i2s->xfer_buf, done);
+		if(i2s->tap)
+			i2s->tap(i2s, done);
+		
+		/* run time, for anyone watching bus contention */
+		start = time_us_32() - start;
+		i2s->isr.blocks++;
+		i2s->isr.us_sum += start;
+		if(start > i2s->isr.us_max)
+			i2s->isr.us_max = start;
+		if(start > i2s_stall_us)
+			i2s->isr.stalls++;
+		
+		TRACE(TRC_DMA_IN, TRC_SRC_I2S + n, i2s->ib_idx, start);
+	}
 	
-	/* process to transfer buffer */
-	Audio_Proc((int16_t *)xfer_buf,
-	(int16_t *)&input_buf[(ib_idx^1)*FRAMES_PER_BUFFER],
-		2*FRAMES_PER_BUFFER);
-
 	gpio_put(IN_DIAG_PIN, 0);
 }
 
 /*
  * IRQ1 handler - used only for I2S output
- * ATM this is not double-buffered, but it would be prudent to
- * do so if adding code to compute the next buffer.
+ * ATM this is not double-buffered - the DMA reads the one block again
+ * while the next is copied in ahead of it. It would be prudent to
+ * double-buffer if adding code to compute the next buffer.
  */
 void dma_output_handler()
 {
-	gpio_put(OUT_DIAG_PIN, 1);
+	uint32_t start;
+	i2s_inst *i2s;
 	
-	/* Clear IRQ for I2S output */
-    dma_channel_acknowledge_irq1(dma_chan_output);
-	
-	/* reset read address to start of next buffer */
-	ob_idx ^= 1;
-	dma_channel_set_read_addr(dma_chan_output,
-		&output_buf[ob_idx*FRAMES_PER_BUFFER],
-		true
-	);
+	gpio_put(OUT_DIAG_PIN, 1);
 	
-	/* start next transfer sequence */
-	dma_channel_start(dma_chan_output);
+	for(uint n=0;n<I2S_INSTANCES;n++)
+	{
+		i2s = &i2s_insts[n];
+		if(!dma_channel_get_irq1_status(i2s->dma_chan_output))
+			continue;
+		start = time_us_32();
+		
+		/* Clear IRQ for I2S output */
+		dma_channel_acknowledge_irq1(i2s->dma_chan_output);
+		
+		/* reset read address to start of the buffer */
+		i2s->ob_idx ^= 1;
+		dma_channel_set_read_addr(i2s->dma_chan_output, i2s->output_buf, true);
+		
+		/* start next transfer sequence */
+		dma_channel_start(i2s->dma_chan_output);
+		
+		/* copy from transfer buffer */
+		memcpy(i2s->output_buf, i2s->xfer_buf, i2s_words*sizeof(uint32_t));
+		
+		TRACE(TRC_DMA_OUT, TRC_SRC_I2S + n, i2s->ob_idx, time_us_32() - start);
+	}
 	
-	/* copy from transfer buffer */
-	memcpy(&output_buf[ob_idx*FRAMES_PER_BUFFER], xfer_buf,
-		FRAMES_PER_BUFFER*sizeof(uint32_t));
-
 	gpio_put(OUT_DIAG_PIN, 0);
 }
 
@@ -132,104 +399,401 @@ void core1_entry()
 #endif
 
 /*
- * initialize the I2S processing
+ * find clocks & dividers for a sample rate, slot width & count - returns
+ * 0 if ok
  */
-void init_i2s_fulldup(void)
+int32_t i2s_fulldup_plan(clkplan *plan, uint32_t fs, uint8_t slot_bits,
+	uint8_t slots)
 {
-	int32_t i;
-	int16_t *obuf = (int16_t *)output_buf;
-	int16_t *ibuf = (int16_t *)input_buf;
+	if((slot_bits != 16) && (slot_bits != 32))
+		return 1;
+	if((slots != 2) && (slots != 4) && (slots != 8) && (slots != 16))
+		return 1;
 	
-	/* clear buffers */
-	for(i=0;i<2*FRAMES_PER_BUFFER;i++)
+	return clkplan_solve(plan, fs, I2S_MCLK_RATIO,
+		I2S_FRAME_CYCLES(slot_bits, slots));
+}
+
+/*
+ * switch clk_sys, PIO divider & MCLK to a plan - I2S must be stopped
+ */
+void i2s_fulldup_clocks(const clkplan *plan)
+{
+	/* switch clk_sys if the current clock doesn't match */
+	if(clock_get_hz(clk_sys) != plan->sys_hz)
 	{
-		*ibuf++ = 0;
-		*ibuf++ = 0;
-		*obuf++ = i<<10;
-		*obuf++ = i<<10;
+		clkplan_apply(plan);
+		Codec_Reclock();
 	}
-	ib_idx = ob_idx = 0;
 	
-	/* diag GPIO */
-	gpio_init(IN_DIAG_PIN);
-	gpio_set_dir(IN_DIAG_PIN, GPIO_OUT);
-	gpio_init(OUT_DIAG_PIN);
-	gpio_set_dir(OUT_DIAG_PIN, GPIO_OUT);
+	/* generate an MCLK on GPIO at the plan's MCLK/Fs ratio */
+	clock_gpio_init(I2S_MCLK_PIN, CLOCKS_CLK_GPOUT1_CTRL_AUXSRC_VALUE_CLK_SYS, plan->mclk_div);
+	
+	Fsample = (plan->fs_mhz + 500) / 1000;
+	pio_div = plan->pio_div;
+}
 
-    /* set up PIO */
-    pio = pio0;
-    uint offset = pio_add_program(pio, &i2s_fulldup_program);
-    printf("loaded program at offset: %i\n", offset);
-    sm = pio_claim_unused_sm(pio, true);
-    printf("claimed sm: %i\n", sm);
-	
-	/* compute PIO divider for desired sample rate */
-    uint32_t system_clock_frequency = clock_get_hz(clk_sys);
-    assert(system_clock_frequency < 0x40000000);
-    printf("System clock %u Hz\n", (uint) system_clock_frequency);
-    uint32_t sample_freq = 48000;
-    printf("Target sample freq %d\n", sample_freq);
-    uint32_t divider = system_clock_frequency * 2 / sample_freq; // avoid arithmetic overflow
-    divider = divider & ~(0x1ff); // mask off bottom 9 for exact MCLK/BCLK ratio of 4.0
-    assert(divider < 0x1000000);
-    printf("PIO clock divider 0x%x/256\n", divider);
-	Fsample = 2 * system_clock_frequency / divider;
-	printf("Actual sample freq = %d\n", Fsample);
+/*
+ * switch the framing format, word length, slot count & clocking - I2S
+ * must be stopped and the clocks planned for the same slots. The PIO only
+ * has room for one variant so the program is swapped if it changes. As
+ * slave the codec drives BCLK & LRCK, I2S framing with 2 slots only.
+ * Input rings are dropped.
+ */
+void i2s_fulldup_format(uint8_t fmt, uint8_t bits, uint8_t slots,
+	uint8_t slave)
+{
+	const pio_program_t *prog = i2s_prog_get(fmt, slave)->prog;
+	
+	if(prog != i2s_prog_get(i2s_fmt, i2s_slave)->prog)
+	{
+		pio_remove_program(pio, i2s_prog_get(i2s_fmt, i2s_slave)->prog,
+			pio_offset);
+		pio_offset = pio_add_program(pio, prog);
+	}
+	
+	i2s_slave = slave;
+	i2s_fmt = fmt;
+	i2s_bits = bits;
+	i2s_slot_bits = I2S_SLOT_BITS(bits);
+	i2s_slots = slots;
+	i2s_words = FRAMES_PER_BUFFER * slots * i2s_slot_bits / 32;
+	i2s_rj_shift = (fmt == FMT_RJ) ? i2s_slot_bits - bits : 0;
+	
+	/* input rings are cut into blocks of the old length */
+	for(uint n=0;n<I2S_INSTANCES;n++)
+	{
+		i2s_insts[n].ring = NULL;
+		i2s_insts[n].tap = NULL;
+	}
+}
+
+/* set while core 1 has its DMA ISRs masked */
+static volatile uint8_t i2s_isr_parked;
+
+/*
+ * mask or unmask the DMA ISRs on the calling core - core 1 parks itself
+ * so core 0 can reconfigure I2S without taking the lockout
+ */
+void i2s_fulldup_park(uint8_t park)
+{
+	irq_set_enabled(DMA_IRQ_0, !park);
+	irq_set_enabled(DMA_IRQ_1, !park);
+	i2s_isr_parked = park;
+}
+
+/*
+ * keep the DMA ISRs from running
+ */
+static void i2s_isr_hold(void)
+{
+#ifdef MULTICORE
+	/* hold core 1 outside the DMA ISRs, unless it's parked already */
+	if(!i2s_isr_parked)
+		Audio_Disable_Core(1);
+#else
+	irq_set_enabled(DMA_IRQ_0, false);
+	irq_set_enabled(DMA_IRQ_1, false);
+#endif
+}
+
+/*
+ * let the DMA ISRs run again
+ */
+static void i2s_isr_release(void)
+{
+#ifdef MULTICORE
+	if(!i2s_isr_parked)
+		Audio_Disable_Core(0);
+#else
+	irq_set_enabled(DMA_IRQ_0, true);
+	irq_set_enabled(DMA_IRQ_1, true);
+#endif
+}
+
+/*
+ * mask of the state machines in use
+ */
+static uint32_t i2s_sm_mask(void)
+{
+	uint32_t mask = 0;
+	
+	for(uint n=0;n<I2S_INSTANCES;n++)
+		mask |= 1u << i2s_insts[n].sm;
+	
+	return mask;
+}
+
+/*
+ * set the block callback for an instance - safe with audio running
+ */
+void i2s_fulldup_set_proc(uint8_t idx, i2s_proc_fn proc, void *user)
+{
+	if(idx >= I2S_INSTANCES)
+		return;
+	
+	i2s_isr_hold();
+	i2s_insts[idx].user = user;
+	i2s_insts[idx].proc = proc;
+	i2s_isr_release();
+}
+
+/*
+ * land an instance's input blocks in turn round a ring of blocks of
+ * i2s_words each rather than the ping-pong buffers, and call tap with each
+ * - NULL ring goes back to the buffers. The tap may clear i2s->ring
+ * itself. Safe with audio running.
+ */
+void i2s_fulldup_set_ring(uint8_t idx, uint32_t *ring, uint blocks,
+	i2s_tap_fn tap)
+{
+	if(idx >= I2S_INSTANCES)
+		return;
+	
+	i2s_isr_hold();
+	i2s_insts[idx].ring_blocks = blocks;
+	i2s_insts[idx].ring_idx = blocks - 1;
+	i2s_insts[idx].ring = ring;
+	i2s_insts[idx].tap = tap;
+	i2s_isr_release();
+}
+
+/*
+ * instances the watchdog has seen slip since they last started, as a mask
+ */
+uint32_t i2s_fulldup_slipped(void)
+{
+	uint32_t mask = 0;
 	
-	/* set up the PIO and divider */
+	for(uint n=0;n<I2S_INSTANCES;n++)
+		if(i2s_insts[n].slipped)
+			mask |= 1u << n;
+	
+	return mask;
+}
+
+/*
+ * stop the PIO & DMA - safe to call with audio running
+ */
+void i2s_fulldup_stop(void)
+{
+	i2s_inst *i2s;
+	
+	i2s_isr_hold();
+	
+	/* no more DREQs */
+	pio_set_sm_mask_enabled(pio, i2s_sm_mask(), false);
+	
+	for(uint n=0;n<I2S_INSTANCES;n++)
+	{
+		i2s = &i2s_insts[n];
+		
+		/* mask channel IRQs before abort so no stray completion fires */
+		dma_channel_set_irq0_enabled(i2s->dma_chan_input, false);
+		dma_channel_set_irq1_enabled(i2s->dma_chan_output, false);
+		dma_channel_abort(i2s->dma_chan_input);
+		dma_channel_abort(i2s->dma_chan_output);
+		dma_channel_acknowledge_irq0(i2s->dma_chan_input);
+		dma_channel_acknowledge_irq1(i2s->dma_chan_output);
+	}
+	
+	i2s_isr_release();
+}
+
+/*
+ * I2S buffers in SRAM4 with the DMA ahead of the cores on the bus, or in
+ * striped SRAM at the default priority - buffers move at the next start
+ */
+void i2s_fulldup_place(uint8_t banked)
+{
+	i2s_banked = banked;
+	bus_ctrl_hw->priority = banked ?
+		BUSCTRL_BUS_PRIORITY_DMA_W_BITS | BUSCTRL_BUS_PRIORITY_DMA_R_BITS : 0;
+}
+
+/*
+ * take an instance's input ISR times & start over
+ */
+void i2s_fulldup_isr_times(uint8_t idx, i2s_isr_times *times)
+{
+	i2s_isr_hold();
+	*times = i2s_insts[idx].isr;
+	memset(&i2s_insts[idx].isr, 0, sizeof(i2s_isr_times));
+	i2s_isr_release();
+}
+
+/*
+ * clear buffers and (re)start one state machine & its DMA, leaving the
+ * state machine disabled
+ */
+static void i2s_inst_start(i2s_inst *i2s)
+{
+	const i2s_prog *p = i2s_prog_get(i2s_fmt, i2s_slave);
+	
+	/* relearn the block phase */
+	i2s_phase_reset(&i2s->phase);
+	i2s->slipped = 0;
+	
+	/* buffers in SRAM4 when the blocks fit */
+	if(i2s_banked && (i2s_words <= I2S_BANK_WORDS))
+	{
+		i2s->input_buf = bank_input_buf[i2s->idx];
+		i2s->output_buf = bank_output_buf[i2s->idx];
+	}
+	else
+	{
+		i2s->input_buf = input_buf[i2s->idx];
+		i2s->output_buf = output_buf[i2s->idx];
+	}
+	
+	/* clean buffers */
+	memset(i2s->input_buf, 0, 2*i2s_words*sizeof(uint32_t));
+	memset(i2s->output_buf, 0, i2s_words*sizeof(uint32_t));
+	memset(i2s->xfer_buf, 0, WORDS_MAX*sizeof(uint32_t));
+	
+	/* reset the state machine, FIFOs & pins */
     i2s_fulldup_program_init(
 		pio,
-		sm,
-		offset,
-		I2S_DO_PIN,
-		I2S_DI_PIN,
-		I2S_CLK_PIN_BASE
+		i2s->sm,
+		pio_offset,
+		p->get_config(pio_offset),
+		(i2s_slot_bits > 16) ? p->entry_left : p->entry_point,
+		i2s->do_pin,
+		i2s->di_pin,
+		i2s->clk_pin_base,
+		(p->frame_loop ? i2s_slots * i2s_slot_bits : i2s_slot_bits) - p->y_adj,
+		!i2s_slave
 	);
-    pio_sm_set_clkdiv_int_frac(pio, sm, divider >> 8u, divider & 0xffu);
 	
-	/* generate an MCLK on GPIO at 8x BCLK (256x LRCK) */
-	gpio_set_function(I2S_MCLK_PIN, GPIO_FUNC_GPCK);
-	clock_gpio_init(I2S_MCLK_PIN, CLOCKS_CLK_GPOUT1_CTRL_AUXSRC_VALUE_CLK_SYS, divider>>9);
-	printf("MCLK at %d Hz\n", system_clock_frequency/(divider>>9));
-	
-    /* configure dma channel for input */
-	ib_idx = 0;
-    dma_chan_input = dma_claim_unused_channel(true);
-	printf("DMA input using chl %d\n", dma_chan_input);
-    dma_channel_config c = dma_channel_get_default_config(dma_chan_input);
+	/* the slave follows BCLK so samples it as fast as it can */
+	if(i2s_slave)
+		pio_sm_set_clkdiv_int_frac(pio, i2s->sm, 1, 0);
+	else
+		pio_sm_set_clkdiv_int_frac(pio, i2s->sm, pio_div >> 8u, pio_div & 0xffu);
+	
+    /* input dma to first half */
+	i2s->ib_idx = 0;
+	i2s->in_blk = i2s->input_buf;
+    dma_channel_config c = dma_channel_get_default_config(i2s->dma_chan_input);
     channel_config_set_read_increment(&c,false);
     channel_config_set_write_increment(&c,true);
-    channel_config_set_dreq(&c,pio_get_dreq(pio,sm,false));
+    channel_config_set_dreq(&c,pio_get_dreq(pio,i2s->sm,false));
     channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
-
+	channel_config_set_sniff_enable(&c, i2s->sniff);
+	if(i2s->sniff)
+		dma_sniffer_set_data_accumulator(I2S_SNIFF_SEED);
     dma_channel_configure(
-        dma_chan_input,
+        i2s->dma_chan_input,
         &c,
-        input_buf, 			// Destination pointer
-        &pio->rxf[sm], 		// Source pointer
-        FRAMES_PER_BUFFER, // Number of transfers
-        true				// Start immediately
+        i2s->input_buf, 		// Destination pointer
+        &pio->rxf[i2s->sm], 	// Source pointer
+        i2s_words,				// Number of transfers
+        true					// Start immediately
     );
-    dma_channel_set_irq0_enabled(dma_chan_input, true);
+    dma_channel_set_irq0_enabled(i2s->dma_chan_input, true);
 
-    /* configure dma channel for output */
-	ob_idx = 0;
-	dma_chan_output = dma_claim_unused_channel(true);
-	printf("DMA output using chl %d\n", dma_chan_output);
-    dma_channel_config cc = dma_channel_get_default_config(dma_chan_output);
+    /* output dma from the block */
+	i2s->ob_idx = 0;
+    dma_channel_config cc = dma_channel_get_default_config(i2s->dma_chan_output);
     channel_config_set_read_increment(&cc,true);
     channel_config_set_write_increment(&cc,false);
-    channel_config_set_dreq(&cc,pio_get_dreq(pio,sm,true));
+    channel_config_set_dreq(&cc,pio_get_dreq(pio,i2s->sm,true));
     channel_config_set_transfer_data_size(&cc, DMA_SIZE_32);
     dma_channel_configure(
-        dma_chan_output,
+        i2s->dma_chan_output,
         &cc,
-        &pio->txf[sm],		// Destination pointer
-        output_buf,			// Source pointer
-        FRAMES_PER_BUFFER,	// Number of transfers
-        true				// Start immediately
+        &pio->txf[i2s->sm],		// Destination pointer
+        i2s->output_buf,		// Source pointer
+        i2s_words,				// Number of transfers
+        true					// Start immediately
     );
-    dma_channel_set_irq1_enabled(dma_chan_output, true);
+    dma_channel_set_irq1_enabled(i2s->dma_chan_output, true);
+}
+
+/*
+ * clear buffers and (re)start the PIO & DMA from the top of a frame
+ */
+void i2s_fulldup_start(void)
+{
+	const i2s_prog *p = i2s_prog_get(i2s_fmt, i2s_slave);
+	
+	/* the slot loops are either side of entry_left */
+	i2s_phase_split = p->frame_loop ? 0 : p->entry_left;
+	
+	for(uint n=0;n<I2S_INSTANCES;n++)
+		i2s_inst_start(&i2s_insts[n]);
+	
+	/* go - in one write so every LRCK is in phase */
+	pio_enable_sm_mask_in_sync(pio, i2s_sm_mask());
+	
+	/* watch LRCK from here, whoever drives it */
+	fsmeas_start(Fsample);
+}
+
+/*
+ * initialize the I2S processing
+ */
+void init_i2s_fulldup(void)
+{
+	/* diag GPIO */
+	gpio_init(IN_DIAG_PIN);
+	gpio_set_dir(IN_DIAG_PIN, GPIO_OUT);
+	gpio_init(OUT_DIAG_PIN);
+	gpio_set_dir(OUT_DIAG_PIN, GPIO_OUT);
+
+    /* set up PIO */
+    pio = pio0;
+    pio_offset = pio_add_program(pio, i2s_prog_get(i2s_fmt, i2s_slave)->prog);
+    printf("loaded program at offset: %i\n", pio_offset);
+	
+	/* find clocks & dividers for desired sample rate */
+	clkplan plan;
+	uint64_t t0 = time_us_64();
+	uint32_t sample_freq = I2S_FS_DEFAULT;
+	printf("Target sample freq %d\n", sample_freq);
+	if(i2s_fulldup_plan(&plan, sample_freq, I2S_SLOT_BITS(I2S_BITS_DEFAULT),
+		I2S_SLOTS_DEFAULT))
+		panic("No clock plan for %d Hz", sample_freq);
+	printf("Clock plan in %d us: VCO %d Hz / %d / %d, error %d ppb\n",
+		(uint32_t)(time_us_64() - t0), plan.vco_hz, plan.postdiv1,
+		plan.postdiv2, plan.err_ppb);
+	
+	/* set clocks & MCLK output */
+	gpio_set_function(I2S_MCLK_PIN, GPIO_FUNC_GPCK);
+	i2s_fulldup_clocks(&plan);
+	i2s_fulldup_format(I2S_FMT_DEFAULT, I2S_BITS_DEFAULT, I2S_SLOTS_DEFAULT, 0);
+    printf("System clock %u Hz\n", (uint) clock_get_hz(clk_sys));
+    printf("PIO clock divider 0x%x/256\n", pio_div);
+	printf("Actual sample freq = %d\n", Fsample);
+	printf("MCLK at %d Hz\n", clock_get_hz(clk_sys)/plan.mclk_div);
+	
+	/* claim a state machine & dma channels for each instance */
+	for(uint n=0;n<I2S_INSTANCES;n++)
+	{
+		i2s_inst *i2s = &i2s_insts[n];
+		
+		i2s->idx = n;
+		i2s->do_pin = i2s_pins[n][0];
+		i2s->di_pin = i2s_pins[n][1];
+		i2s->clk_pin_base = i2s_pins[n][2];
+		i2s->xfer_buf = xfer_buf[n];
+		i2s->proc = n ? i2s_fulldup_proc_mirror : i2s_fulldup_proc_audio;
+		i2s->user = NULL;
+		i2s->sniff = 0;
+		
+		i2s->sm = pio_claim_unused_sm(pio, true);
+		i2s->dma_chan_input = dma_claim_unused_channel(true);
+		i2s->dma_chan_output = dma_claim_unused_channel(true);
+		printf("I2S%d: sm %d, DMA input chl %d, output chl %d, DO %d DI %d BCLK %d\n",
+			n, i2s->sm, i2s->dma_chan_input, i2s->dma_chan_output,
+			i2s->do_pin, i2s->di_pin, i2s->clk_pin_base);
+	}
+	
+	/* stereo buffers in SRAM4 & DMA first on the bus */
+	i2s_fulldup_place(i2s_banked);
+	printf("I2S buffers at 0x%08X, SRAM4 0x%08X, bus priority 0x%X\n",
+		(uint32_t)(uintptr_t)input_buf, (uint32_t)(uintptr_t)bank_input_buf,
+		bus_ctrl_hw->priority);
     
 #ifndef MULTICORE
 	/* No multi-core - just use core 0 */
@@ -249,7 +813,10 @@ void init_i2s_fulldup(void)
 	printf("Multicore background started\n");
 #endif
 
-	/* Start PIO */
-    pio_sm_set_enabled(pio, sm, true);
+	/* frame rate counter on the other PIO */
+	fsmeas_init(I2S_CLK_PIN_BASE+1);
+	
+	/* Start DMA & PIO */
+	i2s_fulldup_start();
 	printf("PIO started\n");
 }
@@ -6,9 +6,109 @@
 #define __i2s_fulldup__
 
 #include "main.h"
+#include "clkplan.h"
+#include "codec.h"
+#include "i2s_phase.h"
 
+/* default rate, framing, word length & clocking */
+#define I2S_FS_DEFAULT 48000
+#define I2S_FMT_DEFAULT FMT_I2S
+#define I2S_BITS_DEFAULT 16
+#define I2S_MCLK_RATIO 256
+
+/* 16-bit words go in 16-bit slots, 24 & 32-bit in 32-bit slots */
+#define I2S_SLOT_BITS(bits) ((bits) > 16 ? 32 : 16)
+
+/* slots per frame - 2 except for TDM */
+#define I2S_SLOTS_DEFAULT 2
+#define I2S_TDM_SLOTS_MAX 16
+
+/* engines on separate pin groups, sharing clocks, format & PIO program */
+#ifdef DUAL_I2S
+#define I2S_INSTANCES 2
+#else
+#define I2S_INSTANCES 1
+#endif
+
+/* the sniffer restarts from this for every input block */
+#define I2S_SNIFF_SEED 0xFFFFFFFF
+
+/*
+ * stereo blocks fit buffers in SRAM4, away from the striped banks & the
+ * stack core 0 works in - up to 2 x 32-bit slots of 32 frames
+ */
+#define I2S_BANK_WORDS 64
+
+typedef struct i2s_inst i2s_inst;
+
+/* input ISR run times since they were last read */
+typedef struct
+{
+	uint32_t blocks;
+	uint32_t us_sum, us_max;
+	uint32_t stalls;		// blocks that took over i2s_stall_us
+} i2s_isr_times;
+
+/*
+ * block callback - called from the input DMA ISR with the FIFO words just
+ * received to fill the next block to send, both i2s_words long
+ */
+typedef void (*i2s_proc_fn)(i2s_inst *i2s, uint32_t *dst, uint32_t *src);
+
+/* input tap - called from the input DMA ISR with each block after proc */
+typedef void (*i2s_tap_fn)(i2s_inst *i2s, uint32_t *src);
+
+/* one engine - a state machine, DMA pair, pins & buffers */
+struct i2s_inst
+{
+	uint8_t idx;
+	uint do_pin, di_pin, clk_pin_base;
+	uint sm, dma_chan_input, dma_chan_output;
+	uint ib_idx, ob_idx;	// input half, output block parity
+	uint32_t *input_buf, *output_buf, *xfer_buf;
+	i2s_proc_fn proc;
+	void *user;				// for the callback
+	uint8_t sniff;			// DMA sniffer is on the input channel
+	uint32_t sniff_crc;		// sniffer total for the block being processed
+	uint32_t *in_blk;		// block the input DMA is filling
+	
+	/* input ring - blocks land in it in place of input_buf while set */
+	uint32_t *volatile ring;
+	uint ring_blocks, ring_idx;
+	i2s_tap_fn tap;
+	
+	/* slip watchdog */
+	uint phase_pc;			// program counter as the block completed
+	i2s_phase phase;
+	volatile uint8_t slipped;
+	uint32_t slips;
+	
+	i2s_isr_times isr;
+};
+
+extern i2s_inst i2s_insts[I2S_INSTANCES];
+extern uint i2s_words;
 extern uint32_t Fsample;
+extern uint8_t i2s_bits, i2s_slot_bits, i2s_fmt, i2s_slots, i2s_slave;
+extern uint8_t i2s_banked;
+extern uint32_t i2s_stall_us;
 
 void init_i2s_fulldup(void);
+int32_t i2s_fulldup_plan(clkplan *plan, uint32_t fs, uint8_t slot_bits,
+	uint8_t slots);
+void i2s_fulldup_clocks(const clkplan *plan);
+void i2s_fulldup_format(uint8_t fmt, uint8_t bits, uint8_t slots,
+	uint8_t slave);
+void i2s_fulldup_park(uint8_t park);
+void i2s_fulldup_stop(void);
+void i2s_fulldup_start(void);
+uint32_t i2s_fulldup_slipped(void);
+void i2s_fulldup_place(uint8_t banked);
+void i2s_fulldup_isr_times(uint8_t idx, i2s_isr_times *times);
+void i2s_fulldup_set_proc(uint8_t idx, i2s_proc_fn proc, void *user);
+void i2s_fulldup_set_ring(uint8_t idx, uint32_t *ring, uint blocks,
+	i2s_tap_fn tap);
+void i2s_fulldup_proc_audio(i2s_inst *i2s, uint32_t *dst, uint32_t *src);
+void i2s_fulldup_proc_mirror(i2s_inst *i2s, uint32_t *dst, uint32_t *src);
 
 #endif
\ No newline at end of file
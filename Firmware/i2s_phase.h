@@ -0,0 +1,53 @@
+/*
+ * i2s_phase.h - slip watchdog vote on the half of the PIO program each
+ * input block ends in, kept free of the SDK so pio_emu.c runs it too
+ */
+
+#ifndef __i2s_phase__
+#define __i2s_phase__
+
+#include <stdint.h>
+
+/*
+ * blocks to learn the program half a block ends in, and how many of the
+ * last 16 must disagree to call it a slip
+ */
+#define I2S_PHASE_LEARN 16
+#define I2S_PHASE_TRIP 12
+
+typedef struct
+{
+	uint8_t n, votes, ref;
+	uint16_t hist;			// 1 for each recent block out of phase
+} i2s_phase;
+
+/*
+ * learn the block phase again from the next block
+ */
+static inline void i2s_phase_reset(i2s_phase *ph)
+{
+	ph->n = 0;
+	ph->votes = 0;
+	ph->ref = 0;
+	ph->hist = 0;
+}
+
+/*
+ * one block ended in the given half - learn the usual one over the first
+ * I2S_PHASE_LEARN, then returns 1 while most of the recent ones disagree
+ */
+static inline uint8_t i2s_phase_vote(i2s_phase *ph, uint8_t half)
+{
+	if(ph->n < I2S_PHASE_LEARN)
+	{
+		ph->votes += half;
+		if(++ph->n == I2S_PHASE_LEARN)
+			ph->ref = (2*ph->votes > I2S_PHASE_LEARN) ? 1 : 0;
+		return 0;
+	}
+
+	ph->hist = (uint16_t)((ph->hist << 1) | (half != ph->ref));
+	return __builtin_popcount(ph->hist) >= I2S_PHASE_TRIP;
+}
+
+#endif
@@ -0,0 +1,451 @@
+/*
+ * latency.c - round trip latency from an MLS burst through the codec
+ *
+ * One I2S instance sends a burst of a 10-bit MLS on every slot and keeps
+ * what comes back in slot 0, all from the input ISR callback with a few
+ * operations a frame. The burst repeats the MLS for LATENCY_LAG_MAX frames
+ * more than a period and only the last period back is kept, so the loop
+ * has settled and the correlation is circular with flat sidelobes. The
+ * idle loop then cross-correlates burst and capture a slice of lags at a
+ * time and takes the round trip from the peak, to a fraction of a frame
+ * by searching the correlation between lags with windowed sinc
+ * interpolation, before arming the next burst. The share of the
+ * ping-pong buffers is read off the DMA halves when the burst starts and
+ * the rest is put down to the codec's DAC & ADC filters.
+ *
+ * rp2040_i2s_latency in the host build is this with LATENCY_HOST, measuring
+ * modelled codecs with known fractional delays.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "latency.h"
+#ifndef LATENCY_HOST
+#include "i2s_fulldup.h"
+#else
+#define __not_in_flash_func(f) f
+enum {FMT_I2S, FMT_LJ, FMT_RJ, FMT_DSP_A, FMT_DSP_B, FMT_TDM};
+
+/* just what the measurement uses of the I2S engine */
+typedef struct
+{
+	uint32_t ib_idx, ob_idx;
+} i2s_inst;
+
+static uint32_t i2s_words, Fsample;
+static uint8_t i2s_bits, i2s_slot_bits, i2s_fmt, i2s_slots;
+#endif
+
+/* burst level - half scale */
+#define LATENCY_AMP 16384
+
+/* frames sent - the last period is kept */
+#define LATENCY_BURST_LEN (LATENCY_MLS_LEN + LATENCY_LAG_MAX)
+
+/* lags correlated per poll - about 1ms of M0+ time */
+#define LATENCY_LAGS_PER_POLL 16
+
+/* the peak must stand this far over anything else */
+#define LATENCY_PEAK_RATIO 4
+
+/* lags each side used to interpolate & golden section steps on the peak */
+#define LATENCY_INTERP 8
+#define LATENCY_SEARCH 32
+
+enum {LATENCY_IDLE, LATENCY_RUN, LATENCY_DONE};
+
+static int16_t latency_mls[LATENCY_MLS_LEN];
+static int16_t latency_cap[LATENCY_MLS_LEN];
+static int32_t latency_corr[LATENCY_LAG_MAX];
+static uint32_t latency_frame, latency_t0, latency_bframes, latency_lag;
+static uint32_t latency_mpos;
+static uint8_t latency_pipe;
+static volatile uint8_t latency_state, latency_arm;
+static latency_stats latency_n;
+
+/*
+ * slot word to a 16-bit sample - MSB aligned except RJ
+ */
+static inline int32_t latency_in(uint32_t w)
+{
+	if(i2s_slot_bits == 16)
+		return (int32_t)w >> 16;
+	if(i2s_fmt == FMT_RJ)
+		w <<= 32 - i2s_bits;
+	return (int32_t)w >> 16;
+}
+
+/*
+ * 16-bit sample to a slot word
+ */
+static inline uint32_t latency_out(int32_t v)
+{
+	if(i2s_slot_bits == 16)
+		return ((uint32_t)v << 16) | (v & 0xFFFF);
+	if(i2s_fmt == FMT_RJ)
+		return (uint32_t)(((int32_t)((uint32_t)v << 16)) >> (32 - i2s_bits));
+	return (uint32_t)v << 16;
+}
+
+/*
+ * block callback - starts a burst at the top of a block when armed, sends
+ * it and keeps the frames that come back. Runs in the input DMA ISR.
+ */
+static void __not_in_flash_func(latency_proc)(i2s_inst *i2s, uint32_t *dst,
+	uint32_t *src)
+{
+	uint32_t i, s, fw = i2s_words / latency_bframes, n;
+	uint32_t w;
+
+	if((latency_state == LATENCY_IDLE) && latency_arm)
+	{
+		latency_arm = 0;
+		latency_t0 = latency_frame;
+		latency_mpos = 0;
+
+		/* output half already swapped for this block - goes out after next */
+		latency_pipe = (i2s->ob_idx == i2s->ib_idx) ? 2 : 1;
+		latency_state = LATENCY_RUN;
+	}
+
+	for(i=0;i<latency_bframes;i++)
+	{
+		n = latency_frame + i - latency_t0;
+		w = 0;
+		if((latency_state == LATENCY_RUN) && (n < LATENCY_BURST_LEN))
+		{
+			w = latency_out(latency_mls[latency_mpos]);
+			if(++latency_mpos == LATENCY_MLS_LEN)
+				latency_mpos = 0;
+			if(n >= LATENCY_LAG_MAX)
+				latency_cap[n - LATENCY_LAG_MAX] = latency_in(src[i*fw]);
+		}
+		for(s=0;s<fw;s++)
+			*dst++ = w;
+	}
+	latency_frame += latency_bframes;
+
+	if((latency_state == LATENCY_RUN) &&
+		(latency_frame - latency_t0 >= LATENCY_BURST_LEN))
+	{
+		__sync_synchronize();
+		latency_state = LATENCY_DONE;
+	}
+}
+
+/*
+ * MLS & state for the current format, then arm the first burst
+ */
+static void latency_setup(void)
+{
+	uint32_t lfsr = 0x3FF, i, bit;
+
+	/* x^10 + x^7 + 1 */
+	for(i=0;i<LATENCY_MLS_LEN;i++)
+	{
+		bit = ((lfsr >> 9) ^ (lfsr >> 6)) & 1;
+		lfsr = ((lfsr << 1) | bit) & 0x3FF;
+		latency_mls[i] = bit ? LATENCY_AMP : -LATENCY_AMP;
+	}
+
+	latency_bframes = i2s_words * 32 / i2s_slot_bits / i2s_slots;
+	latency_frame = 0;
+	latency_lag = 0;
+	memset(&latency_n, 0, sizeof(latency_n));
+	latency_n.fs = Fsample;
+	latency_state = LATENCY_IDLE;
+	latency_arm = 1;
+}
+
+/*
+ * correlation at lag p + t from the lags around it - the burst is white
+ * so this is as band limited as the loop
+ */
+static double latency_interp(int32_t p, double t)
+{
+	double sum = 0.0, x;
+	int32_t k, l;
+
+	for(k=-LATENCY_INTERP;k<=LATENCY_INTERP;k++)
+	{
+		l = p + k;
+		if((l < 0) || (l >= LATENCY_LAG_MAX))
+			continue;
+		x = t - k;
+		if(fabs(x) < 1e-9)
+			sum += latency_corr[l];
+		else
+			sum += latency_corr[l] * sin(M_PI * x) / (M_PI * x) *
+				(0.5 + 0.5 * cos(M_PI * x / (LATENCY_INTERP + 1)));
+	}
+
+	return sum;
+}
+
+/*
+ * find the peak in the correlation & fold it into the results
+ */
+static void latency_peak(void)
+{
+	int32_t p = 0, l, sign;
+	uint32_t top = 0, next = 0, a;
+	double a0 = -1.0, a1 = 1.0, t0, t1, frames;
+	const double g = 0.6180339887;
+
+	for(l=0;l<LATENCY_LAG_MAX;l++)
+	{
+		a = abs(latency_corr[l]);
+		if(a > top)
+		{
+			top = a;
+			p = l;
+		}
+	}
+	for(l=0;l<LATENCY_LAG_MAX;l++)
+	{
+		a = abs(latency_corr[l]);
+		if(((l < p - 4) || (l > p + 4)) && (a > next))
+			next = a;
+	}
+	if(!top || (p == 0) || (p == LATENCY_LAG_MAX-1) ||
+		(top < LATENCY_PEAK_RATIO * next))
+	{
+		latency_n.misses++;
+		return;
+	}
+
+	/* golden section for the top within a lag either side */
+	sign = (latency_corr[p] < 0) ? -1 : 1;
+	for(l=0;l<LATENCY_SEARCH;l++)
+	{
+		t0 = a1 - g * (a1 - a0);
+		t1 = a0 + g * (a1 - a0);
+		if(sign * latency_interp(p, t0) > sign * latency_interp(p, t1))
+			a1 = t1;
+		else
+			a0 = t0;
+	}
+	t0 = (a0 + a1) / 2;
+	frames = p + t0;
+
+	latency_n.frames = frames;
+	if(!latency_n.runs || (frames < latency_n.frames_min))
+		latency_n.frames_min = frames;
+	if(!latency_n.runs || (frames > latency_n.frames_max))
+		latency_n.frames_max = frames;
+	latency_n.pipe_frames = latency_pipe * latency_bframes;
+	latency_n.codec_frames = frames - latency_n.pipe_frames;
+	latency_n.gain_db = 20.0 * log10(sign * latency_interp(p, t0) /
+		((double)LATENCY_MLS_LEN * LATENCY_AMP));
+	latency_n.inverted = (sign < 0);
+	latency_n.runs++;
+}
+
+/*
+ * correlate a finished capture a slice at a time - call from the idle loop
+ */
+void latency_poll(void)
+{
+	uint32_t k, n, j;
+	int32_t acc;
+
+	if(latency_state != LATENCY_DONE)
+		return;
+	__sync_synchronize();
+
+	for(k=0;(k<LATENCY_LAGS_PER_POLL) && (latency_lag<LATENCY_LAG_MAX);k++)
+	{
+		/*
+		 * capture starts LATENCY_LAG_MAX into the burst, lag frames after
+		 * MLS index LATENCY_LAG_MAX - lag. MLS is +/-1 so it's adds and
+		 * subtracts.
+		 */
+		j = LATENCY_LAG_MAX - latency_lag;
+		for(n=0, acc=0;n<LATENCY_MLS_LEN;n++)
+		{
+			acc += (latency_mls[j] > 0) ? latency_cap[n] : -latency_cap[n];
+			if(++j == LATENCY_MLS_LEN)
+				j = 0;
+		}
+		latency_corr[latency_lag++] = acc;
+	}
+	if(latency_lag < LATENCY_LAG_MAX)
+		return;
+
+	latency_peak();
+	latency_lag = 0;
+	latency_state = LATENCY_IDLE;
+	__sync_synchronize();
+	latency_arm = 1;
+}
+
+/*
+ * results since the last start
+ */
+void latency_get(latency_stats *stats)
+{
+	*stats = latency_n;
+}
+
+/*
+ * print the results
+ */
+void latency_report(void)
+{
+	latency_stats s;
+	double us;
+
+	latency_get(&s);
+	if(!s.runs)
+	{
+		printf("Latency: no burst found in %u\n", s.misses);
+		return;
+	}
+
+	us = 1e6 / s.fs;
+	printf("Latency: %.2f frames (%.1f us) = %u buffers + %.2f codec (%.1f us), %.2f to %.2f, gain %.1f dB%s, %u runs %u missed\n",
+		s.frames, s.frames * us, s.pipe_frames, s.codec_frames,
+		s.codec_frames * us, s.frames_min, s.frames_max, s.gain_db,
+		s.inverted ? " inverted" : "", s.runs, s.misses);
+}
+
+#ifndef LATENCY_HOST
+static uint8_t latency_idx;
+
+/*
+ * send bursts on an instance in place of its callback - takes effect at
+ * the next block. Call again after a rate or format change. Returns 0 if
+ * ok.
+ */
+int32_t latency_start(uint8_t idx)
+{
+	if(idx >= I2S_INSTANCES)
+		return 1;
+
+	/* keep the ISR off the old state while it's reset */
+	i2s_fulldup_set_proc(idx,
+		idx ? i2s_fulldup_proc_mirror : i2s_fulldup_proc_audio, NULL);
+	latency_idx = idx;
+	latency_setup();
+	i2s_fulldup_set_proc(idx, latency_proc, NULL);
+
+	return 0;
+}
+
+/*
+ * back to the instance's usual callback
+ */
+void latency_stop(void)
+{
+	i2s_fulldup_set_proc(latency_idx,
+		latency_idx ? i2s_fulldup_proc_mirror : i2s_fulldup_proc_audio, NULL);
+}
+#else
+#include <stdlib.h>
+
+#define SIM_BLOCKS 400
+#define SIM_TAPS 64
+
+/* codec passband edge as a fraction of fs/2 */
+#define SIM_BAND 0.9
+
+/*
+ * run bursts through the ping-pong buffers and a codec modelled as a gain
+ * and a linear phase lowpass at 0.45fs with a fractional delay, plus some
+ * noise, then check the measured round trip against the model - returns 0
+ * if within tol frames
+ */
+static int32_t sim_run(const char *name, uint8_t fmt, uint8_t bits,
+	uint8_t slots, uint8_t pipe, double delay, double gain, double tol)
+{
+	static double tx[SIM_BLOCKS*32], h[SIM_TAPS];
+	uint32_t out[512], in[512];
+	uint32_t blk, i, s, fw, bf, k;
+	i2s_inst inst;
+	latency_stats got;
+	double frac = delay - floor(delay), x, y, want;
+	int32_t err, v, base;
+
+	i2s_fmt = fmt;
+	i2s_bits = bits;
+	i2s_slot_bits = (bits > 16) ? 32 : 16;
+	i2s_slots = slots;
+	i2s_words = 32 * slots * i2s_slot_bits / 32;
+	Fsample = 48000;
+	latency_setup();
+	bf = latency_bframes;
+	fw = i2s_words / bf;
+
+	/* fraction of the delay in the taps, centred on SIM_TAPS/2 */
+	for(k=0;k<SIM_TAPS;k++)
+	{
+		x = ((double)k - SIM_TAPS/2 - frac) * SIM_BAND;
+		h[k] = gain * SIM_BAND *
+			(fabs(x) < 1e-9 ? 1.0 : sin(M_PI * x) / (M_PI * x)) *
+			(0.54 + 0.46 * cos(M_PI * x / SIM_BAND / (SIM_TAPS/2 + 1)));
+	}
+	memset(tx, 0, sizeof(tx));
+	memset(in, 0, sizeof(in));
+
+	/* both halves swapped before the ISR means two blocks of buffering */
+	inst.ib_idx = 0;
+	inst.ob_idx = (pipe == 2) ? 0 : 1;
+
+	for(blk=0;blk<SIM_BLOCKS;blk++)
+	{
+		/* input block is the output from pipe blocks ago through the codec */
+		for(i=0;i<bf;i++)
+		{
+			base = (int32_t)(blk*bf + i) - pipe*bf - (int32_t)floor(delay) +
+				SIM_TAPS/2;
+			for(k=0, y=0;k<SIM_TAPS;k++)
+				if((base - (int32_t)k >= 0) && (base - (int32_t)k < (int32_t)(blk*bf)))
+					y += h[k] * tx[base - k];
+			y += (rand() / (double)RAND_MAX - 0.5) * 20.0;
+			v = (int32_t)lrint(y);
+			for(s=0;s<fw;s++)
+				in[i*fw + s] = latency_out(v);
+		}
+
+		latency_proc(&inst, out, in);
+		for(i=0;i<bf;i++)
+			tx[blk*bf + i] = latency_in(out[i*fw]);
+
+		latency_poll();
+		latency_poll();
+		latency_poll();
+		latency_poll();
+	}
+
+	latency_get(&got);
+	want = pipe * bf + delay;
+	err = !got.runs || got.misses || (fabs(got.frames_min - want) > tol) ||
+		(fabs(got.frames_max - want) > tol) || (got.pipe_frames != pipe * bf) ||
+		(got.inverted != (gain < 0));
+	printf("%-24s delay %6.2f: %2u runs, %7.3f to %7.3f frames, %u buffers + %6.3f codec, gain %5.1f dB%s %s\n",
+		name, delay, got.runs, got.frames_min, got.frames_max, got.pipe_frames,
+		got.codec_frames, got.gain_db, got.inverted ? " inv" : "",
+		err ? "FAIL" : "ok");
+
+	return err;
+}
+
+int main(void)
+{
+	int32_t err = 0;
+
+	printf("Round trip latency over modelled codecs\n");
+	err |= sim_run("I2S 16-bit", FMT_I2S, 16, 2, 2, 0.0, 0.5, 0.02);
+	err |= sim_run("I2S 16-bit", FMT_I2S, 16, 2, 2, 17.25, 0.5, 0.02);
+	err |= sim_run("I2S 16-bit", FMT_I2S, 16, 2, 2, 33.5, 0.25, 0.02);
+	err |= sim_run("I2S 16-bit, 1 buffer", FMT_I2S, 16, 2, 1, 21.8, 0.5, 0.02);
+	err |= sim_run("I2S 24-bit, inverting", FMT_I2S, 24, 2, 2, 12.6, -0.7, 0.02);
+	err |= sim_run("RJ 24-bit", FMT_RJ, 24, 2, 2, 40.1, 0.1, 0.02);
+	err |= sim_run("TDM 8 x 32-bit", FMT_TDM, 32, 8, 2, 5.33, 0.5, 0.02);
+	printf("%s\n", err ? "FAILED" : "PASSED");
+
+	return err;
+}
+#endif
@@ -0,0 +1,36 @@
+/*
+ * latency.h - round trip latency from an MLS burst through the codec
+ */
+
+#ifndef __latency__
+#define __latency__
+
+#include <stdint.h>
+
+/* burst length - a 10-bit MLS */
+#define LATENCY_MLS_LEN 1023
+
+/* longest round trip looked for, in frames */
+#define LATENCY_LAG_MAX 512
+
+/* results since the last start */
+typedef struct
+{
+	uint32_t runs;			// bursts with a clear peak
+	uint32_t misses;		// bursts without
+	uint32_t fs;			// frame rate the times are at
+	double frames;			// last round trip in frames
+	double frames_min, frames_max;
+	uint32_t pipe_frames;	// of that in the ping-pong buffers
+	double codec_frames;	// and in the codec, DAC & ADC
+	double gain_db;			// loop gain seen by the burst
+	uint8_t inverted;		// loop inverts
+} latency_stats;
+
+int32_t latency_start(uint8_t idx);
+void latency_stop(void);
+void latency_poll(void);
+void latency_get(latency_stats *stats);
+void latency_report(void);
+
+#endif
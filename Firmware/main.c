@@ -22,14 +22,23 @@
 #include "pico/binary_info.h"
 #include "pico/unique_id.h"
 #include "i2s_fulldup.h"
-#include "wm8731.h"
-#include "aic3101.h"
-#include "nau88c22.h"
-#include "sgtl5000.h"
-#include "uda1345.h"
+#include "codec.h"
 #include "audio.h"
 #include "led.h"
 #include "button.h"
+#include "trace.h"
+#include "fsmeas.h"
+#include "prbs.h"
+#include "latency.h"
+#include "capture.h"
+#include "stream.h"
+#include "memstress.h"
+#include "console.h"
+#include "plan.h"
+
+#if defined(PRBS_TEST) && defined(LATENCY_TEST)
+#error "PRBS_TEST and LATENCY_TEST both take over the first I2S instance"
+#endif
 
 /* build version in simple format */
 const char *fwVersionStr = "V0.1";
@@ -39,14 +48,23 @@ const char *bdate = __DATE__;
 const char *btime = __TIME__;
 
 /* blink timing for various states */
-const uint8_t blink_time[3][6] =
+const uint8_t blink_time[AUDIO_MODES][8] =
 {
-	{10, 50, 0, 0, 0, 0},	// state 0 = 1 short
-	{10, 10, 10, 50, 0, 0},	// state 1 = 2 short
-	{10, 10, 50, 50, 0, 0},	// state 2 = 1 short 1 long
+	{10, 50, 0, 0, 0, 0, 0, 0},		// state 0 = 1 short
+	{10, 10, 10, 50, 0, 0, 0, 0},	// state 1 = 2 short
+	{10, 10, 50, 50, 0, 0, 0, 0},	// state 2 = 1 short 1 long
+	{10, 10, 10, 10, 10, 50, 0, 0},	// state 3 = 3 short
 };	
 uint8_t state, bt_idx;
 
+#ifdef RATE_SWEEP
+/* rates to step through */
+const uint32_t sweep_rates[] =
+{
+	8000, 11025, 16000, 22050, 32000, 44100, 48000, 88200, 96000, 192000
+};
+#endif
+
 /*
  * my version of sleep_ms() that may work after flashing
  */
@@ -71,10 +89,31 @@ void my_sleep_ms(uint64_t ms)
 int main()
 {
 	int i;
-	bool sysclk_stat;
-	uint64_t led_time, cmd_time;
+	//bool sysclk_stat;
+	uint64_t led_time;
 	pico_unique_board_id_t id_out;
-	uint8_t codec_err = 0, cmd = 0;
+	uint8_t codec_err = 0;
+#ifdef FS_REPORT
+	uint64_t fs_time;
+#endif
+#ifdef PRBS_TEST
+	uint64_t prbs_time;
+#endif
+#ifdef LATENCY_TEST
+	uint64_t latency_time;
+#endif
+#ifdef MEM_STRESS
+	uint64_t stress_time;
+#endif
+#ifdef SCOPE_CAPTURE
+	/* 50ms before the button & 100ms after at 48kHz */
+	const capture_cfg scope = {CAPTURE_TRIG_SOFT, 0, 0, 2400, 4800};
+#endif
+#ifdef RATE_SWEEP
+	uint64_t sweep_time;
+	uint32_t sweep_idx = 0;
+	int32_t sweep_us;
+#endif
 	
 	/* set sysclk prior to init serial */
 	//sysclk_stat = set_sys_clock_khz(TARGET_SYSCLK, false);
@@ -87,6 +126,7 @@ int main()
 	 * that I haven't figured out yet.
 	 */
 	my_sleep_ms(100);
+	trace_init();
 	printf("\n\nRP2040 I2S Test\n");
 	printf("CHIP_ID: 0x%08X\n\r", *(volatile uint32_t *)(SYSINFO_BASE));
 	printf("BOARD_ID: 0x");
@@ -110,69 +150,32 @@ int main()
 	init_i2s_fulldup();
 	printf("I2S Initialized\n");
 	
+	/* block streaming UART - after I2S has set clk_peri */
+	stream_init();
+	
 	/* init Audio AFTER I2S!!! - needs Fsample computed */
 	Audio_Init();
+	trace_flush();
 	printf("Audio Initialized\n");
 	
+#ifdef CODEC_MODEL_CHECK
+	/* check codec sequence before running it for real */
+	Codec_ModelCheck();
+	trace_flush();
+#endif
+	
 	/* init codec */
-#if	defined(CODEC_WM8731)
-	if(!WM8731_Init())
-		printf("WM8731 Codec Initialized\n");
-	else
-	{
-		printf("WM8731 Codec Init Failed...\n");
-		codec_err = 1;
-	}
-#elif defined(CODEC_AIC3101)
-	if(!AIC3101_Init())
-	{
-		printf("AIC3101 Codec Initialized\n");
-		AIC3101_Dump_Regs();
-	}
-	else
-	{
-		printf("AIC3101 Codec Init Failed...\n");
+	if(Codec_Init())
 		codec_err = 1;
-	}
-#elif defined(CODEC_NAU88C22)
-	if(!NAU88C22_Init())
-	{
-		uint16_t id, rev;
-		NAU88C22_ReadRegister(63, &id);
-		NAU88C22_ReadRegister(62, &rev);
-		printf("NAU88C22 Codec Initialized - ID = 0x%03X, Rev = 0x%03X\n", id, rev);
-		//NAU88C22_Dump_Regs();
-	}
-	else
-	{
-		printf("NAU88C22 Codec Init Failed...\n");
-		codec_err = 1;
-	}
-#elif defined(CODEC_SGTL5000)
-	if(!SGTL5000_Init())
-	{
-		uint16_t id;
-		SGTL5000_ReadRegister(0x0000, &id);
-		printf("SGTL5000 Codec Initialized - ID = 0x%04X\n", id);
-		//SGTL5000_Dump_Regs();
-	}
-	else
-	{
-		printf("SGTL5000 Codec Init Failed...\n");
-		codec_err = 1;
-	}
-#elif defined(CODEC_UDA1345)
-	if(!UDA1345_Init())
-	{
-		printf("UDA1345 Codec Initialized\n");
-	}
+	trace_flush();
+
+#ifdef CODEC_MASTER
+	/* hand BCLK & LRCK over to the codec */
+	if(Audio_Set_Clocking(1))
+		printf("Codec can't run as master\n");
 	else
-	{
-		printf("UDA1345 Codec Init Failed...\n");
-		codec_err = 1;
-	}
-#else
-#error "Please define a codec in main.h"
+		printf("Codec is clock master\n");
+	trace_flush();
 #endif
 
 	/* hangup if codec error */
@@ -186,17 +189,119 @@ int main()
 		}
 	}
 
+#ifdef PRBS_TEST
+	/* stream a PRBS out of the first instance & check it comes back */
+	if(prbs_start(0))
+		printf("PRBS check can't start - unknown sniffer byte order\n");
+	else
+		printf("PRBS check running\n");
+	prbs_time = time_us_64() + 5000000;
+#endif
+
+#ifdef LATENCY_TEST
+	/* MLS bursts out of the first instance, timed back through the codec */
+	latency_start(0);
+	printf("Latency measurement running\n");
+	latency_time = time_us_64() + 5000000;
+#endif
+
+#ifdef SCOPE_CAPTURE
+	/* ring on the first instance, fired by the button */
+	if(capture_arm(0, &scope))
+		printf("Capture doesn't fit the ring\n");
+	else
+		printf("Capture armed\n");
+#endif
+
+#ifdef MEM_STRESS
+	/* unloaded first, then striped & SRAM4 buffers under load in turn */
+	memstress_start();
+	printf("Memory stress running\n");
+	stress_time = time_us_64() + 5000000;
+#endif
+
 	/* start blink sequence */
 	state = 0;
 	bt_idx = 0;
 	led_time = time_us_64() + 10000 * blink_time[state][bt_idx++];
 	LEDOn();
 	
+	/* take commands from here on */
+	console_init();
+	
+#ifdef PLAN_AUTORUN
+	/* measure with no host attached */
+	if(plan_run(PLAN_AUTORUN))
+		printf("No such plan\n");
+#endif
+	
 	/* loop here forever */
 	printf("Looping\n\n");
-	cmd_time = time_us_64() + 500000;
+#ifdef FS_REPORT
+	fs_time = time_us_64() + 5000000;
+#endif
+#ifdef RATE_SWEEP
+	sweep_time = time_us_64() + 2000000;
+#endif
     while(true)
     {
+		/* format deferred trace events */
+		trace_poll();
+		
+		/* collect frame rate measurements */
+		fsmeas_poll();
+		
+		/* resync I2S if it slipped */
+		Audio_Watch();
+		
+		/* keep the ASRC source running */
+		Audio_Src_Poll();
+		
+		/* serial commands */
+		console_poll();
+		
+		/* step the measurement plan */
+		plan_poll();
+		
+		/* keep streaming through format changes */
+		stream_poll();
+		
+#ifdef PRBS_TEST
+		/* sort out loopback blocks that didn't match */
+		prbs_poll();
+		if(time_us_64() >= prbs_time)
+		{
+			prbs_report();
+			prbs_time = time_us_64() + 5000000;
+		}
+#endif
+		
+#ifdef SCOPE_CAPTURE
+		/* send a frozen capture & wait for the next press */
+		if(!capture_dump())
+			capture_arm(0, &scope);
+#endif
+		
+#ifdef LATENCY_TEST
+		/* correlate the last burst a slice at a time */
+		latency_poll();
+		if(time_us_64() >= latency_time)
+		{
+			latency_report();
+			latency_time = time_us_64() + 5000000;
+		}
+#endif
+		
+#ifdef MEM_STRESS
+		/* hammer the striped banks & move on a phase every 5 sec */
+		memstress_poll();
+		if(time_us_64() >= stress_time)
+		{
+			memstress_report();
+			stress_time = time_us_64() + 5000000;
+		}
+#endif
+		
 		/* periodic LED toggle */
 		if(time_us_64() >= led_time)
 		{
@@ -213,9 +318,19 @@ int main()
 		/* check for button press */
 		if(button_re())
 		{
+#ifdef SCOPE_CAPTURE
+			/* catch what the mode change does */
+			capture_trigger();
+#endif
+			
 			/* advance state */
-			state = (state+1)%3;
-			Audio_Mode(state);
+			Audio_Mode((state+1)%AUDIO_MODES);
+		}
+		
+		/* follow mode changes from the button or the console */
+		if(Audio_Get_Mode() != state)
+		{
+			state = Audio_Get_Mode();
 			printf("State %d\n", state);
 			
 			/* restart blink sequence */
@@ -224,14 +339,30 @@ int main()
 			LEDOn();
 		}
 		
-		/* periodic Codec cmd */
-		if(time_us_64() >= cmd_time)
+#ifdef FS_REPORT
+		/* periodic frame rate report */
+		if(time_us_64() >= fs_time)
 		{
-			cmd_time = time_us_64() + 50000;
-			//UDA1345_Volume(cmd);
-			//UDA1345_Mute(cmd);
-			//cmd = cmd ^ 1;
-			cmd++;
+			fsmeas_report();
+			if(state == AUDIO_MODE_ASRC)
+				Audio_Src_Report();
+			fs_time = time_us_64() + 5000000;
 		}
+#endif
+		
+#ifdef RATE_SWEEP
+		/* periodic rate change */
+		if(time_us_64() >= sweep_time)
+		{
+			sweep_us = Audio_Set_Rate(sweep_rates[sweep_idx]);
+			if(sweep_us < 0)
+				printf("Rate %d: not supported\n", sweep_rates[sweep_idx]);
+			else
+				printf("Rate %d: actual %d, switched in %d us\n",
+					sweep_rates[sweep_idx], Fsample, sweep_us);
+			sweep_idx = (sweep_idx + 1) % (sizeof(sweep_rates)/sizeof(sweep_rates[0]));
+			sweep_time = time_us_64() + 2000000;
+		}
+#endif
 	}
 }
\ No newline at end of file
@@ -14,6 +14,51 @@
 //#define CODEC_SGTL5000
 #define CODEC_UDA1345
 
+/* uncomment to dry-run the codec init against its model at boot */
+//#define CODEC_MODEL_CHECK
+
+/* uncomment to step through sample rates and report switch times */
+//#define RATE_SWEEP
+
+/* uncomment to run the codec as BCLK & LRCK master with I2S following it */
+//#define CODEC_MASTER
+
+/* uncomment to run a second codec on the other PMOD with the same output */
+//#define DUAL_I2S
+
+/*
+ * uncomment to send a PRBS in place of audio and check it comes back bit
+ * exact - needs the codec in digital loopback or DO jumpered to DI
+ */
+//#define PRBS_TEST
+
+/*
+ * uncomment to time MLS bursts round the codec's analog loop in place of
+ * audio - needs the line out wired to the line in
+ */
+//#define LATENCY_TEST
+
+/*
+ * uncomment to capture the first instance's input around each button press
+ * and send it over the console for capture_dec.py
+ */
+//#define SCOPE_CAPTURE
+
+/*
+ * uncomment to load the striped SRAM banks from core 0 and report the input
+ * ISR times with the I2S buffers there & in SRAM4 every 5 sec
+ */
+//#define MEM_STRESS
+
+/*
+ * uncomment to run a measurement plan from plans.c at power up - its name,
+ * or NULL for all of them in turn
+ */
+//#define PLAN_AUTORUN "level"
+
+/* uncomment to report the measured frame rate every 5 sec */
+//#define FS_REPORT
+
 void my_sleep_ms(uint64_t ms);
 
 #endif
@@ -0,0 +1,163 @@
+#!/usr/bin/env python3
+# memmap.py - memory layout of a linked firmware ELF: what each RP2040 RAM
+# bank holds, the stacks, and the biggest objects in striped SRAM. Run
+# after every build by CMakeLists.txt. Each -e symbol=bank must land in
+# that bank and each -f bank=bytes must leave that much of the bank free,
+# stacks included, or the exit status is 1.
+#
+# usage: memmap.py firmware.elf [-n biggest] [-e symbol=bank ...]
+#                  [-f bank=bytes ...]
+
+import struct
+import sys
+
+# name, base, size - SRAM0-3 are striped word by word, SRAM4 & 5 are not
+BANKS = [
+    ('flash', 0x10000000, 0x200000),
+    ('striped', 0x20000000, 0x40000),
+    ('SRAM4', 0x20040000, 0x1000),
+    ('SRAM5', 0x20041000, 0x1000),
+]
+
+STACKS = [
+    ('core 0 stack', '__StackBottom', '__StackTop'),
+    ('core 1 stack', '__StackOneBottom', '__StackOneTop'),
+]
+
+SHF_ALLOC = 2
+SHT_SYMTAB = 2
+STT_OBJECT = 1
+PT_LOAD = 1
+
+def bank_of(addr):
+    for name, base, size in BANKS:
+        if base <= addr < base + size:
+            return name
+    return None
+
+def load(path):
+    data = open(path, 'rb').read()
+    if data[:4] != b'\x7fELF':
+        raise ValueError('%s is not an ELF file' % path)
+    wide = data[4] == 2
+    end = '<' if data[5] == 1 else '>'
+    if wide:
+        phoff, shoff = struct.unpack_from(end + 'QQ', data, 0x20)
+        phentsize, phnum, shentsize, shnum, shstrndx = struct.unpack_from(end + 'HHHHH', data, 0x36)
+    else:
+        phoff, shoff = struct.unpack_from(end + 'II', data, 0x1c)
+        phentsize, phnum, shentsize, shnum, shstrndx = struct.unpack_from(end + 'HHHHH', data, 0x2a)
+
+    # sections - name, type, flags, address, offset, size, link, entry size
+    secs = []
+    for i in range(shnum):
+        o = shoff + i * shentsize
+        if wide:
+            nm, typ, flags, addr, off, size, link, _, _, ent = struct.unpack_from(end + 'IIQQQQIIQQ', data, o)
+        else:
+            nm, typ, flags, addr, off, size, link, _, _, ent = struct.unpack_from(end + 'IIIIIIIIII', data, o)
+        secs.append([nm, typ, flags, addr, off, size, link, ent])
+    strs = secs[shstrndx][4]
+    for s in secs:
+        s[0] = data[strs + s[0]:data.index(b'\0', strs + s[0])].decode()
+
+    # bytes loaded from flash, whether or not they run from there
+    flash = 0
+    for i in range(phnum):
+        o = phoff + i * phentsize
+        if wide:
+            typ, _, _, _, paddr, filesz = struct.unpack_from(end + 'IIQQQQ', data, o)
+        else:
+            typ, _, _, paddr, filesz = struct.unpack_from(end + 'IIIII', data, o)
+        if typ == PT_LOAD and bank_of(paddr) == 'flash':
+            flash += filesz
+
+    # symbols - name, address, size, is an object
+    syms = {}
+    for s in secs:
+        if s[1] != SHT_SYMTAB:
+            continue
+        names = secs[s[6]][4]
+        for o in range(s[4], s[4] + s[5], s[7]):
+            if wide:
+                nm, info, _, _, value, size = struct.unpack_from(end + 'IBBHQQ', data, o)
+            else:
+                nm, value, size, info, _, _ = struct.unpack_from(end + 'IIIBBH', data, o)
+            if not nm:
+                continue
+            name = data[names + nm:data.index(b'\0', names + nm)].decode()
+            syms[name] = (value, size, (info & 0xf) == STT_OBJECT)
+
+    allocs = [(s[0], s[3], s[5]) for s in secs if (s[2] & SHF_ALLOC) and s[5]]
+    return allocs, flash, syms
+
+def used_in(allocs, bank):
+    return sum(a[2] for a in allocs if bank_of(a[1]) == bank)
+
+def report(allocs, flash, syms, biggest):
+    for name, base, size in BANKS:
+        if name == 'flash':
+            print('%-8s %7d of %7d bytes' % (name, flash, size))
+            continue
+        here = [a for a in allocs if bank_of(a[1]) == name]
+        used = used_in(allocs, name)
+        print('%-8s %7d of %7d bytes at 0x%08x, %d free' % (name, used,
+            size, base, size - used))
+        for sec, addr, sz in sorted(here, key=lambda a: a[1]):
+            print('    %-24s 0x%08x %7d' % (sec, addr, sz))
+
+    for name, lo, hi in STACKS:
+        if lo in syms and hi in syms:
+            print('%-12s 0x%08x-0x%08x %5d bytes in %s' % (name, syms[lo][0],
+                syms[hi][0], syms[hi][0] - syms[lo][0], bank_of(syms[lo][0])))
+
+    objs = [(n, v[0], v[1]) for n, v in syms.items() if v[2] and v[1]]
+    for bank in ('SRAM4', 'SRAM5'):
+        for n, addr, sz in sorted(objs, key=lambda o: o[1]):
+            if bank_of(addr) == bank:
+                print('%-8s %-24s 0x%08x %7d' % (bank, n, addr, sz))
+    striped = sorted([o for o in objs if bank_of(o[1]) == 'striped'], key=lambda o: -o[2])
+    for n, addr, sz in striped[:biggest]:
+        print('%-8s %-24s 0x%08x %7d' % ('striped', n, addr, sz))
+
+def main():
+    args = sys.argv[1:]
+    biggest = 12
+    expect = []
+    headroom = []
+    while '-n' in args:
+        i = args.index('-n')
+        biggest = int(args[i+1])
+        del args[i:i+2]
+    while '-e' in args:
+        i = args.index('-e')
+        expect.append(args[i+1].split('='))
+        del args[i:i+2]
+    while '-f' in args:
+        i = args.index('-f')
+        bank, need = args[i+1].split('=')
+        headroom.append((bank, int(need, 0)))
+        del args[i:i+2]
+    if len(args) != 1:
+        print('usage: memmap.py firmware.elf [-n biggest] '
+            '[-e symbol=bank ...] [-f bank=bytes ...]')
+        sys.exit(2)
+
+    allocs, flash, syms = load(args[0])
+    report(allocs, flash, syms, biggest)
+
+    bad = 0
+    for sym, bank in expect:
+        got = bank_of(syms[sym][0]) if sym in syms else None
+        if got != bank:
+            print('%s is in %s, not %s' % (sym, got, bank))
+            bad = 1
+    sizes = dict((b[0], b[2]) for b in BANKS)
+    for bank, need in headroom:
+        free = sizes[bank] - used_in(allocs, bank)
+        if free < need:
+            print('%s has %d bytes free, not %d' % (bank, free, need))
+            bad = 1
+    sys.exit(bad)
+
+main()
@@ -0,0 +1,118 @@
+/*
+ * memstress.c - input ISR times under core 0 bus load, by buffer placement
+ *
+ * Core 0 copies a buffer through the striped SRAM banks as fast as it can
+ * while the input ISR on core 1 times itself. Each report ends a phase and
+ * starts the next: unloaded, loaded with the I2S buffers in striped SRAM
+ * at the default bus priority, and loaded with them in SRAM4 and the DMA
+ * ahead of the cores. The unloaded worst plus MEMSTRESS_SLACK_US is the
+ * stall limit for the loaded phases, and each pair of them is compared.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "memstress.h"
+#include "i2s_fulldup.h"
+#include "audio.h"
+
+static const char *memstress_names[MEMSTRESS_PHASES] =
+{
+	"quiet", "striped", "SRAM4"
+};
+
+static uint32_t memstress_buf[2][MEMSTRESS_WORDS];
+static uint8_t memstress_phase;
+static i2s_isr_times memstress_last[MEMSTRESS_PHASES];
+
+/*
+ * move the buffers for a phase & start its ISR times from zero
+ */
+static void memstress_enter(uint8_t phase)
+{
+	i2s_isr_times t;
+	
+	memstress_phase = phase;
+	Audio_Set_Mute(1);
+	i2s_fulldup_stop();
+	i2s_fulldup_place(phase != MEMSTRESS_STRIPED);
+	i2s_fulldup_start();
+	Audio_Set_Mute(0);
+	
+	for(uint n=0;n<I2S_INSTANCES;n++)
+		i2s_fulldup_isr_times(n, &t);
+}
+
+/*
+ * start over from the unloaded phase
+ */
+void memstress_start(void)
+{
+	i2s_stall_us = 0xFFFFFFFF;
+	memset(memstress_last, 0, sizeof(memstress_last));
+	memstress_enter(MEMSTRESS_QUIET);
+}
+
+/*
+ * keep the striped banks busy for a while in the loaded phases
+ */
+void memstress_poll(void)
+{
+	uint32_t t0 = time_us_32();
+	
+	if(memstress_phase == MEMSTRESS_QUIET)
+		return;
+	
+	while(time_us_32() - t0 < MEMSTRESS_POLL_US)
+	{
+		for(uint n=0;n<MEMSTRESS_WORDS;n++)
+			memstress_buf[1][n] = memstress_buf[0][n] + n;
+		for(uint n=0;n<MEMSTRESS_WORDS;n++)
+			memstress_buf[0][n] = memstress_buf[1][n] ^ n;
+	}
+}
+
+/*
+ * print the phase just run, compare the loaded pair & start the next one
+ */
+void memstress_report(void)
+{
+	i2s_isr_times t, sum;
+	const i2s_isr_times *s, *b;
+	
+	/* worst of every instance */
+	memset(&sum, 0, sizeof(sum));
+	for(uint n=0;n<I2S_INSTANCES;n++)
+	{
+		i2s_fulldup_isr_times(n, &t);
+		printf("Mem stress %s: I2S%d %u blocks, ISR mean %u us, worst %u us, %u stalls\n",
+			memstress_names[memstress_phase], n, t.blocks,
+			t.blocks ? t.us_sum / t.blocks : 0, t.us_max, t.stalls);
+		sum.blocks += t.blocks;
+		sum.us_sum += t.us_sum;
+		sum.stalls += t.stalls;
+		if(t.us_max > sum.us_max)
+			sum.us_max = t.us_max;
+	}
+	memstress_last[memstress_phase] = sum;
+	
+	switch(memstress_phase)
+	{
+		case MEMSTRESS_QUIET:
+			i2s_stall_us = sum.us_max + MEMSTRESS_SLACK_US;
+			printf("Mem stress: stall over %u us\n", i2s_stall_us);
+			memstress_enter(MEMSTRESS_STRIPED);
+			break;
+		
+		case MEMSTRESS_STRIPED:
+			memstress_enter(MEMSTRESS_BANKED);
+			break;
+		
+		default:
+			s = &memstress_last[MEMSTRESS_STRIPED];
+			b = &memstress_last[MEMSTRESS_BANKED];
+			printf("Mem stress: worst %u -> %u us, stalls %u -> %u, striped -> SRAM4\n",
+				s->us_max, b->us_max, s->stalls, b->stalls);
+			memstress_enter(MEMSTRESS_STRIPED);
+			break;
+	}
+}
@@ -0,0 +1,31 @@
+/*
+ * memstress.h - input ISR times under core 0 bus load, by buffer placement
+ */
+
+#ifndef __memstress__
+#define __memstress__
+
+#include <stdint.h>
+
+/* words core 0 copies back & forth in striped SRAM - 32kB */
+#define MEMSTRESS_WORDS 4096
+
+/* how long each poll keeps the bus busy */
+#define MEMSTRESS_POLL_US 2000
+
+/* an ISR this much over the worst seen unloaded counts as a stall */
+#define MEMSTRESS_SLACK_US 2
+
+enum memstress_phases
+{
+	MEMSTRESS_QUIET,		// SRAM4 buffers, no load - sets the stall limit
+	MEMSTRESS_STRIPED,		// striped buffers, default priority, loaded
+	MEMSTRESS_BANKED,		// SRAM4 buffers, DMA priority, loaded
+	MEMSTRESS_PHASES
+};
+
+void memstress_start(void);
+void memstress_poll(void);
+void memstress_report(void);
+
+#endif
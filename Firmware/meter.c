@@ -0,0 +1,213 @@
+/*
+ * meter.c - level, tone & THD+N of the I2S input, measured on core 1
+ *
+ * Core 0 posts a request in the mailbox and carries on; the input ISR on
+ * core 1 feeds each block through while it's live, then acks it, and core
+ * 0 picks the sums up on a later poll. Per frame the ISR adds the sample,
+ * its square and its products with a sine & cosine at the tone frequency
+ * from sine_interp(), along with those references' own sums & products.
+ * Core 0 then fits the sine, cosine & DC by least squares, so the tone,
+ * its level & THD+N come out right with or without a whole number of
+ * cycles, down to the 16-bit floor. 32-bit input is measured on its top
+ * 16 bits, and TDM input on slot 0 or 1 of its planar block.
+ */
+
+#include <math.h>
+#include "main.h"
+#include "hardware/sync.h"
+#include "meter.h"
+#include "audio.h"
+
+/* full scale sine power in 16-bit LSBs squared */
+#define METER_FS_POWER (32767.0 * 32767.0 / 2.0)
+
+/* a quarter cycle of phase, for the cosine */
+#define METER_QUARTER (1u<<30)
+
+/* what a power of zero reads as */
+#define METER_FLOOR_DB -200.0
+
+meter_box meter;
+
+/*
+ * ask for a measurement of ch over about frames at a tone of inc, rounded
+ * to whole cycles - returns 0 if posted, or 1 if one is live or it's out
+ * of range
+ */
+int32_t meter_start(uint8_t ch, uint32_t frames, uint32_t inc)
+{
+	uint64_t cycles;
+
+	if(meter_armed() || (ch > 1) || !inc || !frames ||
+		(frames > METER_FRAMES_MAX))
+		return 1;
+
+	cycles = ((uint64_t)frames * inc + (1ULL << 31)) >> 32;
+	if(!cycles)
+		cycles = 1;
+	frames = ((cycles << 32) + inc / 2) / inc;
+	if(frames > METER_FRAMES_MAX)
+		return 1;
+
+	meter.ch = ch;
+	meter.frames = frames;
+	meter.inc = inc;
+	meter.n = meter.phs = 0;
+	meter.sum = meter.i = meter.q = 0;
+	meter.sumsq = 0;
+	meter.rs = meter.rc = meter.rsc = 0;
+	meter.rss = meter.rcc = 0;
+
+	/* core 1 mustn't see the request before its settings */
+	__dmb();
+	meter.req++;
+
+	return 0;
+}
+
+/*
+ * drop a live request - an ISR part way through a block stops at its next
+ * frame
+ */
+void meter_stop(void)
+{
+	meter.frames = 0;
+	__dmb();
+	meter.ack = meter.req;
+}
+
+/*
+ * the result once core 1 has acked - returns 0 if there is one, 1 while
+ * it's live, or -1 if it was stopped
+ */
+int32_t meter_get(meter_result *r)
+{
+	double n, mean, p, t, e, i, q, ss, cc, sc, det, a, b;
+
+	if(meter_armed())
+		return 1;
+	__dmb();
+	if(!meter.frames || (meter.n < meter.frames))
+		return -1;
+
+	n = meter.n;
+	mean = meter.sum / n;
+	p = meter.sumsq / n - mean * mean;
+
+	/*
+	 * least squares fit of the sine, cosine & DC - against the reference's
+	 * own sums, so what's left is only what isn't the tone however near
+	 * sine_interp() is to a sine
+	 */
+	ss = meter.rss - (double)meter.rs * meter.rs / n;
+	cc = meter.rcc - (double)meter.rc * meter.rc / n;
+	sc = meter.rsc - (double)meter.rs * meter.rc / n;
+	i = meter.i - (double)meter.sum * meter.rs / n;
+	q = meter.q - (double)meter.sum * meter.rc / n;
+	det = ss * cc - sc * sc;
+	a = (det > 0.0) ? (i * cc - q * sc) / det : 0.0;
+	b = (det > 0.0) ? (q * ss - i * sc) / det : 0.0;
+
+	/* the tone's power & what's left after it */
+	t = (a * i + b * q) / n;
+	e = p - t;
+
+	r->frames = meter.n;
+	r->dc = mean;
+	r->rms_db = (p > 0.0) ? 10.0 * log10(p / METER_FS_POWER) : METER_FLOOR_DB;
+	r->tone_db = (t > 0.0) ? 10.0 * log10(t / METER_FS_POWER) : METER_FLOOR_DB;
+	r->thdn_db = ((t > 0.0) && (e > 0.0)) ? 10.0 * log10(e / t) :
+		METER_FLOOR_DB;
+
+	return 0;
+}
+
+/*
+ * add a block of 16-bit stereo input - from the input ISR
+ */
+void __not_in_flash_func(meter_feed)(const int16_t *src, int32_t len)
+{
+	uint32_t n = meter.n, phs = meter.phs;
+	int32_t x, rs, rc;
+
+	for(src+=meter.ch;(len > 0) && (n < meter.frames);len-=2, src+=2)
+	{
+		x = *src;
+		rs = sine_interp(phs);
+		rc = sine_interp(phs + METER_QUARTER);
+		meter.sum += x;
+		meter.sumsq += (uint32_t)(x * x);
+		meter.i += x * rs;
+		meter.q += x * rc;
+		meter.rs += rs;
+		meter.rc += rc;
+		meter.rss += (uint32_t)(rs * rs);
+		meter.rcc += (uint32_t)(rc * rc);
+		meter.rsc += rs * rc;
+		phs += meter.inc;
+		n++;
+	}
+	meter.n = n;
+	meter.phs = phs;
+
+	/* the sums are in before the ack */
+	if(n >= meter.frames)
+	{
+		__dmb();
+		meter.ack = meter.req;
+	}
+}
+
+/*
+ * add frames of 32-bit input, MSB aligned, stride words apart - from the
+ * input ISR
+ */
+static void __not_in_flash_func(meter_feed_words)(const int32_t *src,
+	int32_t stride, int32_t frames)
+{
+	uint32_t n = meter.n, phs = meter.phs;
+	int32_t x, rs, rc;
+
+	for(;(frames > 0) && (n < meter.frames);frames--, src+=stride)
+	{
+		x = *src >> 16;
+		rs = sine_interp(phs);
+		rc = sine_interp(phs + METER_QUARTER);
+		meter.sum += x;
+		meter.sumsq += (uint32_t)(x * x);
+		meter.i += x * rs;
+		meter.q += x * rc;
+		meter.rs += rs;
+		meter.rc += rc;
+		meter.rss += (uint32_t)(rs * rs);
+		meter.rcc += (uint32_t)(rc * rc);
+		meter.rsc += rs * rc;
+		phs += meter.inc;
+		n++;
+	}
+	meter.n = n;
+	meter.phs = phs;
+
+	if(n >= meter.frames)
+	{
+		__dmb();
+		meter.ack = meter.req;
+	}
+}
+
+/*
+ * as above for interleaved 32-bit stereo input
+ */
+void __not_in_flash_func(meter_feed32)(const int32_t *src, int32_t len)
+{
+	meter_feed_words(src + meter.ch, 2, len / 2);
+}
+
+/*
+ * as above for a planar TDM block - slot ch is the run of frames it
+ * starts
+ */
+void __not_in_flash_func(meter_feed_tdm)(const int32_t *src, int32_t frames)
+{
+	meter_feed_words(src + meter.ch * frames, 1, frames);
+}
@@ -0,0 +1,55 @@
+/*
+ * meter.h - level, tone & THD+N of the I2S input, measured on core 1
+ */
+
+#ifndef __meter__
+#define __meter__
+
+#include <stdint.h>
+
+/* most frames in one measurement */
+#define METER_FRAMES_MAX (1<<20)
+
+/*
+ * mailbox between core 0 & the input ISR on core 1 - a request is live
+ * while req & ack differ, and only core 1 touches the sums while it is
+ */
+typedef struct
+{
+	volatile uint32_t req, ack;
+	uint8_t ch;				// channel of the stereo pair, or TDM slot
+	uint32_t frames;		// frames to take, a whole number of cycles
+	uint32_t inc;			// tone phase increment per frame
+	uint32_t n, phs;
+	int64_t sum, i, q;		// samples & their products with the tone
+	uint64_t sumsq;
+	int64_t rs, rc, rsc;	// the sine & cosine references' sums
+	uint64_t rss, rcc;
+} meter_box;
+
+/* result, in dB against a full scale sine */
+typedef struct
+{
+	uint32_t frames;
+	double rms_db;			// everything but DC
+	double tone_db;			// at the tone frequency
+	double thdn_db;			// everything else, against the tone
+	double dc;				// mean in 16-bit LSBs
+} meter_result;
+
+extern meter_box meter;
+
+int32_t meter_start(uint8_t ch, uint32_t frames, uint32_t inc);
+int32_t meter_get(meter_result *r);
+void meter_stop(void);
+void meter_feed(const int16_t *src, int32_t len);
+void meter_feed32(const int32_t *src, int32_t len);
+void meter_feed_tdm(const int32_t *src, int32_t frames);
+
+/* for the ISR - skip the call when nothing is asked for */
+static inline uint8_t meter_armed(void)
+{
+	return meter.req != meter.ack;
+}
+
+#endif
@@ -6,6 +6,9 @@
 #include <stdio.h>
 #include "main.h"
 #include "hardware/i2c.h"
+#include "codec_seq.h"
+#include "codec.h"
+#include "trace.h"
 #include "nau88c22.h"
 
 #define I2C_PORT i2c0
@@ -15,55 +18,62 @@
 /* The 7 bits NAU88C22 address (sent through I2C interface) */
 #define NAU88C22_I2C_ADDR 0x1A
 
+/* register address & data widths */
+#define NAU88C22_REG_BITS 7
+#define NAU88C22_VAL_BITS 9
+#define WR(r, v) SEQ_WR(NAU88C22_REG_BITS, NAU88C22_VAL_BITS, r, v)
+#define VFY(r, m, v) SEQ_VFY(NAU88C22_REG_BITS, NAU88C22_VAL_BITS, r, m, v)
+
 /* Initialization data */
-static uint16_t codec_settings[] = 
+static const codec_seq_t codec_settings[] CODEC_SEQ =
 {
 	// Reset and power-up
-	0,		0x000,	// Software Reset
-	1,		0x0CD,	// aux mixers, internal tie-off enable & 80k impedance for slow charge
-	69,		0x000,	// low voltage bias
-	127,	250,	// Wait 250ms
+	WR(0,	0x000),	// Software Reset
+	VFY(63,	0x1FF, 0x01A),	// Device ID
+	WR(1,	0x0CD),	// aux mixers, internal tie-off enable & 80k impedance for slow charge
+	WR(69,	0x000),	// low voltage bias
+	SEQ_DLY(250),	// Wait 250ms
 	
 	// Input routing & ADC setup
-	2,		0x03F,	// ADC, PGA, Mix/Boost inputs powered up
-	//14,		0x108,	// HPF, 128x
-	14,		0x008,	// DC, 128x
+	WR(2,	0x03F),	// ADC, PGA, Mix/Boost inputs powered up
+	//WR(14,	0x108),	// HPF, 128x
+	WR(14,	0x008),	// DC, 128x
 	
-	44,		0x044,	// PGA input - select line inputs
-	45, 	0x010,	// LPGA 0dB, unmuted, immediate, no ZC
-	46,		0x010,	// RPGA 0dB, unmuted, immediate, no ZC
-	47,		0x030,	// Lchl line in 0dB, no boost
-	48,		0x030,	// Rchl line in 0dB, no boost
+	WR(44,	0x044),	// PGA input - select line inputs
+	WR(45, 	0x010),	// LPGA 0dB, unmuted, immediate, no ZC
+	WR(46,	0x010),	// RPGA 0dB, unmuted, immediate, no ZC
+	WR(47,	0x030),	// Lchl line in 0dB, no boost
+	WR(48,	0x030),	// Rchl line in 0dB, no boost
 	
 	// Output routing & DAC setup
-	3,		0x18F,	// DACs and aux outputs enabled
-	10,		0x008,	// 128x rate
-//	10,		0x000,	// 64x rate
-	49,		0x002,	// thermal shutdown only (default)
-	50,		0x001,	// L main mixer input from LDAC (default) NEEDED!
-	51,		0x001,	// R main mixer input from RDAC (default) NEEDED!
-	56,		0x001,	// LDAC to AUX2 (default) NEEDED!
-	57,		0x001,	// RDAC to AUX1 (default) NEEDED!
+	WR(3,	0x18F),	// DACs and aux outputs enabled
+	WR(10,	0x008),	// 128x rate
+//	WR(10,	0x000),	// 64x rate
+	WR(49,	0x002),	// thermal shutdown only (default)
+	WR(50,	0x001),	// L main mixer input from LDAC (default) NEEDED!
+	WR(51,	0x001),	// R main mixer input from RDAC (default) NEEDED!
+	WR(56,	0x001),	// LDAC to AUX2 (default) NEEDED!
+	WR(57,	0x001),	// RDAC to AUX1 (default) NEEDED!
 	
 	// Format & clock
-	4, 		0x010,	// 16-bit I2S
+	WR(4, 	0x010),	// 16-bit I2S
 #if 1
 	// No PLL
-	6,		0x000,	// MCLK, no PLL, 1x division, FS, BCLK inputs
-	7,		0x000,	// 4wire off, 48k, no timer (default)
+	WR(6,	0x000),	// MCLK, no PLL, 1x division, FS, BCLK inputs
+	WR(7,	0x000),	// 4wire off, 48k, no timer (default)
 #else
 	// PLL setting for IMCLK = 12.5MHz from 12.5MHz input
-	6,		0x140,	// PLL, 2x division, FS, BCLK inputs (default)
-	7,		0x000,	// 4wire off, 48k, no timer (default)
-	36,		0x008,	// PLL D = 1, N = 8
-	37,		0x000,	// K (high) = 0
-	38,		0x000,	// K (mid) = 0
-	39,		0x000,	// K (low) = 0
-	8,		0x034,	// CSB pin is PLL/16
-	1,		0x0ED,	// enable PLL
+	WR(6,	0x140),	// PLL, 2x division, FS, BCLK inputs (default)
+	WR(7,	0x000),	// 4wire off, 48k, no timer (default)
+	WR(36,	0x008),	// PLL D = 1, N = 8
+	WR(37,	0x000),	// K (high) = 0
+	WR(38,	0x000),	// K (mid) = 0
+	WR(39,	0x000),	// K (low) = 0
+	WR(8,	0x034),	// CSB pin is PLL/16
+	WR(1,	0x0ED),	// enable PLL
 #endif
 
-	255,	0x000,	// EOF
+	SEQ_END
 };
 
 
@@ -98,8 +108,7 @@ int32_t NAU88C22_WriteRegister(uint16_t Reg, uint16_t Data)
 		return 1;
 	}
 	
-	printf("NAU88C22_WriteRegister: write to DevAddr 0x%02X / Reg %3d = 0x%03X\n\r",
-		NAU88C22_I2C_ADDR, Reg, Data);
+	TRACE(TRC_REG_WR, TRC_SRC_NAU88C22, Reg, Data);
 
 	return 0;
 }
@@ -153,12 +162,28 @@ int32_t NAU88C22_ReadRegister(uint16_t Reg, uint16_t *Data)
 	/* assemble 9-bit result */
 	*Data = ((i2c_msg[0]&1)<<8) | i2c_msg[1];
 	
-	printf("NAU88C22_ReadRegister: read from DevAddr 0x%02X / Reg %3d = 0x%03X\n\r",
-		NAU88C22_I2C_ADDR, Reg, *Data);
+	TRACE(TRC_REG_RD, TRC_SRC_NAU88C22, Reg, *Data);
 
 	return 0;
 }
 
+/* Clock Control 1 shadow - MCLKSEL from the rate, BCLKSEL & CLKIOEN from the format */
+static uint16_t nau88c22_clk1;
+static uint8_t nau88c22_master;
+
+/*
+ * access methods for the sequence player
+ */
+const codec_seq_if nau88c22_if =
+{
+	.name = "NAU88C22",
+	.trace_src = TRC_SRC_NAU88C22,
+	.reg_stride = 1,
+	.write = NAU88C22_WriteRegister,
+	.read = NAU88C22_ReadRegister,
+	.reclock = codec_seq_i2c_reclock,
+};
+
 /**
   * @brief  Resets the audio NAU88C22. It restores the default configuration of the
   *         NAU88C22 (this function shall be called before initializing the NAU88C22).
@@ -168,35 +193,121 @@ int32_t NAU88C22_ReadRegister(uint16_t Reg, uint16_t *Data)
   */
 int32_t NAU88C22_Reset(void)
 {
-	uint8_t idx = 0, reg, tries;
-	uint16_t data;
-	int32_t result = 0;
-	
-	while((reg = codec_settings[2*idx]) < 0x80)
+	nau88c22_clk1 = 0;
+	return codec_seq_play(&nau88c22_if, codec_settings);
+}
+
+/* filter sample rate codes for reg 7 */
+static const struct
+{
+	uint32_t fs;
+	uint8_t smplr;
+} nau88c22_rates[] =
+{
+	{48000,	0},
+	{44100,	0},
+	{32000,	1},
+	{24000,	2},
+	{22050,	2},
+	{16000,	3},
+	{12000,	4},
+	{11025,	4},
+	{8000,	5},
+};
+
+/* MCLK divider codes for reg 6, indexed by twice the divide ratio */
+static const int8_t nau88c22_mclksel[25] =
+{
+	-1, -1, 0, 1, 2, -1, 3, -1, 4, -1, -1, -1, 5,
+	-1, -1, -1, 6, -1, -1, -1, -1, -1, -1, -1, 7
+};
+
+/**
+  * @brief  Reprogram the NAU88C22 clocking for a new rate
+  * @note   Assumes the no-PLL table - IMCLK = MCLK / MCLKSEL must be 256 x fs
+  * @param  fs: sample rate in Hz
+  * @param  mclk_ratio: MCLK / fs
+  * @retval 0 if ok, else rate not supported or bus error
+  */
+int32_t NAU88C22_SetRate(uint32_t fs, uint16_t mclk_ratio)
+{
+	uint32_t i, div2;
+
+	for(i=0;i<sizeof(nau88c22_rates)/sizeof(nau88c22_rates[0]);i++)
+		if(nau88c22_rates[i].fs == fs)
+			break;
+	if(i == sizeof(nau88c22_rates)/sizeof(nau88c22_rates[0]))
+		return 1;
+
+	/* MCLK must divide down to 256 x fs */
+	if(mclk_ratio % 128)
+		return 1;
+	div2 = mclk_ratio / 128;
+	if((div2 >= sizeof(nau88c22_mclksel)) || (nau88c22_mclksel[div2] < 0))
+		return 1;
+
+	nau88c22_clk1 = (nau88c22_clk1 & ~0x1e0) | (nau88c22_mclksel[div2] << 5);
+	codec_seq_t seq[] =
 	{
-		data = codec_settings[2*idx + 1];
-		if(reg < 127)
-		{
-			/* valid register - write data */
-			/*
-			 * NOTE: Sometimes writing reg 1 fails. Seems to succeed on 2nd try.
-			 */
-			tries = 0;
-			while((NAU88C22_WriteRegister(reg, data)!=0) && (tries++ <5));
-			if(tries > 4)
-				result++;
-		}
-		else
-		{
-			/* time delay */
-			printf("NAU88C22_Reset: delay %d ms\n\r", data);
-			my_sleep_ms(data);
-		}
-		
-		idx++;
+		SEQ_WRV(6,	nau88c22_clk1),					// MCLK, no PLL, FS & BCLK dir
+		SEQ_WRV(7,	nau88c22_rates[i].smplr << 1),	// 4wire off, filter rate, no timer
+		SEQ_END
+	};
+	return codec_seq_play(&nau88c22_if, seq);
+}
+
+/**
+  * @brief  Select NAU88C22 clocking - takes effect at the next SetFormat
+  * @param  enable: 1 for the codec to drive BCLK & FS, 0 to follow them
+  * @retval 0 if ok
+  */
+int32_t NAU88C22_SetMaster(uint8_t enable)
+{
+	nau88c22_master = enable ? 1 : 0;
+	return 0;
+}
+
+/**
+  * @brief  Set the NAU88C22 audio interface format & word length
+  * @param  fmt: FMT_I2S, FMT_LJ, FMT_RJ, FMT_DSP_A or FMT_DSP_B
+  * @param  bits: 16, 20, 24 or 32
+  * @retval 0 if ok, else format not supported or bus error
+  */
+int32_t NAU88C22_SetFormat(uint8_t fmt, uint8_t bits)
+{
+	uint16_t iface;
+
+	switch(bits)
+	{
+		case 16: iface = 0 << 5; break;
+		case 20: iface = 1 << 5; break;
+		case 24: iface = 2 << 5; break;
+		case 32: iface = 3 << 5; break;
+		default: return 1;
 	}
 
-	return result;
+	switch(fmt)
+	{
+		case FMT_RJ: iface |= 0 << 3; break;
+		case FMT_LJ: iface |= 1 << 3; break;
+		case FMT_I2S: iface |= 2 << 3; break;
+		case FMT_DSP_A: iface |= 3 << 3; break;
+		case FMT_DSP_B: iface |= (3 << 3) | 0x080; break;	// PCM B via LRP
+		default: return 1;
+	}
+
+	/* as master BCLK = 256fs / 4 for 32-bit slots or / 8 for 16-bit */
+	nau88c22_clk1 &= ~0x01d;
+	if(nau88c22_master)
+		nau88c22_clk1 |= ((bits > 16 ? 2 : 3) << 2) | 0x001;
+
+	codec_seq_t seq[] =
+	{
+		SEQ_WRV(6,	nau88c22_clk1),	// BCLK divider, FS & BCLK dir
+		SEQ_WRV(4,	iface),			// format, word length
+		SEQ_END
+	};
+	return codec_seq_play(&nau88c22_if, seq);
 }
 
 /*
@@ -212,6 +323,7 @@ int32_t NAU88C22_Dump_Regs(void)
 		NAU88C22_ReadRegister(reg, &data);
 		reg++;
 	}
+	return 0;
 }
 
 /*
@@ -6,10 +6,18 @@
 #ifndef __NAU88C22__
 #define __NAU88C22__
 
+#include "codec_seq.h"
+
 int32_t NAU88C22_WriteRegister(uint16_t Reg, uint16_t Data);
 int32_t NAU88C22_ReadRegister(uint16_t Reg, uint16_t *Data);
 int32_t NAU88C22_Reset(void);
+int32_t NAU88C22_SetRate(uint32_t fs, uint16_t mclk_ratio);
+int32_t NAU88C22_SetFormat(uint8_t fmt, uint8_t bits);
+int32_t NAU88C22_SetMaster(uint8_t enable);
 int32_t NAU88C22_Dump_Regs(void);
 int32_t NAU88C22_Init(void);
 
+/* register access for the sequence player & the console */
+extern const codec_seq_if nau88c22_if;
+
 #endif
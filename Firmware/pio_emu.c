@@ -0,0 +1,1461 @@
+/*
+ * pio_emu.c - host PIO emulator & I2S waveform checker for i2s_fulldup.pio
+ *
+ * Assembles the .pio source to machine code, runs it on a model of one
+ * state machine (shift registers, autopull/autopush, FIFOs, side-set &
+ * delays) and checks the BCLK/LRCK/DOUT waveforms it produces against
+ * the framing format of each program (I2S, left justified, DSP A & B,
+ * TDM) at every supported slot width & count. The slave program is run
+ * against an external master's clocks and the frame rate counter against
+ * an LRCK of known period. DOUT is looped back to DIN so the receive
+ * path is checked against the transmitted words too.
+ *
+ * The I2S program is then run through the fractional clock divider at
+ * the dividers clkplan picks & a few it can't avoid, for 48000 frames
+ * each, checking the frame rate it sustains, LRCK period jitter, BCLK
+ * duty against the I2S timing limits and, at the common rates, that the
+ * emulation runs well ahead of real time.
+ *
+ * Last the slip watchdog's vote from i2s_phase.h is run on the program
+ * counter as each block of looped-back words completes, with a slot's
+ * worth of input bits forced in partway to slip the words against the
+ * frame. It has to trip, and a restart has to line the frame up again.
+ *
+ * The host build makes it rp2040_i2s_pio_emu, run as
+ *   rp2040_i2s_pio_emu [i2s_fulldup.pio] [program]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include "i2s_phase.h"
+
+/* the program source when none is given */
+#ifndef PIO_EMU_SOURCE
+#define PIO_EMU_SOURCE "i2s_fulldup.pio"
+#endif
+
+#define PIO_MEM_SIZE 32
+#define PIO_FIFO_DEPTH 4
+#define PIO_MAX_LABELS 32
+
+/* pins as wired by i2s_fulldup_program_init() */
+#define PIN_DO 12
+#define PIN_DI 13
+#define PIN_CLK_BASE 10
+
+/* framing the waveform is decoded as */
+enum
+{
+	EMU_I2S,	// channel from LRCK one bit earlier, left on low
+	EMU_LJ,		// channel from LRCK, left on high
+	EMU_DSP_A,	// sync one bit before the left MSB
+	EMU_DSP_B,	// sync with the left MSB
+	EMU_TDM,	// DSP B sync, N slots per frame
+	EMU_SLAVE,	// I2S with BCLK & LRCK from outside
+	EMU_FSMEAS,	// LRCK period counter
+};
+
+/* one assembled program */
+typedef struct
+{
+	char name[32];
+	uint16_t code[PIO_MEM_SIZE];
+	uint8_t len;
+	uint8_t sideset_bits;		// including the enable bit if optional
+	uint8_t sideset_opt;
+	uint8_t wrap_target, wrap;
+	uint8_t nlabels;
+	char label[PIO_MAX_LABELS][32];
+	uint8_t label_addr[PIO_MAX_LABELS];
+} pio_prog;
+
+/* one state machine */
+typedef struct
+{
+	const pio_prog *prog;
+	uint32_t x, y, osr, isr;
+	uint8_t osr_cnt, isr_cnt;
+	uint8_t pc, delay;
+	uint8_t stalled;
+	uint8_t forced;			// running an instruction from outside
+	uint32_t txf[PIO_FIFO_DEPTH], rxf[PIO_FIFO_DEPTH];
+	uint8_t tx_lvl, rx_lvl;
+
+	/* config */
+	uint8_t out_base, out_count, set_base, set_count, in_base, side_base, jmp_pin;
+	uint8_t out_left, in_left, autopull, autopush, pull_thresh, push_thresh;
+
+	/* outputs & inputs */
+	uint32_t pins, pindirs;
+	uint32_t (*input)(uint32_t pins);
+	uint64_t cycles;
+
+	/* clock divider - 16.8 like CLKDIV, 0 in the integer part is 65536 */
+	uint16_t div_int;
+	uint8_t div_frac, div_acc;
+	uint64_t sys_clocks;
+} pio_sm;
+
+/*
+ * assembler
+ */
+static int asm_err;
+static int asm_line;
+
+static void asm_fail(const char *msg, const char *tok)
+{
+	fprintf(stderr, "line %d: %s '%s'\n", asm_line, msg, tok ? tok : "");
+	asm_err = 1;
+}
+
+static int asm_label(const pio_prog *p, const char *name)
+{
+	int i;
+	for(i=0;i<p->nlabels;i++)
+		if(!strcmp(p->label[i], name))
+			return p->label_addr[i];
+	return -1;
+}
+
+static int asm_num(const pio_prog *p, const char *tok, int *val)
+{
+	char *end;
+	int l;
+
+	if(!strncmp(tok, "0b", 2))
+		*val = strtol(tok+2, &end, 2);
+	else
+		*val = strtol(tok, &end, 0);
+	if(*tok && !*end)
+		return 0;
+
+	/* labels are numbers too */
+	if((l = asm_label(p, tok)) >= 0)
+	{
+		*val = l;
+		return 0;
+	}
+	return 1;
+}
+
+static int asm_lookup(const char *tok, const char *const *names, int n)
+{
+	int i;
+	for(i=0;i<n;i++)
+		if(names[i] && !strcmp(tok, names[i]))
+			return i;
+	return -1;
+}
+
+/*
+ * encode one instruction - tok[] has delay & side-set removed
+ */
+static uint16_t asm_insn(const pio_prog *p, char **tok, int ntok)
+{
+	static const char *const jmp_cond[] = {"", "!x", "x--", "!y", "y--", "x!=y", "pin", "!osre"};
+	static const char *const in_src[] = {"pins", "x", "y", "null", NULL, NULL, "isr", "osr"};
+	static const char *const out_dst[] = {"pins", "x", "y", "null", "pindirs", "pc", "isr", "exec"};
+	static const char *const mov_dst[] = {"pins", "x", "y", NULL, "exec", "pc", "isr", "osr"};
+	static const char *const mov_src[] = {"pins", "x", "y", "null", NULL, "status", "isr", "osr"};
+	static const char *const set_dst[] = {"pins", "x", "y", NULL, "pindirs"};
+	int a = 0, b, v = 0, op = 0;
+
+	if(!strcmp(tok[0], "nop"))
+		return 0xA042;	// mov y, y
+
+	if(!strcmp(tok[0], "jmp"))
+	{
+		a = 0;
+		if(ntok == 3 && (a = asm_lookup(tok[1], jmp_cond, 8)) < 0)
+			asm_fail("bad jmp condition", tok[1]);
+		if(asm_num(p, tok[ntok-1], &v))
+			asm_fail("bad jmp target", tok[ntok-1]);
+		return 0x0000 | (a << 5) | (v & 0x1F);
+	}
+
+	if(!strcmp(tok[0], "wait"))
+	{
+		static const char *const wait_src[] = {"gpio", "pin", "irq"};
+		if(ntok != 4 || asm_num(p, tok[1], &v) || v > 1 ||
+			(a = asm_lookup(tok[2], wait_src, 3)) < 0 || asm_num(p, tok[3], &b))
+			asm_fail("bad operands for", tok[0]);
+		return 0x2000 | (v << 7) | (a << 5) | (b & 0x1F);
+	}
+
+	if(!strcmp(tok[0], "in") || !strcmp(tok[0], "out"))
+	{
+		int is_in = tok[0][0] == 'i';
+		if(ntok != 3)
+			asm_fail("bad operands for", tok[0]);
+		a = asm_lookup(tok[1], is_in ? in_src : out_dst, 8);
+		if(a < 0 || asm_num(p, tok[2], &v) || v < 1 || v > 32)
+			asm_fail("bad operands for", tok[0]);
+		return (is_in ? 0x4000 : 0x6000) | (a << 5) | (v & 0x1F);
+	}
+
+	if(!strcmp(tok[0], "push") || !strcmp(tok[0], "pull"))
+	{
+		int is_pull = tok[0][1] == 'u' && tok[0][2] == 'l';
+		int cond = 0, block = 1, i;
+		for(i=1;i<ntok;i++)
+		{
+			if(!strcmp(tok[i], "iffull") || !strcmp(tok[i], "ifempty"))
+				cond = 1;
+			else if(!strcmp(tok[i], "noblock"))
+				block = 0;
+			else if(strcmp(tok[i], "block"))
+				asm_fail("bad operand", tok[i]);
+		}
+		return 0x8000 | (is_pull << 7) | (cond << 6) | (block << 5);
+	}
+
+	if(!strcmp(tok[0], "mov"))
+	{
+		char *src;
+		if(ntok != 3 || (a = asm_lookup(tok[1], mov_dst, 8)) < 0)
+			asm_fail("bad mov destination", tok[1]);
+		src = tok[2];
+		if(*src == '!' || *src == '~')
+		{
+			op = 1;
+			src++;
+		}
+		else if(!strncmp(src, "::", 2))
+		{
+			op = 2;
+			src += 2;
+		}
+		if((b = asm_lookup(src, mov_src, 8)) < 0)
+			asm_fail("bad mov source", src);
+		return 0xA000 | (a << 5) | (op << 3) | b;
+	}
+
+	if(!strcmp(tok[0], "set"))
+	{
+		if(ntok != 3 || (a = asm_lookup(tok[1], set_dst, 5)) < 0 ||
+			asm_num(p, tok[2], &v) || v < 0 || v > 31)
+			asm_fail("bad operands for", tok[0]);
+		return 0xE000 | (a << 5) | v;
+	}
+
+	asm_fail("unsupported instruction", tok[0]);
+	return 0;
+}
+
+/*
+ * split a line into tokens on whitespace & commas
+ */
+static int asm_split(char *line, char **tok, int max)
+{
+	int n = 0;
+	char *s = strtok(line, " \t,\r\n");
+	while(s && n < max)
+	{
+		tok[n++] = s;
+		s = strtok(NULL, " \t,\r\n");
+	}
+	return n;
+}
+
+/*
+ * two passes over the source - labels first, then code. Only the program
+ * called name is assembled, or the first one if name is NULL.
+ */
+int pio_assemble(pio_prog *p, const char *path, const char *name)
+{
+	char buf[256], *tok[16], *c;
+	int pass, ntok, i, v, side, delay, addr, in_sdk, nprog, active;
+	FILE *f;
+
+	memset(p, 0, sizeof(pio_prog));
+	for(pass=0;pass<2;pass++)
+	{
+		if(!(f = fopen(path, "r")))
+		{
+			perror(path);
+			return 1;
+		}
+		addr = 0;
+		in_sdk = 0;
+		nprog = 0;
+		active = 0;
+		asm_line = 0;
+		p->wrap = 0xFF;
+		while(fgets(buf, sizeof(buf), f))
+		{
+			asm_line++;
+
+			/* skip embedded C */
+			if(buf[0] == '%')
+			{
+				in_sdk = !strchr(buf, '}') || strstr(buf, "{");
+				if(!strncmp(buf, "%}", 2))
+					in_sdk = 0;
+				continue;
+			}
+			if(in_sdk)
+				continue;
+
+			/* strip comments */
+			if((c = strchr(buf, ';')))
+				*c = 0;
+			if((c = strstr(buf, "//")))
+				*c = 0;
+			for(c=buf;*c;c++)
+				*c = tolower((unsigned char)*c);
+			if(!(ntok = asm_split(buf, tok, 16)))
+				continue;
+
+			/* directives */
+			if(!strcmp(tok[0], ".program") && ntok > 1)
+			{
+				active = name ? !strcmp(tok[1], name) : !nprog;
+				if(active)
+					strncpy(p->name, tok[1], sizeof(p->name)-1);
+				nprog++;
+				continue;
+			}
+			if(!active)
+				continue;
+			if(!strcmp(tok[0], ".side_set") && ntok > 1)
+			{
+				p->sideset_bits = atoi(tok[1]);
+				if(ntok > 2 && !strcmp(tok[2], "opt"))
+				{
+					p->sideset_opt = 1;
+					p->sideset_bits++;
+				}
+				continue;
+			}
+			if(!strcmp(tok[0], ".define") && ntok > 2)
+			{
+				/* kept with the labels - both are just numbers here */
+				i = !strcmp(tok[1], "public") ? 2 : 1;
+				if(!pass && i+1 < ntok && p->nlabels < PIO_MAX_LABELS)
+				{
+					strncpy(p->label[p->nlabels], tok[i], 31);
+					p->label_addr[p->nlabels++] = strtol(tok[i+1], NULL, 0);
+				}
+				continue;
+			}
+			if(!strcmp(tok[0], ".wrap_target"))
+			{
+				p->wrap_target = addr;
+				continue;
+			}
+			if(!strcmp(tok[0], ".wrap"))
+			{
+				p->wrap = addr - 1;
+				continue;
+			}
+			if(tok[0][0] == '.')
+				continue;
+
+			/* labels */
+			i = 0;
+			if(!strcmp(tok[0], "public"))
+				i = 1;
+			if(i < ntok && tok[i][strlen(tok[i])-1] == ':')
+			{
+				if(!pass && p->nlabels < PIO_MAX_LABELS)
+				{
+					tok[i][strlen(tok[i])-1] = 0;
+					strncpy(p->label[p->nlabels], tok[i], 31);
+					p->label_addr[p->nlabels++] = addr;
+				}
+				memmove(tok, &tok[i+1], (ntok-i-1) * sizeof(char *));
+				ntok -= i + 1;
+				if(!ntok)
+					continue;
+			}
+
+			/* pull off side-set & delay */
+			side = -1;
+			delay = 0;
+			for(i=0;i<ntok;i++)
+			{
+				if(!strcmp(tok[i], "side") && i+1 < ntok)
+				{
+					if(asm_num(p, tok[i+1], &side))
+						asm_fail("bad side value", tok[i+1]);
+					memmove(&tok[i], &tok[i+2], (ntok-i-2) * sizeof(char *));
+					ntok -= 2;
+					i--;
+				}
+				else if(tok[i][0] == '[')
+				{
+					delay = atoi(tok[i]+1);
+					memmove(&tok[i], &tok[i+1], (ntok-i-1) * sizeof(char *));
+					ntok--;
+					i--;
+				}
+			}
+
+			if(addr >= PIO_MEM_SIZE)
+			{
+				asm_fail("program too long", NULL);
+				break;
+			}
+			if(pass)
+			{
+				uint16_t insn = asm_insn(p, tok, ntok);
+				int dbits = 5 - p->sideset_bits;
+				if(delay >= (1 << dbits))
+					asm_fail("delay too long", NULL);
+				v = delay;
+				if(side >= 0)
+				{
+					if(p->sideset_opt)
+						side |= 1 << (p->sideset_bits - 1);
+					v |= side << dbits;
+				}
+				else if(p->sideset_bits && !p->sideset_opt)
+					asm_fail("side-set required", NULL);
+				p->code[addr] = insn | (v << 8);
+			}
+			addr++;
+		}
+		fclose(f);
+		p->len = addr;
+	}
+	if(!p->len)
+	{
+		fprintf(stderr, "%s: no program %s\n", path, name ? name : "");
+		return 1;
+	}
+	if(p->wrap == 0xFF)
+		p->wrap = p->len - 1;
+
+	return asm_err;
+}
+
+/*
+ * state machine
+ */
+static void pio_set_pins(uint32_t *pins, uint8_t base, uint8_t count, uint32_t val)
+{
+	uint32_t mask = count >= 32 ? ~0u : (1u << count) - 1;
+
+	/* pin numbers wrap at 32 so rotate rather than shift */
+	base &= 31;
+	val &= mask;
+	if(base)
+	{
+		mask = (mask << base) | (mask >> (32 - base));
+		val = (val << base) | (val >> (32 - base));
+	}
+	*pins = (*pins & ~mask) | val;
+}
+
+static uint32_t pio_get_gpio(const pio_sm *sm)
+{
+	return sm->input ? sm->input(sm->pins) : sm->pins;
+}
+
+static uint32_t pio_get_pins(const pio_sm *sm)
+{
+	uint32_t pins = pio_get_gpio(sm);
+	return (pins >> sm->in_base) | (sm->in_base ? pins << (32 - sm->in_base) : 0);
+}
+
+int pio_sm_put(pio_sm *sm, uint32_t data)
+{
+	if(sm->tx_lvl == PIO_FIFO_DEPTH)
+		return 1;
+	sm->txf[sm->tx_lvl++] = data;
+	return 0;
+}
+
+int pio_sm_get(pio_sm *sm, uint32_t *data)
+{
+	if(!sm->rx_lvl)
+		return 1;
+	*data = sm->rxf[0];
+	memmove(sm->rxf, sm->rxf+1, --sm->rx_lvl * sizeof(uint32_t));
+	return 0;
+}
+
+static int pio_pull(pio_sm *sm)
+{
+	if(!sm->tx_lvl)
+		return 1;
+	sm->osr = sm->txf[0];
+	memmove(sm->txf, sm->txf+1, --sm->tx_lvl * sizeof(uint32_t));
+	sm->osr_cnt = 0;
+	return 0;
+}
+
+static int pio_push(pio_sm *sm)
+{
+	if(sm->rx_lvl == PIO_FIFO_DEPTH)
+		return 1;
+	sm->rxf[sm->rx_lvl++] = sm->isr;
+	sm->isr = 0;
+	sm->isr_cnt = 0;
+	return 0;
+}
+
+/*
+ * run one instruction - returns 1 if it stalled
+ */
+static int pio_exec(pio_sm *sm, uint16_t insn)
+{
+	const pio_prog *p = sm->prog;
+	uint8_t op = insn >> 13, a = (insn >> 5) & 7, b = insn & 0x1F, jumped = 0;
+	uint32_t n = b ? b : 32, data = 0, mask = n == 32 ? ~0u : (1u << n) - 1, t;
+	int dbits = 5 - p->sideset_bits, side_en = 1;
+	uint32_t side = (insn >> (8 + dbits)) & ((1 << p->sideset_bits) - 1);
+
+	/* side-set happens on the first cycle, even if stalled */
+	if(p->sideset_bits)
+	{
+		if(p->sideset_opt)
+		{
+			side_en = side >> (p->sideset_bits - 1);
+			side &= (1 << (p->sideset_bits - 1)) - 1;
+		}
+		if(side_en)
+			pio_set_pins(&sm->pins, sm->side_base,
+				p->sideset_bits - p->sideset_opt, side);
+	}
+
+	switch(op)
+	{
+		case 0:	// jmp
+			t = 1;
+			switch(a)
+			{
+				case 1: t = !sm->x; break;
+				case 2: t = sm->x--; break;
+				case 3: t = !sm->y; break;
+				case 4: t = sm->y--; break;
+				case 5: t = sm->x != sm->y; break;
+				case 6: t = (pio_get_gpio(sm) >> sm->jmp_pin) & 1; break;
+				case 7: t = sm->osr_cnt < sm->pull_thresh; break;
+			}
+			if(t)
+			{
+				sm->pc = b;
+				jumped = 1;
+			}
+			break;
+
+		case 1:	// wait - stalls until the condition is met
+			if(a & 3)
+				t = a & 1 ? (pio_get_pins(sm) >> b) & 1 : 0;
+			else
+				t = (pio_get_gpio(sm) >> b) & 1;
+			if(t != (insn >> 7 & 1))
+				return 1;
+			break;
+
+		case 2:	// in
+			if(sm->autopush && sm->isr_cnt >= sm->push_thresh && pio_push(sm))
+				return 1;
+			switch(a)
+			{
+				case 0: data = pio_get_pins(sm); break;
+				case 1: data = sm->x; break;
+				case 2: data = sm->y; break;
+				case 6: data = sm->isr; break;
+				case 7: data = sm->osr; break;
+			}
+			data &= mask;
+			if(sm->in_left)
+				sm->isr = (n == 32 ? 0 : sm->isr << n) | data;
+			else
+				sm->isr = (n == 32 ? 0 : sm->isr >> n) | (data << (32 - n));
+			sm->isr_cnt = sm->isr_cnt + n > 32 ? 32 : sm->isr_cnt + n;
+			if(sm->autopush && sm->isr_cnt >= sm->push_thresh)
+				pio_push(sm);
+			break;
+
+		case 3:	// out
+			if(sm->autopull && sm->osr_cnt >= sm->pull_thresh && pio_pull(sm))
+				return 1;
+			if(sm->out_left)
+			{
+				data = sm->osr >> (32 - n);
+				sm->osr = n == 32 ? 0 : sm->osr << n;
+			}
+			else
+			{
+				data = sm->osr & mask;
+				sm->osr = n == 32 ? 0 : sm->osr >> n;
+			}
+			sm->osr_cnt = sm->osr_cnt + n > 32 ? 32 : sm->osr_cnt + n;
+			switch(a)
+			{
+				case 0: pio_set_pins(&sm->pins, sm->out_base, sm->out_count, data); break;
+				case 1: sm->x = data; break;
+				case 2: sm->y = data; break;
+				case 4: pio_set_pins(&sm->pindirs, sm->out_base, sm->out_count, data); break;
+				case 5: sm->pc = data & 0x1F; jumped = 1; break;
+				case 6: sm->isr = data; sm->isr_cnt = n; break;
+			}
+			break;
+
+		case 4:	// push / pull
+			if(insn & 0x80)
+			{
+				if((insn & 0x40) && sm->osr_cnt < sm->pull_thresh)
+					break;
+				if(pio_pull(sm))
+				{
+					if(insn & 0x20)
+						return 1;
+					sm->osr = sm->x;
+					sm->osr_cnt = 0;
+				}
+			}
+			else
+			{
+				if((insn & 0x40) && sm->isr_cnt < sm->push_thresh)
+					break;
+				if(pio_push(sm) && (insn & 0x20))
+					return 1;
+			}
+			break;
+
+		case 5:	// mov
+			switch(b & 7)
+			{
+				case 0: data = pio_get_pins(sm); break;
+				case 1: data = sm->x; break;
+				case 2: data = sm->y; break;
+				case 3: data = 0; break;
+				case 5: data = sm->tx_lvl ? 0 : ~0u; break;
+				case 6: data = sm->isr; break;
+				case 7: data = sm->osr; break;
+			}
+			if(((b >> 3) & 3) == 1)
+				data = ~data;
+			else if(((b >> 3) & 3) == 2)
+			{
+				for(t=0,n=0;n<32;n++)
+					t |= ((data >> n) & 1) << (31 - n);
+				data = t;
+			}
+			switch(a)
+			{
+				case 0: pio_set_pins(&sm->pins, sm->out_base, sm->out_count, data); break;
+				case 1: sm->x = data; break;
+				case 2: sm->y = data; break;
+				case 5: sm->pc = data & 0x1F; jumped = 1; break;
+				case 6: sm->isr = data; sm->isr_cnt = 0; break;
+				case 7: sm->osr = data; sm->osr_cnt = 0; break;
+			}
+			break;
+
+		case 7:	// set
+			switch(a)
+			{
+				case 0: pio_set_pins(&sm->pins, sm->set_base, sm->set_count, b); break;
+				case 1: sm->x = b; break;
+				case 2: sm->y = b; break;
+				case 4: pio_set_pins(&sm->pindirs, sm->set_base, sm->set_count, b); break;
+			}
+			break;
+
+		default:
+			fprintf(stderr, "unsupported opcode 0x%04X\n", insn);
+			exit(1);
+	}
+
+	/* advance with wrap */
+	if(!jumped && !sm->forced)
+		sm->pc = (sm->pc == p->wrap) ? p->wrap_target : (sm->pc + 1) & 0x1F;
+	sm->delay = (insn >> 8) & ((1 << dbits) - 1);
+
+	return 0;
+}
+
+/*
+ * run an instruction from outside as SMx_INSTR does - the PC only moves
+ * if it jumps. Returns 1 if it stalled.
+ */
+int pio_sm_exec(pio_sm *sm, uint16_t insn)
+{
+	int r;
+
+	sm->forced = 1;
+	r = pio_exec(sm, insn);
+	sm->forced = 0;
+
+	return r;
+}
+
+/*
+ * one PIO clock
+ */
+void pio_sm_step(pio_sm *sm)
+{
+	sm->cycles++;
+	if(sm->delay)
+	{
+		sm->delay--;
+		return;
+	}
+	sm->stalled = pio_exec(sm, sm->prog->code[sm->pc]);
+}
+
+/*
+ * one PIO clock through the divider - the fraction accumulates each PIO
+ * clock & the system clocks to it are INT, or INT+1 when it overflows,
+ * so the average is exact over 256 PIO clocks
+ */
+void pio_sm_clock(pio_sm *sm)
+{
+	uint32_t acc = sm->div_acc + sm->div_frac;
+
+	sm->div_acc = acc;
+	sm->sys_clocks += (sm->div_int ? sm->div_int : 65536) + (acc >> 8);
+	pio_sm_step(sm);
+}
+
+/*
+ * I2S check - loopback DOUT to DIN
+ */
+static uint32_t loopback(uint32_t pins)
+{
+	return (pins & ~(1u << PIN_DI)) | (((pins >> PIN_DO) & 1) << PIN_DI);
+}
+
+/* test data - xorshift so every bit position toggles */
+static uint32_t xorshift(uint32_t *state)
+{
+	*state ^= *state << 13;
+	*state ^= *state >> 17;
+	*state ^= *state << 5;
+	return *state;
+}
+
+static uint32_t rnd_state;
+static uint32_t rnd(void)
+{
+	return xorshift(&rnd_state);
+}
+
+/*
+ * same setup as i2s_fulldup_program_init() - y in through the FIFO, OSR
+ * emptied for autopull & a jump to the entry label
+ */
+static void i2s_init(pio_sm *sm, const pio_prog *p, int entry, uint32_t y)
+{
+	memset(sm, 0, sizeof(*sm));
+	sm->prog = p;
+	sm->out_base = PIN_DO;
+	sm->out_count = 1;
+	sm->in_base = PIN_DI;
+	sm->side_base = PIN_CLK_BASE;
+	sm->out_left = sm->in_left = 1;
+	sm->autopull = sm->autopush = 1;
+	sm->pull_thresh = sm->push_thresh = 32;
+	sm->osr_cnt = 32;
+	sm->input = loopback;
+	sm->div_int = 1;
+	pio_sm_put(sm, y);
+	pio_exec(sm, 0x80A0);					// pull block
+	pio_exec(sm, 0xA047);					// mov y, osr
+	pio_exec(sm, 0x6060);					// out null, 32
+	pio_exec(sm, entry);					// jmp entry
+	sm->delay = 0;
+}
+
+#define TEST_FRAMES 64
+#define TEST_SLOTS_MAX 16
+#define TEST_WORDS (TEST_SLOTS_MAX*TEST_FRAMES)
+
+/*
+ * run the program at one slot width & count and check the waveform
+ */
+static int check_width(const pio_prog *p, int fmt, uint32_t bits, uint32_t slots)
+{
+	static uint32_t tx[TEST_WORDS], rx[TEST_WORDS];
+	static uint32_t exp[TEST_SLOTS_MAX][TEST_FRAMES], got[TEST_SLOTS_MAX][TEST_FRAMES+2];
+	uint32_t slot = bits > 16 ? 32 : 16, words = TEST_FRAMES * slots * slot / 32;
+	uint32_t ngot[TEST_SLOTS_MAX], nexp[TEST_SLOTS_MAX];
+	uint32_t i, nin = 0, nrx = 0, prev, cur, bclk, lrck, dout, v;
+	uint32_t word = 0, wbits = 0, bad_len = 0, bad_edge = 0, bclk_cnt = 0;
+	int entry, errs = 0, ch = -1, nch, first, lr_prev = -1, sync, start, setup;
+	int framed = (fmt == EMU_DSP_A) || (fmt == EMU_DSP_B) || (fmt == EMU_TDM);
+	pio_sm sm;
+
+	/*
+	 * words in FIFO order & the samples they should produce. Slots go out
+	 * MSB first, two to a word at 16 bits. Two slot programs start 16-bit
+	 * slots on the right channel.
+	 */
+	rnd_state = 0x12345678 + bits + slots;
+	for(i=0;i<words;i++)
+	{
+		tx[i] = rnd();
+		if(bits == 24)
+			tx[i] &= 0xFFFFFF00;
+	}
+	memset(ngot, 0, sizeof(ngot));
+	memset(nexp, 0, sizeof(nexp));
+	first = (slots == 2) && (slot == 16);
+	for(i=0;i<TEST_FRAMES*slots;i++)
+	{
+		if(slot == 32)
+			v = tx[i];
+		else
+			v = (i & 1) ? tx[i/2] & 0xFFFF : tx[i/2] >> 16;
+		nch = (first + i) % slots;
+		exp[nch][nexp[nch]++] = v;
+	}
+
+	entry = asm_label(p, slot > 16 ? "entry_left" : "entry_point");
+	if(entry < 0)
+		entry = asm_label(p, "entry_point");
+	if(entry < 0)
+	{
+		printf("  %2u-bit: no entry label\n", bits);
+		return 1;
+	}
+	i2s_init(&sm, p, entry, (fmt == EMU_TDM ? slots * slot : slot) - 2);
+
+	/*
+	 * an entry on a mov is the end of the previous slot so its BCLK edge
+	 * only sets up LRCK. DSP has nothing but the sync to go on so when
+	 * starting mid-frame the first slot has to be known.
+	 */
+	setup = (p->code[entry] >> 13) == 5;
+	if(framed && first)
+		ch = first;
+
+	/* run until every word is out plus a frame to flush */
+	prev = sm.pins;
+	for(;;)
+	{
+		for(i=0;i<slots;i++)
+			if(ngot[i] < TEST_FRAMES)
+				break;
+		if(i == slots)
+			break;
+
+		if(nin < words)
+			nin += !pio_sm_put(&sm, tx[nin]);
+		else
+			pio_sm_put(&sm, 0);
+		if(nrx < words)
+			nrx += !pio_sm_get(&sm, &rx[nrx]);
+		else
+			pio_sm_get(&sm, &cur);
+		pio_sm_step(&sm);
+		if(sm.cycles > 32ULL * 4 * TEST_FRAMES * slots * slot)
+		{
+			printf("  %2u-bit: timeout\n", bits);
+			return 1;
+		}
+
+		cur = sm.pins;
+		bclk = (cur >> PIN_CLK_BASE) & 1;
+		lrck = (cur >> (PIN_CLK_BASE+1)) & 1;
+		dout = (cur >> PIN_DO) & 1;
+
+		/* LRCK & DOUT may only change with BCLK falling once running */
+		if(bclk_cnt && ((((cur ^ prev) >> (PIN_CLK_BASE+1)) & 1) ||
+			(((cur ^ prev) >> PIN_DO) & 1)))
+			if(!(((prev >> PIN_CLK_BASE) & 1) && !bclk))
+				bad_edge++;
+
+		/* receiver samples on BCLK rising */
+		if(bclk && !((prev >> PIN_CLK_BASE) & 1))
+		{
+			if(bclk_cnt++ || !setup)
+			{
+				/* which slot this bit belongs to & is it a new one */
+				switch(fmt)
+				{
+					default:
+					case EMU_I2S:
+						nch = lr_prev;
+						start = nch != ch;
+						break;
+					case EMU_LJ:
+						nch = !lrck;
+						start = nch != ch;
+						break;
+					case EMU_DSP_A:
+					case EMU_DSP_B:
+					case EMU_TDM:
+						sync = fmt == EMU_DSP_A ? lr_prev : (int)lrck;
+						nch = sync ? 0 : ch + 1;
+						start = sync || wbits == slot;
+						/* sync only & always after the last slot */
+						if(start && ch >= 0 && (sync != (ch == (int)slots - 1)))
+							bad_len++;
+						if(nch >= (int)slots)
+							nch = slots - 1;
+						break;
+				}
+				if(start)
+				{
+					if(ch >= 0)
+					{
+						if(wbits != slot)
+							bad_len++;
+						if(ngot[ch] < TEST_FRAMES+2)
+							got[ch][ngot[ch]++] = word;
+					}
+					ch = nch;
+					word = 0;
+					wbits = 0;
+				}
+				word = (word << 1) | dout;
+				wbits++;
+			}
+			lr_prev = lrck;
+		}
+		prev = cur;
+	}
+
+	/* every sample in the right slot in the right order */
+	for(i=0;i<TEST_FRAMES*slots;i++)
+		if(got[i % slots][i / slots] != exp[i % slots][i / slots])
+			errs++;
+
+	/* looped-back input should match output word for word */
+	for(i=0;i<nrx;i++)
+		if(rx[i] != tx[i])
+			break;
+
+	printf("  %2u-bit x %2u: %3u frames, %4u PIO cycles/frame, order %s, %s %s, edges %s, loopback %s (%u/%u words)\n",
+		bits, slots, TEST_FRAMES, (uint32_t)(sm.cycles / ((bclk_cnt + slot) / (slots*slot))),
+		errs ? "FAIL" : "ok", framed ? "sync" : "LRCK", bad_len ? "FAIL" : "ok",
+		bad_edge ? "FAIL" : "ok", i == nrx && nrx ? "ok" : "FAIL", i, nrx);
+
+	return errs || bad_len || bad_edge || i != nrx || !nrx;
+}
+
+#define SLIP_FRAMES 32		// frames per block, as FRAMES_PER_BUFFER
+#define SLIP_AT 24			// blocks before the slip goes in
+#define SLIP_BLOCKS 64
+#define SLIP_WORDS (SLIP_BLOCKS*SLIP_FRAMES*2)
+
+/*
+ * slip watchdog check - looped-back words are read a block at a time as
+ * the input DMA does, taking the PC as each block completes for the vote.
+ * SLIP_AT blocks in an `in pins` of one slot is forced in just after a
+ * push, so every word after it is a slot late against the frame and the
+ * slots swap. The vote has to trip within I2S_PHASE_TRIP blocks of that,
+ * allowing for the block in flight, and after a restart as Audio_Watch()
+ * does the words have to match the frame again, with the same half learnt
+ * & no trip.
+ */
+static int check_slip(const pio_prog *p, uint32_t bits)
+{
+	static uint32_t tx[SLIP_WORDS], rx[SLIP_WORDS];
+	uint32_t slot = bits > 16 ? 32 : 16, wpb = SLIP_FRAMES * 2 * slot / 32;
+	uint32_t nin, nrx, blk, slip_blk = 0, slip_word = 0, trip_blk = 0, late, i;
+	uint32_t bad[2] = {0, 0}, late_ok = 0, late_n = 0;
+	uint16_t insn;
+	uint8_t ref = 0, trip;
+	int entry, split, run, slipped, fail;
+	i2s_phase ph;
+	pio_sm sm;
+
+	entry = asm_label(p, slot > 16 ? "entry_left" : "entry_point");
+	split = asm_label(p, "entry_left");
+	if((entry < 0) || (split < 0))
+	{
+		printf("  %2u-bit slip: no entry labels\n", bits);
+		return 1;
+	}
+
+	/* run 0 slips, run 1 is the restart after it */
+	for(run=0;run<2;run++)
+	{
+		i2s_init(&sm, p, entry, slot - 2);
+		i2s_phase_reset(&ph);
+		rnd_state = 0x5119 + bits + run;
+		nin = nrx = 0;
+		slipped = 0;
+		trip = 0;
+		for(blk=0;(blk<SLIP_BLOCKS) && !trip;)
+		{
+			if(nin < SLIP_WORDS)
+				if(!pio_sm_put(&sm, rnd()))
+					tx[nin++] = sm.txf[sm.tx_lvl-1];
+
+			/* one slot in at a word boundary, side-set held as it is */
+			if(!run && !slipped && (blk == SLIP_AT) && !sm.isr_cnt)
+			{
+				insn = 0x4000 | (slot & 0x1F);
+				insn |= ((sm.pins >> PIN_CLK_BASE) & 3) << (13 - p->sideset_bits);
+				slip_word = nrx + sm.rx_lvl;
+				pio_sm_exec(&sm, insn);
+				slipped = 1;
+				slip_blk = blk;
+			}
+
+			pio_sm_step(&sm);
+			if(pio_sm_get(&sm, &rx[nrx]))
+				continue;
+			if(++nrx % wpb)
+				continue;
+
+			/* block done - vote on the half the PC is in */
+			trip = i2s_phase_vote(&ph, (sm.pc < (uint32_t)split) ? 1 : 0);
+			trip_blk = blk++;
+		}
+		if(!run)
+			ref = ph.ref;
+
+		/*
+		 * words against what went out - a slot late once slipped, past the
+		 * one the forced bits went into
+		 */
+		for(i=1;i<nrx;i++)
+		{
+			late = (slot == 32) ? tx[i-1] : (tx[i-1] << 16) | (tx[i] >> 16);
+			if(!run && slipped && (i == slip_word))
+				continue;
+			if(!run && slipped && (i > slip_word))
+			{
+				late_n++;
+				late_ok += rx[i] == late;
+			}
+			else if(rx[i] != tx[i])
+				bad[run]++;
+		}
+
+		if(run)
+		{
+			fail = trip || (ph.ref != ref) || bad[1];
+			printf("  %2u-bit slip: restart %u blocks, %s, words %s\n",
+				bits, blk, trip ? "tripped FAIL" : "no trip ok",
+				bad[1] || (ph.ref != ref) ? "FAIL" : "aligned ok");
+		}
+		else
+		{
+			fail = !trip || (trip_blk + 1 - slip_blk > I2S_PHASE_TRIP + 1) ||
+				bad[0] || (late_ok != late_n) || !late_n;
+			printf("  %2u-bit slip: at block %u, tripped %s in %u blocks, "
+				"words before %s, after %s (%u/%u a slot late)\n",
+				bits, slip_blk, trip ? "ok" : "FAIL", trip_blk + 1 - slip_blk,
+				bad[0] ? "FAIL" : "ok", (late_ok == late_n) && late_n ? "ok" :
+				"FAIL", late_ok, late_n);
+		}
+		if(fail)
+			return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * external I2S master for the slave check - BCLK falls at the start of
+ * each bit, LRCK leads the data by a bit and DIN plays ext_data[], one
+ * slot value at a time, left first
+ */
+static double ext_period;
+static uint64_t ext_now, ext_start;
+static uint32_t ext_slot, ext_nslots, *ext_data;
+
+static uint32_t ext_i2s(uint32_t pins)
+{
+	double t = (ext_now + ext_start) / ext_period;
+	uint64_t bit = (uint64_t)t, sbit;
+	uint32_t bclk = t - bit >= 0.5, lrck = (bit % (2*ext_slot)) >= ext_slot, din = 0;
+
+	if(bit >= 1)
+	{
+		sbit = bit - 1;
+		if(sbit / ext_slot < ext_nslots)
+			din = (ext_data[sbit / ext_slot] >> (ext_slot - 1 - sbit % ext_slot)) & 1;
+	}
+	pins &= ~((1u << PIN_DI) | (3u << PIN_CLK_BASE));
+	return pins | (din << PIN_DI) | (bclk << PIN_CLK_BASE) | (lrck << (PIN_CLK_BASE+1));
+}
+
+/*
+ * find where a run of slot values starts in a longer one - the offset
+ * has to have the right parity for the channel the run starts on
+ */
+static int find_run(const uint32_t *hay, uint32_t nhay, const uint32_t *run,
+	uint32_t n, uint32_t parity)
+{
+	uint32_t o, i;
+
+	for(o=parity;o+n<=nhay;o+=2)
+	{
+		for(i=0;i<n;i++)
+			if(hay[o+i] != run[i])
+				break;
+		if(i == n)
+			return o;
+	}
+	return -1;
+}
+
+/*
+ * run the slave program against an external master at one slot width -
+ * BCLK is a non-integer number of PIO clocks and starts at a random phase
+ */
+static int check_slave(const pio_prog *p, uint32_t bits)
+{
+	static uint32_t tx[TEST_WORDS], rx[TEST_WORDS], din[TEST_WORDS+16];
+	static uint32_t tx_slots[TEST_WORDS], rx_slots[TEST_WORDS], dout[TEST_WORDS+16];
+	uint32_t slot = bits > 16 ? 32 : 16, words = TEST_FRAMES * slot / 16;
+	uint32_t i, nin = 0, nrx = 0, nslots = 2 * TEST_FRAMES, cur, prev_bclk = 0, bclk;
+	uint64_t bit;
+	int entry, rx_at, tx_at;
+	pio_sm sm;
+
+	/* what each side sends, as slot values in time order */
+	rnd_state = 0x9E3779B9 + bits;
+	for(i=0;i<words;i++)
+	{
+		tx[i] = rnd();
+		if(bits == 24)
+			tx[i] &= 0xFFFFFF00;
+	}
+	for(i=0;i<nslots;i++)
+		tx_slots[i] = slot == 32 ? tx[i] : (i & 1 ? tx[i/2] & 0xFFFF : tx[i/2] >> 16);
+	for(i=0;i<nslots+16;i++)
+		din[i] = rnd() & (slot == 32 ? (bits == 24 ? 0xFFFFFF00 : ~0u) : 0xFFFF);
+	memset(dout, 0, sizeof(dout));
+	ext_period = 12.37;
+	ext_now = 0;
+	ext_start = 1234;
+	ext_slot = slot;
+	ext_nslots = nslots + 16;
+	ext_data = din;
+
+	/* same setup as i2s_fulldup_program_init() for the slave */
+	memset(&sm, 0, sizeof(sm));
+	sm.prog = p;
+	sm.out_base = PIN_DO;
+	sm.out_count = 1;
+	sm.in_base = PIN_DI;
+	sm.out_left = sm.in_left = 1;
+	sm.autopull = sm.autopush = 1;
+	sm.pull_thresh = sm.push_thresh = 32;
+	sm.osr_cnt = 32;
+	sm.input = ext_i2s;
+	entry = asm_label(p, slot > 16 ? "sync_left" : "sync_right");
+	if(entry < 0)
+	{
+		printf("  %2u-bit: no entry label\n", bits);
+		return 1;
+	}
+	pio_sm_put(&sm, slot - 1);
+	pio_exec(&sm, 0x80A0);					// pull block
+	pio_exec(&sm, 0xA047);					// mov y, osr
+	pio_exec(&sm, 0x6060);					// out null, 32
+	pio_exec(&sm, entry);					// jmp entry
+
+	/* run until the master runs out of data */
+	while((bit = (uint64_t)((ext_now + ext_start) / ext_period)) < (nslots + 14) * slot)
+	{
+		if(nin < words)
+			nin += !pio_sm_put(&sm, tx[nin]);
+		else
+			pio_sm_put(&sm, 0);
+		if(nrx < words)
+			nrx += !pio_sm_get(&sm, &rx[nrx]);
+		else
+			pio_sm_get(&sm, &cur);
+		ext_now = sm.cycles;
+		pio_sm_step(&sm);
+
+		/* the master samples DOUT as BCLK rises, a bit behind LRCK */
+		bclk = (ext_i2s(0) >> PIN_CLK_BASE) & 1;
+		if(bclk && !prev_bclk && bit >= 1)
+			dout[(bit-1) / slot] = (dout[(bit-1) / slot] << 1) | ((sm.pins >> PIN_DO) & 1);
+		prev_bclk = bclk;
+	}
+
+	/* 16-bit slots start on the right channel, 32-bit on the left */
+	for(i=0;i<nrx*32/slot;i++)
+		rx_slots[i] = slot == 32 ? rx[i] : (i & 1 ? rx[i/2] & 0xFFFF : rx[i/2] >> 16);
+	rx_at = find_run(din, nslots + 16, rx_slots, nrx*32/slot, slot == 16);
+	tx_at = find_run(dout, nslots + 14, tx_slots, nslots - 16, slot == 16);
+
+	printf("  %2u-bit: %6.2f clocks/bit, DIN->RX %s (%u words, at slot %d), TX->DOUT %s (at slot %d)\n",
+		bits, ext_period, rx_at >= 0 && nrx >= words - 8 ? "ok" : "FAIL", nrx, rx_at,
+		tx_at >= 0 ? "ok" : "FAIL", tx_at);
+
+	return rx_at < 0 || nrx < words - 8 || tx_at < 0;
+}
+
+/*
+ * LRCK with a fixed period in PIO clocks for the rate counter check
+ */
+static uint32_t ext_lrck(uint32_t pins)
+{
+	double t = (ext_now + ext_start) / ext_period;
+	uint32_t lrck = t - (uint64_t)t >= 0.5;
+
+	return (pins & ~(1u << (PIN_CLK_BASE+1))) | (lrck << (PIN_CLK_BASE+1));
+}
+
+/*
+ * run the frame rate counter on an LRCK of known period - each window
+ * should come out within the 2 clock edge detection of the true length,
+ * plus a clock for edges that fall between clocks. The first window
+ * starts off the sync wait rather than a window end so is dropped.
+ */
+static int check_fsmeas(const pio_prog *p, double period, uint32_t frames)
+{
+	uint32_t x, n = 0, bad = 0, cycles, first = 1;
+	double sum = 0, err, worst = 0;
+	pio_sm sm;
+
+	ext_period = period;
+	ext_now = 0;
+	ext_start = 777;
+	memset(&sm, 0, sizeof(sm));
+	sm.prog = p;
+	sm.in_base = sm.jmp_pin = PIN_CLK_BASE+1;
+	sm.input = ext_lrck;
+	sm.pull_thresh = sm.push_thresh = 32;
+	pio_sm_put(&sm, frames - 1);
+	pio_exec(&sm, 0x80A0);					// pull block
+	pio_exec(&sm, asm_label(p, "entry_point"));
+
+	while(n < 16 && sm.cycles < 20 * frames * period)
+	{
+		ext_now = sm.cycles;
+		pio_sm_step(&sm);
+		if(pio_sm_get(&sm, &x))
+			continue;
+		if(first)
+		{
+			first = 0;
+			continue;
+		}
+		cycles = 2 * ~x + 2 * frames + 4;
+		err = cycles - frames * period;
+		if(err >= 3 || err <= -3)
+			bad++;
+		if(err > worst || -err > worst)
+			worst = err < 0 ? -err : err;
+		sum += cycles;
+		n++;
+	}
+
+	printf("  %8.3f clocks/frame x %4u: %2u windows, worst %.2f clocks, mean %.4f clocks/frame %s\n",
+		period, frames, n, worst, n ? sum / n / frames : 0, bad || n < 16 ? "FAIL" : "ok");
+
+	return bad || n < 16;
+}
+
+/* a second of audio at 48kHz */
+#define CLKDIV_FRAMES 48000
+
+/* I2S transmitter BCLK high & low time, as a fraction of the period */
+#define I2S_T_HIGH_MIN 0.35
+
+/* slowest acceptable emulation of a timed case - seconds of audio a second */
+#define CLKDIV_REALTIME_MIN 2.0
+
+/*
+ * dividers the throughput check runs at - pio_div is 16.8 like clkplan's.
+ * The cost is per PIO clock, so only the rates up to 48kHz are timed: at
+ * 192kHz a second of audio is 49M PIO clocks & the top dividers aren't
+ * audio rates at all.
+ */
+static const struct
+{
+	uint32_t sys_hz;
+	uint32_t pio_div;
+	uint32_t slot;
+	uint8_t timed;
+	const char *desc;
+} clkdivs[] =
+{
+	{159750000, 26 << 8, 16, 1, "48kHz, default plan"},
+	{159750000, 13 << 8, 32, 1, "48kHz"},
+	{172000000, (3 << 8) | 128, 32, 0, "192kHz"},
+	{125000000, (22 << 8) | 36, 16, 1, "44.1kHz on the SDK clock"},
+	{125000000, (10 << 8) | 44, 32, 1, "48kHz on the SDK clock"},
+	{133000000, (1 << 8) | 192, 16, 0, "fractional near the top"},
+	{159750000, 1 << 8, 32, 0, "flat out"},
+};
+
+/*
+ * run the I2S program through the clock divider for CLKDIV_FRAMES frames
+ * with the FIFOs kept serviced. The frames should average out to exactly
+ * the divider's rate with at most a system clock of LRCK jitter & BCLK has
+ * to meet the I2S transmitter's high & low times. A timed case has to
+ * run at least CLKDIV_REALTIME_MIN times faster than the audio it makes.
+ */
+static int check_clkdiv(const pio_prog *p, uint32_t idx)
+{
+	uint32_t sys_hz = clkdivs[idx].sys_hz, pio_div = clkdivs[idx].pio_div;
+	uint32_t slot = clkdivs[idx].slot, cycles = 2 * slot * 4;
+	uint32_t tx_state = 0x2468ACE1, rx_state = tx_state, x, frames = 0;
+	uint32_t stalls = 0, bad_rx = 0, bad_edge = 0, edges = 0, rises = 0, prev, cur;
+	uint64_t edge = 0, rise = 0, first = 0, period, per_min = ~0ULL, per_max = 0;
+	uint64_t hi_min = ~0ULL, lo_min = ~0ULL, exp;
+	double fs, bclk, real, audio;
+	int entry, bad;
+	clock_t t0;
+	pio_sm sm;
+
+	entry = asm_label(p, slot > 16 ? "entry_left" : "entry_point");
+	if(entry < 0)
+	{
+		printf("  %s: no entry label\n", clkdivs[idx].desc);
+		return 1;
+	}
+	i2s_init(&sm, p, entry, slot - 2);
+	sm.div_int = pio_div >> 8;
+	sm.div_frac = pio_div & 0xFF;
+
+	t0 = clock();
+	prev = sm.pins;
+	while(frames < CLKDIV_FRAMES && sm.cycles < (uint64_t)(CLKDIV_FRAMES + 2) * cycles)
+	{
+		/* DMA keeps up - a stall would be the program's own doing */
+		while(sm.tx_lvl < PIO_FIFO_DEPTH)
+			pio_sm_put(&sm, xorshift(&tx_state));
+		while(!pio_sm_get(&sm, &x))
+			bad_rx += x != xorshift(&rx_state);
+		pio_sm_clock(&sm);
+		stalls += sm.stalled;
+
+		cur = sm.pins;
+		if(!((cur ^ prev) & (7u << PIN_CLK_BASE | 1u << PIN_DO)))
+			continue;
+
+		/* BCLK high & low times, from the second edge of the first whole frame */
+		if(((cur ^ prev) & (1u << PIN_CLK_BASE)) && frames)
+		{
+			if(edges++)
+			{
+				period = sm.sys_clocks - edge;
+				if((prev >> PIN_CLK_BASE) & 1)
+					hi_min = period < hi_min ? period : hi_min;
+				else
+					lo_min = period < lo_min ? period : lo_min;
+			}
+			edge = sm.sys_clocks;
+		}
+
+		/* LRCK & DOUT only with BCLK falling */
+		if(frames && ((cur ^ prev) & (1u << (PIN_CLK_BASE+1) | 1u << PIN_DO)) &&
+			!(((prev >> PIN_CLK_BASE) & 1) && !((cur >> PIN_CLK_BASE) & 1)))
+			bad_edge++;
+
+		/*
+		 * frame period from LRCK rising - the first rise is the jump to the
+		 * entry label mid-frame rather than a frame start
+		 */
+		if(((cur >> (PIN_CLK_BASE+1)) & 1) && !((prev >> (PIN_CLK_BASE+1)) & 1) && rises++)
+		{
+			if(frames++)
+			{
+				period = sm.sys_clocks - rise;
+				per_min = period < per_min ? period : per_min;
+				per_max = period > per_max ? period : per_max;
+			}
+			else
+				first = sm.sys_clocks;
+			rise = sm.sys_clocks;
+		}
+		prev = cur;
+	}
+	real = (double)(clock() - t0) / CLOCKS_PER_SEC;
+
+	/*
+	 * frames - 1 whole periods between the first & last rise, against the
+	 * ideal in 1/256ths of a system clock
+	 */
+	exp = (uint64_t)(frames - 1) * cycles * pio_div;
+	fs = (double)sys_hz * 256 / ((double)cycles * pio_div);
+	bclk = 4.0 * pio_div / 256;
+	audio = frames / fs;
+	bad = frames != CLKDIV_FRAMES || stalls || bad_rx || bad_edge ||
+		(rise - first) * 256 + 256 <= exp || (rise - first) * 256 >= exp + 256 ||
+		per_max - per_min > 1 || hi_min < I2S_T_HIGH_MIN * bclk ||
+		lo_min < I2S_T_HIGH_MIN * bclk ||
+		(clkdivs[idx].timed && audio < real * CLKDIV_REALTIME_MIN);
+
+	printf("  div %7.3f, %2u-bit slots at %6.2f MHz (%s):\n"
+		"    Fs %10.3f Hz, %5.2f Mword/s, frame %llu..%llu clocks, BCLK high %llu low %llu of %.2f,"
+		" %u stalls, edges %s, loopback %s, %.3f s of audio in %.3f s (%.2fx real time%s) %s\n",
+		pio_div / 256.0, slot, sys_hz / 1e6, clkdivs[idx].desc,
+		fs, fs * slot / 16 / 1e6, (unsigned long long)per_min, (unsigned long long)per_max,
+		(unsigned long long)hi_min, (unsigned long long)lo_min, bclk, stalls,
+		bad_edge ? "FAIL" : "ok", bad_rx ? "FAIL" : "ok", audio, real,
+		audio / (real > 0 ? real : 1e-9), clkdivs[idx].timed ? "" : ", not timed",
+		bad ? "FAIL" : "ok");
+
+	return bad;
+}
+
+/* programs in i2s_fulldup.pio & their framing - RJ runs the LJ program */
+static const struct
+{
+	const char *name;
+	int fmt;
+	const char *desc;
+} progs[] =
+{
+	{"i2s_fulldup", EMU_I2S, "I2S"},
+	{"i2s_fulldup_lj", EMU_LJ, "left justified"},
+	{"i2s_fulldup_dsp_a", EMU_DSP_A, "DSP mode A"},
+	{"i2s_fulldup_dsp_b", EMU_DSP_B, "DSP mode B"},
+	{"i2s_fulldup_tdm", EMU_TDM, "TDM"},
+	{"i2s_fulldup_slave", EMU_SLAVE, "I2S slave"},
+	{"i2s_fsmeas", EMU_FSMEAS, "frame rate counter"},
+};
+
+int main(int argc, char **argv)
+{
+	static const uint32_t widths[] = {16, 24, 32}, tdm_slots[] = {4, 8, 16};
+	const char *path = argc > 1 ? argv[1] : PIO_EMU_SOURCE;
+	pio_prog prog;
+	int i, j, k, fail = 0;
+
+	for(j=0;j<(int)(sizeof(progs)/sizeof(progs[0]));j++)
+	{
+		if(argc > 2 && strcmp(argv[2], progs[j].name))
+			continue;
+		if(pio_assemble(&prog, path, progs[j].name))
+			return 1;
+
+		printf("%s (%s): %u instructions, side-set %u, wrap %u..%u\n",
+			prog.name, progs[j].desc, prog.len, prog.sideset_bits,
+			prog.wrap_target, prog.wrap);
+		for(i=0;i<prog.len;i++)
+			printf("  %2d: 0x%04X\n", i, prog.code[i]);
+
+		if(progs[j].fmt == EMU_FSMEAS)
+		{
+			fail |= check_fsmeas(&prog, 2770.833, 16);	// 48k from 133MHz
+			fail |= check_fsmeas(&prog, 1536.0, 64);		// 96k from 147.456MHz
+			fail |= check_fsmeas(&prog, 3628.117, 4);		// 44.1k from 160MHz
+			continue;
+		}
+		for(i=0;i<3;i++)
+		{
+			if(progs[j].fmt == EMU_SLAVE)
+				fail |= check_slave(&prog, widths[i]);
+			else if(progs[j].fmt != EMU_TDM)
+				fail |= check_width(&prog, progs[j].fmt, widths[i], 2);
+			else
+				for(k=0;k<3;k++)
+					fail |= check_width(&prog, progs[j].fmt, widths[i], tdm_slots[k]);
+		}
+		if(progs[j].fmt == EMU_I2S)
+		{
+			for(i=0;i<(int)(sizeof(clkdivs)/sizeof(clkdivs[0]));i++)
+				fail |= check_clkdiv(&prog, i);
+			fail |= check_slip(&prog, 16);
+			fail |= check_slip(&prog, 32);
+		}
+	}
+
+	printf(fail ? "FAILED\n" : "PASSED\n");
+	return fail;
+}
@@ -0,0 +1,408 @@
+/*
+ * plan.c - measurement plans & the core 0 sequencer that runs them
+ *
+ * plan_poll() is called from the idle loop. It finishes whatever the last
+ * step is waiting on - a settle time, core 1 taking a mode, a rate
+ * change or a meter result - then runs steps until one has to wait, at
+ * most PLAN_STEPS_POLL a call. A plan that fails stops where it is. Either way
+ * the rows it made are printed as a table at the end, one per
+ * measurement, and stay until the next run.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "plan.h"
+#include "audio.h"
+#include "codec.h"
+#include "meter.h"
+
+/* what the last step is waiting on */
+enum plan_waits
+{
+	PLAN_WAIT_NONE,
+	PLAN_WAIT_TIME,
+	PLAN_WAIT_MODE,
+	PLAN_WAIT_RATE,
+	PLAN_WAIT_METER
+};
+
+static uint8_t plan_st = PLAN_IDLE, plan_wait, plan_all, plan_depth;
+static uint32_t plan_idx, plan_pc, plan_n;
+static uint64_t plan_until, plan_t0;
+static uint16_t plan_reg, plan_val;
+static uint8_t plan_ch;
+static struct
+{
+	uint32_t pc, left;
+} plan_loops[PLAN_DEPTH];
+static plan_row plan_tab[PLAN_ROWS];
+static uint32_t plan_dropped;
+
+static const char *plan_states[] =
+{
+	"idle", "running", "done", "failed"
+};
+
+/*
+ * start plans[idx] from the top with nothing written
+ */
+static void plan_begin(uint32_t idx)
+{
+	plan_idx = idx;
+	plan_pc = 0;
+	plan_depth = 0;
+	plan_wait = PLAN_WAIT_NONE;
+	plan_reg = PLAN_NO_REG;
+	plan_val = 0;
+	plan_t0 = time_us_64();
+	plan_st = PLAN_RUNNING;
+	printf("plan %s: running\n", plans[idx].name);
+}
+
+/*
+ * the table of the rows plans[plan_idx] made
+ */
+void plan_report(void)
+{
+	const plan_row *r;
+	uint32_t i, n = 0;
+
+	if(plan_st == PLAN_IDLE)
+		return;
+
+	printf("plan %s: %s in %u ms\n", plans[plan_idx].name,
+		plan_states[plan_st], (uint32_t)((time_us_64() - plan_t0) / 1000));
+	printf("%6s %-4s %10s %7s %6s %6s %2s %8s %8s %8s %6s\n", "fs", "mode",
+		"Hz", "set dB", "reg", "val", "ch", "rms dB", "tone dB", "THD+N", "DC");
+	for(i=0;i<plan_n;i++)
+	{
+		r = &plan_tab[i];
+		if(r->plan != plan_idx)
+			continue;
+		n++;
+		printf("%6u %-4u %10.3f %7.2f ", r->fs, r->mode, r->hz / 65536.0,
+			r->db / 256.0);
+		if(r->reg == PLAN_NO_REG)
+			printf("%6s %6s ", "-", "-");
+		else
+			printf("0x%04X 0x%04X ", r->reg, r->val);
+		printf("%2u ", r->ch);
+		if(r->ok)
+			printf("%8.2f %8.2f %8.2f %6d\n", r->rms / 100.0, r->tone / 100.0,
+				r->thdn / 100.0, r->dc);
+		else
+			printf("%8s %8s %8s %6s\n", "-", "-", "-", "-");
+	}
+	printf("plan %s: %u rows", plans[plan_idx].name, n);
+	if(plan_dropped)
+		printf(", %u dropped", plan_dropped);
+	printf("\n");
+}
+
+/*
+ * end the plan & move to the next if running them all
+ */
+static void plan_end(uint8_t state)
+{
+	plan_st = state;
+	plan_wait = PLAN_WAIT_NONE;
+	meter_stop();
+	plan_report();
+
+	if(plan_all && (state == PLAN_DONE) && (plan_idx + 1 < plans_num))
+		plan_begin(plan_idx + 1);
+}
+
+/*
+ * stop with why & where
+ */
+static void plan_fail(const char *why)
+{
+	printf("plan %s: %s at step %u\n", plans[plan_idx].name, why, plan_pc - 1);
+	plan_end(PLAN_FAILED);
+}
+
+/*
+ * dB to the 1/100 dB a row holds
+ */
+static int16_t plan_cdb(double db)
+{
+	db *= 100.0;
+	if(db > INT16_MAX)
+		return INT16_MAX;
+	if(db < INT16_MIN)
+		return INT16_MIN;
+
+	return (int16_t)db;
+}
+
+/*
+ * a row for the measurement that just finished or timed out
+ */
+static void plan_row_add(const meter_result *m)
+{
+	audio_status s;
+	plan_row *r;
+
+	if(plan_n >= PLAN_ROWS)
+	{
+		plan_dropped++;
+		return;
+	}
+	r = &plan_tab[plan_n++];
+
+	Audio_Get_Status(&s);
+	r->fs = s.fs;
+	r->hz = s.hz;
+	r->db = s.db;
+	r->reg = plan_reg;
+	r->val = plan_val;
+	r->plan = plan_idx;
+	r->mode = s.mode;
+	r->ch = plan_ch;
+	r->ok = m ? 1 : 0;
+	r->rms = m ? plan_cdb(m->rms_db) : 0;
+	r->tone = m ? plan_cdb(m->tone_db) : 0;
+	r->thdn = m ? plan_cdb(m->thdn_db) : 0;
+	r->dc = m ? (int16_t)m->dc : 0;
+}
+
+/*
+ * 1 while the last step still has to wait
+ */
+static int32_t plan_waiting(void)
+{
+	meter_result m;
+	int32_t r;
+
+	switch(plan_wait)
+	{
+		case PLAN_WAIT_TIME:
+			return time_us_64() < plan_until;
+
+		case PLAN_WAIT_MODE:
+			/* core 1 takes it between handlers, give it the chance */
+			if(Audio_Mode_Live())
+				return 0;
+			tight_loop_contents();
+			return 1;
+
+		case PLAN_WAIT_RATE:
+			/* core 1 mutes & parks along the way, as for a mode */
+			r = Audio_Rate_Poll();
+			if(r > 0)
+			{
+				tight_loop_contents();
+				return 1;
+			}
+			if(r < 0)
+				plan_fail("rate");
+			return 0;
+
+		case PLAN_WAIT_METER:
+			r = meter_get(&m);
+			if((r > 0) && (time_us_64() < plan_until))
+				return 1;
+			if(r > 0)
+				meter_stop();
+			plan_row_add(r ? NULL : &m);
+			return 0;
+	}
+
+	return 0;
+}
+
+/*
+ * the codec register write for REG & REG_ADD
+ */
+static void plan_reg_write(uint16_t reg, int32_t val)
+{
+	if((reg == PLAN_NO_REG) || (val < 0) || (val > 0xFFFF) ||
+		Codec_WriteReg(reg, val))
+	{
+		plan_fail("codec reg");
+		return;
+	}
+	plan_reg = reg;
+	plan_val = val;
+}
+
+/*
+ * run one step
+ */
+static void plan_exec(const plan_step *st)
+{
+	audio_status s;
+	uint64_t ms;
+
+	switch(st->op)
+	{
+		case PLAN_OP_END:
+			plan_end(PLAN_DONE);
+			break;
+
+		case PLAN_OP_RATE:
+			if(Audio_Rate_Post(st->val))
+				plan_fail("rate");
+			else
+				plan_wait = PLAN_WAIT_RATE;
+			break;
+
+		case PLAN_OP_MODE:
+			Audio_Mode_Post(st->arg);
+			plan_wait = PLAN_WAIT_MODE;
+			break;
+
+		case PLAN_OP_TONE:
+			if(Audio_Set_Tone(st->val))
+				plan_fail("tone");
+			break;
+
+		case PLAN_OP_TONE_MUL:
+			Audio_Get_Status(&s);
+			if(Audio_Set_Tone(((uint64_t)s.hz * (uint32_t)st->val) >> 16))
+				plan_fail("tone");
+			break;
+
+		case PLAN_OP_LEVEL:
+			if(Audio_Set_Level(st->val))
+				plan_fail("level");
+			break;
+
+		case PLAN_OP_LEVEL_ADD:
+			Audio_Get_Status(&s);
+			if(Audio_Set_Level(s.db + st->val))
+				plan_fail("level");
+			break;
+
+		case PLAN_OP_REG:
+			plan_reg_write(st->reg, st->val);
+			break;
+
+		case PLAN_OP_REG_ADD:
+			plan_reg_write(plan_reg, plan_val + st->val);
+			break;
+
+		case PLAN_OP_SETTLE:
+			plan_until = time_us_64() + 1000ULL * st->val;
+			plan_wait = PLAN_WAIT_TIME;
+			break;
+
+		case PLAN_OP_MEASURE:
+			Audio_Get_Status(&s);
+			if(meter_start(st->arg, st->val, s.inc))
+			{
+				plan_fail("measure");
+				break;
+			}
+			plan_ch = st->arg;
+
+			/* frames at the rate, plus slack */
+			ms = (uint64_t)st->val * 1000 / s.fs + PLAN_METER_SLACK_MS;
+			plan_until = time_us_64() + 1000 * ms;
+			plan_wait = PLAN_WAIT_METER;
+			break;
+
+		case PLAN_OP_LOOP:
+			if(plan_depth >= PLAN_DEPTH)
+			{
+				plan_fail("loops too deep");
+				break;
+			}
+			plan_loops[plan_depth].pc = plan_pc;
+			plan_loops[plan_depth].left = st->arg ? st->arg : 1;
+			plan_depth++;
+			break;
+
+		case PLAN_OP_NEXT:
+			if(!plan_depth)
+			{
+				plan_fail("NEXT without LOOP");
+				break;
+			}
+			if(--plan_loops[plan_depth-1].left)
+				plan_pc = plan_loops[plan_depth-1].pc;
+			else
+				plan_depth--;
+			break;
+
+		default:
+			plan_fail("bad step");
+			break;
+	}
+}
+
+/*
+ * start a plan by name, or all of them in turn for NULL - drops the rows
+ * of the last run. Returns 0 if ok, or 1 if there's no such plan.
+ */
+int32_t plan_run(const char *name)
+{
+	uint32_t i;
+
+	for(i=0;name && (i<plans_num);i++)
+		if(!strcmp(name, plans[i].name))
+			break;
+	if(!plans_num || (i == plans_num))
+		return 1;
+
+	if(plan_st == PLAN_RUNNING)
+		meter_stop();
+	plan_all = name ? 0 : 1;
+	plan_n = 0;
+	plan_dropped = 0;
+	plan_begin(name ? i : 0);
+
+	return 0;
+}
+
+/*
+ * stop where it is - the rows so far are kept
+ */
+void plan_stop(void)
+{
+	if(plan_st != PLAN_RUNNING)
+		return;
+	printf("plan %s: stopped\n", plans[plan_idx].name);
+	plan_end(PLAN_FAILED);
+}
+
+/*
+ * step the running plan - call from the idle loop
+ */
+void plan_poll(void)
+{
+	uint32_t n;
+
+	if(plan_st != PLAN_RUNNING)
+		return;
+
+	/* finish what the last step started */
+	if(plan_waiting())
+		return;
+	plan_wait = PLAN_WAIT_NONE;
+
+	/* then on to the next that has to wait */
+	for(n=0;(n<PLAN_STEPS_POLL) && (plan_st == PLAN_RUNNING) &&
+		(plan_wait == PLAN_WAIT_NONE);n++)
+		plan_exec(&plans[plan_idx].steps[plan_pc++]);
+}
+
+uint8_t plan_state(void)
+{
+	return plan_st;
+}
+
+const char *plan_name(void)
+{
+	return (plan_st == PLAN_IDLE) ? "-" : plans[plan_idx].name;
+}
+
+/*
+ * rows of the last run, over every plan in it
+ */
+uint32_t plan_rows(const plan_row **rows)
+{
+	*rows = plan_tab;
+	return plan_n;
+}
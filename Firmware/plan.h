@@ -0,0 +1,116 @@
+/*
+ * plan.h - measurement plans & the core 0 sequencer that runs them
+ *
+ * A plan is a table of plan_step entries built with the PLAN_xx() macros
+ * below and kept in flash. The sequencer steps through it from the idle
+ * loop: it changes the tone, level, mode, rate or a codec register, waits,
+ * and has core 1 measure the input, keeping a row per measurement. It
+ * never spins on core 1 - mode changes, rate changes and measurements are
+ * posted and checked for on later polls.
+ */
+
+#ifndef __plan__
+#define __plan__
+
+#include "main.h"
+#include "codec_seq.h"
+#include "fixparam.h"
+
+/* rows one run keeps, loops one plan can nest & steps a poll can run */
+#define PLAN_ROWS 64
+#define PLAN_DEPTH 4
+#define PLAN_STEPS_POLL 16
+
+/* a measurement that hasn't finished in this long past its frames fails */
+#define PLAN_METER_SLACK_MS 100
+
+/* no codec register written yet */
+#define PLAN_NO_REG 0xFFFF
+
+/* step opcodes */
+enum plan_ops
+{
+	PLAN_OP_END,		// end of the plan
+	PLAN_OP_RATE,		// val = sample rate
+	PLAN_OP_MODE,		// arg = AUDIO_MODE_xx, waits until core 1 has it
+	PLAN_OP_TONE,		// val = Q16.16 Hz
+	PLAN_OP_TONE_MUL,	// val = Q16.16 ratio to the tone
+	PLAN_OP_LEVEL,		// val = 1/256 dB
+	PLAN_OP_LEVEL_ADD,	// val = 1/256 dB added to the level
+	PLAN_OP_REG,		// codec reg = val
+	PLAN_OP_REG_ADD,	// val added to the last reg written
+	PLAN_OP_SETTLE,		// wait val ms
+	PLAN_OP_MEASURE,	// arg = channel, val = frames - adds a row
+	PLAN_OP_LOOP,		// run to the matching NEXT arg times
+	PLAN_OP_NEXT,
+};
+
+/* one step - 8 bytes */
+typedef struct
+{
+	uint8_t op;
+	uint8_t arg;
+	uint16_t reg;
+	int32_t val;
+} plan_step;
+
+/* keep plan tables in flash */
+#define PLAN_TAB __in_flash("plan")
+
+/* table entry builders - range checked at compile time like SEQ_xx() */
+#define PLAN_RATE(fs)		{PLAN_OP_RATE, 0, 0, (fs)}
+#define PLAN_MODE(m)		{PLAN_OP_MODE, SEQ_CHK(m, 2), 0, 0}
+#define PLAN_TONE(hz)		{PLAN_OP_TONE, 0, 0, FIXPARAM_HZ(hz)}
+#define PLAN_TONE_MUL(r)	{PLAN_OP_TONE_MUL, 0, 0, FIXPARAM_HZ(r)}
+#define PLAN_LEVEL(db)		{PLAN_OP_LEVEL, 0, 0, FIXPARAM_DB(db)}
+#define PLAN_LEVEL_ADD(db)	{PLAN_OP_LEVEL_ADD, 0, 0, FIXPARAM_DB(db)}
+#define PLAN_REG(r, v)		{PLAN_OP_REG, 0, SEQ_CHK(r, 16), SEQ_CHK(v, 16)}
+#define PLAN_REG_ADD(v)		{PLAN_OP_REG_ADD, 0, 0, (v)}
+#define PLAN_SETTLE(ms)		{PLAN_OP_SETTLE, 0, 0, (ms)}
+#define PLAN_MEASURE(ch, n)	{PLAN_OP_MEASURE, SEQ_CHK(ch, 1), 0, (n)}
+#define PLAN_LOOP(n)		{PLAN_OP_LOOP, SEQ_CHK(n, 8), 0, 0}
+#define PLAN_NEXT			{PLAN_OP_NEXT, 0, 0, 0}
+#define PLAN_END			{PLAN_OP_END, 0, 0, 0}
+
+/* a named plan */
+typedef struct
+{
+	const char *name;
+	const plan_step *steps;
+} plan_def;
+
+/* one measurement & what was set for it */
+typedef struct
+{
+	uint32_t fs;
+	uint32_t hz;			// Q16.16 tone
+	int32_t db;				// 1/256 dB level
+	uint16_t reg, val;		// last codec write, reg PLAN_NO_REG if none
+	uint8_t plan;			// index in plans[]
+	uint8_t mode, ch;
+	uint8_t ok;				// 0 if the measurement timed out
+	int16_t rms, tone, thdn;	// 1/100 dB, as meter_result
+	int16_t dc;				// 16-bit LSBs
+} plan_row;
+
+enum plan_states
+{
+	PLAN_IDLE,
+	PLAN_RUNNING,
+	PLAN_DONE,
+	PLAN_FAILED
+};
+
+/* the built in plans - see plans.c */
+extern const plan_def plans[];
+extern const uint32_t plans_num;
+
+int32_t plan_run(const char *name);	// NULL runs them all in turn
+void plan_stop(void);
+void plan_poll(void);
+uint8_t plan_state(void);
+const char *plan_name(void);
+uint32_t plan_rows(const plan_row **rows);
+void plan_report(void);
+
+#endif
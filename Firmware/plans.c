@@ -0,0 +1,91 @@
+/*
+ * plans.c - the built in measurement plans, see plan.h
+ *
+ * Each leaves the tone at 100Hz & full scale for the button modes, and any
+ * rate it changed back at the default.
+ */
+
+#include "plan.h"
+#include "audio.h"
+#include "i2s_fulldup.h"
+#include "tables.h"
+
+/* level linearity - 997Hz from full scale down to -90dB in 10dB steps */
+static const plan_step plan_level[] PLAN_TAB =
+{
+	PLAN_MODE(AUDIO_MODE_SINE),
+	PLAN_TONE(997),
+	PLAN_LEVEL(0),
+	PLAN_LOOP(10),
+		PLAN_SETTLE(20),
+		PLAN_MEASURE(0, 9600),
+		PLAN_LEVEL_ADD(-10),
+	PLAN_NEXT,
+	PLAN_LEVEL(0),
+	PLAN_TONE(TAB_OSC_HZ),
+	PLAN_END
+};
+
+/* frequency response - -6dB from 20Hz up an octave a step to 10.24kHz */
+static const plan_step plan_freq[] PLAN_TAB =
+{
+	PLAN_MODE(AUDIO_MODE_SINE),
+	PLAN_LEVEL(-6),
+	PLAN_TONE(20),
+	PLAN_LOOP(10),
+		PLAN_SETTLE(20),
+		PLAN_MEASURE(0, 9600),
+		PLAN_TONE_MUL(2),
+	PLAN_NEXT,
+	PLAN_LEVEL(0),
+	PLAN_TONE(TAB_OSC_HZ),
+	PLAN_END
+};
+
+/* 997Hz at -6dB at each standard rate up to 96kHz */
+static const plan_step plan_rates[] PLAN_TAB =
+{
+	PLAN_MODE(AUDIO_MODE_SINE),
+	PLAN_TONE(997),
+	PLAN_LEVEL(-6),
+	PLAN_RATE(8000),	PLAN_SETTLE(50),	PLAN_MEASURE(0, 4000),
+	PLAN_RATE(16000),	PLAN_SETTLE(50),	PLAN_MEASURE(0, 8000),
+	PLAN_RATE(32000),	PLAN_SETTLE(50),	PLAN_MEASURE(0, 16000),
+	PLAN_RATE(44100),	PLAN_SETTLE(50),	PLAN_MEASURE(0, 22050),
+	PLAN_RATE(48000),	PLAN_SETTLE(50),	PLAN_MEASURE(0, 24000),
+	PLAN_RATE(96000),	PLAN_SETTLE(50),	PLAN_MEASURE(0, 48000),
+	PLAN_RATE(I2S_FS_DEFAULT),
+	PLAN_LEVEL(0),
+	PLAN_TONE(TAB_OSC_HZ),
+	PLAN_END
+};
+
+#ifdef CODEC_UDA1345
+/* DAC volume register - 997Hz at full scale, 0 to -28dB in 4dB steps */
+static const plan_step plan_dac_vol[] PLAN_TAB =
+{
+	PLAN_MODE(AUDIO_MODE_SINE),
+	PLAN_TONE(997),
+	PLAN_LEVEL(0),
+	PLAN_REG(0x00, 0),
+	PLAN_LOOP(8),
+		PLAN_SETTLE(50),
+		PLAN_MEASURE(0, 9600),
+		PLAN_REG_ADD(4),
+	PLAN_NEXT,
+	PLAN_REG(0x00, 0),
+	PLAN_TONE(TAB_OSC_HZ),
+	PLAN_END
+};
+#endif
+
+const plan_def plans[] =
+{
+	{"level",	plan_level},
+	{"freq",	plan_freq},
+	{"rates",	plan_rates},
+#ifdef CODEC_UDA1345
+	{"dac_vol",	plan_dac_vol},
+#endif
+};
+const uint32_t plans_num = sizeof(plans)/sizeof(plans[0]);
@@ -0,0 +1,614 @@
+/*
+ * prbs.c - bit-exact loopback check with a PRBS stream & the DMA sniffer
+ *
+ * One I2S instance sends a PRBS-31 sequence cut into slots, repeating
+ * every PRBS_SLOTS slots, straight out of a table of FIFO words. Whatever
+ * loops it back - a codec in digital loopback or DO jumpered to DI - the
+ * DMA sniffer takes a CRC32 of each input block as it lands. Once the
+ * loop delay is known the CRC of every block is known ahead, so the input
+ * ISR does one compare per block and no per-sample work. Blocks that
+ * don't match are handed to prbs_poll() on core 0, which counts the bit
+ * errors if the stream is still in step, finds where it went for a slip
+ * or L/R swap, or counts the block lost and searches again.
+ *
+ * PRBS_HOST makes rp2040_i2s_prbs of it, the checker over a modelled loop
+ * and sniffer with injected bit errors, slips & dropouts.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "prbs.h"
+#ifndef PRBS_HOST
+#include "hardware/dma.h"
+#include "i2s_fulldup.h"
+#else
+#define __not_in_flash_func(f) f
+#define I2S_SNIFF_SEED 0xFFFFFFFF
+enum {FMT_I2S, FMT_LJ, FMT_RJ, FMT_DSP_A, FMT_DSP_B, FMT_TDM};
+
+/* just what the checker uses of the I2S engine */
+typedef struct
+{
+	uint8_t sniff;
+	uint32_t sniff_crc;
+} i2s_inst;
+
+static uint32_t i2s_words;
+static uint8_t i2s_bits, i2s_slot_bits, i2s_fmt, i2s_slots;
+#endif
+
+/* CRC-32 IEEE 802.3 polynomial, shifted MSB first as the sniffer does */
+#define PRBS_POLY 0x04C11DB7
+
+/* FIFO words in the largest block - 32 frames of 16 32-bit slots */
+#define PRBS_BLOCK_MAX 512
+
+/* mismatched slots a block can have and still be in step */
+#define PRBS_BAD_MAX(slots) ((slots)/8)
+
+static uint32_t prbs_tab[PRBS_SLOTS];				// one period as FIFO words
+static uint32_t prbs_crc[2][PRBS_PHASES_MAX];		// block CRCs for the delay
+static uint32_t prbs_cap[PRBS_BLOCK_MAX];			// block for core 0
+static uint32_t prbs_exp[PRBS_BLOCK_MAX];			// core 0 scratch
+static uint32_t prbs_words, prbs_bslots, prbs_phases, prbs_tx_pos;
+static uint32_t prbs_cap_blk;
+static volatile uint32_t prbs_rx_blk;
+static volatile uint8_t prbs_cap_full;
+
+/* 0 while searching, else 1 + the CRC table in use */
+static volatile uint8_t prbs_lock;
+
+static uint8_t prbs_bswap;
+static prbs_stats prbs_n;
+
+/*
+ * CRC32 of FIFO words the way the sniffer takes them - bytes in memory
+ * order unless swapped, each MSB first, no final inversion
+ */
+static uint32_t prbs_crc32(uint32_t crc, const uint32_t *w, uint32_t n,
+	uint8_t bswap)
+{
+	uint32_t i, b, k, x;
+
+	for(i=0;i<n;i++)
+	{
+		x = bswap ? __builtin_bswap32(w[i]) : w[i];
+		for(b=0;b<4;b++)
+		{
+			crc ^= (x & 0xFF) << 24;
+			x >>= 8;
+			for(k=0;k<8;k++)
+				crc = (crc & 0x80000000) ? (crc << 1) ^ PRBS_POLY : crc << 1;
+		}
+	}
+
+	return crc;
+}
+
+/*
+ * slot n of a run of FIFO words - 16-bit slots pair up left in the top
+ */
+static inline uint32_t prbs_slot(const uint32_t *w, uint32_t n)
+{
+	if(i2s_slot_bits == 16)
+		return (n & 1) ? w[n >> 1] & 0xFFFF : w[n >> 1] >> 16;
+	return w[n];
+}
+
+/*
+ * slot n of the stream, wrapping on the period
+ */
+static inline uint32_t prbs_stream(uint32_t n)
+{
+	return prbs_slot(prbs_tab, n & (PRBS_SLOTS-1));
+}
+
+/*
+ * the FIFO words of a block starting at stream slot s0
+ */
+static void prbs_expect(uint32_t *dst, uint32_t s0)
+{
+	uint32_t i;
+
+	for(i=0;i<i2s_words;i++)
+	{
+		if(i2s_slot_bits == 16)
+			dst[i] = (prbs_stream(s0 + 2*i) << 16) | prbs_stream(s0 + 2*i + 1);
+		else
+			dst[i] = prbs_stream(s0 + i);
+	}
+}
+
+/*
+ * fill the table for the current format & clear the counts
+ */
+static void prbs_setup(void)
+{
+	uint32_t lfsr = 0x7FFFFFFF, mask, i, b, x, bit;
+
+	/* bits the codec carries in a slot */
+	if(i2s_slot_bits == 16)
+		mask = 0xFFFF;
+	else if(i2s_fmt == FMT_RJ)
+		mask = 0xFFFFFFFF >> (32 - i2s_bits);
+	else
+		mask = 0xFFFFFFFF << (32 - i2s_bits);
+
+	for(i=0;i<PRBS_SLOTS;i++)
+	{
+		/* PRBS-31, x^31 + x^28 + 1, 32 bits to a slot */
+		for(b=0, x=0;b<32;b++)
+		{
+			bit = ((lfsr >> 30) ^ (lfsr >> 27)) & 1;
+			lfsr = ((lfsr << 1) | bit) & 0x7FFFFFFF;
+			x = (x << 1) | bit;
+		}
+
+		if(i2s_slot_bits == 16)
+		{
+			if(i & 1)
+				prbs_tab[i >> 1] |= x >> 16;
+			else
+				prbs_tab[i >> 1] = x & 0xFFFF0000;
+		}
+		else
+			prbs_tab[i] = x & mask;
+	}
+
+	prbs_words = PRBS_SLOTS * i2s_slot_bits / 32;
+	prbs_bslots = i2s_words * 32 / i2s_slot_bits;
+	prbs_phases = PRBS_SLOTS / prbs_bslots;
+	prbs_tx_pos = 0;
+	prbs_rx_blk = 0;
+	prbs_lock = 0;
+	prbs_cap_full = 0;
+	memset(&prbs_n, 0, sizeof(prbs_n));
+}
+
+/*
+ * block callback - sends the next block of the stream and checks the
+ * CRC of the one received. Runs in the input DMA ISR.
+ */
+static void __not_in_flash_func(prbs_proc)(i2s_inst *i2s, uint32_t *dst,
+	uint32_t *src)
+{
+	uint32_t k = prbs_rx_blk;
+	uint8_t lock = prbs_lock;
+
+	memcpy(dst, &prbs_tab[prbs_tx_pos], i2s_words*sizeof(uint32_t));
+	prbs_tx_pos += i2s_words;
+	if(prbs_tx_pos >= prbs_words)
+		prbs_tx_pos = 0;
+
+	if(lock && (i2s->sniff_crc == prbs_crc[lock-1][k & (prbs_phases-1)]))
+		prbs_n.blocks++;
+	else
+	{
+		if(lock)
+			prbs_n.block_errs++;
+
+		/* over to core 0 unless it's still on the last one */
+		if(!prbs_cap_full)
+		{
+			memcpy(prbs_cap, src, i2s_words*sizeof(uint32_t));
+			prbs_cap_blk = k;
+			__sync_synchronize();
+			prbs_cap_full = 1;
+		}
+	}
+
+	prbs_rx_blk = k + 1;
+}
+
+/*
+ * find the stream in block blk - returns the loop delay in slots or -1.
+ * A few bad slots are let through so a bit error doesn't stop a lock.
+ */
+static int32_t prbs_search(const uint32_t *cap, uint32_t blk)
+{
+	uint32_t a, o, i, s0, x, bad;
+
+	/* try a few slots in the block in case the first is hit */
+	for(a=0;a<prbs_bslots;a+=prbs_bslots/4)
+	{
+		x = prbs_slot(cap, a);
+		for(o=0;o<PRBS_SLOTS;o++)
+		{
+			if(prbs_stream(o) != x)
+				continue;
+
+			s0 = o - a;
+			for(i=0, bad=0;(i<prbs_bslots) && (bad<=PRBS_BAD_MAX(prbs_bslots));i++)
+				if(prbs_slot(cap, i) != prbs_stream(s0 + i))
+					bad++;
+			if(bad <= PRBS_BAD_MAX(prbs_bslots))
+				return (blk * prbs_bslots - s0) & (PRBS_SLOTS-1);
+		}
+	}
+
+	return -1;
+}
+
+/*
+ * CRCs of every block phase for a delay, into the table not in use so the
+ * ISR never sees one half written
+ */
+static void prbs_lock_to(int32_t delay)
+{
+	uint8_t t = (prbs_lock == 1);
+	uint32_t p;
+
+	for(p=0;p<prbs_phases;p++)
+	{
+		prbs_expect(prbs_exp, p * prbs_bslots - delay);
+		prbs_crc[t][p] = prbs_crc32(I2S_SNIFF_SEED, prbs_exp, i2s_words,
+			prbs_bswap);
+	}
+
+	prbs_n.delay = delay;
+	prbs_n.rotate = delay % i2s_slots;
+	prbs_n.syncs++;
+	__sync_synchronize();
+	prbs_lock = t + 1;
+}
+
+/*
+ * sort out a block the ISR couldn't match - call from the idle loop
+ */
+void prbs_poll(void)
+{
+	uint32_t i, x, bad, bits;
+	int32_t d;
+
+	if(!prbs_cap_full)
+		return;
+	__sync_synchronize();
+
+	if(!prbs_lock)
+	{
+		if((d = prbs_search(prbs_cap, prbs_cap_blk)) >= 0)
+			prbs_lock_to(d);
+	}
+	else
+	{
+		/* where the stream should be - a few bits off is still in step */
+		prbs_expect(prbs_exp, prbs_cap_blk * prbs_bslots - prbs_n.delay);
+		for(i=0, bad=0, bits=0;i<prbs_bslots;i++)
+		{
+			if((x = prbs_slot(prbs_cap, i) ^ prbs_slot(prbs_exp, i)))
+			{
+				bad++;
+				bits += __builtin_popcount(x);
+			}
+		}
+
+		if(bad <= PRBS_BAD_MAX(prbs_bslots))
+			prbs_n.bit_errs += bits;
+		else if((d = prbs_search(prbs_cap, prbs_cap_blk)) >= 0)
+		{
+			prbs_n.slips++;
+			if((uint32_t)d % i2s_slots != prbs_n.rotate)
+				prbs_n.swaps++;
+			prbs_lock_to(d);
+		}
+		else
+		{
+			prbs_n.lost++;
+			prbs_lock = 0;
+		}
+	}
+
+	__sync_synchronize();
+	prbs_cap_full = 0;
+}
+
+/*
+ * counts since the last start
+ */
+void prbs_get(prbs_stats *stats)
+{
+	*stats = prbs_n;
+	stats->locked = (prbs_lock != 0);
+}
+
+/*
+ * print the counts
+ */
+void prbs_report(void)
+{
+	prbs_stats s;
+
+	prbs_get(&s);
+	if(!s.syncs)
+	{
+		printf("PRBS: no lock\n");
+		return;
+	}
+
+	printf("PRBS: %s, delay %d slots rotated %u, %u blocks ok, %u bad, %u bit errors, %u slips (%u swaps), %u lost, %u syncs\n",
+		s.locked ? "locked" : "searching", s.delay, s.rotate, s.blocks,
+		s.block_errs, s.bit_errs, s.slips, s.swaps, s.lost, s.syncs);
+}
+
+#ifndef PRBS_HOST
+static uint8_t prbs_idx;
+
+/*
+ * run a few words through the sniffer on a spare channel to find the byte
+ * order it takes 32-bit transfers in - returns 0 if it's one the model
+ * knows
+ */
+static int32_t prbs_sniff_check(void)
+{
+	static uint32_t src[4] = {0x01020304, 0x80402010, 0xDEADBEEF, 0x00FF00FF};
+	static uint32_t dst[4];
+	uint32_t crc;
+	uint chan;
+
+	chan = dma_claim_unused_channel(true);
+	dma_channel_config c = dma_channel_get_default_config(chan);
+	channel_config_set_read_increment(&c, true);
+	channel_config_set_write_increment(&c, true);
+	channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+	channel_config_set_sniff_enable(&c, true);
+	dma_sniffer_enable(chan, DMA_SNIFF_CTRL_CALC_VALUE_CRC32, false);
+	dma_sniffer_set_byte_swap_enabled(false);
+	dma_sniffer_set_data_accumulator(I2S_SNIFF_SEED);
+	dma_channel_configure(chan, &c, dst, src, 4, true);
+	dma_channel_wait_for_finish_blocking(chan);
+	crc = dma_sniffer_get_data_accumulator();
+	dma_sniffer_disable();
+	dma_channel_unclaim(chan);
+
+	for(prbs_bswap=0;prbs_bswap<2;prbs_bswap++)
+		if(crc == prbs_crc32(I2S_SNIFF_SEED, src, 4, prbs_bswap))
+			return 0;
+
+	return 1;
+}
+
+/*
+ * send the stream on an instance & check what comes back - restarts I2S
+ * and replaces the instance's callback. Call again after any format
+ * change. Returns 0 if ok.
+ */
+int32_t prbs_start(uint8_t idx)
+{
+	i2s_inst *i2s;
+	int32_t err;
+
+	if(idx >= I2S_INSTANCES)
+		return 1;
+	i2s = &i2s_insts[idx];
+
+	i2s_fulldup_stop();
+	if(!(err = prbs_sniff_check()))
+	{
+		prbs_idx = idx;
+		prbs_setup();
+		i2s->sniff = 1;
+		dma_sniffer_enable(i2s->dma_chan_input,
+			DMA_SNIFF_CTRL_CALC_VALUE_CRC32, false);
+		i2s_fulldup_set_proc(idx, prbs_proc, NULL);
+	}
+	i2s_fulldup_start();
+
+	return err;
+}
+
+/*
+ * back to the instance's usual callback
+ */
+void prbs_stop(void)
+{
+	i2s_inst *i2s = &i2s_insts[prbs_idx];
+
+	i2s_fulldup_stop();
+	i2s->sniff = 0;
+	dma_sniffer_disable();
+	i2s_fulldup_set_proc(prbs_idx,
+		prbs_idx ? i2s_fulldup_proc_mirror : i2s_fulldup_proc_audio, NULL);
+	prbs_lock = 0;
+	i2s_fulldup_start();
+}
+#else
+#include <stdlib.h>
+#include <time.h>
+
+#define SIM_BLOCKS 3000
+#define SIM_LINE 16384
+
+/* what's done to the loop at a block */
+enum {SIM_NONE, SIM_FLIP, SIM_DROP, SIM_DUP, SIM_GARBAGE};
+
+typedef struct
+{
+	uint32_t blk;
+	uint8_t what;
+	uint32_t arg;		// bit to flip or slots to drop or repeat
+} sim_event;
+
+/* byte order of the modelled sniffer */
+static uint8_t sim_bswap;
+
+/*
+ * the sniffer as a serial CRC - each byte in bus order, MSB first, fed
+ * into the feedback one bit at a time
+ */
+static uint32_t sim_sniff(uint32_t acc, const uint32_t *w, uint32_t n)
+{
+	uint32_t i, b, byte, fb;
+	int k;
+
+	for(i=0;i<n;i++)
+		for(b=0;b<4;b++)
+		{
+			byte = (w[i] >> (sim_bswap ? 24 - 8*b : 8*b)) & 0xFF;
+			for(k=7;k>=0;k--)
+			{
+				fb = (acc >> 31) ^ ((byte >> k) & 1);
+				acc <<= 1;
+				if(fb)
+					acc ^= PRBS_POLY;
+			}
+		}
+
+	return acc;
+}
+
+/*
+ * byte order check against the model in place of the hardware
+ */
+static int32_t sim_sniff_check(void)
+{
+	static const uint32_t src[4] = {0x01020304, 0x80402010, 0xDEADBEEF, 0x00FF00FF};
+	uint32_t crc = sim_sniff(I2S_SNIFF_SEED, src, 4);
+
+	for(prbs_bswap=0;prbs_bswap<2;prbs_bswap++)
+		if(crc == prbs_crc32(I2S_SNIFF_SEED, src, 4, prbs_bswap))
+			return 0;
+
+	return 1;
+}
+
+/*
+ * send the stream round a loop for SIM_BLOCKS blocks, doing the events to
+ * it, with core 0 catching up every poll blocks. The loop is delay slots
+ * on top of the two blocks the ping-pong buffers hold. Checks the counts
+ * against what the events should give - returns 0 if they match.
+ */
+static int32_t sim_run(const char *name, uint8_t fmt, uint8_t bits,
+	uint8_t slots, uint32_t delay, uint8_t bswap, uint32_t poll,
+	const sim_event *ev, const prbs_stats *want)
+{
+	static uint32_t line[SIM_LINE];
+	uint32_t tx[PRBS_BLOCK_MAX], rx[PRBS_BLOCK_MAX];
+	uint32_t wr, rd = 0, blk, i, s;
+	i2s_inst inst = {1, 0};
+	prbs_stats got;
+	clock_t t, t_proc = 0;
+	int32_t err = 0;
+
+	i2s_fmt = fmt;
+	i2s_bits = bits;
+	i2s_slot_bits = (bits > 16) ? 32 : 16;
+	i2s_slots = slots;
+	i2s_words = 32 * slots * i2s_slot_bits / 32;
+	sim_bswap = bswap;
+	memset(line, 0, sizeof(line));
+
+	if(sim_sniff_check())
+	{
+		printf("%s: sniffer byte order not found\n", name);
+		return 1;
+	}
+	prbs_setup();
+	wr = delay + 2*prbs_bslots;
+
+	for(blk=0;blk<SIM_BLOCKS;blk++)
+	{
+		/* the loop moves or skips */
+		if(ev->blk == blk && ev->what == SIM_DROP)
+			rd += ev->arg;
+		if(ev->blk == blk && ev->what == SIM_DUP)
+			rd -= ev->arg;
+
+		/* block in from the far end of the line */
+		for(i=0;i<prbs_bslots;i++)
+		{
+			s = line[rd++ & (SIM_LINE-1)];
+			if(i2s_slot_bits == 16)
+				rx[i >> 1] = (i & 1) ? rx[i >> 1] | s : s << 16;
+			else
+				rx[i] = s;
+		}
+
+		if(ev->blk == blk && ev->what == SIM_FLIP)
+			rx[ev->arg / 32] ^= 1u << (ev->arg % 32);
+		if(ev->blk == blk && ev->what == SIM_GARBAGE)
+			for(i=0;i<i2s_words;i++)
+				rx[i] = (uint32_t)rand() ^ ((uint32_t)rand() << 16);
+		if(ev->blk == blk)
+			ev++;
+
+		/* as the ISR sees it */
+		inst.sniff_crc = sim_sniff(I2S_SNIFF_SEED, rx, i2s_words);
+		t = clock();
+		prbs_proc(&inst, tx, rx);
+		t_proc += clock() - t;
+
+		/* block out into the near end */
+		for(i=0;i<prbs_bslots;i++)
+			line[wr++ & (SIM_LINE-1)] = prbs_slot(tx, i);
+
+		if((blk % poll) == poll - 1)
+			prbs_poll();
+	}
+	prbs_poll();
+	prbs_get(&got);
+
+	printf("%-26s delay %4d rot %2u, %4u ok %2u bad, %2u bits, %u slips %u swaps, %u lost, %u syncs, %.0f ns/block",
+		name, got.delay, got.rotate, got.blocks, got.block_errs, got.bit_errs,
+		got.slips, got.swaps, got.lost, got.syncs,
+		1e9 * t_proc / CLOCKS_PER_SEC / SIM_BLOCKS);
+
+	if(!got.locked ||
+		got.delay != (int32_t)((want->delay + 2*prbs_bslots) & (PRBS_SLOTS-1)) ||
+		got.rotate != want->rotate ||
+		got.bit_errs != want->bit_errs || got.slips != want->slips ||
+		got.swaps != want->swaps || got.lost != want->lost ||
+		got.syncs != want->syncs || got.block_errs < want->block_errs ||
+		got.blocks + got.block_errs < SIM_BLOCKS - 16*poll)
+		err = 1;
+	printf(" %s\n", err ? "FAIL" : "ok");
+
+	return err;
+}
+
+int main(void)
+{
+	/* a bit, a one slot slip, a 4 slot slip back, then a dead block */
+	static const sim_event ev_stereo[] =
+	{
+		{500, SIM_FLIP, 31},
+		{1000, SIM_DROP, 1}, {1500, SIM_DUP, 4}, {2000, SIM_GARBAGE, 0},
+		{~0u, SIM_NONE, 0}
+	};
+	static const sim_event ev_bits[] =
+	{
+		{700, SIM_FLIP, 100}, {701, SIM_FLIP, 1000}, {702, SIM_FLIP, 63},
+		{~0u, SIM_NONE, 0}
+	};
+	static const sim_event ev_tdm[] =
+	{
+		{800, SIM_DROP, 3}, {1600, SIM_DUP, 5}, {~0u, SIM_NONE, 0}
+	};
+	int32_t err = 0;
+
+	printf("PRBS checker over a modelled loop & sniffer, %u blocks\n",
+		SIM_BLOCKS);
+
+	/* odd delay so L & R start swapped, the 1 slot slip puts them right */
+	err |= sim_run("I2S 16-bit", FMT_I2S, 16, 2, 37, 0, 1, ev_stereo,
+		&(prbs_stats){.block_errs = 4, .bit_errs = 1, .slips = 2,
+		.swaps = 1, .lost = 1, .syncs = 4, .delay = 40, .rotate = 0});
+	err |= sim_run("I2S 16-bit, slow poll", FMT_I2S, 16, 2, 37, 1, 8,
+		ev_stereo, &(prbs_stats){.block_errs = 4, .bit_errs = 1,
+		.slips = 2, .swaps = 1, .lost = 1, .syncs = 4, .delay = 40,
+		.rotate = 0});
+	err |= sim_run("I2S 24-bit", FMT_I2S, 24, 2, 10, 1, 1, ev_bits,
+		&(prbs_stats){.block_errs = 3, .bit_errs = 3, .syncs = 1,
+		.delay = 10, .rotate = 0});
+	/* core 0 only gets to the first of the three bad blocks */
+	err |= sim_run("RJ 24-bit, slow poll", FMT_RJ, 24, 2, 5, 0, 4, ev_bits,
+		&(prbs_stats){.block_errs = 3, .bit_errs = 1, .syncs = 1,
+		.delay = 5, .rotate = 1});
+	err |= sim_run("TDM 8 x 32-bit", FMT_TDM, 32, 8, 3, 0, 1, ev_tdm,
+		&(prbs_stats){.block_errs = 2, .slips = 2, .swaps = 2, .syncs = 3,
+		.delay = 5, .rotate = 5});
+
+	printf("%s\n", err ? "FAILED" : "PASSED");
+
+	return err;
+}
+#endif
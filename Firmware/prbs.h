@@ -0,0 +1,37 @@
+/*
+ * prbs.h - bit-exact loopback check with a PRBS stream & the DMA sniffer
+ */
+
+#ifndef __prbs__
+#define __prbs__
+
+#include <stdint.h>
+
+/* slots in one period of the stream - a multiple of every block's slots */
+#define PRBS_SLOTS 4096
+
+/* blocks per period at most - the smallest block is 32 frames of 2 slots */
+#define PRBS_PHASES_MAX (PRBS_SLOTS/64)
+
+/* counts since the last start */
+typedef struct
+{
+	uint32_t blocks;		// blocks whose CRC matched
+	uint32_t block_errs;	// blocks whose CRC didn't
+	uint32_t bit_errs;		// bits wrong in the error blocks core 0 got to
+	uint32_t slips;			// times the stream moved against the frame
+	uint32_t swaps;			// slips that changed the slot order - L/R swaps
+	uint32_t lost;			// error blocks with no stream found in them
+	uint32_t syncs;			// times the checker locked
+	int32_t delay;			// loop delay in slots
+	uint8_t rotate;			// slots the frame is rotated by - 1 swaps L/R
+	uint8_t locked;
+} prbs_stats;
+
+int32_t prbs_start(uint8_t idx);
+void prbs_stop(void);
+void prbs_poll(void);
+void prbs_get(prbs_stats *stats);
+void prbs_report(void);
+
+#endif
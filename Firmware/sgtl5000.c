@@ -6,6 +6,9 @@
 #include <stdio.h>
 #include "main.h"
 #include "hardware/i2c.h"
+#include "codec_seq.h"
+#include "codec.h"
+#include "trace.h"
 #include "sgtl5000.h"
 
 #define I2C_PORT i2c0
@@ -67,51 +70,58 @@
 #define DAP_COEF_WR_A1_LSB 0x0136
 #define DAP_COEF_WR_A2_MSB 0x0138
 #define DAP_COEF_WR_A2_LSB 0x013A
-#define SETTING_DELAY 0xFFFE
-#define SETTING_EOF 0xFFFF
+
+/* register address & data widths - addresses are always even */
+#define SGTL5000_REG_BITS 16
+#define SGTL5000_VAL_BITS 16
+#define WR(r, v) SEQ_WR(SGTL5000_REG_BITS, SGTL5000_VAL_BITS, SEQ_ALIGNED(r, 2), v)
+#define VFY(r, m, v) SEQ_VFY(SGTL5000_REG_BITS, SGTL5000_VAL_BITS, SEQ_ALIGNED(r, 2), m, v)
 
 /* Initialization data */
-static uint16_t codec_settings[] = 
+static const codec_seq_t codec_settings[] CODEC_SEQ =
 {
+	// Check part ID
+	VFY(CHIP_ID,			0xFF00, 0xA000),	// PARTID = 0xA0
+
 	// Power configuration
-	CHIP_DIG_POWER,		0x0000,	// all off during setup
-	CHIP_CLK_CTRL,		0x0008,	// MCLK/1, 48khz, 256x
-	CHIP_ANA_POWER,		0x7060, // Power up ADC st, DAC st, Ref
-	SETTING_DELAY,		20,		// 10ms delay
-	CHIP_LINREG_CTRL,	0x006C,	// Charge-pump uses VDDIO rail when > 3.1V
+	WR(CHIP_DIG_POWER,		0x0000),	// all off during setup
+	WR(CHIP_CLK_CTRL,		0x0008),	// MCLK/1, 48khz, 256x
+	WR(CHIP_ANA_POWER,		0x7060), 	// Power up ADC st, DAC st, Ref
+	SEQ_DLY(20),						// 10ms delay
+	WR(CHIP_LINREG_CTRL,	0x006C),	// Charge-pump uses VDDIO rail when > 3.1V
 	
 	// Reference voltages
-	CHIP_REF_CTRL,		0x01F0,	// VAG ~VDDA/2, nominal bias, fast pop
-	CHIP_LINE_OUT_CTRL,	0x0322,	// Lineout bias 1.65V, 0.36mA drive
+	WR(CHIP_REF_CTRL,		0x01F0),	// VAG ~VDDA/2, nominal bias, fast pop
+	WR(CHIP_LINE_OUT_CTRL,	0x0322),	// Lineout bias 1.65V, 0.36mA drive
 	
 	// power
-	CHIP_ANA_POWER,		0x40EB, // Power up LINEOUT, HP, ADC, DAC, Ref
-	CHIP_DIG_POWER,		0x0073,	// ADC, DAC, DAP, LINEOUT
+	WR(CHIP_ANA_POWER,		0x40EB), 	// Power up LINEOUT, HP, ADC, DAC, Ref
+	WR(CHIP_DIG_POWER,		0x0073),	// ADC, DAC, DAP, LINEOUT
 	
 	// line output volume
-	CHIP_LINE_OUT_VOL,	0x0F0F,	// suggested values for 3.3V VDDA/VDDIO
+	WR(CHIP_LINE_OUT_VOL,	0x0F0F),	// suggested values for 3.3V VDDA/VDDIO
 	
 	// Rate and format
-	CHIP_CLK_CTRL,		0x0008,	// MCLK/1, 48khz, 256x
-	CHIP_I2S_CTRL,		0x0130, // 16-bit I2S slave
+	WR(CHIP_CLK_CTRL,		0x0008),	// MCLK/1, 48khz, 256x
+	WR(CHIP_I2S_CTRL,		0x0130), 	// 16-bit I2S slave
 	
 #if 0
 	// DAP on input 
-	CHIP_SSS_CTRL,		0x0070,	// i2s->dap, dap->dac
-	DAP_CONTROL,		0x0001,	// DAP enabled
-	DAP_AUDIO_EQ,		0x0003,	// 5-band EQ
-	DAP_AUDIO_EQ_BASS_BAND0,	0x004F,	// band 0
-	DAP_AUDIO_EQ_BAND1,	0x003B,	// band 1
+	WR(CHIP_SSS_CTRL,		0x0070),	// i2s->dap, dap->dac
+	WR(DAP_CONTROL,			0x0001),	// DAP enabled
+	WR(DAP_AUDIO_EQ,		0x0003),	// 5-band EQ
+	WR(DAP_AUDIO_EQ_BASS_BAND0,	0x004F),	// band 0
+	WR(DAP_AUDIO_EQ_BAND1,	0x003B),	// band 1
 #else
 	// normal routing
-	CHIP_SSS_CTRL,		0x0010,	// i2s->dac, adc->i2s, no dap
+	WR(CHIP_SSS_CTRL,		0x0010),	// i2s->dac, adc->i2s, no dap
 #endif
 	
 	// Mutes
-	CHIP_ADCDAC_CTRL,	0x0200, // Unmute DAC outputs
-	CHIP_ANA_CTRL,		0x0026,	// Unmute Line Out, ADC in
+	WR(CHIP_ADCDAC_CTRL,	0x0200), 	// Unmute DAC outputs
+	WR(CHIP_ANA_CTRL,		0x0026),	// Unmute Line Out, ADC in
 	
-	SETTING_EOF,				// EOF
+	SEQ_END
 };
 
 
@@ -148,8 +158,7 @@ int32_t SGTL5000_WriteRegister(uint16_t Reg, uint16_t Data)
 		return 1;
 	}
 	
-	printf("SGTL5000_WriteRegister: write to DevAddr 0x%02X / Reg 0x%04X = 0x%04X\n\r",
-		SGTL5000_I2C_ADDR, Reg, Data);
+	TRACE(TRC_REG_WR, TRC_SRC_SGTL5000, Reg, Data);
 
 	return 0;
 }
@@ -204,12 +213,24 @@ int32_t SGTL5000_ReadRegister(uint16_t Reg, uint16_t *Data)
 	/* assemble 9-bit result */
 	*Data = (i2c_msg[0]<<8) | i2c_msg[1];
 	
-	printf("SGTL5000_ReadRegister: read from DevAddr 0x%02X / Reg 0x%04X = 0x%04X\n\r",
-		SGTL5000_I2C_ADDR, Reg, *Data);
+	TRACE(TRC_REG_RD, TRC_SRC_SGTL5000, Reg, *Data);
 
 	return 0;
 }
 
+/*
+ * access methods for the sequence player
+ */
+const codec_seq_if sgtl5000_if =
+{
+	.name = "SGTL5000",
+	.trace_src = TRC_SRC_SGTL5000,
+	.reg_stride = 2,
+	.write = SGTL5000_WriteRegister,
+	.read = SGTL5000_ReadRegister,
+	.reclock = codec_seq_i2c_reclock,
+};
+
 /**
   * @brief  Resets the audio SGTL5000. It restores the default configuration of the
   *         SGTL5000 (this function shall be called before initializing the SGTL5000).
@@ -219,35 +240,104 @@ int32_t SGTL5000_ReadRegister(uint16_t Reg, uint16_t *Data)
   */
 int32_t SGTL5000_Reset(void)
 {
-	uint8_t idx = 0, tries;
-	uint16_t reg, data;
-	int32_t result = 0;
-	
-	while((reg = codec_settings[2*idx]) != SETTING_EOF)
+	return codec_seq_play(&sgtl5000_if, codec_settings);
+}
+
+/**
+  * @brief  Reprogram the SGTL5000 clock control for a new rate
+  * @note   fs = SYS_FS / RATE_MODE with MCLK at 256, 384 or 512 x SYS_FS
+  *         (256 only when SYS_FS is 96k).
+  * @param  fs: sample rate in Hz
+  * @param  mclk_ratio: MCLK / fs
+  * @retval 0 if ok, else rate not supported or bus error
+  */
+int32_t SGTL5000_SetRate(uint32_t fs, uint16_t mclk_ratio)
+{
+	static const uint32_t sys_fs[4] = {32000, 44100, 48000, 96000};
+	static const uint8_t rate_div[4] = {1, 2, 4, 6};
+	uint32_t rm, sf, ratio;
+	uint16_t clk_ctrl;
+
+	for(rm=0;rm<4;rm++)
 	{
-		data = codec_settings[2*idx + 1];
-		if(reg != SETTING_DELAY)
-		{
-			/* valid register - write data */
-			/*
-			 * NOTE: Sometimes writing reg 1 fails. Seems to succeed on 2nd try.
-			 */
-			tries = 0;
-			while((SGTL5000_WriteRegister(reg, data)!=0) && (tries++ <5));
-			if(tries > 4)
-				result++;
-		}
-		else
+		for(sf=0;sf<4;sf++)
 		{
-			/* time delay */
-			printf("SGTL5000_Reset: delay %d ms\n\r", data);
-			my_sleep_ms(data);
+			if(sys_fs[sf] != fs * rate_div[rm])
+				continue;
+
+			/* MCLK relative to SYS_FS */
+			if(mclk_ratio % rate_div[rm])
+				continue;
+			ratio = mclk_ratio / rate_div[rm];
+			if((ratio == 256) || ((sf != 3) && ((ratio == 384) || (ratio == 512))))
+			{
+				clk_ctrl = (rm << 4) | (sf << 2) | ((ratio / 128) - 2);
+				codec_seq_t seq[] =
+				{
+					SEQ_WRV(CHIP_CLK_CTRL,	clk_ctrl),
+					SEQ_END
+				};
+				return codec_seq_play(&sgtl5000_if, seq);
+			}
 		}
-		
-		idx++;
 	}
 
-	return result;
+	return 1;
+}
+
+/* codec drives SCLK & LRCLK */
+static uint8_t sgtl5000_master;
+
+/**
+  * @brief  Select SGTL5000 clocking - takes effect at the next SetFormat
+  * @param  enable: 1 for the codec to drive SCLK & LRCLK, 0 to follow them
+  * @retval 0 if ok
+  */
+int32_t SGTL5000_SetMaster(uint8_t enable)
+{
+	sgtl5000_master = enable ? 1 : 0;
+	return 0;
+}
+
+/**
+  * @brief  Set the SGTL5000 I2S format & word length
+  * @note   16-bit uses 32fs SCLK, longer words 64fs. LJ & RJ put the left
+  *         channel in LRCLK high so need LRPOL set.
+  * @param  fmt: FMT_I2S, FMT_LJ, FMT_RJ, FMT_DSP_A or FMT_DSP_B
+  * @param  bits: 16, 20, 24 or 32
+  * @retval 0 if ok, else format not supported or bus error
+  */
+int32_t SGTL5000_SetFormat(uint8_t fmt, uint8_t bits)
+{
+	uint16_t i2s_ctrl;
+
+	switch(bits)
+	{
+		case 16: i2s_ctrl = 0x0130; break;	// 32fs, 16-bit slave
+		case 20: i2s_ctrl = 0x0020; break;	// 64fs, 20-bit slave
+		case 24: i2s_ctrl = 0x0010; break;	// 64fs, 24-bit slave
+		case 32: i2s_ctrl = 0x0000; break;	// 64fs, 32-bit slave
+		default: return 1;
+	}
+
+	switch(fmt)
+	{
+		case FMT_I2S: break;
+		case FMT_LJ: i2s_ctrl |= 0x0003; break;		// no delay, left on high
+		case FMT_RJ: i2s_ctrl |= 0x0005; break;		// RJ, left on high
+		case FMT_DSP_A: i2s_ctrl |= 0x0008; break;	// PCM, 1 SCLK delay
+		case FMT_DSP_B: i2s_ctrl |= 0x000a; break;	// PCM, no delay
+		default: return 1;
+	}
+	if(sgtl5000_master)
+		i2s_ctrl |= 0x0080;	// MS - drive SCLK & LRCLK
+
+	codec_seq_t seq[] =
+	{
+		SEQ_WRV(CHIP_I2S_CTRL,	i2s_ctrl),
+		SEQ_END
+	};
+	return codec_seq_play(&sgtl5000_if, seq);
 }
 
 /*
@@ -263,6 +353,7 @@ int32_t SGTL5000_Dump_Regs(void)
 		SGTL5000_ReadRegister(reg, &data);
 		reg+=2;
 	}
+	return 0;
 }
 
 /*
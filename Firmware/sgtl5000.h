@@ -6,10 +6,18 @@
 #ifndef __SGTL5000__
 #define __SGTL5000__
 
+#include "codec_seq.h"
+
 int32_t SGTL5000_WriteRegister(uint16_t Reg, uint16_t Data);
 int32_t SGTL5000_ReadRegister(uint16_t Reg, uint16_t *Data);
 int32_t SGTL5000_Reset(void);
+int32_t SGTL5000_SetRate(uint32_t fs, uint16_t mclk_ratio);
+int32_t SGTL5000_SetFormat(uint8_t fmt, uint8_t bits);
+int32_t SGTL5000_SetMaster(uint8_t enable);
 int32_t SGTL5000_Dump_Regs(void);
 int32_t SGTL5000_Init(void);
 
+/* register access for the sequence player & the console */
+extern const codec_seq_if sgtl5000_if;
+
 #endif
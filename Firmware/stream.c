@@ -0,0 +1,319 @@
+/*
+ * stream.c - I2S blocks streamed to a host over a UART as framed binary
+ *
+ * While streaming, the input DMA of one I2S instance lands its blocks in
+ * turn round stream_in instead of the ping-pong buffers, as for a capture,
+ * and a tap on the input ISR counts them in. With output asked for too the
+ * tap copies the block just made to send into stream_out beside it - the
+ * one copy, as output blocks are made in place. A repeating timer on core
+ * 0 then sends each block straight from its slot by DMA to the UART, with
+ * nothing for the CPU to do but start the three parts of each frame:
+ *   stream_hdr, 20 bytes - sync, type, block number, format & length
+ *   the block's FIFO words as they are, little endian
+ *   CRC-32 of the header & words, as zlib's
+ * A link too slow for the audio skips blocks rather than stall anything:
+ * once the next block to send is within STREAM_MARGIN of being landed
+ * over the sender jumps to the newest, so the receiver sees a gap in the
+ * block numbers along with the count that explains it. A block that got
+ * landed over all the same as it went is counted late & fails its CRC.
+ * stream_rx.py takes the frames apart & writes WAV files.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "main.h"
+#include "hardware/dma.h"
+#include "hardware/gpio.h"
+#include "hardware/uart.h"
+#include "hardware/sync.h"
+#include "i2s_fulldup.h"
+#include "tables.h"
+#include "stream.h"
+
+/* blocks the next one to send must be clear of being landed over */
+#define STREAM_MARGIN 4
+
+/* the part of a frame going out */
+enum stream_parts
+{
+	STREAM_PART_IDLE,
+	STREAM_PART_HDR,
+	STREAM_PART_DATA,
+	STREAM_PART_CRC
+};
+
+/* the rings don't need clearing at boot */
+static uint32_t __uninitialized_ram(stream_in)[STREAM_WORDS];
+static uint32_t __uninitialized_ram(stream_out)[STREAM_WORDS];
+
+static stream_stats stream_n;
+static repeating_timer_t stream_rt;
+static int stream_dma = -1;
+static volatile uint32_t stream_landed;
+static uint32_t stream_blocks, stream_blk, stream_base, stream_lost;
+static uint32_t stream_crc;
+static const uint32_t *stream_data;
+static stream_hdr stream_h;
+static uint8_t stream_part, stream_type;
+
+/*
+ * input tap - count each block in as it lands & keep what was made from
+ * it to send. Runs in the input DMA ISR.
+ */
+static void __not_in_flash_func(stream_tap)(i2s_inst *i2s, uint32_t *src)
+{
+	uint32_t m;
+
+	/* the last block from before the ring took over */
+	if((src < stream_in) || (src >= &stream_in[STREAM_WORDS]))
+		return;
+
+	m = stream_landed;
+	if(stream_n.srcs & STREAM_OUT)
+		memcpy(&stream_out[(m % stream_blocks) * i2s_words], i2s->xfer_buf,
+			i2s_words * sizeof(uint32_t));
+
+	/* the block's in before it's counted */
+	__dmb();
+	stream_landed = m + 1;
+}
+
+/*
+ * CRC-32 over bytes, carried on from crc - start at ~0 & invert at the end
+ */
+static uint32_t __not_in_flash_func(stream_crc32)(uint32_t crc,
+	const void *buf, uint32_t n)
+{
+	const uint8_t *p = buf;
+
+	while(n--)
+		crc = (crc >> 8) ^ tab_crc32[(crc ^ *p++) & (TAB_CRC_LEN - 1)];
+
+	return crc;
+}
+
+/*
+ * send n bytes from buf
+ */
+static inline void stream_send(const void *buf, uint32_t n)
+{
+	dma_channel_set_read_addr(stream_dma, buf, false);
+	dma_channel_set_trans_count(stream_dma, n, true);
+}
+
+/*
+ * start the header of the next frame to send - returns 1 if there was one
+ */
+static uint8_t stream_frame(void)
+{
+	uint32_t landed = stream_landed, lag, k;
+
+	if(landed == stream_blk)
+		return 0;
+	__dmb();
+
+	/* too close to being landed over - jump to the newest */
+	lag = landed - stream_blk;
+	if(lag > stream_blocks - STREAM_MARGIN)
+	{
+		stream_n.dropped += lag - 1;
+		stream_lost += lag - 1;
+		stream_blk = landed - 1;
+		stream_type = (stream_n.srcs & STREAM_IN) ? STREAM_IN : STREAM_OUT;
+	}
+
+	k = (stream_blk % stream_blocks) * stream_h.words;
+	stream_data = (stream_type == STREAM_IN) ? &stream_in[k] : &stream_out[k];
+	stream_h.type = stream_type;
+	stream_h.seq = stream_base + stream_blk;
+	stream_h.fs = Fsample;
+	stream_h.lost = (stream_lost > 0xFFFF) ? 0xFFFF : stream_lost;
+
+	stream_crc = stream_crc32(0xFFFFFFFF, &stream_h, sizeof(stream_h));
+	stream_crc = ~stream_crc32(stream_crc, stream_data, stream_h.words * 4);
+
+	stream_part = STREAM_PART_HDR;
+	stream_send(&stream_h, sizeof(stream_h));
+
+	return 1;
+}
+
+/*
+ * start the next part once the last has gone - returns 1 if it started one
+ */
+static uint8_t stream_next(void)
+{
+	switch(stream_part)
+	{
+		case STREAM_PART_HDR:
+			stream_part = STREAM_PART_DATA;
+			stream_send(stream_data, stream_h.words * 4);
+			return 1;
+
+		case STREAM_PART_DATA:
+			if(stream_landed - stream_blk >= stream_blocks)
+				stream_n.late++;
+			stream_part = STREAM_PART_CRC;
+			stream_send(&stream_crc, sizeof(stream_crc));
+			return 1;
+
+		case STREAM_PART_CRC:
+			stream_n.frames++;
+			stream_n.bytes += sizeof(stream_h) + stream_h.words * 4 +
+				sizeof(stream_crc);
+			stream_part = STREAM_PART_IDLE;
+
+			/* a block's output follows its input */
+			if((stream_type == STREAM_IN) && (stream_n.srcs & STREAM_OUT))
+				stream_type = STREAM_OUT;
+			else
+			{
+				stream_blk++;
+				stream_lost = 0;
+				stream_type = (stream_n.srcs & STREAM_IN) ? STREAM_IN :
+					STREAM_OUT;
+			}
+			break;
+	}
+
+	return stream_frame();
+}
+
+/*
+ * keep the UART busy - core 0 timer callback
+ */
+static bool stream_pump(repeating_timer_t *rt)
+{
+	(void)rt;
+
+	while(!dma_channel_is_busy(stream_dma) && stream_next())
+		;
+
+	return true;
+}
+
+/*
+ * put the ring on the DMA in the current format & start sending from the
+ * first block that lands in it - block numbers carry on from any last run
+ */
+static void stream_arm(void)
+{
+	stream_blocks = STREAM_WORDS / i2s_words;
+	stream_base += stream_landed;
+	stream_landed = 0;
+	stream_blk = 0;
+	stream_lost = 0;
+	stream_part = STREAM_PART_IDLE;
+	stream_type = (stream_n.srcs & STREAM_IN) ? STREAM_IN : STREAM_OUT;
+
+	stream_h.sync = STREAM_SYNC;
+	stream_h.inst = stream_n.inst;
+	stream_h.bits = i2s_bits;
+	stream_h.slot_bits = i2s_slot_bits;
+	stream_h.slots = i2s_slots;
+	stream_h.fmt = i2s_fmt;
+	stream_h.words = i2s_words;
+
+	i2s_fulldup_set_ring(stream_n.inst, stream_in, stream_blocks, stream_tap);
+	add_repeating_timer_us(-STREAM_PUMP_US, stream_pump, NULL, &stream_rt);
+}
+
+/*
+ * stop sending - a frame part way out is cut short
+ */
+static void stream_halt(void)
+{
+	cancel_repeating_timer(&stream_rt);
+	dma_channel_abort(stream_dma);
+}
+
+/*
+ * set up the UART & its DMA channel - after the clocks, as the baud rate
+ * comes from clk_peri
+ */
+void stream_init(void)
+{
+	dma_channel_config c;
+
+	uart_init(STREAM_UART, STREAM_BAUD);
+	gpio_set_function(STREAM_TX_PIN, GPIO_FUNC_UART);
+
+	stream_dma = dma_claim_unused_channel(false);
+	if(stream_dma < 0)
+		return;
+	c = dma_channel_get_default_config(stream_dma);
+	channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+	channel_config_set_read_increment(&c, true);
+	channel_config_set_write_increment(&c, false);
+	channel_config_set_dreq(&c, uart_get_dreq(STREAM_UART, true));
+	dma_channel_configure(stream_dma, &c, &uart_get_hw(STREAM_UART)->dr,
+		NULL, 0, false);
+}
+
+/*
+ * stream an instance's input, output or both - takes effect at the next
+ * block. Returns 0 if ok, or 1 if it's out of range, there's no DMA
+ * channel or something else has the instance's ring.
+ */
+int32_t stream_start(uint8_t idx, uint8_t srcs)
+{
+	if((idx >= I2S_INSTANCES) || !srcs || (srcs & ~STREAM_BOTH) ||
+		(stream_dma < 0))
+		return 1;
+	if(i2s_insts[idx].tap && (i2s_insts[idx].tap != stream_tap))
+		return 1;
+
+	stream_stop();
+	memset(&stream_n, 0, sizeof(stream_n));
+	stream_n.srcs = srcs;
+	stream_n.inst = idx;
+	stream_base = 0;
+	stream_landed = 0;
+	stream_arm();
+
+	return 0;
+}
+
+/*
+ * give the instance its ping-pong buffers back - the counts are kept
+ */
+void stream_stop(void)
+{
+	if(!stream_n.srcs)
+		return;
+
+	stream_halt();
+	if(i2s_insts[stream_n.inst].tap == stream_tap)
+		i2s_fulldup_set_ring(stream_n.inst, NULL, 0, NULL);
+	stream_n.srcs = 0;
+}
+
+/*
+ * take the ring back after a format change dropped it - call from the
+ * idle loop
+ */
+void stream_poll(void)
+{
+	i2s_inst *i2s;
+
+	if(!stream_n.srcs)
+		return;
+	i2s = &i2s_insts[stream_n.inst];
+	if(i2s->tap == stream_tap)
+		return;
+
+	stream_halt();
+	if(i2s->tap)
+	{
+		printf("stream: ring taken, stopped\n");
+		stream_n.srcs = 0;
+		return;
+	}
+	stream_n.rearms++;
+	stream_arm();
+}
+
+void stream_get(stream_stats *s)
+{
+	*s = stream_n;
+}
@@ -0,0 +1,64 @@
+/*
+ * stream.h - I2S blocks streamed to a host over a UART as framed binary
+ */
+
+#ifndef __stream__
+#define __stream__
+
+#include <stdint.h>
+
+/* UART, TX pin & rate - 3Mbaud is clk_peri's 48MHz / 16, as fast as it goes */
+#define STREAM_UART uart1
+#define STREAM_TX_PIN 4
+#define STREAM_BAUD 3000000
+
+/* ring size in FIFO words, for each of input & output - 128 blocks */
+#define STREAM_WORDS 4096
+
+/* how often core 0 moves the stream on */
+#define STREAM_PUMP_US 50
+
+/* first on the wire in each frame */
+#define STREAM_SYNC 0x5AA5
+
+/* what to send, as a mask */
+enum stream_srcs
+{
+	STREAM_IN = 1,		// blocks as received
+	STREAM_OUT = 2,		// the blocks made from them to send
+	STREAM_BOTH = 3
+};
+
+/*
+ * frame header - little endian, followed by words FIFO words as they are &
+ * a CRC-32 of both, as zlib's
+ */
+typedef struct
+{
+	uint16_t sync;			// STREAM_SYNC
+	uint8_t type;			// STREAM_IN or STREAM_OUT
+	uint8_t inst;			// I2S instance
+	uint32_t seq;			// block number, the same for a block's in & out
+	uint32_t fs;
+	uint8_t bits, slot_bits, slots, fmt;	// as i2s_fulldup_format()
+	uint16_t words;			// FIFO words that follow
+	uint16_t lost;			// blocks skipped just before this one
+} stream_hdr;
+
+typedef struct
+{
+	uint8_t srcs;			// STREAM_xx, 0 when stopped
+	uint8_t inst;
+	uint32_t frames, bytes;
+	uint32_t dropped;		// blocks skipped as the link couldn't keep up
+	uint32_t late;			// frames whose block was overwritten as it went
+	uint32_t rearms;		// times the ring was taken back after a format change
+} stream_stats;
+
+void stream_init(void);
+int32_t stream_start(uint8_t idx, uint8_t srcs);
+void stream_stop(void);
+void stream_poll(void);
+void stream_get(stream_stats *s);
+
+#endif
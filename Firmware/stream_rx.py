@@ -0,0 +1,148 @@
+#!/usr/bin/env python3
+# stream_rx.py - take the frames stream.c sends apart & write the blocks as
+# WAV files, one for input & one for output, a new pair on a format change.
+# Blocks the sender skipped or the link lost come out as silence so the
+# files keep time. Reads a serial port, set raw at the baud rate given, or
+# a file or stdin, until EOF or ^C, then says what it got.
+#
+# usage: stream_rx.py [port or file] [-b baud] [-o output prefix]
+
+import os
+import struct
+import sys
+import termios
+import wave
+import zlib
+
+SYNC = b'\xa5\x5a'
+HDR = struct.Struct('<HBBIIBBBBHH')
+TYPES = {1: 'in', 2: 'out'}
+FMT_RJ = 2
+
+class Track:
+    def __init__(self, prefix, kind):
+        self.prefix, self.kind = prefix, kind
+        self.fmt, self.wav, self.files = None, None, 0
+        self.seq, self.blocks, self.lost, self.gaps = None, 0, 0, 0
+
+    def open(self, fmt):
+        self.close()
+        fs, bits, slot_bits, slots, f = fmt
+        name = '%s_%s%s.wav' % (self.prefix, self.kind,
+                                self.files if self.files else '')
+        self.files += 1
+        self.fmt, self.seq = fmt, None
+        self.nb = (bits + 7) // 8
+        self.wav = wave.open(name, 'wb')
+        self.wav.setnchannels(slots)
+        self.wav.setsampwidth(self.nb)
+        self.wav.setframerate(fs)
+        print('%s: %d x %d-bit at %d Hz' % (name, slots, bits, fs))
+
+    def close(self):
+        if self.wav:
+            self.wav.close()
+            self.wav = None
+
+    # FIFO words to little endian samples - 16-bit slots go two to a word,
+    # the even one high, wider ones one a word MSB aligned or right
+    # justified for RJ
+    def samples(self, words):
+        fs, bits, slot_bits, slots, f = self.fmt
+        out = bytearray()
+        for w in words:
+            if slot_bits == 16:
+                out += struct.pack('<HH', w >> 16, w & 0xFFFF)
+            else:
+                if f == FMT_RJ:
+                    w = (w << (32 - bits)) & 0xFFFFFFFF
+                out += struct.pack('<I', w)[4 - self.nb:]
+        return bytes(out)
+
+    def add(self, seq, lost, fmt, words):
+        if fmt != self.fmt:
+            self.open(fmt)
+        if self.seq is not None:
+            gap = (seq - self.seq - 1) & 0xFFFFFFFF
+            if gap:
+                self.lost += min(gap, lost)
+                self.gaps += max(gap - lost, 0)
+                # a slot a sample, words * 32 / slot_bits of them
+                self.wav.writeframes(b'\0' * gap * (len(words) * 32 //
+                                                    fmt[2]) * self.nb)
+        self.seq = seq
+        self.blocks += 1
+        self.wav.writeframes(self.samples(words))
+
+def port(path, baud):
+    fd = os.open(path, os.O_RDONLY | os.O_NOCTTY)
+    if os.isatty(fd):
+        a = termios.tcgetattr(fd)
+        speed = getattr(termios, 'B%d' % baud)
+        a[0] = a[1] = a[3] = 0
+        a[2] = termios.CS8 | termios.CREAD | termios.CLOCAL
+        a[4] = a[5] = speed
+        a[6][termios.VMIN], a[6][termios.VTIME] = 1, 0
+        termios.tcsetattr(fd, termios.TCSANOW, a)
+    return os.fdopen(fd, 'rb', buffering=0)
+
+def main():
+    args = sys.argv[1:]
+    prefix, baud = 'stream', 3000000
+    if '-o' in args:
+        i = args.index('-o')
+        prefix = args[i+1]
+        del args[i:i+2]
+    if '-b' in args:
+        i = args.index('-b')
+        baud = int(args[i+1])
+        del args[i:i+2]
+    inp = port(args[0], baud) if args else sys.stdin.buffer
+    tracks = {k: Track(prefix, v) for k, v in TYPES.items()}
+    buf, skipped, bad = b'', 0, 0
+    try:
+        while True:
+            data = inp.read(65536)
+            if not data:
+                break
+            buf += data
+            while True:
+                i = buf.find(SYNC)
+                if i < 0:
+                    skipped += max(len(buf) - 1, 0)
+                    buf = buf[-1:]
+                    break
+                skipped += i
+                buf = buf[i:]
+                if len(buf) < HDR.size:
+                    break
+                (sync, kind, inst, seq, fs, bits, slot_bits, slots, fmt,
+                 words, lost) = HDR.unpack_from(buf)
+                n = HDR.size + 4 * words + 4
+                if kind not in TYPES or slot_bits not in (16, 32) or not words:
+                    skipped += 1
+                    buf = buf[1:]
+                    continue
+                if len(buf) < n:
+                    break
+                crc, = struct.unpack_from('<I', buf, n - 4)
+                if crc != zlib.crc32(buf[:n - 4]):
+                    bad += 1
+                    skipped += 1
+                    buf = buf[1:]
+                    continue
+                tracks[kind].add(seq, lost,
+                                 (fs, bits, slot_bits, slots, fmt),
+                                 struct.unpack_from('<%dI' % words, buf,
+                                                    HDR.size))
+                buf = buf[n:]
+    except KeyboardInterrupt:
+        pass
+    for t in tracks.values():
+        t.close()
+        if t.files:
+            print('%s: %d blocks, %d skipped by the sender, %d lost on the '
+                  'link' % (t.kind, t.blocks, t.lost, t.gaps))
+    print('%d bad CRCs, %d bytes skipped' % (bad, skipped))
+
+main()
@@ -0,0 +1,146 @@
+#!/usr/bin/env python3
+# tablegen.py - write tables.c, the sine, ASRC tap & oscillator increment
+# tables in double precision, and the CRC-32 table. Sizes & rates are read
+# from tables.h and asrc.h so the two never drift apart. Run by
+# CMakeLists.txt at build time.
+#
+# usage: tablegen.py output.c [-i dir with tables.h & asrc.h]
+
+import math
+import os
+import re
+import sys
+
+def load_defs(*paths):
+    defs = {}
+    for path in paths:
+        text = open(path).read().replace('\\\n', ' ')
+        for m in re.finditer(r'^#define\s+(\w+)\s+(.+)$', text, re.M):
+            defs[m.group(1)] = m.group(2).strip()
+    return defs
+
+def value(defs, name):
+    # integer macros, possibly shifts of others
+    expr = re.sub(r'[A-Z_][A-Z0-9_]*',
+        lambda m: '(%d)' % value(defs, m.group(0)), defs[name])
+    return int(eval(expr.replace('UL', '')))
+
+def i0(x):
+    # zeroth order modified Bessel function, to convergence
+    s = t = 1.0
+    k = 1
+    while t > 1e-17 * s:
+        t *= (x / (2 * k)) ** 2
+        s += t
+        k += 1
+    return s
+
+def sine(n):
+    # first half cycle & the point after it, the rest being its negative
+    return [int(math.floor(32767 * math.sin(2 * math.pi * i / n) + 0.5))
+        for i in range(n // 2 + 1)]
+
+def asrc_taps(taps, phases, beta):
+    # row p holds the taps for a position p/phases past the centre, each
+    # scaled to unity gain at DC
+    rows = []
+    for p in range(phases + 1):
+        h = []
+        for k in range(taps):
+            t = (taps // 2 - 1) + p / phases - k
+            u = t / (taps // 2)
+            s = 1.0 if t == 0 else math.sin(math.pi * t) / (math.pi * t)
+            w = i0(beta * math.sqrt(1 - u * u)) / i0(beta) if u * u < 1 else 0.0
+            h.append(s * w)
+        sum_h = sum(h)
+        rows.append([int(math.floor(32767 * x / sum_h + 0.5)) for x in h])
+    return rows
+
+def exp2(n):
+    return [int(math.floor(2 ** (i / n) * 2 ** 30 + 0.5)) for i in range(n + 1)]
+
+def recip(n):
+    return [int(math.floor(2 ** 30 / ((n + i + 0.5) / (2 * n)) + 0.5))
+        for i in range(n)]
+
+def crc32(n):
+    out = []
+    for i in range(n):
+        c = i
+        for k in range(8):
+            c = (c >> 1) ^ (0xEDB88320 if c & 1 else 0)
+        out.append(c)
+    return out
+
+def c_rows(vals, per, indent, fmt='%6d'):
+    out = []
+    for i in range(0, len(vals), per):
+        out.append(indent + ', '.join(fmt % v for v in vals[i:i+per]) + ',')
+    return '\n'.join(out)
+
+def main():
+    args = sys.argv[1:]
+    src = os.path.dirname(os.path.abspath(__file__))
+    if '-i' in args:
+        i = args.index('-i')
+        src = args[i+1]
+        del args[i:i+2]
+    if len(args) != 1:
+        print('usage: tablegen.py output.c [-i dir with tables.h & asrc.h]')
+        sys.exit(2)
+
+    defs = load_defs(os.path.join(src, 'tables.h'), os.path.join(src, 'asrc.h'))
+    n = value(defs, 'TAB_SINE_LEN')
+    n_exp2, n_recip = value(defs, 'TAB_EXP2_LEN'), value(defs, 'TAB_RECIP_LEN')
+    n_crc = value(defs, 'TAB_CRC_LEN')
+    taps, phases = value(defs, 'ASRC_TAPS'), value(defs, 'ASRC_PHASES')
+    beta = float(defs['ASRC_BETA'])
+    hz = value(defs, 'TAB_OSC_HZ')
+    rates = [int(r) for r in defs['TAB_OSC_RATES'].split(',')]
+
+    out = []
+    out.append('/*\n * tables.c - made by tablegen.py from tables.h & asrc.h, '
+        'don\'t edit\n */\n')
+    out.append('#include "tables.h"')
+    out.append('#ifdef TABLES_HOST')
+    out.append('#define __scratch_y(group)')
+    out.append('#define __not_in_flash(group)')
+    out.append('#else')
+    out.append('#include "pico/stdlib.h"')
+    out.append('#endif\n')
+
+    out.append('/* in SRAM5 under the core 0 stack, out of the striped banks '
+        'it works in */')
+    out.append('__scratch_y("audio_tab") '
+        'const int16_t sinetab[TAB_SINE_HALF+1] =\n{')
+    out.append(c_rows(sine(n), 8, '\t'))
+    out.append('};\n')
+
+    out.append('/* read by the core 1 ISR, so in RAM whether or not the rest '
+        'is */')
+    out.append('__not_in_flash("asrc_tab") '
+        'const int16_t asrc_coef[ASRC_PHASES+1][ASRC_TAPS] =\n{')
+    for row in asrc_taps(taps, phases, beta):
+        out.append('\t{\n' + c_rows(row, 8, '\t\t') + '\n\t},')
+    out.append('};\n')
+
+    out.append('const tab_inc tab_osc_inc[TAB_OSC_NUM] =\n{')
+    for fs in rates:
+        out.append('\t{%6d, %9d},' % (fs, (hz << 32) // fs))
+    out.append('};\n')
+
+    out.append('const uint32_t tab_exp2[TAB_EXP2_LEN+1] =\n{')
+    out.append(c_rows(exp2(n_exp2), 4, '\t', '0x%08X'))
+    out.append('};\n')
+
+    out.append('const uint32_t tab_recip[TAB_RECIP_LEN] =\n{')
+    out.append(c_rows(recip(n_recip), 4, '\t', '0x%08X'))
+    out.append('};\n')
+
+    out.append('const uint32_t tab_crc32[TAB_CRC_LEN] =\n{')
+    out.append(c_rows(crc32(n_crc), 4, '\t', '0x%08X'))
+    out.append('};')
+
+    open(args[0], 'w').write('\n'.join(out) + '\n')
+
+main()
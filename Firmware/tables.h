@@ -0,0 +1,54 @@
+/*
+ * tables.h - waveform, filter, rate, math & CRC tables made at build time
+ *
+ * tablegen.py reads the sizes here & in asrc.h and writes tables.c, so the
+ * firmware computes none of them at boot. host/tablecheck.c checks them
+ * against libm.
+ */
+
+#ifndef __tables__
+#define __tables__
+
+#include <stdint.h>
+#include "asrc.h"
+
+/*
+ * one cycle of sine at Q15, of which the table holds the first half and
+ * the point after it - the second half is the first negated
+ */
+#define TAB_SINE_BITS 10
+#define TAB_SINE_LEN (1<<TAB_SINE_BITS)
+#define TAB_SINE_HALF (TAB_SINE_LEN/2)
+
+/* test oscillator & the rates it has a ready-made increment for */
+#define TAB_OSC_HZ 100
+#define TAB_OSC_RATES 8000, 11025, 16000, 22050, 32000, 44100, 48000, \
+	88200, 96000, 192000
+#define TAB_OSC_NUM (sizeof((uint32_t[]){TAB_OSC_RATES})/sizeof(uint32_t))
+
+/* 2^(i/TAB_EXP2_LEN) in Q2.30 for fixparam.c, with one past the end */
+#define TAB_EXP2_BITS 6
+#define TAB_EXP2_LEN (1<<TAB_EXP2_BITS)
+
+/* reciprocal seeds - 1/x in Q2.30 mid way along each step of [0.5, 1) */
+#define TAB_RECIP_BITS 6
+#define TAB_RECIP_LEN (1<<TAB_RECIP_BITS)
+
+/* CRC-32 (IEEE 802.3, reflected as zlib's) of each byte value */
+#define TAB_CRC_BITS 8
+#define TAB_CRC_LEN (1<<TAB_CRC_BITS)
+
+/* phase increment per frame, floor(TAB_OSC_HZ * 2^32 / fs) */
+typedef struct
+{
+	uint32_t fs;
+	int32_t inc;
+} tab_inc;
+
+extern const int16_t sinetab[TAB_SINE_HALF+1];
+extern const tab_inc tab_osc_inc[TAB_OSC_NUM];
+extern const uint32_t tab_exp2[TAB_EXP2_LEN+1];
+extern const uint32_t tab_recip[TAB_RECIP_LEN];
+extern const uint32_t tab_crc32[TAB_CRC_LEN];
+
+#endif
@@ -0,0 +1,142 @@
+/*
+ * trace.c - deferred binary event trace
+ *
+ * Each core owns one ring. The producer side only ever runs on the
+ * owning core (thread or IRQ) and only core 0 consumes, so no lock is
+ * shared between cores - a short interrupt mask keeps thread and IRQ
+ * producers on the same core from interleaving.
+ */
+
+#include <stdio.h>
+#include "hardware/sync.h"
+#include "trace.h"
+
+/* per-core ring */
+typedef struct
+{
+	trace_evt evt[TRACE_DEPTH];
+	volatile uint32_t head;		// written by owning core
+	volatile uint32_t tail;		// written by core 0
+} trace_ring;
+
+static trace_ring trace_rings[2];
+volatile uint32_t trace_mask;
+volatile uint32_t trace_dropped[2];
+
+#define TRACE_SRC(id, name) name,
+static const char *trace_src_names[] = { TRACE_SOURCES };
+#undef TRACE_SRC
+
+#define TRACE_EVT(id, fmt) fmt,
+static const char *trace_evt_fmts[] = { TRACE_EVENTS };
+#undef TRACE_EVT
+
+/*
+ * reset rings & enable all non-ISR events
+ */
+void trace_init(void)
+{
+	trace_rings[0].head = trace_rings[0].tail = 0;
+	trace_rings[1].head = trace_rings[1].tail = 0;
+	trace_dropped[0] = trace_dropped[1] = 0;
+	trace_mask = ((1UL<<TRC_NUM_EVTS)-1) &
+		~((1UL<<TRC_DMA_IN) | (1UL<<TRC_DMA_OUT));
+}
+
+/*
+ * record one event on the calling core
+ */
+void __not_in_flash_func(trace_log)(uint8_t id, uint8_t src, uint32_t b,
+	uint32_t c)
+{
+	uint32_t core = get_core_num(), irq, head;
+	trace_ring *ring = &trace_rings[core];
+	trace_evt *evt;
+
+	irq = save_and_disable_interrupts();
+	head = ring->head;
+	if(head - ring->tail >= TRACE_DEPTH)
+	{
+		/* full - drop newest */
+		trace_dropped[core]++;
+		restore_interrupts(irq);
+		return;
+	}
+
+	evt = &ring->evt[head & (TRACE_DEPTH-1)];
+	evt->ts = time_us_32();
+	evt->id = id;
+	evt->src = src;
+	evt->b = b;
+	evt->c = c;
+
+	/* publish after the event is complete */
+	__dmb();
+	ring->head = head + 1;
+	restore_interrupts(irq);
+}
+
+/*
+ * send one event to stdio
+ */
+static void trace_print(uint32_t core, const trace_evt *evt)
+{
+#ifdef TRACE_RAW
+	printf("#T %1u %08X %02X %02X %08X %08X\n",
+		(unsigned)core, (unsigned)evt->ts, evt->id, evt->src,
+		(unsigned)evt->b, (unsigned)evt->c);
+#else
+	const char *src = evt->src < TRC_NUM_SRCS ? trace_src_names[evt->src] : "?";
+
+	printf("[%u %10u] %s: ", (unsigned)core, (unsigned)evt->ts, src);
+	if(evt->id < TRC_NUM_EVTS)
+		printf(trace_evt_fmts[evt->id], (unsigned)evt->b, (unsigned)evt->c);
+	else
+		printf("unknown event %d", evt->id);
+	printf("\n\r");
+#endif
+}
+
+/*
+ * format the oldest pending event - call from core 0 idle time
+ * returns 1 if an event was sent
+ */
+int32_t trace_poll(void)
+{
+	static uint32_t last_dropped[2];
+	uint32_t core, tail;
+	trace_ring *ring;
+
+	for(core=0;core<2;core++)
+	{
+		ring = &trace_rings[core];
+
+		/* report drops once per change */
+		if(trace_dropped[core] != last_dropped[core])
+		{
+			last_dropped[core] = trace_dropped[core];
+			printf("trace: core %u dropped %u events\n\r", (unsigned)core,
+				(unsigned)last_dropped[core]);
+		}
+
+		tail = ring->tail;
+		if(tail != ring->head)
+		{
+			__dmb();
+			trace_print(core, &ring->evt[tail & (TRACE_DEPTH-1)]);
+			__dmb();
+			ring->tail = tail + 1;
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * drain everything pending
+ */
+void trace_flush(void)
+{
+	while(trace_poll());
+}
@@ -0,0 +1,82 @@
+/*
+ * trace.h - deferred binary event trace
+ *
+ * Trace points record a fixed-size event into a per-core ring buffer and
+ * return. Formatting happens later when core 0 calls trace_poll() from
+ * its idle loop, so trace points are cheap enough for the audio ISRs.
+ * With TRACE_RAW defined events are sent as hex records instead of text
+ * and decoded on the host by trace_dec.py, which reads the tables below.
+ */
+
+#ifndef __trace__
+#define __trace__
+
+#include "main.h"
+
+/* uncomment to send raw hex records for trace_dec.py */
+//#define TRACE_RAW
+
+/* events per core - must be a power of 2 */
+#define TRACE_DEPTH 256
+
+/* event sources - TRACE_SRC(id, name) */
+#define TRACE_SOURCES \
+	TRACE_SRC(TRC_SRC_SYS,		"SYS") \
+	TRACE_SRC(TRC_SRC_AUDIO,	"Audio") \
+	TRACE_SRC(TRC_SRC_I2S,		"I2S") \
+	TRACE_SRC(TRC_SRC_I2S1,		"I2S1") \
+	TRACE_SRC(TRC_SRC_WM8731,	"WM8731") \
+	TRACE_SRC(TRC_SRC_AIC3101,	"AIC3101") \
+	TRACE_SRC(TRC_SRC_NAU88C22,	"NAU88C22") \
+	TRACE_SRC(TRC_SRC_SGTL5000,	"SGTL5000") \
+	TRACE_SRC(TRC_SRC_UDA1345,	"UDA1345")
+
+/* event types - TRACE_EVT(id, format of args b & c) */
+#define TRACE_EVENTS \
+	TRACE_EVT(TRC_REG_WR,		"write Reg 0x%04X = 0x%04X") \
+	TRACE_EVT(TRC_REG_RD,		"read Reg 0x%04X = 0x%04X") \
+	TRACE_EVT(TRC_REG_BURST,	"burst Reg 0x%04X x %u") \
+	TRACE_EVT(TRC_DELAY,		"delay %u ms") \
+	TRACE_EVT(TRC_FSAMPLE,		"Fsample = %u, frq = 0x%08X") \
+	TRACE_EVT(TRC_MODE,			"mode %u -> %u") \
+	TRACE_EVT(TRC_RATE,			"rate %u Hz in %u us") \
+	TRACE_EVT(TRC_FORMAT,		"format %u, %u-bit words") \
+	TRACE_EVT(TRC_TDM,			"TDM %u slots, %u-bit words") \
+	TRACE_EVT(TRC_CLOCKING,		"codec master %u, %u-bit words") \
+	TRACE_EVT(TRC_DMA_IN,		"input block %u, %u us") \
+	TRACE_EVT(TRC_DMA_OUT,		"output block %u, %u us") \
+	TRACE_EVT(TRC_SLIP,			"slip %u, block ended in half %u") \
+	TRACE_EVT(TRC_RESYNC,		"resync 0x%X, %u us")
+
+#define TRACE_SRC(id, name) id,
+enum trace_srcs { TRACE_SOURCES TRC_NUM_SRCS };
+#undef TRACE_SRC
+
+#define TRACE_EVT(id, fmt) id,
+enum trace_evts { TRACE_EVENTS TRC_NUM_EVTS };
+#undef TRACE_EVT
+
+/* one event - 16 bytes */
+typedef struct
+{
+	uint32_t ts;		// time_us_32() at the trace point
+	uint8_t id;			// TRC_xx event
+	uint8_t src;		// TRC_SRC_xx source
+	uint16_t rsvd;
+	uint32_t b, c;		// event args
+} trace_evt;
+
+/* events enabled at runtime - ISR events are off by default */
+extern volatile uint32_t trace_mask;
+extern volatile uint32_t trace_dropped[2];
+
+void trace_init(void);
+void trace_log(uint8_t id, uint8_t src, uint32_t b, uint32_t c);
+int32_t trace_poll(void);
+void trace_flush(void);
+
+/* skip the call entirely when the event is masked */
+#define TRACE(id, src, b, c) \
+	do { if(trace_mask & (1UL<<(id))) trace_log(id, src, b, c); } while(0)
+
+#endif
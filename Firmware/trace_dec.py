@@ -0,0 +1,56 @@
+#!/usr/bin/env python3
+# trace_dec.py - decode raw trace records ("#T ..." lines, see TRACE_RAW in
+# trace.h) from a captured console log or stdin. Event formats and source
+# names are read from trace.h so the two never drift apart.
+#
+# usage: trace_dec.py [log file] [-h path/to/trace.h]
+
+import os
+import re
+import sys
+
+def load_tables(path):
+    text = open(path).read()
+    srcs = [m.group(2) for m in re.finditer(r'TRACE_SRC\((\w+),\s*"([^"]*)"\)', text)
+            if m.group(1) != 'id']
+    evts = [(m.group(1), m.group(2)) for m in re.finditer(r'TRACE_EVT\((\w+),\s*"([^"]*)"\)', text)
+            if m.group(1) != 'id']
+    return srcs, evts
+
+def decode(line, srcs, evts, last_ts):
+    f = line.split()
+    core, ts, eid, src, b, c = int(f[1]), int(f[2], 16), int(f[3], 16), int(f[4], 16), int(f[5], 16), int(f[6], 16)
+    name = srcs[src] if src < len(srcs) else '?'
+    if eid < len(evts):
+        fmt = evts[eid][1]
+        nargs = len(re.findall(r'%[-0-9]*[duxX]', fmt))
+        msg = fmt % ((b, c)[:nargs])
+    else:
+        msg = 'unknown event %d' % eid
+    # time_us_32() wraps every ~71 minutes
+    dt = (ts - last_ts[core]) & 0xffffffff if last_ts[core] is not None else 0
+    last_ts[core] = ts
+    return '[%d %10d +%7d] %s: %s' % (core, ts, dt, name, msg)
+
+def main():
+    args = sys.argv[1:]
+    hdr = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'trace.h')
+    if '-h' in args:
+        i = args.index('-h')
+        hdr = args[i+1]
+        del args[i:i+2]
+    srcs, evts = load_tables(hdr)
+    inp = open(args[0], errors='replace') if args else sys.stdin
+    last_ts = [None, None]
+    for line in inp:
+        line = line.strip()
+        if line.startswith('#T '):
+            try:
+                print(decode(line, srcs, evts, last_ts))
+            except (ValueError, IndexError):
+                print('bad record: ' + line)
+        elif line:
+            # pass other console output through untouched
+            print(line)
+
+main()
@@ -6,6 +6,9 @@
 #include <stdio.h>
 #include "main.h"
 #include "hardware/i2c.h"
+#include "codec_seq.h"
+#include "codec.h"
+#include "trace.h"
 #include "uda1345.h"
 
 #define L3_DATA_PIN 16
@@ -21,6 +24,21 @@
 #define L3_DA_PWRCTL 0x03
 #define L3_ST_SYSCLK 0x10
 
+/* register address & data widths */
+#define UDA1345_REG_BITS 5
+#define UDA1345_VAL_BITS 6
+#define WR(r, v) SEQ_WR(UDA1345_REG_BITS, UDA1345_VAL_BITS, r, v)
+
+/* Initialization data */
+static const codec_seq_t codec_settings[] CODEC_SEQ =
+{
+	WR(L3_DA_PWRCTL,	0x03),		// ADC on, DAC on
+	WR(L3_DA_VOLUME,	0x00),		// Full volume
+	WR(L3_DA_DEEMPH,	0x00),		// No Deemph, no mute
+	WR(L3_ST_SYSCLK,	0x20),		// 256x, I2S, No DC blk
+	SEQ_END
+};
+
 /*
  * shift 8 bits out
  */
@@ -65,11 +83,30 @@ int32_t UDA1345_WriteRegister(uint8_t Reg, uint8_t Data)
 	gpio_put(L3_MODE_PIN, 1);
 	L3_TX8(dat);
 	
-	printf("UDA1345_WriteRegister: write Reg 0x%02X = 0x%02X\n\r", Reg, Data);
+	TRACE(TRC_REG_WR, TRC_SRC_UDA1345, Reg, Data);
 
 	return 0;
 }
 
+/*
+ * adapter for the sequence player - L3 is write-only
+ */
+static int32_t UDA1345_SeqWrite(uint16_t reg, uint16_t val)
+{
+	return UDA1345_WriteRegister(reg, val);
+}
+
+const codec_seq_if uda1345_if =
+{
+	.name = "UDA1345",
+	.trace_src = TRC_SRC_UDA1345,
+	.reg_stride = 1,
+	.write = UDA1345_SeqWrite,
+};
+
+/* status register shadow - rate & format changes each own some bits */
+static uint8_t uda1345_status = 0x20;
+
 /**
   * @brief  Resets the audio UDA1345. It restores the default configuration of the
   *         UDA1345 (this function shall be called before initializing the UDA1345).
@@ -79,11 +116,90 @@ int32_t UDA1345_WriteRegister(uint8_t Reg, uint8_t Data)
   */
 int32_t UDA1345_Reset(void)
 {
-	UDA1345_WriteRegister(L3_DA_PWRCTL, 0x03);		// ADC on, DAC on
-	UDA1345_WriteRegister(L3_DA_VOLUME, 0x00);		// Full volume
-	UDA1345_WriteRegister(L3_DA_DEEMPH, 0x00);		// No Deemph, no mute
-	UDA1345_WriteRegister(L3_ST_SYSCLK, 0x20);		// 256x, I2S, No DC blk
-	return 0;
+	uda1345_status = 0x20;
+	return codec_seq_play(&uda1345_if, codec_settings);
+}
+
+/**
+  * @brief  Reprogram the UDA1345 system clock setting for a new rate
+  * @note   The UDA1345 tracks fs on its own - only the MCLK ratio matters.
+  * @param  fs: sample rate in Hz
+  * @param  mclk_ratio: MCLK / fs
+  * @retval 0 if ok, else rate not supported
+  */
+int32_t UDA1345_SetRate(uint32_t fs, uint16_t mclk_ratio)
+{
+	uint8_t sysclk;
+
+	if((fs < 8000) || (fs > 96000))
+		return 1;
+
+	switch(mclk_ratio)
+	{
+		case 512: sysclk = 0x00; break;
+		case 384: sysclk = 0x10; break;
+		case 256: sysclk = 0x20; break;
+		default: return 1;
+	}
+
+	uda1345_status = (uda1345_status & ~0x30) | sysclk;
+	codec_seq_t seq[] =
+	{
+		SEQ_WRV(L3_ST_SYSCLK,	uda1345_status),	// ratio, format, No DC blk
+		SEQ_END
+	};
+	return codec_seq_play(&uda1345_if, seq);
+}
+
+/**
+  * @brief  Set the UDA1345 input format
+  * @note   I2S & MSB justified use the leading bits of each slot and
+  *         ignore the rest. LSB justified is only 16, 18 or 20 bits and
+  *         there's no DSP mode.
+  * @param  fmt: FMT_I2S, FMT_LJ or FMT_RJ
+  * @param  bits: 16, 20, 24 or 32
+  * @retval 0 if ok, else format not supported
+  */
+int32_t UDA1345_SetFormat(uint8_t fmt, uint8_t bits)
+{
+	uint8_t ifmt;
+
+	if((bits != 16) && (bits != 20) && (bits != 24) && (bits != 32))
+		return 1;
+
+	switch(fmt)
+	{
+		case FMT_I2S: ifmt = 0x00; break;
+		case FMT_LJ: ifmt = 0x08; break;
+		case FMT_RJ:
+			if(bits == 16)
+				ifmt = 0x02;
+			else if(bits == 20)
+				ifmt = 0x06;
+			else
+				return 1;
+			break;
+		default: return 1;
+	}
+
+	uda1345_status = (uda1345_status & ~0x0e) | ifmt;
+	codec_seq_t seq[] =
+	{
+		SEQ_WRV(L3_ST_SYSCLK,	uda1345_status),	// ratio, format, No DC blk
+		SEQ_END
+	};
+	return codec_seq_play(&uda1345_if, seq);
+}
+
+/**
+  * @brief  Select UDA1345 clocking
+  * @note   The UDA1345 serial port is slave only.
+  * @param  enable: 1 for the codec to drive BCLK & WS, 0 to follow them
+  * @retval 0 if ok, else not supported
+  */
+int32_t UDA1345_SetMaster(uint8_t enable)
+{
+	return enable ? 1 : 0;
 }
 
 /*
@@ -124,8 +240,6 @@ int32_t UDA1345_Init(void)
 	
 	sleep_us(10);
 	
-	UDA1345_Reset();
-	
-	return 0;
+	return UDA1345_Reset();
 }
 
@@ -6,10 +6,18 @@
 #ifndef __UDA1345__
 #define __UDA1345__
 
+#include "codec_seq.h"
+
 int32_t UDA1345_WriteRegister(uint8_t Reg, uint8_t Data);
 int32_t UDA1345_Reset(void);
+int32_t UDA1345_SetRate(uint32_t fs, uint16_t mclk_ratio);
+int32_t UDA1345_SetFormat(uint8_t fmt, uint8_t bits);
+int32_t UDA1345_SetMaster(uint8_t enable);
 int32_t UDA1345_Volume(int8_t vol);
 int32_t UDA1345_Mute(int8_t mute);
 int32_t UDA1345_Init(void);
 
+/* register access for the sequence player & the console */
+extern const codec_seq_if uda1345_if;
+
 #endif
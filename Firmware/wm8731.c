@@ -6,6 +6,9 @@
 #include <stdio.h>
 #include "pico/stdlib.h"
 #include "hardware/i2c.h"
+#include "codec_seq.h"
+#include "codec.h"
+#include "trace.h"
 #include "wm8731.h"
 
 #define I2C_PORT i2c0
@@ -31,26 +34,30 @@ enum wm8731_regs
 	REG_DAIF,
 	REG_SMPL,
 	REG_ACT,
-	REG_RST = 0x0f,
-	REG_EOF = 0xffff
+	REG_RST = 0x0f
 };
 
+/* register address & data widths */
+#define W8731_REG_BITS 7
+#define W8731_VAL_BITS 9
+#define WR(r, v) SEQ_WR(W8731_REG_BITS, W8731_VAL_BITS, r, v)
+
 /* configuration list */
-const uint16_t w8731_init_data[] =
-{
-	REG_RST, 	0x000,	// Reg 0F: soft reset
-	REG_LLIN, 	0x017,	// Reg 00: Left Line In (0dB, mute off)
-	REG_RLIN,	0x017,	// Reg 01: Right Line In (0dB, mute off)
-	REG_LHP,	0x079,	// Reg 02: Left Headphone out (0dB)
-	REG_RHP,	0x079,	// Reg 03: Right Headphone out (0dB)
-	REG_APATH,	0x012,	// Reg 04: Analog Audio Path Control (DAC sel, Mute Mic)
-	REG_DPATH,	0x000,	// Reg 05: Digital Audio Path Control (mute on = 0x8)
-//	REG_PCTL,	0x062,	// Reg 06: Power Down Control (Clkout, Osc, Mic Off)
-	REG_PCTL,	0x022,	// Reg 06: Power Down Control (Osc, Mic Off)
-	REG_DAIF,	0x002,	// Reg 07: Digital Audio Interface Format (msb, 16-bit, slave, I2S)
-	REG_SMPL,	0x000,	// Reg 08: Sampling Control (Normal, 256x, 48k ADC/DAC)
-	REG_ACT,	0x001,	// Reg 09: Active Control
-	REG_EOF				// End of list
+static const codec_seq_t w8731_init_data[] CODEC_SEQ =
+{
+	WR(REG_RST, 	0x000),	// Reg 0F: soft reset
+	WR(REG_LLIN, 	0x017),	// Reg 00: Left Line In (0dB, mute off)
+	WR(REG_RLIN,	0x017),	// Reg 01: Right Line In (0dB, mute off)
+	WR(REG_LHP,		0x079),	// Reg 02: Left Headphone out (0dB)
+	WR(REG_RHP,		0x079),	// Reg 03: Right Headphone out (0dB)
+	WR(REG_APATH,	0x012),	// Reg 04: Analog Audio Path Control (DAC sel, Mute Mic)
+	WR(REG_DPATH,	0x000),	// Reg 05: Digital Audio Path Control (mute on = 0x8)
+//	WR(REG_PCTL,	0x062),	// Reg 06: Power Down Control (Clkout, Osc, Mic Off)
+	WR(REG_PCTL,	0x022),	// Reg 06: Power Down Control (Osc, Mic Off)
+	WR(REG_DAIF,	0x002),	// Reg 07: Digital Audio Interface Format (msb, 16-bit, slave, I2S)
+	WR(REG_SMPL,	0x000),	// Reg 08: Sampling Control (Normal, 256x, 48k ADC/DAC)
+	WR(REG_ACT,		0x001),	// Reg 09: Active Control
+	SEQ_END					// End of list
 };
 
 uint16_t w8731_shadow[W8731_NUM_REGS];
@@ -111,12 +118,28 @@ int32_t WM8731_WriteRegister(uint16_t DevAddr, uint8_t RegisterAddr,
 		return 1;
 	}
 	
-	printf("WM8731_WriteRegister: write to DevAddr 0x%02X / RegisterAddr 0x%02X = 0x%03X\n\r",
-		DevAddr, RegisterAddr, RegisterValue);
+	TRACE(TRC_REG_WR, TRC_SRC_WM8731, RegisterAddr, RegisterValue);
 
 	return 0;
 }
 
+/*
+ * adapter for the sequence player - WM8731 is write-only
+ */
+static int32_t WM8731_SeqWrite(uint16_t reg, uint16_t val)
+{
+	return WM8731_WriteRegister((W8731_ADDR_0), reg, val);
+}
+
+const codec_seq_if wm8731_if =
+{
+	.name = "WM8731",
+	.trace_src = TRC_SRC_WM8731,
+	.reg_stride = 1,
+	.write = WM8731_SeqWrite,
+	.reclock = codec_seq_i2c_reclock,
+};
+
 /**
   * @brief  Resets the audio WM8731. It restores the default configuration of the
   *         WM8731 (this function shall be called before initializing the WM8731).
@@ -126,22 +149,129 @@ int32_t WM8731_WriteRegister(uint16_t DevAddr, uint8_t RegisterAddr,
   */
 int32_t WM8731_Reset(void)
 {
-	int32_t result = 0;
-	uint16_t reg, data;
-	uint8_t idx = 0, tries;
+	/* Load settings from table */
+	return codec_seq_play(&wm8731_if, w8731_init_data);
+}
+
+/* normal mode sample rate codes - bit 3 selects the 44.1k family */
+static const struct
+{
+	uint32_t fs;
+	uint8_t sr;
+} w8731_rates[] =
+{
+	{8000,	0x3},
+	{32000,	0x6},
+	{48000,	0x0},
+	{96000,	0x7},
+	{44100,	0x8},
+	{88200,	0xF},
+};
+
+/**
+  * @brief  Reprogram the WM8731 sampling control for a new rate
+  * @note   The codec is deactivated while the rate changes.
+  * @param  fs: sample rate in Hz
+  * @param  mclk_ratio: MCLK / fs
+  * @retval 0 if ok, else rate not supported or bus error
+  */
+int32_t WM8731_SetRate(uint32_t fs, uint16_t mclk_ratio)
+{
+	uint32_t i, base, mclk = fs * mclk_ratio;
+	uint16_t smpl;
+
+	for(i=0;i<sizeof(w8731_rates)/sizeof(w8731_rates[0]);i++)
+		if(w8731_rates[i].fs == fs)
+			break;
+	if(i == sizeof(w8731_rates)/sizeof(w8731_rates[0]))
+		return 1;
+
+	/* normal mode needs MCLK at 1x or 1.5x the family base, optionally /2 */
+	smpl = w8731_rates[i].sr << 2;
+	base = (w8731_rates[i].sr & 0x8) ? 11289600 : 12288000;
+	if((mclk == 2*base) || (mclk == 3*base))
+	{
+		smpl |= 0x040;	// CLKIDIV2
+		mclk /= 2;
+	}
+	if(2*mclk == 3*base)
+		smpl |= 0x002;	// BOSR
+	else if(mclk != base)
+		return 1;
+
+	codec_seq_t seq[] =
+	{
+		SEQ_WRV(REG_ACT,	0x000),
+		SEQ_WRV(REG_SMPL,	smpl),
+		SEQ_WRV(REG_ACT,	0x001),
+		SEQ_END
+	};
+	return codec_seq_play(&wm8731_if, seq);
+}
+
+/* codec drives BCLK & LRCK */
+static uint8_t wm8731_master;
+
+/**
+  * @brief  Select WM8731 clocking - takes effect at the next SetFormat
+  * @param  enable: 1 for the codec to drive BCLK & LRCK, 0 to follow them
+  * @retval 0 if ok
+  */
+int32_t WM8731_SetMaster(uint8_t enable)
+{
+	wm8731_master = enable ? 1 : 0;
+	return 0;
+}
 
-	/* Load reg/data pairs from table */
-	while((reg = w8731_init_data[2*idx]) != REG_EOF)
+/**
+  * @brief  Set the WM8731 digital audio interface format & word length
+  * @note   The codec is deactivated while the format changes. 32-bit
+  *         isn't available right justified.
+  * @param  fmt: FMT_I2S, FMT_LJ, FMT_RJ, FMT_DSP_A or FMT_DSP_B
+  * @param  bits: 16, 20, 24 or 32
+  * @retval 0 if ok, else format not supported or bus error
+  */
+int32_t WM8731_SetFormat(uint8_t fmt, uint8_t bits)
+{
+	uint16_t daif;
+
+	/* as master BCLK is fixed at MCLK/4 = 64fs so slots are 32-bit */
+	if(wm8731_master && (bits == 16))
+		return 1;
+
+	switch(bits)
 	{
-		data =  w8731_init_data[2*idx+1];
-		tries = 0;
-		while((WM8731_WriteRegister((W8731_ADDR_0), reg, data)!=0) && (tries++ <5));
-		if(tries>4)
-            result++;
-		idx++;
+		case 16: daif = 0 << 2; break;
+		case 20: daif = 1 << 2; break;
+		case 24: daif = 2 << 2; break;
+		case 32: daif = 3 << 2; break;
+		default: return 1;
 	}
 
-	return result;
+	switch(fmt)
+	{
+		case FMT_I2S: daif |= 0x002; break;
+		case FMT_LJ: daif |= 0x001; break;
+		case FMT_RJ:
+			if(bits == 32)
+				return 1;
+			break;
+		case FMT_DSP_A: daif |= 0x013; break;	// MSB on 2nd BCLK
+		case FMT_DSP_B: daif |= 0x003; break;	// MSB on 1st BCLK
+		default: return 1;
+	}
+
+	if(wm8731_master)
+		daif |= 0x040;
+
+	codec_seq_t seq[] =
+	{
+		SEQ_WRV(REG_ACT,	0x000),
+		SEQ_WRV(REG_DAIF,	daif),	// master/slave, format, word length
+		SEQ_WRV(REG_ACT,	0x001),
+		SEQ_END
+	};
+	return codec_seq_play(&wm8731_if, seq);
 }
 
 /*
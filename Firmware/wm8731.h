@@ -6,12 +6,20 @@
 #ifndef __wm8731__
 #define __wm8731__
 
+#include "codec_seq.h"
+
 int32_t WM8731_Init(void);
 int32_t WM8731_Reset(void);
+int32_t WM8731_SetRate(uint32_t fs, uint16_t mclk_ratio);
+int32_t WM8731_SetFormat(uint8_t fmt, uint8_t bits);
+int32_t WM8731_SetMaster(uint8_t enable);
 void WM8731_Mute(uint8_t enable);
 void WM8731_HPVol(uint8_t vol);
 void WM8731_InSrc(uint8_t src);
 void WM8731_InVol(uint8_t vol);
 void WM8731_MicBoost(uint8_t boost);
 
+/* register access for the sequence player & the console */
+extern const codec_seq_if wm8731_if;
+
 #endif